@@ -0,0 +1,88 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_ADAPTER_EMULATOR
+#define _TWOCAN_ADAPTER_EMULATOR
+
+#include "../../Common/inc/twocandriver.h"
+
+#include <stdio.h>
+
+// Adapters that can be emulated
+#define EMULATOR_CANTACT 0
+#define EMULATOR_AXIOMTEK 1
+
+// Default number of frames per second, roughly a busy NMEA 2000 network
+#define CONST_DEFAULT_RATE 1000
+
+// Maximum length of a command sent by the driver
+#define CONST_COMMAND_LENGTH 64
+
+// Bytes of encoded frames that may wait for the driver to read them, further frames are overrun
+// in the same way as a real adapter's transmit buffer
+#define CONST_OUTPUT_BUFFER 65536
+
+// Maximum number of frames encoded before checking for commands from the driver
+#define CONST_FRAME_BATCH 256
+
+// Longest encoded frame, the Axiomtek record with eight data bytes is 33 bytes
+#define CONST_MAX_RECORD 40
+
+// Period between status reports when running verbosely, in microseconds
+#define CONST_REPORT_INTERVAL 1000000
+
+typedef struct Emulator {
+	int adapter;
+	int master;
+	// Frames generated per second, zero generates frames as fast as the driver reads them
+	unsigned long long rate;
+	// Number of frames to generate, zero for no limit
+	unsigned long long limit;
+	int isOpen;
+	int isReporting;
+	int isFinished;
+	char command[CONST_COMMAND_LENGTH];
+	unsigned int commandLength;
+	char output[CONST_OUTPUT_BUFFER];
+	unsigned int outputHead;
+	unsigned int outputTail;
+	// Statistics for the current session
+	unsigned long long startTime;
+	unsigned long long generated;
+	unsigned long long written;
+	unsigned long long overruns;
+	unsigned long long commands;
+	// Frames transmitted by the driver, the number of reads they arrived in and malformed transmit records
+	unsigned long long transmitted;
+	unsigned long long transmitReads;
+	unsigned long long transmitRejects;
+} Emulator;
+
+int OpenPseudoTerminal(Emulator *emulator, char *slaveName, const size_t length);
+void ProcessInput(Emulator *emulator, const char *buffer, const size_t length);
+void ProcessCommand(Emulator *emulator);
+void SendReply(Emulator *emulator, const char *reply);
+int DecodeTransmit(const Emulator *emulator, const char *command, TwoCanFrame *frame);
+unsigned int EncodeFrame(const Emulator *emulator, const TwoCanFrame *frame, char *record);
+unsigned long long GenerateFrames(Emulator *emulator, const unsigned long long now);
+int FlushOutput(Emulator *emulator);
+void ReportStatistics(const Emulator *emulator, FILE *stream);
+
+#endif
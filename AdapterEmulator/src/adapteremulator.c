@@ -0,0 +1,616 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: AdapterEmulator
+// Unit Description: Emulates the Cantact and Axiomtek serial adapters on a pseudo terminal
+// Date: 16/10/2026
+// Function: Creates a pseudo terminal, answers the commands the Cantact and Axiomtek drivers send
+// and, once the driver has opened the adapter, streams synthetic NMEA 2000 frames at a fixed rate.
+// Frames transmitted by the driver are decoded and counted.
+// Used to measure the serial drivers' throughput and latency without CAN hardware.
+// Usage: adapteremulator [-a cantact|axiomtek] [-r frames per second] [-n frames] [-l link] [-k] [-v]
+//
+
+#include "../inc/adapteremulator.h"
+
+#include "../../Common/inc/twocantraffic.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+// Set by the signal handler to end the emulator
+volatile sig_atomic_t isStopping = 0;
+
+// Hex digits used to encode the frames
+static const char hexDigits[] = "0123456789ABCDEF";
+
+static void SignalHandler(int signal) {
+	(void)signal;
+	isStopping = 1;
+}
+
+//
+// Create the pseudo terminal, the driver opens the slave side
+// [in] emulator, the master is saved in emulator->master
+// [out] slaveName, path of the slave side
+// [in] length, size of slaveName
+// returns TRUE if the pseudo terminal was created
+//
+
+int OpenPseudoTerminal(Emulator *emulator, char *slaveName, const size_t length) {
+	int master;
+	char *name;
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0) {
+		fprintf(stderr, "posix_openpt failed: %s\n", strerror(errno));
+		return FALSE;
+	}
+
+	if ((grantpt(master) != 0) || (unlockpt(master) != 0) || ((name = ptsname(master)) == NULL) || (strlen(name) >= length)) {
+		fprintf(stderr, "Unable to unlock the pseudo terminal: %s\n", strerror(errno));
+		close(master);
+		return FALSE;
+	}
+	strcpy(slaveName, name);
+
+	// Raw mode on the master, so the records pass through untranslated
+	struct termios settings;
+	if (tcgetattr(master, &settings) == 0) {
+		cfmakeraw(&settings);
+		tcsetattr(master, TCSANOW, &settings);
+	}
+
+	fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+	emulator->master = master;
+	return TRUE;
+}
+
+//
+// Queue a reply to a command, replies are never overrun
+// [in] emulator
+// [in] reply, null terminated reply
+//
+
+void SendReply(Emulator *emulator, const char *reply) {
+	size_t length = strlen(reply);
+
+	if (length <= (CONST_OUTPUT_BUFFER - emulator->outputTail)) {
+		memcpy(&emulator->output[emulator->outputTail], reply, length);
+		emulator->outputTail += length;
+	}
+}
+
+//
+// Decode a transmit record sent by the driver, the reverse of the driver's AssemblerEncode
+// Cantact: T + 8 hex digit id + length + data, the Axiomtek driver does not transmit
+// [in] emulator
+// [in] command, the record without its line ending
+// [out] frame
+// returns TRUE if the record is well formed
+//
+
+int DecodeTransmit(const Emulator *emulator, const char *command, TwoCanFrame *frame) {
+	const char *p = command;
+	const char *digit;
+	unsigned int value;
+
+	if ((emulator->adapter != EMULATOR_CANTACT) || (*p++ != 'T')) {
+		return FALSE;
+	}
+
+	memset(frame, 0, sizeof(TwoCanFrame));
+
+	// Identifier, length and data are all upper case hexadecimal
+	for (int field = 0; field < 3; field++) {
+		int count = (field == 0) ? 8 : (field == 1) ? 1 : (int)(frame->dlc * 2);
+
+		value = 0;
+		for (int i = 0; i < count; i++) {
+			if ((*p == '\0') || ((digit = strchr(hexDigits, *p)) == NULL)) {
+				return FALSE;
+			}
+			value = (value << 4) | (unsigned int)(digit - hexDigits);
+			p++;
+			if ((field == 2) && ((i & 1) == 1)) {
+				frame->data[i / 2] = (byte)value;
+				value = 0;
+			}
+		}
+
+		if (field == 0) {
+			if (value > CONST_EXTENDED_ID_MASK) {
+				return FALSE;
+			}
+			frame->id = value;
+		}
+		else if (field == 1) {
+			if (value > CONST_PAYLOAD_LENGTH) {
+				return FALSE;
+			}
+			frame->dlc = (byte)value;
+		}
+	}
+
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	return (*p == '\0');
+}
+
+//
+// Act on a complete command
+// Cantact replies with a carriage return, or a bell for an unknown command
+// Axiomtek replies with #OK or #ERROR
+// Transmitted frames are counted and acknowledged with Z, the Cantact being the only serial adapter that transmits
+// [in] emulator, emulator->command holds the command without its line ending
+//
+
+void ProcessCommand(Emulator *emulator) {
+	const char *command = emulator->command;
+	TwoCanFrame frame;
+
+	emulator->commands++;
+
+	if (emulator->adapter == EMULATOR_CANTACT) {
+		switch (command[0]) {
+			case 'C':
+				emulator->isOpen = FALSE;
+				SendReply(emulator, "\r");
+				break;
+			case 'S':
+				// Bit rate, S0 - S8, NMEA 2000 uses S5, 250k
+				SendReply(emulator, ((command[1] >= '0') && (command[1] <= '8')) ? "\r" : "\a");
+				break;
+			case 'O':
+				emulator->isOpen = TRUE;
+				SendReply(emulator, "\r");
+				break;
+			case 'V':
+				SendReply(emulator, "V1010\r");
+				break;
+			case 'T':
+				if (emulator->isOpen && DecodeTransmit(emulator, command, &frame)) {
+					emulator->transmitted++;
+					SendReply(emulator, "Z\r");
+				}
+				else {
+					emulator->transmitRejects++;
+					SendReply(emulator, "\a");
+				}
+				break;
+			default:
+				SendReply(emulator, "\a");
+				break;
+		}
+	}
+	else {
+		// +++ enters command mode, @C1 closes, @B9 sets 250k, @O100 opens and @S3 starts reporting frames
+		if (strcmp(command, "+++") == 0) {
+			SendReply(emulator, "#OK\r\n");
+		}
+		else if (strcmp(command, "@C1") == 0) {
+			emulator->isOpen = FALSE;
+			emulator->isReporting = FALSE;
+			SendReply(emulator, "#OK\r\n");
+		}
+		else if ((strncmp(command, "@B", 2) == 0) && (command[2] != '\0')) {
+			SendReply(emulator, "#OK\r\n");
+		}
+		else if (strncmp(command, "@O", 2) == 0) {
+			emulator->isOpen = TRUE;
+			SendReply(emulator, "#OK\r\n");
+		}
+		else if (strncmp(command, "@S", 2) == 0) {
+			emulator->isReporting = TRUE;
+			SendReply(emulator, "#OK\r\n");
+		}
+		else {
+			SendReply(emulator, "#ERROR\r\n");
+		}
+	}
+}
+
+//
+// Split the data written by the driver into commands
+// Cantact commands end with a carriage return, Axiomtek commands with a line feed
+// [in] emulator
+// [in] buffer, data read from the master
+// [in] length, number of bytes in buffer
+//
+
+void ProcessInput(Emulator *emulator, const char *buffer, const size_t length) {
+	char terminator = (emulator->adapter == EMULATOR_CANTACT) ? '\r' : '\n';
+
+	for (size_t i = 0; i < length; i++) {
+		char c = buffer[i];
+
+		if (c == terminator) {
+			emulator->command[emulator->commandLength] = '\0';
+			if (emulator->commandLength > 0) {
+				ProcessCommand(emulator);
+			}
+			emulator->commandLength = 0;
+		}
+		else if ((c == '\r') || (c == '\n')) {
+			// The other line ending is ignored
+		}
+		else if (emulator->commandLength < (CONST_COMMAND_LENGTH - 1)) {
+			emulator->command[emulator->commandLength++] = c;
+		}
+	}
+
+	// Axiomtek's +++ escape sequence has no line ending
+	if ((emulator->adapter == EMULATOR_AXIOMTEK) && (emulator->commandLength == 3) && (memcmp(emulator->command, "+++", 3) == 0)) {
+		emulator->command[3] = '\0';
+		ProcessCommand(emulator);
+		emulator->commandLength = 0;
+	}
+}
+
+//
+// Encode a frame as the adapter would send it
+// Cantact: T + 8 hex digit id + length + data + carriage return
+// Axiomtek: @F + 4 status digits + format + 8 hex digit id + 2 digit length + data + carriage return, line feed
+// [in] emulator
+// [in] frame
+// [out] record, at least CONST_MAX_RECORD bytes
+// returns the length of the record
+//
+
+unsigned int EncodeFrame(const Emulator *emulator, const TwoCanFrame *frame, char *record) {
+	char *p = record;
+
+	if (emulator->adapter == EMULATOR_CANTACT) {
+		*p++ = 'T';
+	}
+	else {
+		memcpy(p, "@F01001", 7);
+		p += 7;
+	}
+
+	for (int shift = 28; shift >= 0; shift -= 4) {
+		*p++ = hexDigits[(frame->id >> shift) & 0x0F];
+	}
+
+	if (emulator->adapter == EMULATOR_AXIOMTEK) {
+		*p++ = '0';
+	}
+	*p++ = (char)('0' + frame->dlc);
+
+	for (unsigned int i = 0; i < frame->dlc; i++) {
+		*p++ = hexDigits[frame->data[i] >> 4];
+		*p++ = hexDigits[frame->data[i] & 0x0F];
+	}
+
+	*p++ = '\r';
+	if (emulator->adapter == EMULATOR_AXIOMTEK) {
+		*p++ = '\n';
+	}
+
+	return (unsigned int)(p - record);
+}
+
+//
+// Generate the frames due since the last call
+// At a fixed rate frames that do not fit in the output buffer are overrun, as they would be on a real adapter
+// Without a rate, frames are only generated when there is space for them
+// [in] emulator
+// [in] now, GetHostTimestamp
+// returns the number of frames generated
+//
+
+unsigned long long GenerateFrames(Emulator *emulator, const unsigned long long now) {
+	unsigned long long due;
+	unsigned long long count = 0;
+	TwoCanFrame frame;
+
+	if (emulator->rate == 0) {
+		due = CONST_FRAME_BATCH;
+	}
+	else {
+		due = (((now - emulator->startTime) * emulator->rate) / 1000000) - (emulator->generated + emulator->overruns);
+		if (due > CONST_FRAME_BATCH) {
+			due = CONST_FRAME_BATCH;
+		}
+	}
+
+	// Compact the buffer before appending
+	if (emulator->outputHead > 0) {
+		memmove(emulator->output, &emulator->output[emulator->outputHead], emulator->outputTail - emulator->outputHead);
+		emulator->outputTail -= emulator->outputHead;
+		emulator->outputHead = 0;
+	}
+
+	while (count < due) {
+		if ((emulator->limit > 0) && ((emulator->generated + emulator->overruns) >= emulator->limit)) {
+			break;
+		}
+
+		if ((CONST_OUTPUT_BUFFER - emulator->outputTail) < CONST_MAX_RECORD) {
+			if (emulator->rate == 0) {
+				break;
+			}
+			emulator->overruns++;
+		}
+		else {
+			TrafficGenerateFrame(emulator->generated + emulator->overruns, &frame);
+			emulator->outputTail += EncodeFrame(emulator, &frame, &emulator->output[emulator->outputTail]);
+			emulator->generated++;
+		}
+		count++;
+	}
+
+	return count;
+}
+
+//
+// Write as much of the output buffer as the pseudo terminal accepts
+// [in] emulator
+// returns FALSE if the write failed
+//
+
+int FlushOutput(Emulator *emulator) {
+	while (emulator->outputHead < emulator->outputTail) {
+		ssize_t result = write(emulator->master, &emulator->output[emulator->outputHead], emulator->outputTail - emulator->outputHead);
+
+		if (result > 0) {
+			emulator->outputHead += (unsigned int)result;
+			emulator->written += (unsigned long long)result;
+		}
+		else if ((result < 0) && (errno == EINTR)) {
+			continue;
+		}
+		else if ((result < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+			break;
+		}
+		else {
+			return FALSE;
+		}
+	}
+
+	if (emulator->outputHead == emulator->outputTail) {
+		emulator->outputHead = 0;
+		emulator->outputTail = 0;
+	}
+
+	return TRUE;
+}
+
+//
+// Print the statistics of the current session
+// [in] emulator
+// [in] stream, stdout or stderr
+//
+
+void ReportStatistics(const Emulator *emulator, FILE *stream) {
+	double elapsed = (double)(GetHostTimestamp() - emulator->startTime) / 1000000.0;
+
+	if (elapsed <= 0.0) {
+		elapsed = 1e-6;
+	}
+
+	fprintf(stream, "frames %llu, overruns %llu, bytes %llu, %.3f s, %.0f frames/s, %.2f MB/s\n",
+		emulator->generated, emulator->overruns, emulator->written, elapsed,
+		(double)emulator->generated / elapsed, (double)emulator->written / elapsed / 1e6);
+	if ((emulator->transmitted > 0) || (emulator->transmitRejects > 0)) {
+		fprintf(stream, "transmitted %llu in %llu reads, %.1f frames per read, rejected %llu\n",
+			emulator->transmitted, emulator->transmitReads,
+			(emulator->transmitReads > 0) ? (double)emulator->transmitted / (double)emulator->transmitReads : 0.0,
+			emulator->transmitRejects);
+	}
+	fflush(stream);
+}
+
+static void Usage(const char *program) {
+	fprintf(stderr, "Usage: %s [-a cantact|axiomtek] [-r frames per second] [-n frames] [-l link] [-k] [-v]\n", program);
+	fprintf(stderr, "  -a adapter to emulate, default cantact\n");
+	fprintf(stderr, "  -r frames per second, default %d, 0 sends as fast as the driver reads\n", CONST_DEFAULT_RATE);
+	fprintf(stderr, "  -n number of frames per session, default unlimited\n");
+	fprintf(stderr, "  -l symbolic link to create for the slave, eg. /tmp/ttyCANTACT\n");
+	fprintf(stderr, "  -k keep running after the driver closes the adapter\n");
+	fprintf(stderr, "  -v report statistics every second\n");
+}
+
+int main(int argc, char **argv) {
+	static Emulator emulator;
+	char slaveName[TWOCAN_MAX_PATH];
+	const char *linkName = NULL;
+	int keepRunning = FALSE;
+	int isVerbose = FALSE;
+	int option;
+
+	emulator.adapter = EMULATOR_CANTACT;
+	emulator.rate = CONST_DEFAULT_RATE;
+
+	while ((option = getopt(argc, argv, "a:r:n:l:kvh")) != -1) {
+		switch (option) {
+			case 'a':
+				if (strcmp(optarg, "cantact") == 0) {
+					emulator.adapter = EMULATOR_CANTACT;
+				}
+				else if (strcmp(optarg, "axiomtek") == 0) {
+					emulator.adapter = EMULATOR_AXIOMTEK;
+				}
+				else {
+					Usage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+			case 'r':
+				emulator.rate = strtoull(optarg, NULL, 10);
+				break;
+			case 'n':
+				emulator.limit = strtoull(optarg, NULL, 10);
+				break;
+			case 'l':
+				linkName = optarg;
+				break;
+			case 'k':
+				keepRunning = TRUE;
+				break;
+			case 'v':
+				isVerbose = TRUE;
+				break;
+			default:
+				Usage(argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+
+	if (!OpenPseudoTerminal(&emulator, slaveName, sizeof(slaveName))) {
+		return EXIT_FAILURE;
+	}
+
+	if (linkName != NULL) {
+		unlink(linkName);
+		if (symlink(slaveName, linkName) != 0) {
+			fprintf(stderr, "Unable to link %s to %s: %s\n", linkName, slaveName, strerror(errno));
+			close(emulator.master);
+			return EXIT_FAILURE;
+		}
+	}
+
+	signal(SIGINT, SignalHandler);
+	signal(SIGTERM, SignalHandler);
+	signal(SIGPIPE, SIG_IGN);
+
+	// Scripts read the slave's name from the first line
+	printf("%s\n", slaveName);
+	fflush(stdout);
+
+	int isStreaming = FALSE;
+	unsigned long long nextReport = 0;
+	char input[1024];
+
+	while (!isStopping && !emulator.isFinished) {
+		int wasStreaming = isStreaming;
+		unsigned long long now = GetHostTimestamp();
+
+		isStreaming = emulator.isOpen && ((emulator.adapter == EMULATOR_CANTACT) || emulator.isReporting);
+
+		if (isStreaming && !wasStreaming) {
+			// A new session, start counting from zero
+			emulator.startTime = now;
+			emulator.generated = 0;
+			emulator.written = 0;
+			emulator.overruns = 0;
+			emulator.transmitted = 0;
+			emulator.transmitReads = 0;
+			emulator.transmitRejects = 0;
+			nextReport = now + CONST_REPORT_INTERVAL;
+		}
+
+		if (!isStreaming && wasStreaming) {
+			ReportStatistics(&emulator, stdout);
+			if (!keepRunning) {
+				break;
+			}
+		}
+
+		if (isStreaming) {
+			GenerateFrames(&emulator, now);
+			if (isVerbose && (now >= nextReport)) {
+				ReportStatistics(&emulator, stderr);
+				nextReport += CONST_REPORT_INTERVAL;
+			}
+		}
+
+		if (!FlushOutput(&emulator)) {
+			break;
+		}
+
+		// Sleep until the next frame is due, the driver writes a command or the pseudo terminal drains
+		struct pollfd descriptor;
+		int timeout = 100;
+
+		descriptor.fd = emulator.master;
+		descriptor.events = POLLIN;
+		if (emulator.outputHead < emulator.outputTail) {
+			descriptor.events |= POLLOUT;
+		}
+
+		if (isStreaming && (emulator.rate > 0)) {
+			timeout = (int)((CONST_FRAME_BATCH * 1000) / emulator.rate);
+			if (timeout < 1) {
+				timeout = 1;
+			}
+			else if (timeout > 100) {
+				timeout = 100;
+			}
+		}
+		else if (isStreaming && (emulator.outputHead == emulator.outputTail)) {
+			timeout = 0;
+		}
+
+		if (isStreaming && (emulator.limit > 0) && ((emulator.generated + emulator.overruns) >= emulator.limit) && (emulator.outputHead == emulator.outputTail)) {
+			// Everything has been sent, wait for the driver to close the adapter
+			timeout = 100;
+		}
+
+		int result = poll(&descriptor, 1, timeout);
+
+		if (result < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			fprintf(stderr, "poll failed: %s\n", strerror(errno));
+			break;
+		}
+
+		if (descriptor.revents & POLLIN) {
+			ssize_t length = read(emulator.master, input, sizeof(input));
+			if (length > 0) {
+				unsigned long long before = emulator.transmitted + emulator.transmitRejects;
+				ProcessInput(&emulator, input, (size_t)length);
+				if ((emulator.transmitted + emulator.transmitRejects) > before) {
+					emulator.transmitReads++;
+				}
+			}
+		}
+		else if (descriptor.revents & POLLHUP) {
+			// No driver has the slave open, either not yet connected or it has closed the port
+			if (isStreaming) {
+				emulator.isOpen = FALSE;
+				emulator.isReporting = FALSE;
+			}
+			emulator.outputHead = 0;
+			emulator.outputTail = 0;
+			ThreadSleep(10);
+		}
+	}
+
+	if (isStreaming) {
+		ReportStatistics(&emulator, stdout);
+	}
+
+	if (linkName != NULL) {
+		unlink(linkName);
+	}
+	close(emulator.master);
+	return EXIT_SUCCESS;
+}
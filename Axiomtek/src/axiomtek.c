@@ -27,37 +27,52 @@
 // TwoCan byte array and signals an event to the application.
 //
 
-#include "..\inc\axiomtek.h"
+#include "../inc/axiomtek.h"
 
-#include "..\..\common\inc\twocanerror.h"
+#include "../../Common/inc/twocanerror.h"
+
+#include <string.h>
 
 // Separate thread to read data from the serial port
-HANDLE threadHandle;
+TwoCanThread threadHandle;
 
 // The thread id.
 DWORD threadId;
 
 // Event signalled when valid CAN Frame is received
-HANDLE frameReceivedEvent;
+TwoCanEvent frameReceivedEvent;
 
 // Event signalled when the thread has terminated
-HANDLE threadFinishedEvent;
+TwoCanEvent threadFinishedEvent;
+
+// Event signalled by the caller once it has consumed the received frames
+TwoCanEvent frameConsumedEvent;
 
 // Mutex used to synchronize access to the CAN Frame buffer
-HANDLE frameReceivedMutex;
+TwoCanMutex frameReceivedMutex;
 
 // Pointer to the caller's CAN Frame buffer
 byte *canFramePtr;
 
+// Pointer to the caller's ring buffer, used instead of canFramePtr when started by ReadAdapterEx
+TwoCanRing *canRingPtr = NULL;
+
+// Ring buffer owned by the driver, used when started by ReadAdapterBatch
+TwoCanRing batchRing;
+
 // Variable to indicate thread state
 BOOL isRunning = FALSE;
 
-// Handle to the serial port
-HANDLE serialPortHandle;
+// Set once the read thread has been started, until CloseAdapter, isRunning is also cleared if the thread fails
+BOOL isStarted = FALSE;
+
+// The serial port, opened for event driven reads
+TwoCanSerial serialPort = NULL;
 
-// Variable to receive the number of bytes written to the serial port
-int bytesWritten;
+// PGN and source address filters, applied by the read thread
+TwoCanFilterTable acceptanceFilters;
 
+#if defined(_WIN32)
 // Serial Port stuff
 // BUG BUG What about serial ports greater than COM9 which must be specified as "\\\\.\\COM10"
 // How are they returned from the Ports registry entry ??
@@ -68,11 +83,20 @@ int dataBits;
 int stopBits;
 int parity;
 int adapterPresent;
+#else
+// Serial port selected by SetAdapterPort, USB serial adapters ignore the line settings
+TwoCanChar portName[TWOCAN_MAX_PATH] = CONST_SERIAL_PORT;
+int baudRate = 0;
+int dataBits = 8;
+int stopBits = 0;
+int parity = 0;
+#endif
 
 //
 // The DLL entry point
 // 
 
+#if defined(_WIN32)
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved) {
 	switch (fdwReason)	{
 	case DLL_PROCESS_ATTACH:
@@ -91,6 +115,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved)
 	// As nothing to do, just return TRUE
 	return TRUE;
 }
+#endif
 
 //
 // Drivername,
@@ -120,6 +145,23 @@ DllExport char *ManufacturerName(void)	{
 	return (char *)L"Axiomtek";
 }
 
+#if !defined(_WIN32)
+//
+// Select the serial port opened by OpenAdapter, Windows retrieves the port from the registry
+// [in] name, eg. /dev/ttyUSB0 or the slave side of a pseudo terminal
+// returns TWOCAN_RESULT_SUCCESS if the name is valid
+//
+
+DllExport int SetAdapterPort(const char *name) {
+	if ((name == NULL) || (*name == '\0') || (strlen(name) >= TWOCAN_MAX_PATH)) {
+		DebugPrintf(L"Invalid serial port name\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_ADAPTER_NOT_FOUND);
+	}
+	strcpy(portName, name);
+	return TWOCAN_RESULT_SUCCESS;
+}
+#endif
+
 //
 // Open, connect to the adapter and get ready to start reading
 // returns TWOCAN_RESULT_SUCCESS if events and mutexes and adapter configured correctly
@@ -128,37 +170,57 @@ DllExport char *ManufacturerName(void)	{
 DllExport int OpenAdapter(void)	{
 	DebugPrintf(L"Open Adapter called\n");
 
+	// The events and mutex are created by the first OpenAdapter and kept for the life of the driver, see CloseAdapter
 	// Create an event that is used to notify the caller of a received frame
-	frameReceivedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_DATARX_EVENT);
+	if (frameReceivedEvent == NULL) {
+		frameReceivedEvent = EventCreate(CONST_DATARX_EVENT);
+	}
 
 	if (frameReceivedEvent == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_EVENT);
 	}
 
 	// Create an event that is used to notify the close method that the thread has ended
-	threadFinishedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_EVENT_THREAD_ENDED);
+	if (threadFinishedEvent == NULL) {
+		threadFinishedEvent = EventCreate(CONST_EVENT_THREAD_ENDED);
+	}
 
 	if (threadFinishedEvent == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_COMPLETE_EVENT);
 	}
 
+	// Create an event that the caller signals once it has consumed the received frames
+	if (frameConsumedEvent == NULL) {
+		frameConsumedEvent = EventCreate(CONST_DATACONSUMED_EVENT);
+	}
+
+	if (frameConsumedEvent == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Create FrameConsumed Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT);
+	}
+
 	// Open the mutex that is used to synchronize access to the Can Frame buffer
 	// Initial state set to true, meaning we "own" the initial state of the mutex
-	frameReceivedMutex = OpenMutex(SYNCHRONIZE, TRUE, CONST_MUTEX_NAME);
+	if (frameReceivedMutex == NULL) {
+		frameReceivedMutex = MutexOpen(CONST_MUTEX_NAME);
+	}
 
 	if (frameReceivedMutex == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Open Mutex failed (%d)\n", GetLastError());
+		DebugPrintf(L"Open Mutex failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_MUTEX);
 	}
 
+#if defined(_WIN32)
 	// Retrieve COM Port Settings from Registry
 	if (GetRegistrySettings(friendlyName, portName, &baudRate, &dataBits, &stopBits, &parity, &adapterPresent)) {
 		DebugPrintf(L"Name: %s\nPort: %s\n", friendlyName, portName);
@@ -169,9 +231,21 @@ DllExport int OpenAdapter(void)	{
 		DebugPrintf(L"Adapter not present");
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_ADAPTER_NOT_FOUND);
 	}
+#else
+	// The adapter is present if its serial port exists
+	if (!FileExists(portName)) {
+		// Fatal error
+		DebugPrintf(L"Adapter not present: %s\n", portName);
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_ADAPTER_NOT_FOUND);
+	}
+#endif
 
 	// Configure serial port settings
-	ConfigureSerialPort();
+	int result;
+	result = ConfigureSerialPort();
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		return result;
+	}
 
 	// Axiomtek specific commands to set the bit rate, reporting mode, open the port.
 	ConfigureAdapter();
@@ -187,50 +261,48 @@ DllExport int OpenAdapter(void)	{
 DllExport int CloseAdapter(void)	{
 	// Terminate the read thread
 	isRunning = FALSE;
+	isStarted = FALSE;
 
-	// Wait for the thread to exit
-	int waitResult;
-	waitResult = WaitForSingleObject(threadFinishedEvent, 1000);
-	if (waitResult == WAIT_TIMEOUT) {
-		DebugPrintf(L"Wait for threadFinishedEvent timed out");
-	}
-	if (waitResult == WAIT_ABANDONED) {
-		DebugPrintf(L"Wait for threadFinishedEvent abandoned");
-	}
-	if (waitResult == WAIT_FAILED) {
-		DebugPrintf(L"Wait for threadFinishedEvent Error: %d", GetLastError());
-	}
+	// Wait for the thread to exit, if it was started
+	int waitResult = TWOCAN_WAIT_SIGNALLED;
+	if (threadHandle != NULL) {
+		waitResult = EventWait(threadFinishedEvent, 1000);
+		if (waitResult == TWOCAN_WAIT_TIMEOUT) {
+			DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		}
+		if (waitResult == TWOCAN_WAIT_FAILED) {
+			DebugPrintf(L"Wait for threadFinishedEvent Error: %d", PlatformGetLastError());
+		}
 
-	// Close all the handles
-	int closeResult;
-	closeResult = CloseHandle(threadFinishedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadFinsishedEvent Error: %d", GetLastError());
+		// Release the handle, a thread that has not exited keeps running until it returns
+		int closeResult;
+		closeResult = ThreadClose(threadHandle);
+		if (closeResult == 0) {
+			DebugPrintf(L"Close threadHandle Error: %d", PlatformGetLastError());
+		}
+		threadHandle = NULL;
 	}
 
-	closeResult = CloseHandle(frameReceivedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close frameReceivedEvent Error: %d", GetLastError());
-	}
-	closeResult = CloseHandle(threadHandle);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadHandle Error: %d", GetLastError());
+	// The events and mutex are kept for the life of the driver rather than closed, a read thread that has
+	// not exited or a caller still waiting in ReadAdapterBatch may be using them
+
+	// A read thread that has not exited may still be reading from the adapter, so it is left open
+	if (waitResult != TWOCAN_WAIT_SIGNALLED) {
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_DELETE_THREAD_HANDLE);
 	}
 
 	// Close the Axiomtek Adapter
-	WriteFile(serialPortHandle, "+++\r\n", 5, &bytesWritten, NULL);
+	SerialWrite(serialPort, "+++\r\n", 5);
 	
-	WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
+	SerialWrite(serialPort, "\r\n", 2);
 	
-	WriteFile(serialPortHandle, "@C1\r\n", 5, &bytesWritten, NULL);
+	SerialWrite(serialPort, "@C1\r\n", 5);
 	
-	WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
+	SerialWrite(serialPort, "\r\n", 2);
 	
 	// Close the serial port
-	closeResult = CloseHandle(serialPortHandle);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close Serial Port Error: %d", GetLastError());
-	}
+	SerialClose(serialPort);
+	serialPort = NULL;
 
 	return TWOCAN_RESULT_SUCCESS;
 }
@@ -245,185 +317,267 @@ DllExport int CloseAdapter(void)	{
 DllExport int ReadAdapter(byte *frame)	{
 	// Save the pointer to the Can Frame
 	canFramePtr = frame;
+	canRingPtr = NULL;
 	
 	// Start the read thread
 	isRunning = TRUE;
-	threadHandle = CreateThread(NULL, 0, ReadThread, NULL, 0, &threadId);
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
 	if (threadHandle != NULL) {
+		isStarted = TRUE;
 		DebugPrintf(L"Axiomtek read thread started: %d\n", threadId);
 		return TWOCAN_RESULT_SUCCESS;
 	}
 	isRunning = FALSE;
-	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, GetLastError());
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
 	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
 }
 
 //
-// Read thread, reads data from the serial port, if a valid Cantact Frame is received,
-// process and notify the caller
-// Upon exit, returns TWOCAN_RESULT_SUCCESS as the Thread Exit Code
+// ReadEx, starts the read thread, received frames are queued in the caller's ring buffer
+// [in] ring, pointer to a ring buffer initialised with RingInitialise
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
 //
 
-DWORD WINAPI ReadThread(LPVOID lpParam)
-{
-	DWORD mutexResult;
-	char *getPtr;
-	char *putPtr;
-	char serialBuffer[1024];
-	char assemblyBuffer[4096];
-	DWORD bytesRead;
-	int bytesRemaining;
+DllExport int ReadAdapterEx(TwoCanRing *ring)	{
+	if (!RingIsValid(ring)) {
+		DebugPrintf(L"Invalid ring buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_RING);
+	}
 
-	BOOL start;
-	BOOL end;
-	BOOL partial;
+	// Save the pointer to the ring buffer
+	canRingPtr = ring;
+	canFramePtr = NULL;
+	
+	// Start the read thread
+	isRunning = TRUE;
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		DebugPrintf(L"Axiomtek read thread started: %d\n", threadId);
+		return TWOCAN_RESULT_SUCCESS;
+	}
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
+}
 
-	while (isRunning) {
+//
+// ReadBatch, returns the frames received since the previous call, waiting up to timeoutMs if none are queued
+// The first call starts the read thread, frames are then queued in the driver's own ring buffer between calls
+// [out] frames, pointer to the caller's array of CAN Frames
+// [in] capacity, number of CAN Frames the array can hold
+// [out] count, number of CAN Frames returned, zero if the wait timed out
+// [in] timeoutMs, maximum time to wait for a frame
+// Returns TWOCAN_RESULT_SUCCESS if the read thread is running
+//
 
-		start = FALSE;
-		end = FALSE;
-		partial = FALSE;
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs)	{
+	int result;
 
-		putPtr = assemblyBuffer;
+	if ((frames == NULL) || (count == NULL) || (capacity <= 0)) {
+		DebugPrintf(L"Invalid frame buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
 
+	*count = 0;
 
-		if (ReadFile(serialPortHandle, &serialBuffer, sizeof(serialBuffer), &bytesRead, NULL) != FALSE) {
+	if (!isStarted) {
+		RingInitialise(&batchRing, CONST_RING_CAPACITY);
+		result = ReadAdapterEx(&batchRing);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			return result;
+		}
+	}
+	else if (canRingPtr != &batchRing) {
+		// Already started by ReadAdapter or ReadAdapterEx
+		DebugPrintf(L"Read thread already running\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_READ_FUNCTION);
+	}
+	else if ((!isRunning) && (RingCount(&batchRing) == 0)) {
+		// The read thread ended after a fatal error, once its last frames have been returned. It is not restarted
+		DebugPrintf(L"Read thread has stopped\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_RECEIVE_FAILURE);
+	}
 
-			bytesRemaining = bytesRead;
-			getPtr = serialBuffer;
+	if (RingCount(&batchRing) == 0) {
+		EventWait(frameReceivedEvent, timeoutMs);
+	}
 
-			while (bytesRemaining != 0) {
+	*count = RingReadBatch(&batchRing, frames, capacity);
 
-				// start character
-				if ((*getPtr == '@') || (*getPtr == '#')) {
-					start = TRUE;
-					*putPtr = *getPtr;
-					putPtr++;
-				}
+	// Let the read thread know there is space in the ring
+	EventSet(frameConsumedEvent);
 
-				// normal character
-				if ((*getPtr != '\n') && (*getPtr != '\r') && (*getPtr != '@') && (*getPtr != '#')){
-					*putPtr = *getPtr;
-					putPtr++;
-				}
+	return TWOCAN_RESULT_SUCCESS;
+}
 
-				// end character
-				if (*getPtr == '\n') {
-					end = TRUE;
-				}
+//
+// Filter, accept only the listed PGNs, may be called before or after OpenAdapter
+// The adapter has no extended frame acceptance filter, so the read thread applies the filters
+// [in] filters, pointer to array of PGN and source address filters
+// [in] count, number of filters, zero accepts every frame
+// returns TWOCAN_RESULT_SUCCESS if the filters are valid
+//
 
-				// end character but no start or partial
-				if ((end) && (!start) && (!partial)) {
-					start = FALSE;
-					end = FALSE;
-					partial = FALSE;
-					putPtr = assemblyBuffer;
-				}
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count)	{
+	if (!FilterTableUpdate(&acceptanceFilters, filters, count)) {
+		DebugPrintf(L"Invalid acceptance filters\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
 
-				//assert((putChar - assemblyBuffer) > sizeof(assemblyBuffer));
+//
+// Subscribe, add a PGN to the acceptance filters, may be called before or after OpenAdapter
+// Frames of other PGNs are discarded by the read thread once any filter is set
+// [in] pgn, as for TwoCanFilter
+// [in] source, source address or CONST_FILTER_ANY_SOURCE
+// returns TWOCAN_RESULT_SUCCESS if the PGN is now accepted
+//
 
-				// have a complete frame			
-				if (((start) && (end)) || ((partial) && (end)))  {
+DllExport int SubscribePgn(unsigned int pgn, int source)	{
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableSubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"Invalid subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
 
-					// ignore Axiomtek #OK & #ERROR messages
-					if (assemblyBuffer[0] == '#') {
-						start = FALSE;
-						end = FALSE;
-						partial = FALSE;
-						putPtr = assemblyBuffer;
-					}
+//
+// Unsubscribe, remove a PGN added with SubscribePgn or SetAcceptanceFilters
+// Removing the last PGN leaves no filters, so every frame is accepted again
+// [in] pgn, source, as given when the PGN was added
+// returns TWOCAN_RESULT_SUCCESS if the PGN was removed
+//
 
-					// Check we have the frame start character (@), CAN frame identifier (F) and extended frame identifier (1)
-					if ((assemblyBuffer[0] == AXIOMTEK_FRAME_START) && (assemblyBuffer[1] == AXIOMTEK_FRAME_HEADER) && (assemblyBuffer[6] == '1')) {
+DllExport int UnsubscribePgn(unsigned int pgn, int source)	{
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableUnsubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"No subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
 
-						// 8 hexadecimal characters respresent the 4 byte CAN Header
-						byte headerAsString[CONST_HEADER_LENGTH * 2];
+//
+// Read thread, reads data from the serial port, if a valid Cantact Frame is received,
+// process and notify the caller
+// Upon exit, returns TWOCAN_RESULT_SUCCESS as the Thread Exit Code
+//
 
-						// copy the header bytes from the Axiomtek string
-						memcpy(headerAsString, &assemblyBuffer[7], CONST_HEADER_LENGTH * 2);
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam)
+{
+	TwoCanAssembler assembler;
+	TwoCanFrame frames[CONST_ASSEMBLER_BATCH];
+	char serialBuffer[1024];
+	unsigned int bytesRead;
+	unsigned int offset;
+	unsigned int consumed;
+	unsigned long long timestamp;
+	int readResult;
+	int frameCount;
 
-						// convert hexadecimal string to byte array 
-						byte *headerAsByte;
-						headerAsByte = (byte *)malloc(CONST_HEADER_LENGTH * sizeof(byte));
-						ConvertHexStringToByteArray(headerAsString, CONST_HEADER_LENGTH, headerAsByte);
+	// The assembler carries partial records over from one read to the next
+	AssemblerInitialise(&assembler, TWOCAN_ASSEMBLER_AXIOMTEK);
 
-						// reverse the integer bytes (I assume Endianess)
-						ReverseHeader(headerAsByte);
+	while (isRunning) {
 
-						// now retrieve the payload
-						int payload_len;
-						byte *payload;
+		// Sleep until bytes arrive, waking periodically to check whether the thread has been stopped
+		readResult = SerialRead(serialPort, serialBuffer, sizeof(serialBuffer), &bytesRead, CONST_SERIAL_TIMEOUT);
 
-						// payload length is transmitted in byte 15 & 16
-						payload_len = assemblyBuffer[16] - '0';
-						payload = (byte *)malloc(payload_len * 2 * sizeof(byte));
+		if (readResult == TWOCAN_WAIT_FAILED) {
+			// Avoid spinning on a port that has gone away
+			DebugPrintf(L"Serial Read Error: %d\n", PlatformGetLastError());
+			ThreadSleep(CONST_SERIAL_TIMEOUT);
+		}
 
-						// copy payload from axiomtek string 
-						memcpy(payload, &assemblyBuffer[17], payload_len * 2);
+		if (readResult == TWOCAN_WAIT_SIGNALLED) {
 
-						// convert hex characters to byte array
-						byte *data;
-						data = (byte *)malloc(payload_len * sizeof(byte));
+			timestamp = GetHostTimestamp();
+			offset = 0;
 
-						ConvertHexStringToByteArray(payload, payload_len, data);
+			while (offset < bytesRead) {
+				frameCount = AssemblerPush(&assembler, &serialBuffer[offset], bytesRead - offset, timestamp, frames, CONST_ASSEMBLER_BATCH, &consumed);
+				offset += consumed;
 
-						// make sure we can get a lock on the buffer
-						mutexResult = WaitForSingleObject(frameReceivedMutex, INFINITE);
+				for (int i = 0; i < frameCount; i++) {
+					// Only interested in CAN 2.0 extended data frames that pass the filters
+					if (((frames[i].flags & (TWOCAN_FRAME_FLAG_EXTENDED | TWOCAN_FRAME_FLAG_REMOTE)) == TWOCAN_FRAME_FLAG_EXTENDED) &&
+						(FilterTableMatch(&acceptanceFilters, frames[i].id))) {
+						PostFrame(&frames[i]);
+					}
+				}
+			}
 
-						if (mutexResult == WAIT_OBJECT_0) {
+		} // end if SerialRead
 
-							// copy the final data here
-							memcpy(&canFramePtr[0], headerAsByte, CONST_HEADER_LENGTH);
-							memcpy(&canFramePtr[4], data, payload_len);
+	} // while isRunning
 
-							// release the lock
-							ReleaseMutex(frameReceivedMutex);
+	if (assembler.rejectCount > 0) {
+		DebugPrintf(L"Axiomtek discarded %d malformed records\n", assembler.rejectCount);
+	}
 
-							// notify the caller
-							if (SetEvent(frameReceivedEvent)) {
-								Sleep(5);
-							}
-							else {
-								DebugPrintf(L"Set Event Error: %d\n", GetLastError());
-							}
+	EventSet(threadFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
 
-						}
+//
+// Whether the serial port's input buffer is close to overrunning, so the read thread must stop waiting for the caller
+// returns non zero if CONST_SERIAL_QUEUE_LIMIT or more bytes are waiting
+//
 
-						else {
-							DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, GetLastError());
-						}
+int ReceiveQueueFilling(void) {
+	return (SerialBytesQueued(serialPort) >= CONST_SERIAL_QUEUE_LIMIT);
+}
 
-						// free the malloc's
-						free(headerAsByte);
-						free(payload);
-						free(data);
-					}
+//
+// Hand a received frame to the caller, either by queueing it in the caller's ring buffer
+// or by converting it into the caller's single 12 byte CAN Frame buffer
+// [in] frame, pointer to CAN Frame
+//
 
-					// processed a valid frame so reset all 
-					start = FALSE;
-					end = FALSE;
-					partial = FALSE;
-					putPtr = assemblyBuffer;
+void PostFrame(const TwoCanFrame *frame) {
+	int mutexResult;
 
-				}
+	if (canRingPtr != NULL) {
+		// Back pressure, wait for the caller to drain a full ring while the serial port buffers incoming frames.
+		// No lock required, the frame is only discarded, and counted as an overflow, once the serial port's input buffer
+		// is in danger of dropping frames itself
+		while ((isRunning) && (RingIsFull(canRingPtr)) && (!ReceiveQueueFilling())) {
+			EventWait(frameConsumedEvent, CONST_BACK_PRESSURE_WAIT);
+		}
 
-				getPtr++;
-				bytesRemaining--;
+		if (RingWrite(canRingPtr, frame)) {
+			if (!EventSet(frameReceivedEvent)) {
+				DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+			}
+		}
+		return;
+	}
 
+	// Make sure we can get a lock on the buffer
+	mutexResult = MutexLock(frameReceivedMutex, TWOCAN_WAIT_INFINITE);
 
-			} // end while bytesRemaining != 0
+	if (mutexResult == TWOCAN_WAIT_SIGNALLED) {
 
-			// had a start character but no end character, therefore a partial frame
-			if ((start) && (!end)) {
-				partial = TRUE;
-			}
+		ConvertFrameToByteArray(frame, canFramePtr);
 
-		} // end if ReadFile
+		// Release the lock
+		MutexUnlock(frameReceivedMutex);
 
-	} // while isRunning
+		// Notify the caller
+		if (EventSet(frameReceivedEvent)) {
+			// Wait for the caller to acknowledge the frame before it can be overwritten,
+			// callers that never signal frameConsumedEvent are paced by the timeout
+			EventWait(frameConsumedEvent, 5);
+		}
+		else {
+			DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+		}
+	}
 
-	SetEvent(threadFinishedEvent);
-	ExitThread(TWOCAN_RESULT_SUCCESS);
+	else {
+		DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, PlatformGetLastError());
+	}
 }
 
 //
@@ -433,57 +587,20 @@ DWORD WINAPI ReadThread(LPVOID lpParam)
 
 int ConfigureSerialPort(void) {
 
-	serialPortHandle = CreateFile(portName, GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+	// Overlapped I/O, the read thread sleeps until the driver reports a received character
+	serialPort = SerialOpen(portName, baudRate, dataBits, stopBits, parity);
 
-	if (serialPortHandle == INVALID_HANDLE_VALUE) {
-		DebugPrintf(L"Error opening %ls\n", portName);
+	if (serialPort == NULL) {
+		DebugPrintf(L"Error opening %ls (%d)\n", portName, PlatformGetLastError());
 		return 	SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_SERIALPORT);
 	}
-
+	
 	DebugPrintf(L"Opened port %ls\n", portName);
+	DebugPrintf(L"Baudrate = %d\n", baudRate);
+	DebugPrintf(L"Data bits = %d\n", dataBits);
+	DebugPrintf(L"Stop bits = %d\n", stopBits);
+	DebugPrintf(L"Parity = %d\n", parity);
 
-	DCB dcbSettings = { 0 };
-	dcbSettings.DCBlength = sizeof(dcbSettings);
-
-	if (!GetCommState(serialPortHandle, &dcbSettings)) {
-		DebugPrintf(L"Error retrieving GetCommState %d\n", GetLastError());
-		// BUG BUG need error handling
-	}
-
-	// default settings for Cantact device
-	// BUG BUG should retrieve these automagically from the registry
-	dcbSettings.BaudRate = baudRate;
-	dcbSettings.ByteSize = dataBits;
-	dcbSettings.StopBits = stopBits;
-	dcbSettings.Parity = parity;
-
-	if (!SetCommState(serialPortHandle, &dcbSettings))  	{
-		DebugPrintf(L"Error setting DCB Structure %d\n", GetLastError());
-		// BUG BUG need error handling
-	}
-	else
-	{
-		DebugPrintf(L"Set DCB Structure\n");
-		DebugPrintf(L"Baudrate = %d\n", dcbSettings.BaudRate);
-		DebugPrintf(L"Data bits = %d\n", dcbSettings.ByteSize);
-		DebugPrintf(L"Stop bits = %d\n", dcbSettings.StopBits);
-		DebugPrintf(L"Parity = %d\n", dcbSettings.Parity);
-	}
-
-	COMMTIMEOUTS timeouts = { 0 };
-	timeouts.ReadIntervalTimeout = 10;
-	timeouts.ReadTotalTimeoutConstant = 0;
-	timeouts.ReadTotalTimeoutMultiplier = 0;
-	timeouts.WriteTotalTimeoutConstant = 10;
-	timeouts.WriteTotalTimeoutMultiplier = 0;
-
-	if (!SetCommTimeouts(serialPortHandle, &timeouts)) {
-		DebugPrintf(L"Error setting Time Outs %ld\n", GetLastError());
-		// BUG BUG need error handling
-	}
-	else {
-		DebugPrintf(L"Setting Serial Port Timeouts Successful\n");
-	}
 	return TWOCAN_RESULT_SUCCESS;
 }
 
@@ -495,37 +612,39 @@ int ConfigureSerialPort(void) {
 
 int ConfigureAdapter(void) {
 	
-	if (serialPortHandle != NULL) {
+	if (serialPort != NULL) {
+		int writeResult;
+
 		
-		WriteFile(serialPortHandle, "+++\r\n", 5, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek Commnd Mode +++: %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "+++\r\n", 5);
+		DebugPrintf(L"Axiomtek Commnd Mode +++: %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek CrLf %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "\r\n", 2);
+		DebugPrintf(L"Axiomtek CrLf %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "@C1\r\n", 5, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek Close Port @C1: %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "@C1\r\n", 5);
+		DebugPrintf(L"Axiomtek Close Port @C1: %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek CrLf %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "\r\n", 2);
+		DebugPrintf(L"Axiomtek CrLf %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "@B9\r\n", 5, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek Set Bitrate @B9: %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "@B9\r\n", 5);
+		DebugPrintf(L"Axiomtek Set Bitrate @B9: %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek CrLf %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "\r\n", 2);
+		DebugPrintf(L"Axiomtek CrLf %d\n", writeResult);
 
-		WriteFile(serialPortHandle, "@O100\r\n", 7, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek Open Port 1 @O100: %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "@O100\r\n", 7);
+		DebugPrintf(L"Axiomtek Open Port 1 @O100: %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek CrLf %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "\r\n", 2);
+		DebugPrintf(L"Axiomtek CrLf %d\n", writeResult);
 		
-		WriteFile(serialPortHandle, "@S3\r\n", 5, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek  Report Mode @S3: %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "@S3\r\n", 5);
+		DebugPrintf(L"Axiomtek  Report Mode @S3: %d\n", writeResult);
 
-		WriteFile(serialPortHandle, "\r\n", 2, &bytesWritten, NULL);
-		DebugPrintf(L"Axiomtek CrLf %d\n", bytesWritten);
+		writeResult = SerialWrite(serialPort, "\r\n", 2);
+		DebugPrintf(L"Axiomtek CrLf %d\n", writeResult);
 
 		return TWOCAN_RESULT_SUCCESS;
 	}
@@ -535,6 +654,7 @@ int ConfigureAdapter(void) {
 	}
 }
 
+#if defined(_WIN32)
 // Retrieve COM Port settings from the registry
 //
 // From the Axiomtek.inf installation file
@@ -579,7 +699,7 @@ int GetRegistrySettings(WCHAR *friendlyName, WCHAR *portName, int *baudRate, int
 	}
 
 	// Key is present assume Axiomtek device has at least been installed
-	DebugPrintf(L"RegOpenKey: %d (%d)\n", result, GetLastError());
+	DebugPrintf(L"RegOpenKey: %d (%d)\n", result, PlatformGetLastError());
 
 	// Iterate the sub keys until we find a sub key that contains the matching classGUID
 	for (int i = 0;; i++) {
@@ -702,7 +822,7 @@ int GetRegistrySettings(WCHAR *friendlyName, WCHAR *portName, int *baudRate, int
 
 						}
 						else {
-							DebugPrintf(L"Error %d (%d)\n", result, GetLastError());
+							DebugPrintf(L"Error %d (%d)\n", result, PlatformGetLastError());
 						}
 
 					}
@@ -721,3 +841,4 @@ int GetRegistrySettings(WCHAR *friendlyName, WCHAR *portName, int *baudRate, int
 
 	return TRUE;
 }
+#endif
@@ -0,0 +1,196 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: AssemblerBenchmark
+// Unit Description: Throughput and correctness of the SLCAN and Axiomtek record assembler
+// Date: 16/10/2026
+// Function: Builds a synthetic stream of random extended frames for each format, with a corrupt record
+// every CONST_CORRUPT_INTERVAL frames and, for Axiomtek, # responses between the reports.
+// The stream is pushed in 4096 byte reads, as from the serial port, and one byte at a time.
+// Every decoded frame is checked against the frame it was encoded from and every corrupt record must be rejected.
+// Usage: assemblerbench [frames]
+// Returns 0 if every frame decoded correctly
+//
+
+#include "../../Common/inc/twocanassembler.h"
+#include "../../Common/inc/twocanplatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Frames in each stream unless given on the command line
+#define CONST_DEFAULT_FRAMES 2000000
+
+// A corrupt record precedes every nth frame
+#define CONST_CORRUPT_INTERVAL 50
+
+// An Axiomtek # response precedes every nth frame
+#define CONST_RESPONSE_INTERVAL 100
+
+// Longest encoded record, including a corrupt record and a response before it
+#define CONST_RECORD_SPACE 64
+
+// Frames returned by each call to AssemblerPush
+#define CONST_BATCH 64
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+//
+// Build a stream of records with the frames they encode
+// [in] format, TWOCAN_ASSEMBLER_xxx
+// [in] count, number of frames
+// [out] frames, the frames encoded, in order
+// [out] length, number of bytes in the stream
+// returns the stream, allocated with malloc
+//
+
+static char *BuildStream(const int format, const unsigned int count, TwoCanFrame *frames, size_t *length) {
+	char *stream = (char *)malloc((size_t)count * CONST_RECORD_SPACE);
+	char *position = stream;
+
+	if (stream == NULL) {
+		return NULL;
+	}
+
+	srand(1);
+	for (unsigned int i = 0; i < count; i++) {
+		TwoCanFrame *frame = &frames[i];
+
+		memset(frame, 0, sizeof(TwoCanFrame));
+		frame->id = ((unsigned int)rand() << 16 ^ (unsigned int)rand()) & CONST_EXTENDED_ID_MASK;
+		frame->dlc = (byte)(rand() % (CONST_PAYLOAD_LENGTH + 1));
+		frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+		for (int j = 0; j < frame->dlc; j++) {
+			frame->data[j] = (byte)rand();
+		}
+
+		if (format == TWOCAN_ASSEMBLER_SLCAN) {
+			if ((i % CONST_CORRUPT_INTERVAL) == 0) {
+				// A non hexadecimal digit in the identifier
+				position += sprintf(position, "T12G45678%d\r", frame->dlc);
+			}
+			position += sprintf(position, "T%08X%d", frame->id, frame->dlc);
+		}
+		else {
+			if ((i % CONST_RESPONSE_INTERVAL) == 0) {
+				position += sprintf(position, "#OK\r\n");
+			}
+			if ((i % CONST_CORRUPT_INTERVAL) == 0) {
+				position += sprintf(position, "@F00001" "1G345678%02d\r\n", frame->dlc);
+			}
+			position += sprintf(position, "@F00001" "%08X%02d", frame->id, frame->dlc);
+		}
+
+		for (int j = 0; j < frame->dlc; j++) {
+			*position++ = hexDigits[frame->data[j] >> 4];
+			*position++ = hexDigits[frame->data[j] & 0x0F];
+		}
+		position += sprintf(position, (format == TWOCAN_ASSEMBLER_SLCAN) ? "\r" : "\r\n");
+	}
+
+	*length = (size_t)(position - stream);
+	return stream;
+}
+
+//
+// Decode a stream in reads of a fixed size and check every frame
+// [in] format, TWOCAN_ASSEMBLER_xxx
+// [in] stream, length, the records
+// [in] expected, count, the frames the stream encodes
+// [in] readSize, bytes pushed at a time
+// returns TRUE if every frame decoded correctly and every corrupt record was rejected
+//
+
+static int RunStream(const int format, const char *stream, const size_t length, const TwoCanFrame *expected, const unsigned int count, const unsigned int readSize) {
+	TwoCanAssembler assembler;
+	TwoCanFrame frames[CONST_BATCH];
+	unsigned long long start;
+	double elapsed;
+	unsigned int consumed;
+	unsigned int decoded = 0;
+	unsigned int wrong = 0;
+	unsigned int corrupt = (count + CONST_CORRUPT_INTERVAL - 1) / CONST_CORRUPT_INTERVAL;
+	size_t offset = 0;
+	int result;
+
+	AssemblerInitialise(&assembler, format);
+
+	start = GetHostTimestamp();
+	while (offset < length) {
+		unsigned int read = ((length - offset) < readSize) ? (unsigned int)(length - offset) : readSize;
+
+		result = AssemblerPush(&assembler, &stream[offset], read, 0, frames, CONST_BATCH, &consumed);
+		offset += consumed;
+
+		for (int i = 0; i < result; i++, decoded++) {
+			if ((decoded >= count) || (frames[i].id != expected[decoded].id) || (frames[i].dlc != expected[decoded].dlc) ||
+				(frames[i].flags != expected[decoded].flags) || (memcmp(frames[i].data, expected[decoded].data, frames[i].dlc) != 0)) {
+				wrong++;
+			}
+		}
+	}
+	elapsed = (GetHostTimestamp() - start) / 1e6;
+
+	printf("%-8s %4u byte reads: %6.1f MB/s %5.1fM frames/s, frames %u of %u, wrong %u, rejected %u of %u\n",
+		(format == TWOCAN_ASSEMBLER_SLCAN) ? "SLCAN" : "Axiomtek", readSize, length / elapsed / 1e6, decoded / elapsed / 1e6,
+		decoded, count, wrong, assembler.rejectCount, corrupt);
+
+	return (decoded == count) && (wrong == 0) && (assembler.rejectCount == corrupt);
+}
+
+int main(int argc, char **argv) {
+	static const int formats[] = { TWOCAN_ASSEMBLER_SLCAN, TWOCAN_ASSEMBLER_AXIOMTEK };
+	unsigned int count = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : CONST_DEFAULT_FRAMES;
+	TwoCanFrame *expected;
+	char *stream;
+	size_t length;
+	int passed = TRUE;
+
+	if (count == 0) {
+		fprintf(stderr, "Usage: assemblerbench [frames]\n");
+		return 2;
+	}
+
+	expected = (TwoCanFrame *)malloc(count * sizeof(TwoCanFrame));
+	if (expected == NULL) {
+		fprintf(stderr, "Out of memory\n");
+		return 2;
+	}
+
+	for (int i = 0; i < 2; i++) {
+		stream = BuildStream(formats[i], count, expected, &length);
+		if (stream == NULL) {
+			fprintf(stderr, "Out of memory\n");
+			free(expected);
+			return 2;
+		}
+		passed &= RunStream(formats[i], stream, length, expected, count, 4096);
+		passed &= RunStream(formats[i], stream, length, expected, count, 1);
+		free(stream);
+	}
+
+	free(expected);
+	printf("%s\n", passed ? "Passed" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,193 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: HeaderBenchmark
+// Unit Description: Validates and times the CAN header codec
+// Date: 16/10/2026
+// Function: Random 29 bit ids must decode and encode back to the same id, with the field accessors agreeing
+// with HeaderDecode. Random headers must encode and decode back to the same fields. Ids built by HeaderMakeId
+// must match the Kees parser's previous byte by byte construction, and HeaderGetPgn the fast packet layer's
+// previous PGN extraction. Then times batch decoding, HeaderGetPgn and HeaderEncode against the code they replaced.
+// Usage: headerbench [ids]
+// Returns 0 if every property held
+//
+
+#include "../../Common/inc/twocanheader.h"
+#include "../../Common/inc/twocanplatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Ids and headers checked unless given on the command line
+#define CONST_DEFAULT_IDS 2000000
+
+// Frames decoded or encoded by each pass of a timing loop, and the number of passes
+#define CONST_TIMED_FRAMES 4096
+#define CONST_TIMED_PASSES 5000
+
+//
+// Random 32 bit value, rand may only return 15 bits
+// returns the value
+//
+
+static unsigned int RandomValue(void) {
+	return ((unsigned int)rand() << 30) ^ ((unsigned int)rand() << 15) ^ (unsigned int)rand();
+}
+
+//
+// The Kees parser's previous id construction
+// [in] priority
+// [in] pgn, without the extended data page
+// [in] destination, used for a PDU1 PGN
+// [in] source
+// returns CAN id
+//
+
+static unsigned int ReferenceKeesId(const byte priority, const unsigned int pgn, const byte destination, const byte source) {
+	byte value = (byte)((pgn & 0xFF00) >> 8);
+	unsigned int id;
+
+	id = (unsigned int)(((((pgn >> 16) & 0x01) | (priority << 2)) & 0xFF) << 24);
+	id |= value << 16;
+	id |= (byte)((value > 239) ? (pgn & 0xFF) : destination) << 8;
+	id |= (byte)source;
+	return id & CONST_EXTENDED_ID_MASK;
+}
+
+//
+// The fast packet layer's previous PGN extraction
+// [in] id
+// returns PGN, without the destination of a PDU1 frame
+//
+
+static unsigned int ReferencePgn(const unsigned int id) {
+	unsigned int pgn = (id >> 8) & 0x3FFFF;
+
+	if (((pgn >> 8) & 0xFF) < 240) {
+		pgn &= 0x3FF00;
+	}
+	return pgn;
+}
+
+int main(int argc, char **argv) {
+	unsigned int count = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : CONST_DEFAULT_IDS;
+	static TwoCanFrame frames[CONST_TIMED_FRAMES];
+	static CanHeader headers[CONST_TIMED_FRAMES];
+	unsigned int failures = 0;
+	unsigned long long timings[5];
+	volatile unsigned int sink = 0;
+
+	srand(1);
+
+	// Decode then encode returns the id
+	for (unsigned int n = 0; n < count; n++) {
+		unsigned int id = RandomValue() & CONST_EXTENDED_ID_MASK;
+		CanHeader header;
+
+		HeaderDecode(id, &header);
+		failures += (HeaderEncode(&header) != id);
+		failures += (header.priority != HeaderGetPriority(id)) || (header.pgn != HeaderGetPgn(id)) ||
+			(header.source != HeaderGetSource(id)) || (header.destination != HeaderGetDestination(id));
+		failures += (header.pgn != ReferencePgn(id));
+	}
+	printf("decode and encode, ids %u, failures %u\n", count, failures);
+
+	// Encode then decode returns the header, a PDU1 PGN has no low byte and a PDU2 frame is sent to the global address
+	for (unsigned int n = 0; n < count; n++) {
+		CanHeader header;
+		CanHeader decoded;
+
+		header.priority = (byte)(RandomValue() & CONST_HEADER_PRIORITY_MASK);
+		header.source = (byte)RandomValue();
+		header.destination = (byte)RandomValue();
+		header.pgn = RandomValue() & CONST_HEADER_PGN_MASK;
+		if (HeaderIsPdu1(header.pgn)) {
+			header.pgn &= CONST_HEADER_PDU1_PGN_MASK;
+		}
+		else {
+			header.destination = CONST_HEADER_GLOBAL_ADDRESS;
+		}
+
+		HeaderDecode(HeaderEncode(&header), &decoded);
+		failures += (decoded.priority != header.priority) || (decoded.pgn != header.pgn) ||
+			(decoded.source != header.source) || (decoded.destination != header.destination);
+	}
+	printf("encode and decode, headers %u, failures %u\n", count, failures);
+
+	// Same ids as the Kees parser, which did not support the extended data page
+	for (unsigned int n = 0; n < count; n++) {
+		byte priority = (byte)(RandomValue() & CONST_HEADER_PRIORITY_MASK);
+		unsigned int pgn = RandomValue() & 0x1FFFF;
+		byte destination = (byte)RandomValue();
+		byte source = (byte)RandomValue();
+
+		if (HeaderIsPdu1(pgn)) {
+			pgn &= CONST_HEADER_PDU1_PGN_MASK;
+		}
+		failures += (HeaderMakeId(priority, pgn, destination, source) != ReferenceKeesId(priority, pgn, destination, source));
+	}
+	printf("Kees ids %u, failures %u\n", count, failures);
+
+	for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+		frames[i].id = RandomValue() & CONST_EXTENDED_ID_MASK;
+	}
+	HeaderDecodeBatch(frames, headers, CONST_TIMED_FRAMES);
+
+	timings[0] = GetHostTimestamp();
+	for (int pass = 0; pass < CONST_TIMED_PASSES; pass++) {
+		HeaderDecodeBatch(frames, headers, CONST_TIMED_FRAMES);
+		sink += headers[pass & (CONST_TIMED_FRAMES - 1)].pgn;
+	}
+	timings[1] = GetHostTimestamp();
+	for (int pass = 0; pass < CONST_TIMED_PASSES; pass++) {
+		for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+			sink += ReferencePgn(frames[i].id ^ (pass & 1));
+		}
+	}
+	timings[2] = GetHostTimestamp();
+	for (int pass = 0; pass < CONST_TIMED_PASSES; pass++) {
+		for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+			sink += HeaderGetPgn(frames[i].id ^ (pass & 1));
+		}
+	}
+	timings[3] = GetHostTimestamp();
+	for (int pass = 0; pass < CONST_TIMED_PASSES; pass++) {
+		for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+			sink += ReferenceKeesId(headers[i].priority, headers[i].pgn & 0x1FFFF, headers[i].destination, headers[i].source ^ (byte)pass);
+		}
+	}
+	timings[4] = GetHostTimestamp();
+	for (int pass = 0; pass < CONST_TIMED_PASSES; pass++) {
+		for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+			sink += HeaderMakeId(headers[i].priority, headers[i].pgn & 0x1FFFF, headers[i].destination, headers[i].source ^ (byte)pass);
+		}
+	}
+
+	double ids = (double)CONST_TIMED_FRAMES * CONST_TIMED_PASSES / 1000.0;
+	printf("HeaderDecodeBatch %.2f ns/id\n", (timings[1] - timings[0]) / ids);
+	printf("PGN: previous %.2f ns/id, HeaderGetPgn %.2f ns/id\n", (timings[2] - timings[1]) / ids, (timings[3] - timings[2]) / ids);
+	printf("id: Kees parser %.2f ns/id, HeaderMakeId %.2f ns/id\n", (timings[4] - timings[3]) / ids, (GetHostTimestamp() - timings[4]) / ids);
+
+	printf("%s\n", (failures == 0) ? "Passed" : "FAILED");
+	return (failures == 0) ? 0 : 1;
+}
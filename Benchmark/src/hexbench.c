@@ -0,0 +1,132 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: HexBenchmark
+// Unit Description: Validates and times ConvertHexStringToByteArray
+// Date: 16/10/2026
+// Function: Converts random strings of up to 16 characters, in both cases, with one in ten corrupted
+// by a character that is not a hexadecimal digit. Valid strings must convert to the same bytes as strtoul,
+// corrupted strings must be rejected. Then times the conversion of a CAN header and payload per frame,
+// against the previous strtoul conversion.
+// Usage: hexbench [strings]
+// Returns 0 if every string was converted or rejected correctly
+//
+
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanplatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Strings checked unless given on the command line
+#define CONST_DEFAULT_STRINGS 200000
+
+// Frames converted by each timing loop
+#define CONST_TIMED_FRAMES 5000000
+
+static const char hexDigits[] = "0123456789abcdefABCDEF";
+
+// Characters either side of the digits and letters, and beyond ASCII
+static const char invalidDigits[] = "g: /@G`\x80";
+
+//
+// The previous conversion, each pair of characters converted by strtoul
+// [in] hexstr, the characters
+// [in] len, number of bytes to convert
+// [out] buf, the bytes
+// returns TRUE
+//
+
+static int ReferenceHexStringToByteArray(const byte *hexstr, const unsigned int len, byte *buf) {
+	char pair[3] = { 0 };
+
+	for (unsigned int i = 0; i < len; i++) {
+		pair[0] = hexstr[i * 2];
+		pair[1] = hexstr[(i * 2) + 1];
+		buf[i] = (byte)strtoul(pair, NULL, 16);
+	}
+	return TRUE;
+}
+
+int main(int argc, char **argv) {
+	unsigned int count = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : CONST_DEFAULT_STRINGS;
+	byte header[] = "09F80203";
+	byte payload[] = "FFFC88CF0A00FFFF";
+	byte string[2 * CONST_PAYLOAD_LENGTH];
+	byte expected[CONST_PAYLOAD_LENGTH];
+	byte actual[CONST_PAYLOAD_LENGTH];
+	unsigned int failures = 0;
+	unsigned long long start;
+	unsigned long long middle;
+	unsigned long long end;
+	volatile int sink = 0;
+
+	srand(1);
+	for (unsigned int n = 0; n < count; n++) {
+		// Mostly the lengths of a header and a payload
+		unsigned int length = (rand() % 2) ? ((rand() % 2) ? CONST_HEADER_LENGTH : CONST_PAYLOAD_LENGTH) : rand() % (CONST_PAYLOAD_LENGTH + 1);
+		int isCorrupt = ((rand() % 10) == 0) && (length > 0);
+		int result;
+
+		for (unsigned int i = 0; i < length * 2; i++) {
+			string[i] = hexDigits[rand() % (sizeof(hexDigits) - 1)];
+		}
+		if (isCorrupt) {
+			string[rand() % (length * 2)] = invalidDigits[rand() % (sizeof(invalidDigits) - 1)];
+		}
+
+		memset(expected, 0, sizeof(expected));
+		memset(actual, 0, sizeof(actual));
+		result = ConvertHexStringToByteArray(string, length, actual);
+
+		if (isCorrupt) {
+			failures += (result != FALSE);
+		}
+		else {
+			ReferenceHexStringToByteArray(string, length, expected);
+			failures += (result == FALSE) || (memcmp(expected, actual, length) != 0);
+		}
+	}
+	printf("strings %u, failures %u\n", count, failures);
+
+	start = GetHostTimestamp();
+	for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+		header[0] = (byte)('0' + (i & 7));
+		sink += ReferenceHexStringToByteArray(header, CONST_HEADER_LENGTH, expected);
+		sink += ReferenceHexStringToByteArray(payload, CONST_PAYLOAD_LENGTH, actual);
+	}
+	middle = GetHostTimestamp();
+	for (int i = 0; i < CONST_TIMED_FRAMES; i++) {
+		header[0] = (byte)('0' + (i & 7));
+		sink += ConvertHexStringToByteArray(header, CONST_HEADER_LENGTH, expected);
+		sink += ConvertHexStringToByteArray(payload, CONST_PAYLOAD_LENGTH, actual);
+	}
+	end = GetHostTimestamp();
+
+	printf("header and payload: strtoul %.1f ns/frame, ConvertHexStringToByteArray %.1f ns/frame\n",
+		(middle - start) * 1000.0 / CONST_TIMED_FRAMES, (end - middle) * 1000.0 / CONST_TIMED_FRAMES);
+
+	printf("%s\n", (failures == 0) ? "Passed" : "FAILED");
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,214 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: ParserBenchmark
+// Unit Description: Compares the log file line parsers with the std::regex decoding they replaced
+// Date: 16/10/2026
+// Function: Reads each sample log into memory and decodes every line with both the regex reference,
+// as the Kees, Yacht Devices and candump drivers used to, and the TwoCanParser scanner.
+// Every line must give the same result and, for a frame, the same id and payload. Then times both.
+// Usage: parserbench [sample directory]
+// Returns 0 if the two decoders agree on every line
+//
+
+#include "../../Common/inc/twocanparser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#ifndef CONST_SAMPLE_DIRECTORY
+#define CONST_SAMPLE_DIRECTORY "Sample"
+#endif
+
+// The regex reference is slow, so the scanner is timed over more passes
+#define CONST_REGEX_PASSES 10
+#define CONST_SCANNER_PASSES 1000
+
+typedef int (*ScannerFunction)(const char *line, const unsigned int length, TwoCanFrame *frame);
+typedef int (*ReferenceFunction)(const std::string &line, TwoCanFrame *frame);
+
+//
+// Kees log, as decoded by the driver before the scanner
+// [in] line
+// [out] frame
+// returns TWOCAN_PARSE_xxx
+//
+
+static int ReferenceKeesLine(const std::string &line, TwoCanFrame *frame) {
+	static const std::regex keesRegex("^[0-9]{4}-[0-9]{2}-[0-9]{2}[TZ][0-9]{2}:[0-9]{2}:[0-9]{2}.[0-9]{3},([0-9]),([0-9]{5,6}),([0-9]+),([0-9]+),([0-9]),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2})$");
+	static const std::regex isoRequest("^[0-9]{4}-[0-9]{2}-[0-9]{2}[TZ][0-9]{2}:[0-9]{2}:[0-9]{2}.[0-9]{3},([0-9]),59904,([0-9]+),([0-9]+),3,([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2}),([0-9A-Fa-f]{2})$");
+	std::smatch matchGroups;
+	byte canFrame[CONST_FRAME_LENGTH];
+
+	if (!std::regex_match(line, matchGroups, keesRegex)) {
+		return std::regex_match(line, isoRequest) ? TWOCAN_PARSE_IGNORED : TWOCAN_PARSE_INVALID;
+	}
+
+	unsigned int priority = strtoul(matchGroups[1].str().c_str(), NULL, 10);
+	unsigned int pgn = strtoul(matchGroups[2].str().c_str(), NULL, 10);
+	unsigned int source = strtoul(matchGroups[3].str().c_str(), NULL, 10);
+	unsigned int destination = strtoul(matchGroups[4].str().c_str(), NULL, 10);
+
+	canFrame[3] = ((pgn >> 16) & 0x01) | (priority << 2);
+	canFrame[2] = (pgn & 0xFF00) >> 8;
+	canFrame[1] = (canFrame[2] > 239) ? (pgn & 0xFF) : destination;
+	canFrame[0] = source;
+	for (int i = 0; i < CONST_PAYLOAD_LENGTH; i++) {
+		canFrame[CONST_HEADER_LENGTH + i] = (byte)strtoul(matchGroups[6 + i].str().c_str(), NULL, 16);
+	}
+	ConvertByteArrayToFrame(canFrame, CONST_PAYLOAD_LENGTH, frame);
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Yacht Devices log, as decoded by the driver before the scanner
+// [in] line
+// [out] frame
+// returns TWOCAN_PARSE_xxx
+//
+
+static int ReferenceYachtDevicesLine(const std::string &line, TwoCanFrame *frame) {
+	static const std::regex yachtDevicesRegex("^[0-9]{2}:[0-9]{2}:[0-9]{2}.[0-9]{3}\\sR\\s([0-9A-F]{8})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})$");
+	std::smatch matchGroups;
+	byte canFrame[CONST_FRAME_LENGTH];
+	unsigned int id;
+
+	if (!std::regex_match(line, matchGroups, yachtDevicesRegex)) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	id = strtoul(matchGroups[1].str().c_str(), NULL, 16);
+	memcpy(canFrame, &id, CONST_HEADER_LENGTH);
+	for (int i = 0; i < CONST_PAYLOAD_LENGTH; i++) {
+		canFrame[CONST_HEADER_LENGTH + i] = (byte)strtoul(matchGroups[2 + i].str().c_str(), NULL, 16);
+	}
+	ConvertByteArrayToFrame(canFrame, CONST_PAYLOAD_LENGTH, frame);
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Linux candump log, as decoded by the driver before the scanner
+// [in] line
+// [out] frame
+// returns TWOCAN_PARSE_xxx
+//
+
+static int ReferenceCandumpLine(const std::string &line, TwoCanFrame *frame) {
+	static const std::regex candumpRegex("^\\([0-9]+.[0-9]+\\)\\s(slcan|vcan|can)[0-9]\\s([0-9A-F]{8})#([0-9A-F]{16})$");
+	std::smatch matchGroups;
+	byte canFrame[CONST_FRAME_LENGTH];
+	unsigned int id;
+
+	if (!std::regex_match(line, matchGroups, candumpRegex)) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	id = strtoul(matchGroups[2].str().c_str(), NULL, 16);
+	memcpy(canFrame, &id, CONST_HEADER_LENGTH);
+	for (int i = 0; i < CONST_PAYLOAD_LENGTH; i++) {
+		canFrame[CONST_HEADER_LENGTH + i] = (byte)strtoul(matchGroups[3].str().substr(i * 2, 2).c_str(), NULL, 16);
+	}
+	ConvertByteArrayToFrame(canFrame, CONST_PAYLOAD_LENGTH, frame);
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Check and time both decoders over a sample log
+// [in] fileName, the sample log
+// [in] reference, the regex decoder
+// [in] scanner, the TwoCanParser decoder
+// returns TRUE if the log was read and both decoders agree on every line
+//
+
+static int RunLog(const std::string &fileName, ReferenceFunction reference, ScannerFunction scanner) {
+	std::ifstream logFile(fileName);
+	std::vector<std::string> lines;
+	std::string line;
+	TwoCanFrame expected;
+	TwoCanFrame actual;
+	unsigned int mismatches = 0;
+	volatile int sink = 0;
+
+	if (!logFile.is_open()) {
+		fprintf(stderr, "Unable to open %s\n", fileName.c_str());
+		return FALSE;
+	}
+	while (std::getline(logFile, line)) {
+		lines.push_back(line);
+	}
+
+	for (const std::string &entry : lines) {
+		memset(&expected, 0, sizeof(TwoCanFrame));
+		memset(&actual, 0, sizeof(TwoCanFrame));
+		int referenceResult = reference(entry, &expected);
+		int scannerResult = scanner(entry.c_str(), (unsigned int)entry.size(), &actual);
+
+		if ((referenceResult != scannerResult) || ((referenceResult == TWOCAN_PARSE_FRAME) &&
+			((expected.id != actual.id) || (memcmp(expected.data, actual.data, CONST_PAYLOAD_LENGTH) != 0)))) {
+			if (mismatches < 3) {
+				fprintf(stderr, "Mismatch %d %d: %s\n", referenceResult, scannerResult, entry.c_str());
+			}
+			mismatches++;
+		}
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < CONST_REGEX_PASSES; pass++) {
+		for (const std::string &entry : lines) {
+			sink += reference(entry, &expected);
+		}
+	}
+	auto middle = std::chrono::steady_clock::now();
+	for (int pass = 0; pass < CONST_SCANNER_PASSES; pass++) {
+		for (const std::string &entry : lines) {
+			sink += scanner(entry.c_str(), (unsigned int)entry.size(), &actual);
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	double referenceTime = std::chrono::duration<double>(middle - start).count();
+	double scannerTime = std::chrono::duration<double>(end - middle).count();
+	printf("%-20s lines %zu, mismatches %u, regex %.2fM lines/s, scanner %.2fM lines/s\n",
+		fileName.substr(fileName.find_last_of("/\\") + 1).c_str(), lines.size(), mismatches,
+		lines.size() * CONST_REGEX_PASSES / referenceTime / 1e6, lines.size() * CONST_SCANNER_PASSES / scannerTime / 1e6);
+
+	return mismatches == 0;
+}
+
+int main(int argc, char **argv) {
+	std::string directory = (argc > 1) ? argv[1] : CONST_SAMPLE_DIRECTORY;
+	int passed = TRUE;
+
+	passed &= RunLog(directory + "/kees.log", ReferenceKeesLine, ParseKeesLine);
+	passed &= RunLog(directory + "/yachtdevices.log", ReferenceYachtDevicesLine, ParseYachtDevicesLine);
+	passed &= RunLog(directory + "/candump.log", ReferenceCandumpLine, ParseCandumpLine);
+
+	printf("%s\n", passed ? "Passed" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: ReplayBenchmark
+// Unit Description: Checks that a driver loses no frames at full bus load while the caller stalls
+// Date: 16/10/2026
+// Function: Built against the Kvaser driver and the mock CANlib, or the Toucan driver and the mock CANAL library.
+// The mock generates numbered frames at full bus load, the caller reads them with ReadAdapterBatch but
+// regularly stops reading for longer than the driver's ring buffer can absorb, so the read thread must hold
+// frames back in the adapter's receive queue. Lost frames are detected from the sequence numbers they carry.
+// The mock's rate and frame count may be overridden with the KVASER_MOCK_ or CANAL_MOCK_ environment variables.
+// Usage: kvaserreplaybench [seconds] or toucanreplaybench [seconds]
+// Returns 0 if every frame was received, in order
+//
+
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanerror.h"
+#include "../../Common/inc/twocanplatform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined (REPLAY_KVASER)
+#define CONST_MOCK_RATE "KVASER_MOCK_RATE"
+#define CONST_MOCK_FRAMES "KVASER_MOCK_FRAMES"
+#elif defined (REPLAY_TOUCAN)
+#define CONST_MOCK_RATE "CANAL_MOCK_RATE"
+#define CONST_MOCK_FRAMES "CANAL_MOCK_FRAMES"
+#else
+#error Define REPLAY_KVASER or REPLAY_TOUCAN
+#endif
+
+// Seconds replayed unless given on the command line
+#define CONST_DEFAULT_SECONDS 10
+
+// Full bus load, extended frames with eight data bytes at 250 kbit/s (frames per second)
+#define CONST_FULL_LOAD_RATE "1900"
+
+// The caller stops reading for CONST_STALL_TIME every CONST_STALL_INTERVAL (milliseconds).
+// At full load a stall fills the driver's ring buffer, the rest must wait in the adapter's receive queue
+#define CONST_STALL_INTERVAL 2000
+#define CONST_STALL_TIME 600
+
+// Time allowed for the last frames to arrive (milliseconds)
+#define CONST_DRAIN_TIME 2000
+
+// Frames returned by each call to ReadAdapterBatch
+#define CONST_BATCH_SIZE 256
+
+// Exported by the driver under test
+int OpenAdapter(void);
+int CloseAdapter(void);
+int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
+
+//
+// Set an environment variable, unless already set
+// [in] name
+// [in] value
+//
+
+static void DefaultSetting(const char *name, const char *value) {
+	if (getenv(name) == NULL) {
+#if defined (__MSVC__)
+		_putenv_s(name, value);
+#else
+		setenv(name, value, 0);
+#endif
+	}
+}
+
+//
+// Sequence number carried by a frame generated by TrafficGenerateFrame
+// [in] frame
+// [out] mask, the bits of the sequence number the frame carries
+// returns the sequence number
+//
+
+static unsigned int FrameSequence(const TwoCanFrame *frame, unsigned int *mask) {
+	unsigned int sequence = 0;
+	unsigned int length = (frame->dlc < 4) ? frame->dlc : 4;
+
+	for (unsigned int i = 0; i < length; i++) {
+		sequence |= (unsigned int)frame->data[i] << (i * 8);
+	}
+	*mask = (length < 4) ? ((1U << (length * 8)) - 1) : 0xFFFFFFFF;
+	return sequence;
+}
+
+int main(int argc, char **argv) {
+	unsigned int seconds = (argc > 1) ? (unsigned int)strtoul(argv[1], NULL, 10) : CONST_DEFAULT_SECONDS;
+	TwoCanFrame frames[CONST_BATCH_SIZE];
+	char frameLimit[32];
+	unsigned long long expected;
+	unsigned long long received = 0;
+	unsigned long long lost = 0;
+	unsigned long long outOfOrder = 0;
+	unsigned long long stalls = 0;
+	unsigned int next = 0;
+	unsigned long long start;
+	unsigned long long nextStall;
+	unsigned long long lastFrame;
+	unsigned long long end;
+	int count;
+	int result;
+
+	DefaultSetting(CONST_MOCK_RATE, CONST_FULL_LOAD_RATE);
+	snprintf(frameLimit, sizeof(frameLimit), "%llu", strtoull(getenv(CONST_MOCK_RATE), NULL, 10) * seconds);
+	DefaultSetting(CONST_MOCK_FRAMES, frameLimit);
+	expected = strtoull(getenv(CONST_MOCK_FRAMES), NULL, 10);
+
+	result = OpenAdapter();
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		printf("OpenAdapter failed %d\n", result);
+		return 1;
+	}
+
+	start = GetHostTimestamp();
+	nextStall = start + (CONST_STALL_INTERVAL * 1000ULL);
+	lastFrame = start;
+	end = start;
+
+	while (received < expected) {
+		unsigned long long now = GetHostTimestamp();
+
+		if (now >= nextStall) {
+			ThreadSleep(CONST_STALL_TIME);
+			nextStall += CONST_STALL_INTERVAL * 1000ULL;
+			stalls++;
+		}
+
+		result = ReadAdapterBatch(frames, CONST_BATCH_SIZE, &count, 100);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			printf("ReadAdapterBatch failed %d\n", result);
+			break;
+		}
+
+		if (count == 0) {
+			if ((GetHostTimestamp() - lastFrame) > (CONST_DRAIN_TIME * 1000ULL)) {
+				break;
+			}
+			continue;
+		}
+
+		for (int i = 0; i < count; i++) {
+			unsigned int mask;
+			unsigned int sequence = FrameSequence(&frames[i], &mask);
+
+			if (sequence != (next & mask)) {
+				// Only a frame carrying the full sequence number can tell how many were lost
+				if (mask == 0xFFFFFFFF) {
+					if (sequence > next) {
+						lost += sequence - next;
+					}
+					else {
+						outOfOrder++;
+					}
+					next = sequence;
+				}
+				else {
+					outOfOrder++;
+				}
+			}
+			next++;
+		}
+
+		received += count;
+		lastFrame = GetHostTimestamp();
+		end = lastFrame;
+	}
+
+	CloseAdapter();
+
+	// Frames never delivered at the end of the replay are lost too
+	if ((received + lost) < expected) {
+		lost = expected - received;
+	}
+
+	printf("frames %llu, received %llu, lost %llu, out of order %llu, stalls %llu\n", expected, received, lost, outOfOrder, stalls);
+	if (end > start) {
+		printf("throughput %.0f frames/s over %.1f s\n", received * 1000000.0 / (end - start), (end - start) / 1000000.0);
+	}
+
+	printf("%s\n", ((lost == 0) && (outOfOrder == 0) && (received == expected)) ? "Passed" : "FAILED");
+	return ((lost == 0) && (outOfOrder == 0) && (received == expected)) ? 0 : 1;
+}
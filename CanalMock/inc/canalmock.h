@@ -0,0 +1,102 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_CANAL_MOCK
+#define _TWOCAN_CANAL_MOCK
+
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+
+// The CANAL API implemented by the mock
+#include "../../Toucan/inc/canal.h"
+#include "../../Toucan/inc/canal_a.h"
+
+// Calling convention of the CANAL functions, the same as the declarations in canal.h
+// Windows exports them with canalmock.def so the names match the Rusoku library,
+// the shared object exports them by default visibility, the mock's own functions are static
+#if defined(WIN32)
+#define CanalExport WINAPI EXPORT
+#else
+#define CanalExport
+#endif
+
+// Environment variables used to configure the mock, read by CanalOpen
+// Frames per second, 0 generates frames as fast as the caller receives them
+#define CONST_MOCK_RATE "CANAL_MOCK_RATE"
+// Number of frames generated at a time
+#define CONST_MOCK_BURST "CANAL_MOCK_BURST"
+// Microseconds between a frame's timestamp and the frame being available to CanalBlockingReceive
+#define CONST_MOCK_LATENCY "CANAL_MOCK_LATENCY"
+// Number of frames the adapter can hold, further frames are overrun
+#define CONST_MOCK_QUEUE "CANAL_MOCK_QUEUE"
+// Number of frames generated after CanalInterfaceStart, 0 for no limit
+#define CONST_MOCK_FRAMES "CANAL_MOCK_FRAMES"
+// Microseconds taken by CanalSend
+#define CONST_MOCK_SEND_LATENCY "CANAL_MOCK_SEND_LATENCY"
+// Log file replayed in a loop instead of the synthetic frames, any format the TwoCan parsers accept
+#define CONST_MOCK_LOG "CANAL_MOCK_LOG"
+
+// Defaults
+#define CONST_DEFAULT_RATE 1000
+#define CONST_DEFAULT_QUEUE 256
+
+// Longest the generator sleeps before checking whether it has been stopped, in microseconds
+#define CONST_GENERATOR_SLEEP 10000
+
+// The only handle returned by CanalOpen, the mock supports a single channel
+#define CONST_MOCK_HANDLE 1
+
+#define CONST_MOCK_VENDOR "Rusoku Toucan (CANAL mock)"
+
+// State of the emulated channel
+typedef struct CanalMock {
+	volatile int isOpen;
+	volatile int isStarted;
+	// Configuration
+	unsigned long long rate;
+	unsigned int burst;
+	unsigned long long latency;
+	unsigned long long frameLimit;
+	unsigned long long sendLatency;
+	char serialNumber[16];
+	// Frames waiting for CanalBlockingReceive, the generator thread is the producer
+	TwoCanRing receiveQueue;
+	TwoCanEvent receiveEvent;
+	// Signalled by the receive functions, paces the generator when there is no fixed rate
+	TwoCanEvent spaceEvent;
+	TwoCanEvent generatorFinishedEvent;
+	TwoCanThread generatorThread;
+	DWORD generatorThreadId;
+	TwoCanTimer timer;
+	// Frames loaded from CONST_MOCK_LOG
+	TwoCanFrame *logFrames;
+	unsigned int logCount;
+	// Frames generated since CanalInterfaceStart, including overruns and filtered frames
+	unsigned long long sequence;
+	unsigned long long startTime;
+	// Acceptance filter applied to extended frames
+	int filterType;
+	unsigned long filterId;
+	unsigned long filterMask;
+	canalStatistics statistics;
+	canalStatus status;
+} CanalMock;
+
+#endif
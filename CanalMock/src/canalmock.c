@@ -0,0 +1,489 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: CanalMock
+// Unit Description: Mock CAN Abstraction Layer (CANAL) library
+// Date: 16/10/2026
+// Function: Implements the canal.h and canal_a.h API used by the Toucan driver without a Rusoku device.
+// After CanalInterfaceStart a generator thread produces synthetic NMEA 2000 frames, or replays a log file,
+// at a configurable rate, burst size and latency into a fixed size receive queue. Frames that arrive
+// while the queue is full are counted as overruns, as they would be by the adapter.
+// Configured with the CANAL_MOCK_xxx environment variables listed in canalmock.h
+//
+
+#include "../inc/canalmock.h"
+
+#include "../../Common/inc/twocanerror.h"
+#include "../../Common/inc/twocantraffic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The emulated channel
+static CanalMock mock;
+
+//
+// Queue a frame for the receive functions, applying the acceptance filter
+// [in] frame, the frame's timestamp is its arrival time at the adapter
+//
+
+static void PublishFrame(TwoCanFrame *frame) {
+	if (mock.filterType == FILTER_REJECT_ALL) {
+		return;
+	}
+
+	if ((mock.filterType == FILTER_VALUE) && ((frame->id & mock.filterMask) != (mock.filterId & mock.filterMask))) {
+		return;
+	}
+
+	if (RingWrite(&mock.receiveQueue, frame)) {
+		mock.statistics.cntReceiveFrames++;
+		mock.statistics.cntReceiveData += frame->dlc;
+	}
+	else {
+		mock.statistics.cntOverruns++;
+		mock.status.channel_status = CANAL_STATUSMSG_OVERRUN;
+	}
+}
+
+//
+// Generator thread, produces the frames received by the adapter
+// With a fixed rate, each burst is due at start + (first frame of the burst / rate) and is queued
+// latency microseconds later, a generator that falls behind catches up burst by burst.
+// Without a rate, frames are generated whenever the receive queue has space
+// Upon exit, returns TWOCAN_RESULT_SUCCESS as Thread Exit Code
+//
+
+static DWORD TWOCAN_THREAD_CALL GeneratorThread(void *lParam) {
+	TwoCanFrame frame;
+
+	(void)lParam;
+
+	while (mock.isOpen) {
+		if ((!mock.isStarted) || ((mock.frameLimit > 0) && (mock.sequence >= mock.frameLimit))) {
+			ThreadSleep(CONST_GENERATOR_SLEEP / 1000);
+			continue;
+		}
+
+		unsigned long long now = GetHostTimestamp();
+		unsigned long long due = now;
+		unsigned int count = 1;
+
+		if (mock.rate > 0) {
+			due = mock.startTime + (((mock.sequence / mock.burst) * mock.burst * 1000000ULL) / mock.rate);
+			if (now < (due + mock.latency)) {
+				unsigned long long delay = (due + mock.latency) - now;
+				TimerWait(mock.timer, (delay > CONST_GENERATOR_SLEEP) ? CONST_GENERATOR_SLEEP : delay);
+				continue;
+			}
+			count = mock.burst - (unsigned int)(mock.sequence % mock.burst);
+		}
+		else if (RingIsFull(&mock.receiveQueue)) {
+			EventWait(mock.spaceEvent, CONST_GENERATOR_SLEEP / 1000);
+			continue;
+		}
+
+		for (unsigned int i = 0; i < count; i++) {
+			if ((mock.frameLimit > 0) && (mock.sequence >= mock.frameLimit)) {
+				break;
+			}
+
+			if (mock.logCount > 0) {
+				frame = mock.logFrames[mock.sequence % mock.logCount];
+			}
+			else {
+				TrafficGenerateFrame(mock.sequence, &frame);
+			}
+			frame.timestamp = due;
+			PublishFrame(&frame);
+			mock.sequence++;
+		}
+
+		EventSet(mock.receiveEvent);
+	}
+
+	EventSet(mock.generatorFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+//
+// Open the channel
+// [in] pDevice, initialisation string, device number;serial number;bit rate
+// [in] flags, ignored
+// returns the handle, or zero if the channel is already open or cannot be created
+//
+
+long CanalExport CanalOpen(const char *pDevice, unsigned long flags) {
+	const char *serialNumber;
+	unsigned int queueSize;
+
+	(void)flags;
+
+	if ((pDevice == NULL) || mock.isOpen) {
+		return 0;
+	}
+
+	memset(&mock, 0, sizeof(CanalMock));
+
+	// The serial number is the second field of the initialisation string
+	serialNumber = strchr(pDevice, ';');
+	snprintf(mock.serialNumber, sizeof(mock.serialNumber), "%.8s", (serialNumber != NULL) ? serialNumber + 1 : "00000000");
+
+	mock.rate = TrafficGetSetting(CONST_MOCK_RATE, CONST_DEFAULT_RATE);
+	mock.burst = (unsigned int)TrafficGetSetting(CONST_MOCK_BURST, 1);
+	mock.latency = TrafficGetSetting(CONST_MOCK_LATENCY, 0);
+	mock.frameLimit = TrafficGetSetting(CONST_MOCK_FRAMES, 0);
+	mock.sendLatency = TrafficGetSetting(CONST_MOCK_SEND_LATENCY, 0);
+	queueSize = (unsigned int)TrafficGetSetting(CONST_MOCK_QUEUE, CONST_DEFAULT_QUEUE);
+
+	if (mock.burst == 0) {
+		mock.burst = 1;
+	}
+
+	if (!RingInitialise(&mock.receiveQueue, queueSize)) {
+		DebugPrintf(L"CANAL mock queue size must be a power of two, no larger than %d\n", CONST_RING_CAPACITY);
+		return 0;
+	}
+
+	if (getenv(CONST_MOCK_LOG) != NULL) {
+		mock.logCount = TrafficLoadLog(getenv(CONST_MOCK_LOG), &mock.logFrames);
+		if (mock.logCount == 0) {
+			DebugPrintf(L"CANAL mock unable to load %s\n", getenv(CONST_MOCK_LOG));
+			return 0;
+		}
+	}
+
+	mock.receiveEvent = EventCreate(NULL);
+	mock.spaceEvent = EventCreate(NULL);
+	mock.generatorFinishedEvent = EventCreate(NULL);
+	mock.timer = TimerCreate();
+
+	if ((mock.receiveEvent == NULL) || (mock.spaceEvent == NULL) || (mock.generatorFinishedEvent == NULL)) {
+		DebugPrintf(L"CANAL mock unable to create events (%d)\n", PlatformGetLastError());
+		CanalClose(CONST_MOCK_HANDLE);
+		return 0;
+	}
+
+	mock.isOpen = TRUE;
+	mock.generatorThread = ThreadCreate(GeneratorThread, NULL, &mock.generatorThreadId);
+	if (mock.generatorThread == NULL) {
+		DebugPrintf(L"CANAL mock unable to start the generator (%d)\n", PlatformGetLastError());
+		mock.isOpen = FALSE;
+		CanalClose(CONST_MOCK_HANDLE);
+		return 0;
+	}
+
+	return CONST_MOCK_HANDLE;
+}
+
+//
+// Close the channel, stops the generator and reports the statistics
+// [in] handle
+// returns CANAL_ERROR_SUCCESS
+//
+
+int CanalExport CanalClose(long handle) {
+	if (handle != CONST_MOCK_HANDLE) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+
+	if (mock.isOpen) {
+		mock.isOpen = FALSE;
+		if (EventWait(mock.generatorFinishedEvent, 1000) != TWOCAN_WAIT_SIGNALLED) {
+			DebugPrintf(L"CANAL mock generator did not stop\n");
+		}
+		ThreadClose(mock.generatorThread);
+	}
+
+	DebugPrintf(L"CANAL mock received %lu frames, %lu overruns, transmitted %lu frames\n",
+		mock.statistics.cntReceiveFrames, mock.statistics.cntOverruns, mock.statistics.cntTransmitFrames);
+
+	if (mock.receiveEvent != NULL) {
+		EventClose(mock.receiveEvent);
+	}
+	if (mock.spaceEvent != NULL) {
+		EventClose(mock.spaceEvent);
+	}
+	if (mock.generatorFinishedEvent != NULL) {
+		EventClose(mock.generatorFinishedEvent);
+	}
+	TimerClose(mock.timer);
+	free(mock.logFrames);
+
+	memset(&mock, 0, sizeof(CanalMock));
+	return CANAL_ERROR_SUCCESS;
+}
+
+unsigned long CanalExport CanalGetLevel(long handle) {
+	(void)handle;
+	return CANAL_LEVEL_STANDARD;
+}
+
+//
+// Transmit a frame, takes CANAL_MOCK_SEND_LATENCY microseconds
+// [in] handle
+// [in] pCanalMsg, frame to transmit
+// returns CANAL_ERROR_SUCCESS
+//
+
+int CanalExport CanalSend(long handle, PCANALMSG pCanalMsg) {
+	if ((handle != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+
+	if ((pCanalMsg == NULL) || (pCanalMsg->sizeData > CONST_PAYLOAD_LENGTH)) {
+		return CANAL_ERROR_PARAMETER;
+	}
+
+	if (mock.sendLatency > 0) {
+		TimerWait(mock.timer, mock.sendLatency);
+	}
+
+	mock.statistics.cntTransmitFrames++;
+	mock.statistics.cntTransmitData += pCanalMsg->sizeData;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalBlockingSend(long handle, PCANALMSG pCanalMsg, unsigned long timeout) {
+	(void)timeout;
+	return CanalSend(handle, pCanalMsg);
+}
+
+//
+// Remove the oldest frame from the receive queue
+// [in] handle
+// [out] pCanalMsg
+// returns CANAL_ERROR_SUCCESS, or CANAL_ERROR_FIFO_EMPTY if no frame is queued
+//
+
+int CanalExport CanalReceive(long handle, PCANALMSG pCanalMsg) {
+	TwoCanFrame frame;
+
+	if ((handle != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+
+	if (pCanalMsg == NULL) {
+		return CANAL_ERROR_PARAMETER;
+	}
+
+	if (!RingRead(&mock.receiveQueue, &frame)) {
+		return CANAL_ERROR_FIFO_EMPTY;
+	}
+
+	if (mock.rate == 0) {
+		EventSet(mock.spaceEvent);
+	}
+
+	pCanalMsg->flags = (frame.flags & TWOCAN_FRAME_FLAG_EXTENDED) ? CANAL_IDFLAG_EXTENDED : CANAL_IDFLAG_STANDARD;
+	if (frame.flags & TWOCAN_FRAME_FLAG_REMOTE) {
+		pCanalMsg->flags |= CANAL_IDFLAG_RTR;
+	}
+	pCanalMsg->obid = 0;
+	pCanalMsg->id = frame.id;
+	pCanalMsg->sizeData = frame.dlc;
+	memcpy(pCanalMsg->data, frame.data, CONST_PAYLOAD_LENGTH);
+	// The adapter's free running 32 bit microsecond counter
+	pCanalMsg->timestamp = (unsigned int)frame.timestamp;
+	return CANAL_ERROR_SUCCESS;
+}
+
+//
+// Wait up to timeout milliseconds for a frame
+// [in] handle
+// [out] pCanalMsg
+// [in] timeout, milliseconds
+// returns CANAL_ERROR_SUCCESS, or CANAL_ERROR_TIMEOUT if no frame arrived
+//
+
+int CanalExport CanalBlockingReceive(long handle, PCANALMSG pCanalMsg, unsigned long timeout) {
+	int result;
+
+	result = CanalReceive(handle, pCanalMsg);
+	if (result != CANAL_ERROR_FIFO_EMPTY) {
+		return result;
+	}
+
+	EventWait(mock.receiveEvent, (unsigned int)timeout);
+
+	result = CanalReceive(handle, pCanalMsg);
+	return (result == CANAL_ERROR_FIFO_EMPTY) ? CANAL_ERROR_TIMEOUT : result;
+}
+
+int CanalExport CanalDataAvailable(long handle) {
+	if ((handle != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return 0;
+	}
+	return (int)RingCount(&mock.receiveQueue);
+}
+
+int CanalExport CanalGetStatus(long handle, PCANALSTATUS pCanalStatus) {
+	if ((handle != CONST_MOCK_HANDLE) || (pCanalStatus == NULL)) {
+		return CANAL_ERROR_PARAMETER;
+	}
+	*pCanalStatus = mock.status;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetStatistics(long handle, PCANALSTATISTICS pCanalStatistics) {
+	if ((handle != CONST_MOCK_HANDLE) || (pCanalStatistics == NULL)) {
+		return CANAL_ERROR_PARAMETER;
+	}
+	*pCanalStatistics = mock.statistics;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalSetFilter(long handle, unsigned long filter) {
+	(void)handle;
+	mock.filterId = filter;
+	mock.filterType = FILTER_VALUE;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalSetMask(long handle, unsigned long mask) {
+	(void)handle;
+	mock.filterMask = mask;
+	mock.filterType = FILTER_VALUE;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalSetBaudrate(long handle, unsigned long baudrate) {
+	(void)handle;
+	(void)baudrate;
+	return CANAL_ERROR_SUCCESS;
+}
+
+unsigned long CanalExport CanalGetVersion(void) {
+	return (CANAL_MAIN_VERSION << 24) | (CANAL_MINOR_VERSION << 16) | CANAL_SUB_VERSION;
+}
+
+unsigned long CanalExport CanalGetDllVersion(void) {
+	return 1;
+}
+
+const char *CanalExport CanalGetVendorString(void) {
+	return CONST_MOCK_VENDOR;
+}
+
+const char *CanalExport CanalGetDriverInfo(void) {
+	return "Mock CANAL library, configured with the CANAL_MOCK_xxx environment variables";
+}
+
+// The standard frame filter is accepted but has no effect, the mock only generates extended frames
+int CanalExport CanalSetFilter11bit(long handle, Filter_Type_TypeDef type, unsigned long id, unsigned long mask) {
+	(void)handle;
+	(void)type;
+	(void)id;
+	(void)mask;
+	return CANAL_ERROR_SUCCESS;
+}
+
+//
+// Set the extended frame acceptance filter, a frame is accepted if (frame id & mask) == (id & mask)
+// [in] handle
+// [in] type, FILTER_ACCEPT_ALL, FILTER_REJECT_ALL or FILTER_VALUE
+// [in] id, [in] mask
+// returns CANAL_ERROR_SUCCESS
+//
+
+int CanalExport CanalSetFilter29bit(long handle, Filter_Type_TypeDef type, unsigned long id, unsigned long mask) {
+	if (handle != CONST_MOCK_HANDLE) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+	mock.filterId = id;
+	mock.filterMask = mask;
+	mock.filterType = type;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetBootloaderVersion(long handle, unsigned long *bootloader_version) {
+	(void)handle;
+	*bootloader_version = 1;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetHardwareVersion(long handle, unsigned long *hardware_version) {
+	(void)handle;
+	*hardware_version = 1;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetFirmwareVersion(long handle, unsigned long *firmware_version) {
+	(void)handle;
+	*firmware_version = 1;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetSerialNumber(long handle, unsigned long *serial) {
+	(void)handle;
+	*serial = strtoul(mock.serialNumber, NULL, 10);
+	return CANAL_ERROR_SUCCESS;
+}
+
+// Rusoku's USB vendor and product id
+int CanalExport CanalGetVidPid(long handle, unsigned long *vidpid) {
+	(void)handle;
+	*vidpid = 0x16D00EAC;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetDeviceId(long handle, unsigned long *deviceid) {
+	(void)handle;
+	*deviceid = 0;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalGetVendor(long handle, unsigned int size, char *vendor) {
+	(void)handle;
+	if ((vendor == NULL) || (size == 0)) {
+		return CANAL_ERROR_PARAMETER;
+	}
+	snprintf(vendor, size, "%s", CONST_MOCK_VENDOR);
+	return CANAL_ERROR_SUCCESS;
+}
+
+//
+// Go on bus, the generator starts a new sequence of frames
+// [in] handle
+// returns CANAL_ERROR_SUCCESS
+//
+
+int CanalExport CanalInterfaceStart(long handle) {
+	if ((handle != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+	mock.sequence = 0;
+	mock.startTime = GetHostTimestamp();
+	mock.status.channel_status = CANAL_STATUSMSG_OK;
+	mock.isStarted = TRUE;
+	return CANAL_ERROR_SUCCESS;
+}
+
+int CanalExport CanalInterfaceStop(long handle) {
+	if ((handle != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return CANAL_ERROR_NOT_OPEN;
+	}
+	mock.isStarted = FALSE;
+	return CANAL_ERROR_SUCCESS;
+}
@@ -20,14 +20,28 @@
 #ifndef _TWOCAN_CANTACT
 #define _TWOCAN_CANTACT
 
-#include "..\..\common\inc\twocandriver.h"
-
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanassembler.h"
+#include "../../Common/inc/twocanfilter.h"
+#include "../../Common/inc/twocantransmit.h"
 
 #include <stdio.h>
 
-#define DllExport __declspec(dllexport)
+// Default serial port on Linux
+#define CONST_SERIAL_PORT "/dev/ttyACM0"
+
+// Maximum time the read thread sleeps waiting for serial data before checking whether it has been stopped
+#define CONST_SERIAL_TIMEOUT 100
+
+// Number of frames decoded from the serial data at a time
+#define CONST_ASSEMBLER_BATCH 64
+
+// Bytes waiting in the serial port's input buffer at which the read thread stops waiting for the caller to drain
+// a full ring and discards frames instead, so that the input buffer does not overrun. Half of a Linux tty's buffer
+#define CONST_SERIAL_QUEUE_LIMIT 2048
+
+#define DllExport TWOCAN_EXPORT
 
 DllExport char *DriverName(void);
 DllExport char *DriverVersion(void);
@@ -36,11 +50,27 @@ DllExport int IsInstalled(void);
 DllExport int OpenAdapter(void);
 DllExport int CloseAdapter(void);
 DllExport int ReadAdapter(byte *frame);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count);
+DllExport int SubscribePgn(unsigned int pgn, int source);
+DllExport int UnsubscribePgn(unsigned int pgn, int source);
+DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data);
+DllExport int WriteAdapterEx(const TwoCanFrame *frames, int count);
+DllExport int SetTransmitCallback(TwoCanTransmitCallback callback, void *context);
+DllExport int GetTransmitStatistics(TwoCanTransmitStatistics *statistics);
 
-DWORD WINAPI ReadThread(LPVOID lParam);
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrame(const TwoCanFrame *frame);
+int ReceiveQueueFilling(void);
+int SendFrames(const TwoCanFrame *frames, const int count);
 int ConfigureSerialPort(void);
 int ConfigureAdapter(void);
+#if defined(_WIN32)
 int GetRegistrySettings(WCHAR *friendlyName, WCHAR *portName, int *baudRate, int *dataBits, int *stopBits, int *parity, int *isPresent);
+#else
+DllExport int SetAdapterPort(const char *name);
+#endif
 
 // Cantact constants for opening & closing the bus, setting the bus speed, line endings
 #define CANTACT_OPEN 'O'
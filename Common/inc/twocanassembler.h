@@ -0,0 +1,84 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_ASSEMBLER
+#define _TWOCAN_ASSEMBLER
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Record formats understood by the assembler
+// SLCAN (Lawicel) as used by the Cantact, T, t, R and r records terminated by CR, with an optional 4 digit timestamp
+#define TWOCAN_ASSEMBLER_SLCAN 0
+// Axiomtek AX92903 report mode, @F records terminated by CR LF, # responses are ignored
+#define TWOCAN_ASSEMBLER_AXIOMTEK 1
+
+// Longest record produced by AssemblerEncode, an SLCAN transmit record with eight data bytes is 27 characters
+#define CONST_MAX_RECORD_LENGTH 32
+
+// Assembler states, between records or part way through a record
+#define TWOCAN_ASSEMBLER_IDLE 0
+#define TWOCAN_ASSEMBLER_RECORD 1
+
+// Layout of a record, defined in twocanassembler.c
+struct AssemblerField;
+
+// Streaming decoder for the text records sent by the serial adapters.
+// Bytes are pushed as they arrive from the serial port, a record may be split across any number of pushes.
+// Each character is decoded straight into the frame under construction, nothing is buffered or allocated.
+// A record that does not match its layout is discarded and counted in rejectCount, decoding resumes at the next start character
+typedef struct TwoCanAssembler {
+	byte format;
+	// TWOCAN_ASSEMBLER_xxx state
+	byte state;
+	// Position within the current record's layout
+	byte field;
+	// Characters consumed by the current field
+	byte digits;
+	// Value of the numeric field being decoded
+	unsigned int value;
+	const struct AssemblerField *layout;
+	// Number of malformed records discarded
+	unsigned int rejectCount;
+	// The frame under construction
+	TwoCanFrame frame;
+} TwoCanAssembler;
+
+// Initialise an assembler for one of the TWOCAN_ASSEMBLER_xxx formats
+void AssemblerInitialise(TwoCanAssembler *assembler, const int format);
+
+// Decode received bytes, completed frames are stamped with timestamp and written to frames.
+// Stops early if capacity frames are completed, consumed returns the number of bytes used.
+// Returns the number of frames written
+int AssemblerPush(TwoCanAssembler *assembler, const char *bytes, const unsigned int length, const unsigned long long timestamp,
+	TwoCanFrame *frames, const int capacity, unsigned int *consumed);
+
+// Encode an extended data frame as the record the adapter expects to be sent, returns the length of the record, 0 if the format cannot be encoded
+unsigned int AssemblerEncode(const int format, const TwoCanFrame *frame, char *record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,103 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_CACHE
+#define _TWOCAN_CACHE
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Replay cache files are written alongside the log file, eg. kees.log.tcc
+#define CONST_CACHE_EXTENSION TWOCAN_TEXT(".tcc")
+#define CONST_CACHE_TEMP_EXTENSION TWOCAN_TEXT(".tmp")
+
+// Identifies a replay cache file, "TCC1"
+#define CONST_CACHE_MAGIC 0x31434354
+
+// Number of bytes hashed at the start and at the end of the log file
+#define CONST_CACHE_HASH_SPAN 0x100000
+
+// Number of frames buffered before they are written to the cache file
+#define CONST_CACHE_WRITE_BUFFER 4096
+
+// Size of each mapped view of the cache file
+#define CONST_CACHE_VIEW_SIZE 0x4000000
+
+// Replay cache file header, followed by count TwoCanFrame records.
+// The cache is only used if the log file's size, last write time and hash still match
+typedef struct TwoCanCacheHeader {
+	unsigned int magic;
+	unsigned int recordSize;
+	unsigned long long sourceSize;
+	unsigned long long sourceTime;
+	unsigned long long sourceHash;
+	unsigned long long count;
+} TwoCanCacheHeader;
+
+// Binary replay cache of the frames parsed from a text log file.
+// The first replay writes the cache, later replays and every loop back to the start of the log
+// read the pre-parsed frames straight from a memory mapped view of the cache file
+typedef struct TwoCanCache {
+	TwoCanCacheHeader header;
+	TwoCanChar cacheName[TWOCAN_MAX_PATH];
+	TwoCanChar tempName[TWOCAN_MAX_PATH];
+	TwoCanFile file;
+	TwoCanMapping mapping;
+	// Reading, the currently mapped view and the index of the next frame
+	const byte *view;
+	unsigned long long viewOffset;
+	unsigned long long viewLength;
+	unsigned long long position;
+	unsigned int granularity;
+	// Writing, frames waiting to be written
+	int writing;
+	unsigned int buffered;
+	TwoCanFrame buffer[CONST_CACHE_WRITE_BUFFER];
+} TwoCanCache;
+
+// Open an existing replay cache for the log file, returns FALSE if there is no cache or it is out of date
+int CacheOpen(TwoCanCache *cache, const TwoCanChar *logFileName);
+
+// Start writing a new replay cache for the log file, after CacheOpen has failed
+int CacheCreate(TwoCanCache *cache, const TwoCanChar *logFileName);
+
+// Append a frame to a replay cache being written
+int CacheWrite(TwoCanCache *cache, const TwoCanFrame *frame);
+
+// Finish writing the replay cache and reopen it for reading
+int CacheCommit(TwoCanCache *cache, const TwoCanChar *logFileName);
+
+// Retrieve the next frame, returns FALSE at the end of the cache
+int CacheRead(TwoCanCache *cache, TwoCanFrame *frame);
+
+// Restart from the first frame
+void CacheRewind(TwoCanCache *cache);
+
+// Close the replay cache, an unfinished cache is discarded
+void CacheClose(TwoCanCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
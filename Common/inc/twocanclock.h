@@ -0,0 +1,65 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_CLOCK
+#define _TWOCAN_CLOCK
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Period over which the minimum host to device offset is collected before it replaces the current offset
+// Keeps the correlation tracking the drift between the adapter's oscillator and the host clock
+#define CONST_CLOCK_WINDOW 10000000
+
+// Correlates a free running 32 bit adapter timestamp with the host clock (GetHostTimestamp)
+// The adapter counter is extended to 64 bits, then shifted into the host clock domain using the
+// smallest observed host - device offset, as USB and driver latency can only ever delay the host's view of a frame
+typedef struct TwoCanClock {
+	// Microseconds per adapter tick
+	unsigned int resolution;
+	// Last raw adapter timestamp
+	unsigned int lastDevice;
+	// Adapter time extended past the 32 bit wrap, in microseconds
+	unsigned long long deviceTime;
+	// Host - device offset currently applied
+	long long offset;
+	// Smallest offset seen in the current window and the host time the window started
+	long long windowOffset;
+	unsigned long long windowStart;
+	// Last timestamp returned, timestamps never go backwards
+	unsigned long long lastTimestamp;
+	int synchronised;
+} TwoCanClock;
+
+// Reset the correlation, resolution is the number of microseconds per adapter tick
+void ClockInitialise(TwoCanClock *clock, const unsigned int resolution);
+
+// Convert a raw adapter timestamp to a monotonic host clock timestamp in microseconds
+// hostTime is the GetHostTimestamp value taken when the frame was received from the adapter
+unsigned long long ClockConvert(TwoCanClock *clock, const unsigned int deviceTicks, const unsigned long long hostTime);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -17,23 +17,23 @@
 //
 // NMEA2000 is a registered Trademark of the National Marine Electronics Association
 
+#ifndef _TWOCAN_DRIVER
+#define _TWOCAN_DRIVER
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif
 
-#ifndef _TWOCAN_DRIVER
-#define _TWOCAN_DRIVER
-
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
+#include "twocanplatform.h"
 
 // Events and Mutexes used to notify callers & control access to data
-#define CONST_DATARX_EVENT L"Global\\DataReceived"
-#define CONST_DATATX_EVENT L"Global\\DataTransmit"
-#define CONST_MUTEX_NAME L"Global\\DataMutex"
-#define CONST_RW_MUTEX L"Globa\\ReadWriteMutex"
-#define CONST_EVENT_THREAD_ENDED L"Local\\ThreadEnded"
+#define CONST_DATARX_EVENT TWOCAN_TEXT("Global\\DataReceived")
+#define CONST_DATATX_EVENT TWOCAN_TEXT("Global\\DataTransmit")
+#define CONST_DATACONSUMED_EVENT TWOCAN_TEXT("Global\\DataConsumed")
+#define CONST_MUTEX_NAME TWOCAN_TEXT("Global\\DataMutex")
+#define CONST_RW_MUTEX TWOCAN_TEXT("Globa\\ReadWriteMutex")
+#define CONST_EVENT_THREAD_ENDED TWOCAN_TEXT("Local\\ThreadEnded")
 
 // Treat all received NMEA 2000 bytes as unsigned char
 typedef unsigned char byte;
@@ -41,6 +41,18 @@ typedef unsigned char byte;
 // Length of a CAN v2.0 header
 #define CONST_HEADER_LENGTH 4
 
+// Length of a TwoCan CAN Frame, 4 byte header followed by 8 data bytes
+#define CONST_FRAME_LENGTH 12
+
+// Maximum number of CAN v2.0 data bytes
+#define CONST_PAYLOAD_LENGTH 8
+
+// Mask for a 29 bit extended CAN id
+#define CONST_EXTENDED_ID_MASK 0x1FFFFFFF
+
+// Mask for an 11 bit standard CAN id
+#define CONST_STANDARD_ID_MASK 0x7FF
+
 // Length of an array 
 #define COUNT(x)  (sizeof(x) / sizeof((x)[0]))
 
@@ -52,24 +64,49 @@ typedef struct CanHeader {
 	unsigned int pgn;
 } CanHeader;
 
+// CAN Frame flags
+#define TWOCAN_FRAME_FLAG_EXTENDED 0x01
+// Timestamp taken by the adapter rather than by the host when the frame was read
+#define TWOCAN_FRAME_FLAG_HARDWARE_TIMESTAMP 0x02
+// Remote transmission request, the frame carries no data
+#define TWOCAN_FRAME_FLAG_REMOTE 0x04
+
+// CAN Frame as delivered by ReadAdapterBatch and queued in a TwoCanRing
+typedef struct TwoCanFrame {
+	// Microseconds in the GetHostTimestamp time base, monotonic
+	unsigned long long timestamp;
+	// 29 bit CAN id
+	unsigned int id;
+	// Number of valid data bytes, 0 - 8
+	byte dlc;
+	// TWOCAN_FRAME_FLAG_xxx
+	byte flags;
+	// Unused data bytes are zero
+	byte data[CONST_PAYLOAD_LENGTH];
+} TwoCanFrame;
+
 // A few functions used to convert the raw data from the different Windows devices (Axiomtek, Kvaser, Cantact) into a consistent CAN Frame byte array
 
-// Reverse the byte order of a 4 byte header
-// Cantact device seems to present the header as a BigEndian value
-void ReverseHeader(byte* buf);
+// Value of each hexadecimal character, indexed by the character, 0xFF for any other character
+extern const byte hexValues[256];
 
 // Convert a hexadecimal string to a byte array
 // Cantact & Axiomtek as serial devices present all of their data as hex strings so we convert the hex string to a byte array
+// len is the number of bytes, returns FALSE if any character is not a hexadecimal digit
+int ConvertHexStringToByteArray(const byte *hexstr, const unsigned int len, byte *buf);
 
+// Convert an unsigned integer to a 4 byte array
+// Kvaser presents the CAN header as an integer
+int ConvertIntegerToByteArray(const unsigned int value, byte *buf);
 
-int ConvertHexStringToByteArray(const byte *hexstr, const unsigned int len, byte *buf);
+// Convert a 12 byte CAN Frame (little endian header followed by the payload) to a TwoCanFrame
+void ConvertByteArrayToFrame(const byte *buf, const byte dlc, TwoCanFrame *frame);
+
+// Convert a TwoCanFrame to the 12 byte CAN Frame used by ReadAdapter
+void ConvertFrameToByteArray(const TwoCanFrame *frame, byte *buf);
 
 #ifdef __cplusplus
 }
 #endif
 
-// Convert an unsigned integer to a 4 byte array
-// Kvaser presents the CAN header as an integer
-int ConvertIntegerToByteArray(const unsigned int value, byte *buf);
-
 #endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_DUPLICATE
+#define _TWOCAN_DUPLICATE
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Number of frames remembered, a power of two. A full 250 kbit/s bus carries under 2000 frames a second,
+// so the table is at most half full for windows of up to about 2 seconds
+#define CONST_DUPLICATE_SLOT_BITS 13
+#define CONST_DUPLICATE_SLOTS (1 << CONST_DUPLICATE_SLOT_BITS)
+
+// Number of slots a frame may occupy, starting from its hash
+#define CONST_DUPLICATE_PROBES 16
+
+// Longest window (microseconds)
+#define CONST_DUPLICATE_MAX_WINDOW 60000000
+
+// Window that turns suppression off
+#define CONST_DUPLICATE_DISABLED 0
+
+// Duplicate suppression statistics, returned by GetDuplicateStatistics
+typedef struct TwoCanDuplicateStatistics {
+	unsigned long long framesPassed;
+	unsigned long long framesSuppressed;
+	// Frames forgotten before their window had elapsed, because every slot they could use was busy
+	unsigned long long framesEvicted;
+} TwoCanDuplicateStatistics;
+
+// A frame that has been passed, with the timestamp it was passed at
+typedef struct TwoCanDuplicateSlot {
+	unsigned long long timestamp;
+	unsigned int id;
+	byte dlc;
+	byte isUsed;
+	// Payload, zero beyond dlc
+	byte data[CONST_PAYLOAD_LENGTH];
+} TwoCanDuplicateSlot;
+
+// Open addressing table of recently passed frames, keyed on id, dlc and payload.
+// Slots are never emptied, an entry older than the window is simply treated as free.
+// A frame is suppressed if an identical frame was passed within the window, a frame that is
+// repeated unchanged, eg. a steady heading, is therefore passed at most once per window
+typedef struct TwoCanDuplicateTable {
+	// Microseconds, CONST_DUPLICATE_DISABLED passes every frame
+	volatile unsigned int window;
+	TwoCanDuplicateStatistics statistics;
+	TwoCanDuplicateSlot slots[CONST_DUPLICATE_SLOTS];
+} TwoCanDuplicateTable;
+
+// Initialise an empty table, returns FALSE if the window is longer than CONST_DUPLICATE_MAX_WINDOW
+int DuplicateInitialise(TwoCanDuplicateTable *table, const unsigned int window);
+
+// Change the window, takes effect from the next frame, returns FALSE if the window is too long
+int DuplicateSetWindow(TwoCanDuplicateTable *table, const unsigned int window);
+
+// Check a frame, returns TRUE if it duplicates a frame passed within the window and should be discarded
+int DuplicateCheck(TwoCanDuplicateTable *table, const TwoCanFrame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
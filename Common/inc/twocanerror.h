@@ -20,8 +20,7 @@
 #ifndef TWOCAN_ERROR_H
 #define TWOCAN_ERROR_H
 
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
+#include "twocanplatform.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -34,7 +33,7 @@ extern "C"
 {
 #endif
 
-void DebugPrintf(wchar_t *fmt, ...);
+void DebugPrintf(const wchar_t *fmt, ...);
 
 #ifdef __cplusplus
 }
@@ -116,4 +115,14 @@ char *GetErrorMessage(int win32ErrorCode);
 #define TWOCAN_ERROR_SOCKET_BIND 42
 #define TWOCAN_ERROR_SOCKET_FLAGS 43
 #define TWOCAN_ERROR_SOCKET_READ 44
+#define TWOCAN_ERROR_INVALID_RING 45
+#define TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT 46
+#define TWOCAN_ERROR_DELETE_FRAME_CONSUMED_EVENT 47
+#define TWOCAN_ERROR_INVALID_BUFFER 48
+#define TWOCAN_ERROR_INVALID_REPLAY_SPEED 49
+#define TWOCAN_ERROR_INVALID_FILTER 50
+#define TWOCAN_ERROR_TRANSMIT_QUEUE_FULL 51
+#define TWOCAN_ERROR_CREATE_TRANSMIT_THREAD 52
+#define TWOCAN_ERROR_INVALID_ADDRESS 53
+#define TWOCAN_ERROR_INVALID_DUPLICATE_WINDOW 54
 #endif
\ No newline at end of file
@@ -0,0 +1,153 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_FASTPACKET
+#define _TWOCAN_FASTPACKET
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Number of messages that may be reassembled at once, must be a power of two
+#define CONST_FASTPACKET_SLOTS 128
+
+// Slots examined for a message, starting at its hash, before the oldest of them is evicted
+#define CONST_FASTPACKET_PROBES 8
+
+// Longest fast packet message, 6 bytes in the first frame and 7 in each of the 31 that follow
+#define CONST_FASTPACKET_LENGTH 223
+
+// Most frames in a fast packet message, the 5 bit frame counter
+#define CONST_FASTPACKET_FRAMES 32
+
+// Continuation frames are only kept ahead of their first frame if their counter is below this, so frames
+// left over from a message whose first frame was lost are not mistaken for part of the next message
+#define CONST_FASTPACKET_REORDER 4
+
+// A message not completed within this many microseconds of its last frame is abandoned
+#define CONST_FASTPACKET_TIMEOUT 750000
+
+// FastPacketExpire examines the slots at most this often, in microseconds
+#define CONST_FASTPACKET_EXPIRE_INTERVAL 100000
+
+// Number of PGNs, the PGN is an 18 bit value
+#define CONST_PGN_COUNT 0x40000
+
+// Results of FastPacketPush
+// The frame's PGN is a single frame PGN, the caller handles the frame as it is
+#define TWOCAN_FASTPACKET_SINGLE 0
+// The frame has been stored, the message is not yet complete
+#define TWOCAN_FASTPACKET_PENDING 1
+// The frame completed a message
+#define TWOCAN_FASTPACKET_COMPLETE 2
+// The frame was malformed or a duplicate and has been discarded
+#define TWOCAN_FASTPACKET_DISCARDED 3
+
+// A reassembled fast packet message
+typedef struct TwoCanFastMessage {
+	// Timestamp of the frame that completed the message
+	unsigned long long timestamp;
+	// CAN id of the first frame
+	unsigned int id;
+	unsigned int pgn;
+	// Number of valid bytes in data
+	unsigned int length;
+	byte data[CONST_FASTPACKET_LENGTH];
+} TwoCanFastMessage;
+
+// Called from the driver's read thread with each completed message, the message is only valid during the call
+typedef void (*TwoCanFastPacketCallback)(const TwoCanFastMessage *message, void *context);
+
+// Reassembly statistics, returned by GetFastPacketStatistics
+typedef struct TwoCanFastPacketStatistics {
+	unsigned long long messagesCompleted;
+	// Frames that arrived other than immediately after the previous frame of their message
+	unsigned long long framesOutOfOrder;
+	// Frames whose counter had already been received, beyond the end of the message, or too far ahead of a missing first frame
+	unsigned long long framesDiscarded;
+	// Messages that timed out, or were replaced by a new message with the same sequence id, before they were complete
+	unsigned long long sequencesAbandoned;
+	// Messages evicted to make room for another, because every slot they could use was busy
+	unsigned long long sequencesEvicted;
+	// Most messages being reassembled at any one time
+	unsigned int maximumActive;
+} TwoCanFastPacketStatistics;
+
+// A message being reassembled
+typedef struct TwoCanFastSlot {
+	// Source address, sequence id and PGN, see FastPacketKey
+	unsigned int key;
+	byte isActive;
+	// Number of frames in the message, zero until the first frame has arrived
+	byte framesExpected;
+	// Frame counter expected next, used to count frames out of order
+	byte nextFrame;
+	// Bit n set once frame n has arrived
+	unsigned int framesReceived;
+	// Timestamp of the most recent frame, for timeouts
+	unsigned long long lastTimestamp;
+	TwoCanFastMessage message;
+} TwoCanFastSlot;
+
+// Fast packet reassembly, frames are pushed as they are received and complete messages returned.
+// A fixed table of slots is hashed on (source, PGN, sequence id), each frame examines at most
+// CONST_FASTPACKET_PROBES slots and nothing is allocated. Frames are stored at their counter's offset,
+// so frames received out of order, including a few before the first frame, still complete the message.
+// Only used from a single thread, the driver's read thread
+typedef struct TwoCanFastPacketTable {
+	TwoCanFastSlot slots[CONST_FASTPACKET_SLOTS];
+	unsigned int activeCount;
+	// Time the slots may next be examined for timed out messages
+	unsigned long long expireTime;
+	// Bit set for each PGN transmitted as a fast packet
+	unsigned int fastPgns[CONST_PGN_COUNT / 32];
+	TwoCanFastPacketCallback volatile callback;
+	void * volatile callbackContext;
+	TwoCanFastPacketStatistics statistics;
+} TwoCanFastPacketTable;
+
+// Clear the table and load the list of NMEA 2000 fast packet PGNs, any callback is kept
+void FastPacketInitialise(TwoCanFastPacketTable *table);
+
+// Check whether a PGN is transmitted as a fast packet
+int FastPacketIsFastPacket(const TwoCanFastPacketTable *table, const unsigned int pgn);
+
+// Add a frame to the message it belongs to, returns TWOCAN_FASTPACKET_xxx.
+// If COMPLETE, message points at the reassembled message, valid until the next call to FastPacketPush or FastPacketExpire
+int FastPacketPush(TwoCanFastPacketTable *table, const TwoCanFrame *frame, const TwoCanFastMessage **message);
+
+// Abandon messages with no frame for CONST_FASTPACKET_TIMEOUT, cheap enough to call for every frame
+// as the slots are only examined every CONST_FASTPACKET_EXPIRE_INTERVAL. Returns the number abandoned
+unsigned int FastPacketExpire(TwoCanFastPacketTable *table, const unsigned long long now);
+
+// Push frames and pass each completed message to the callback, does nothing if there is no callback
+void FastPacketProcess(TwoCanFastPacketTable *table, const TwoCanFrame *frames, const int count);
+
+// Set or clear the completed message callback
+void FastPacketSetCallback(TwoCanFastPacketTable *table, TwoCanFastPacketCallback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
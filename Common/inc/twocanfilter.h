@@ -0,0 +1,108 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_FILTER
+#define _TWOCAN_FILTER
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Source address that matches frames from any device
+#define CONST_FILTER_ANY_SOURCE 0xFF
+
+// Maximum number of filters in a set
+#define CONST_MAX_FILTERS 64
+
+// Number of PGNs, the PGN is 18 bits
+#define CONST_FILTER_PGN_COUNT 0x40000
+
+// Accept a PGN, from a single source address or from CONST_FILTER_ANY_SOURCE
+// For PDU1 PGNs (PF < 240) the low byte of the PGN must be zero, frames are accepted whatever their destination
+typedef struct TwoCanFilter {
+	unsigned int pgn;
+	byte source;
+} TwoCanFilter;
+
+// Filters compiled to 29 bit identifier code and mask pairs, a frame is accepted if ((id ^ code) & mask) == 0 for any pair.
+// An empty set accepts every frame.
+// The read threads match with the two PGN bitmaps, the pairs are only checked for PGNs restricted to a source address
+typedef struct TwoCanFilterSet {
+	unsigned int count;
+	unsigned int codes[CONST_MAX_FILTERS];
+	unsigned int masks[CONST_MAX_FILTERS];
+	// One bit per PGN accepted from any source address
+	unsigned int anySource[CONST_FILTER_PGN_COUNT / 32];
+	// One bit per PGN accepted from some source addresses only
+	unsigned int someSources[CONST_FILTER_PGN_COUNT / 32];
+	// A single code and mask that accepts at least every frame accepted by the set,
+	// for adapters with one hardware acceptance filter. The set is then applied in software to what gets through
+	unsigned int hardwareCode;
+	unsigned int hardwareMask;
+} TwoCanFilterSet;
+
+// Double buffered filter sets, a driver's read thread matches frames against the active set
+// while SetAcceptanceFilters compiles its replacement.
+// sequence is odd while an update is in progress, updates take it with PlatformCompareExchange so they are
+// serialised. Readers match again if it changed while they read, as the set they read may have been recompiled
+typedef struct TwoCanFilterTable {
+	TwoCanFilterSet sets[2];
+	volatile unsigned int active;
+	volatile unsigned int sequence;
+	// The filters the active set was compiled from, so that single PGNs can be added and removed
+	unsigned int filterCount;
+	TwoCanFilter filters[CONST_MAX_FILTERS];
+} TwoCanFilterTable;
+
+// Compile filters into set, returns FALSE if count is out of range or a filter is not a valid PGN
+int FilterCompile(TwoCanFilterSet *set, const TwoCanFilter *filters, const int count);
+
+// Check a 29 bit identifier against a compiled set, returns TRUE if the frame is accepted
+int FilterMatch(const TwoCanFilterSet *set, const unsigned int id);
+
+// Compile filters into the inactive set and make it active, returns FALSE and leaves the table unchanged if they are invalid
+int FilterTableUpdate(TwoCanFilterTable *table, const TwoCanFilter *filters, const int count);
+
+// Check a 29 bit identifier against the active set, may be called while the table is being updated
+int FilterTableMatch(const TwoCanFilterTable *table, const unsigned int id);
+
+// Combined code and mask of the active set for an adapter's acceptance filter, a zero mask accepts every frame
+void FilterTableHardware(const TwoCanFilterTable *table, unsigned int *code, unsigned int *mask);
+
+// Widen a code and mask from FilterTableHardware so that it also accepts every frame of a PGN
+void FilterWidenHardware(unsigned int *code, unsigned int *mask, const unsigned int pgn);
+
+// Copy the code and mask pairs of the active set, codes and masks must hold CONST_MAX_FILTERS, returns the number of pairs
+unsigned int FilterTableCodes(const TwoCanFilterTable *table, unsigned int *codes, unsigned int *masks);
+
+// Add a filter to the active set, returns FALSE if it is invalid or the set is full
+int FilterTableSubscribe(TwoCanFilterTable *table, const unsigned int pgn, const byte source);
+
+// Remove a filter from the active set, removing the last filter leaves an empty set that accepts every frame
+int FilterTableUnsubscribe(TwoCanFilterTable *table, const unsigned int pgn, const byte source);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,148 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_HEADER
+#define _TWOCAN_HEADER
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Layout of the 29 bit identifier, from the most significant bit,
+// priority (3 bits), extended data page, data page, PDU format (8 bits), PDU specific (8 bits), source (8 bits)
+#define CONST_HEADER_PRIORITY_SHIFT 26
+#define CONST_HEADER_PRIORITY_MASK 0x07
+#define CONST_HEADER_PGN_SHIFT 8
+#define CONST_HEADER_PGN_MASK 0x3FFFF
+#define CONST_HEADER_ADDRESS_MASK 0xFF
+
+// Data page and PDU format of a PGN, the PGN of a PDU1 frame without its destination
+#define CONST_HEADER_PDU1_PGN_MASK 0x3FF00
+
+// PDU format values from 240 are PDU2, broadcast, below that the PDU specific byte is the destination
+#define CONST_HEADER_PDU2_FORMAT 240
+
+// Destination reported for a PDU2 PGN
+#define CONST_HEADER_GLOBAL_ADDRESS 255
+
+//
+// Check whether a PGN is destination specific
+// [in] pgn
+// returns TRUE for a PDU1 PGN, whose low byte is the destination
+//
+
+TWOCAN_INLINE int HeaderIsPdu1(const unsigned int pgn) {
+	return (((pgn >> 8) & 0xFF) < CONST_HEADER_PDU2_FORMAT);
+}
+
+//
+// Priority of a 29 bit CAN id
+// [in] id
+// returns priority, 0 to 7
+//
+
+TWOCAN_INLINE byte HeaderGetPriority(const unsigned int id) {
+	return (byte)((id >> CONST_HEADER_PRIORITY_SHIFT) & CONST_HEADER_PRIORITY_MASK);
+}
+
+//
+// Source address of a 29 bit CAN id
+// [in] id
+// returns source address
+//
+
+TWOCAN_INLINE byte HeaderGetSource(const unsigned int id) {
+	return (byte)(id & CONST_HEADER_ADDRESS_MASK);
+}
+
+//
+// PGN of a 29 bit CAN id, without the destination of a PDU1 frame
+// [in] id
+// returns PGN
+//
+
+TWOCAN_INLINE unsigned int HeaderGetPgn(const unsigned int id) {
+	unsigned int pgn = (id >> CONST_HEADER_PGN_SHIFT) & CONST_HEADER_PGN_MASK;
+	return HeaderIsPdu1(pgn) ? (pgn & CONST_HEADER_PDU1_PGN_MASK) : pgn;
+}
+
+//
+// Destination address of a 29 bit CAN id
+// [in] id
+// returns destination address, the global address for a PDU2 frame
+//
+
+TWOCAN_INLINE byte HeaderGetDestination(const unsigned int id) {
+	unsigned int pgn = (id >> CONST_HEADER_PGN_SHIFT) & CONST_HEADER_PGN_MASK;
+	return HeaderIsPdu1(pgn) ? (byte)(pgn & CONST_HEADER_ADDRESS_MASK) : CONST_HEADER_GLOBAL_ADDRESS;
+}
+
+//
+// Build a 29 bit CAN id
+// [in] priority, only the low 3 bits are used
+// [in] pgn, the low byte of a PDU1 PGN is replaced by the destination
+// [in] destination, ignored for a PDU2 PGN
+// [in] source
+// returns CAN id
+//
+
+TWOCAN_INLINE unsigned int HeaderMakeId(const byte priority, const unsigned int pgn, const byte destination, const byte source) {
+	unsigned int pduSpecific = HeaderIsPdu1(pgn) ? destination : (pgn & CONST_HEADER_ADDRESS_MASK);
+	return ((unsigned int)(priority & CONST_HEADER_PRIORITY_MASK) << CONST_HEADER_PRIORITY_SHIFT) |
+		((pgn & CONST_HEADER_PDU1_PGN_MASK) << CONST_HEADER_PGN_SHIFT) | (pduSpecific << CONST_HEADER_PGN_SHIFT) | source;
+}
+
+//
+// Decode a 29 bit CAN id
+// [in] id
+// [out] header, priority, PGN, source and destination
+//
+
+TWOCAN_INLINE void HeaderDecode(const unsigned int id, CanHeader *header) {
+	unsigned int pgn = (id >> CONST_HEADER_PGN_SHIFT) & CONST_HEADER_PGN_MASK;
+	int isPdu1 = HeaderIsPdu1(pgn);
+
+	header->priority = (byte)((id >> CONST_HEADER_PRIORITY_SHIFT) & CONST_HEADER_PRIORITY_MASK);
+	header->source = (byte)(id & CONST_HEADER_ADDRESS_MASK);
+	header->destination = isPdu1 ? (byte)(pgn & CONST_HEADER_ADDRESS_MASK) : CONST_HEADER_GLOBAL_ADDRESS;
+	header->pgn = isPdu1 ? (pgn & CONST_HEADER_PDU1_PGN_MASK) : pgn;
+}
+
+//
+// Encode a CAN header as a 29 bit CAN id
+// [in] header
+// returns CAN id
+//
+
+TWOCAN_INLINE unsigned int HeaderEncode(const CanHeader *header) {
+	return HeaderMakeId(header->priority, header->pgn, header->destination, header->source);
+}
+
+// Decode the ids of an array of frames in one pass
+void HeaderDecodeBatch(const TwoCanFrame *frames, CanHeader *headers, const unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,64 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_LOGFILE
+#define _TWOCAN_LOGFILE
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Size of each mapped view of a log file, keeps multi gigabyte logs within a 32 bit address space
+#define CONST_LOG_VIEW_SIZE 0x10000000
+
+// A log file mapped into memory and read a line at a time.
+// Lines are returned as pointers into the mapped view, they are not copied and are not null terminated
+typedef struct TwoCanLogFile {
+	TwoCanFile file;
+	TwoCanMapping mapping;
+	// Currently mapped view
+	const char *view;
+	unsigned long long viewOffset;
+	unsigned long long viewLength;
+	// Total file size and the offset of the next line
+	unsigned long long size;
+	unsigned long long position;
+	unsigned int granularity;
+} TwoCanLogFile;
+
+// Map a log file, returns FALSE if the file can not be opened or is empty
+int LogFileOpen(TwoCanLogFile *logFile, const TwoCanChar *fileName);
+
+// Retrieve the next line, without the line terminator, returns FALSE at the end of the file
+int LogFileReadLine(TwoCanLogFile *logFile, const char **line, unsigned int *length);
+
+// Restart from the beginning of the file
+void LogFileRewind(TwoCanLogFile *logFile);
+
+// Unmap and close the log file
+void LogFileClose(TwoCanLogFile *logFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
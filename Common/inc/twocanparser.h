@@ -0,0 +1,59 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_PARSER
+#define _TWOCAN_PARSER
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Results returned by the log file line parsers
+// The line does not match the log format
+#define TWOCAN_PARSE_INVALID 0
+// The line was converted to a CAN Frame
+#define TWOCAN_PARSE_FRAME 1
+// The line is correctly formatted but carries nothing to process
+#define TWOCAN_PARSE_IGNORED 2
+
+// Line parsers for the supported log file formats.
+// Each parser scans a single line in place, without copying or allocating, and accepts an optional trailing CR/LF.
+// The frame's timestamp is set to the time recorded in the log, in microseconds
+
+// Kees log, 2009-06-18Z09:46:01.129,2,127251,1,255,8,ff,e0,6c,fd,ff,ff,ff,ff
+int ParseKeesLine(const char *line, const unsigned int length, TwoCanFrame *frame);
+
+// Yacht Devices log, 19:06:35.596 R 09F80203 FF FC 88 CF 0A 00 FF FF
+int ParseYachtDevicesLine(const char *line, const unsigned int length, TwoCanFrame *frame);
+
+// Linux candump log, (1542794024.860693) can0 1CFF1906#419F010B00000000
+int ParseCandumpLine(const char *line, const unsigned int length, TwoCanFrame *frame);
+
+// TwoCan raw log, the 12 byte CAN Frame, 0x01,0x01,0xF8,0x09,0x64,0xD9,0xDF,0x19,0xC7,0xB9,0x0A,0x04
+// The raw log has no timestamp, the frame's timestamp is set to zero
+int ParseTwoCanRawLine(const char *line, const unsigned int length, TwoCanFrame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
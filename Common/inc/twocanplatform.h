@@ -0,0 +1,227 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_PLATFORM
+#define _TWOCAN_PLATFORM
+
+#if defined(_WIN32)
+#define WINDOWS_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <limits.h>
+#endif
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <wchar.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Thin layer over the operating system so that the driver core, parsers and log file replayers
+// build on both Windows and POSIX systems. The Win32 implementation is in twocanplatformwin32.c,
+// the POSIX implementation in twocanplatformposix.c, CMake selects one of them.
+
+#if defined(_WIN32)
+
+// Exported driver functions
+#define TWOCAN_EXPORT __declspec(dllexport)
+
+// Function never returns to its caller
+#define TWOCAN_NORETURN __declspec(noreturn)
+
+// Small functions defined in a header, the C compiler only accepts the __inline spelling
+#define TWOCAN_INLINE static __inline
+
+// Characters used for file names and object names, UTF-16 on Windows
+typedef WCHAR TwoCanChar;
+#define TWOCAN_TEXT(x) L##x
+#define TWOCAN_MAX_PATH MAX_PATH
+
+// Calling convention of a thread's entry point
+#define TWOCAN_THREAD_CALL WINAPI
+
+// Operating system objects are plain handles
+typedef HANDLE TwoCanEvent;
+typedef HANDLE TwoCanMutex;
+typedef HANDLE TwoCanThread;
+typedef HANDLE TwoCanFile;
+typedef HANDLE TwoCanMapping;
+typedef HANDLE TwoCanTimer;
+
+// Serial ports also carry the state of their overlapped reads and writes
+typedef struct TwoCanSerialObject *TwoCanSerial;
+
+// Full memory barrier
+#define PlatformMemoryBarrier() MemoryBarrier()
+
+// Loads before the barrier complete before loads after it
+#define PlatformReadBarrier() MemoryBarrier()
+
+// Atomically replace *target with exchange if it equals comparand, returns the previous value of *target
+#define PlatformCompareExchange(target, exchange, comparand) ((unsigned int)InterlockedCompareExchange((volatile LONG *)(target), (LONG)(exchange), (LONG)(comparand)))
+
+#else
+
+#define TWOCAN_EXPORT __attribute__((visibility("default")))
+
+#define TWOCAN_NORETURN __attribute__((noreturn))
+
+#define TWOCAN_INLINE static inline
+
+// File names are UTF-8 on POSIX systems
+typedef char TwoCanChar;
+#define TWOCAN_TEXT(x) x
+#define TWOCAN_MAX_PATH PATH_MAX
+
+#define TWOCAN_THREAD_CALL
+
+// The few Win32 types that appear in the driver interface
+typedef int BOOL;
+typedef unsigned int DWORD;
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+// Operating system objects, allocated by the POSIX implementation
+typedef struct TwoCanEventObject *TwoCanEvent;
+typedef struct TwoCanMutexObject *TwoCanMutex;
+typedef struct TwoCanThreadObject *TwoCanThread;
+typedef struct TwoCanFileObject *TwoCanFile;
+typedef struct TwoCanFileObject *TwoCanMapping;
+typedef struct TwoCanTimerObject *TwoCanTimer;
+typedef struct TwoCanSerialObject *TwoCanSerial;
+
+#define PlatformMemoryBarrier() __sync_synchronize()
+
+#define PlatformReadBarrier() __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+#define PlatformCompareExchange(target, exchange, comparand) __sync_val_compare_and_swap((target), (comparand), (exchange))
+
+#endif
+
+// Results of EventWait and MutexLock
+#define TWOCAN_WAIT_SIGNALLED 0
+#define TWOCAN_WAIT_TIMEOUT 1
+#define TWOCAN_WAIT_FAILED 2
+
+// Timeout meaning wait forever
+#define TWOCAN_WAIT_INFINITE 0xFFFFFFFF
+
+// FileOpen modes, an existing file read sequentially, or a new file to be written
+#define TWOCAN_FILE_READ 0
+#define TWOCAN_FILE_CREATE 1
+
+// Thread entry point, returns the thread's exit code
+typedef DWORD (TWOCAN_THREAD_CALL *TwoCanThreadFunction)(void *parameter);
+
+// Auto reset events, returns NULL on failure.
+// Windows events are named so that the caller can open them, POSIX events are private to the process
+// and the caller should use ReadAdapterBatch rather than waiting on a named event
+TwoCanEvent EventCreate(const TwoCanChar *name);
+int EventSet(TwoCanEvent event);
+int EventWait(TwoCanEvent event, const unsigned int timeoutMs);
+int EventClose(TwoCanEvent event);
+
+// Open the mutex created by the caller to guard its CAN Frame buffer, POSIX mutexes are private to the process
+TwoCanMutex MutexOpen(const TwoCanChar *name);
+// Create an unnamed mutex private to the driver
+TwoCanMutex MutexCreate(void);
+int MutexLock(TwoCanMutex mutex, const unsigned int timeoutMs);
+int MutexUnlock(TwoCanMutex mutex);
+int MutexClose(TwoCanMutex mutex);
+
+// Start a thread, threadId is only used for diagnostics
+TwoCanThread ThreadCreate(TwoCanThreadFunction function, void *parameter, DWORD *threadId);
+
+// End the calling thread
+TWOCAN_NORETURN void ThreadExit(const DWORD exitCode);
+
+// Release a thread handle, the thread itself keeps running until it returns
+int ThreadClose(TwoCanThread thread);
+
+// Suspend the calling thread
+void ThreadSleep(const unsigned int milliseconds);
+
+// Timer used for waits shorter than a millisecond, returns NULL if none is available
+TwoCanTimer TimerCreate(void);
+void TimerWait(TwoCanTimer timer, const unsigned long long microseconds);
+void TimerClose(TwoCanTimer timer);
+
+// Monotonic host clock in microseconds, used to timestamp received frames
+unsigned long long GetHostTimestamp(void);
+
+// Files, FileOpen returns NULL on failure
+TwoCanFile FileOpen(const TwoCanChar *fileName, const int mode);
+int FileRead(TwoCanFile file, void *buffer, const unsigned int length, unsigned int *bytesRead);
+int FileWrite(TwoCanFile file, const void *buffer, const unsigned int length);
+int FileSeek(TwoCanFile file, const unsigned long long offset);
+int FileSize(TwoCanFile file, unsigned long long *size);
+int FileTime(TwoCanFile file, unsigned long long *lastWrite);
+void FileClose(TwoCanFile file);
+int FileExists(const TwoCanChar *fileName);
+int FileDelete(const TwoCanChar *fileName);
+int FileReplace(const TwoCanChar *source, const TwoCanChar *destination);
+
+// Read only memory mapping of an open file, views must start on a MappingGranularity boundary
+TwoCanMapping MappingCreate(TwoCanFile file);
+const void *MappingView(TwoCanMapping mapping, const unsigned long long offset, const unsigned long long length);
+void MappingUnview(const void *view, const unsigned long long length);
+void MappingClose(TwoCanMapping mapping);
+unsigned int MappingGranularity(void);
+
+// Serial ports, returns NULL on failure. Settings follow the Win32 DCB conventions,
+// stopBits 0 = 1, 1 = 1.5, 2 = 2 stop bits, parity 0 = none, 1 = odd, 2 = even, a baud rate of zero keeps the current speed
+TwoCanSerial SerialOpen(const TwoCanChar *portName, const int baudRate, const int dataBits, const int stopBits, const int parity);
+
+// Sleep until bytes arrive or timeoutMs elapses, then return whatever has been received without waiting for more.
+// Returns TWOCAN_WAIT_SIGNALLED if bytesRead is non zero, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+int SerialRead(TwoCanSerial port, void *buffer, const unsigned int length, unsigned int *bytesRead, const unsigned int timeoutMs);
+int SerialWrite(TwoCanSerial port, const void *buffer, const unsigned int length);
+// Number of received bytes waiting in the operating system's input buffer, zero if it cannot be determined
+unsigned int SerialBytesQueued(TwoCanSerial port);
+void SerialClose(TwoCanSerial port);
+
+// Full path of a file in the user's documents folder, path must hold TWOCAN_MAX_PATH characters
+int GetDocumentsPath(const TwoCanChar *fileName, TwoCanChar *path);
+
+// Append an extension to a file name, returns FALSE if the result would not fit in TWOCAN_MAX_PATH characters
+int PathAddExtension(TwoCanChar *path, const TwoCanChar *fileName, const TwoCanChar *extension);
+
+// Error code of the last failed call
+int PlatformGetLastError(void);
+
+// Human readable message for an error code
+char *PlatformErrorMessage(const int errorCode);
+
+// Write formatted debug output, Windows to the debugger, POSIX to stderr when TWOCAN_DEBUG is set
+void PlatformDebugOutput(const wchar_t *format, va_list args);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_REPLAY
+#define _TWOCAN_REPLAY
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Default replay speed, frames are replayed at the rate they were recorded
+#define CONST_REPLAY_SPEED_REALTIME 1.0
+
+// Replay speed meaning replay as fast as the caller consumes the frames
+#define CONST_REPLAY_SPEED_MAXIMUM 0.0
+
+// Gaps in the log longer than this (microseconds) are skipped rather than replayed
+#define CONST_REPLAY_MAX_GAP 10000000
+
+// Longest single wait (milliseconds), so the read thread notices when it is stopped
+#define CONST_REPLAY_MAX_WAIT 100
+
+// Paces replayed frames by their recorded timestamps.
+// Each frame is due at anchorHost + (logTime - anchorLog) / speed, the anchor is reset whenever the
+// speed changes, the log restarts or wraps (eg. a time of day passing midnight), or a long gap is skipped
+typedef struct TwoCanReplayClock {
+	// Speed requested by the caller, may be changed while replaying
+	volatile double requestedSpeed;
+	// Speed used for the current anchor
+	double speed;
+	int anchored;
+	unsigned long long anchorLog;
+	unsigned long long anchorHost;
+	unsigned long long lastLog;
+	// Timer used for sub millisecond waits
+	TwoCanTimer timer;
+} TwoCanReplayClock;
+
+// Initialise the replay clock, speed is a multiple of the recorded rate, CONST_REPLAY_SPEED_MAXIMUM for no pacing
+int ReplayInitialise(TwoCanReplayClock *clock, const double speed);
+
+// Change the replay speed, takes effect from the next frame
+void ReplaySetSpeed(TwoCanReplayClock *clock, const double speed);
+
+// Wait until a frame with the given log timestamp is due, returns the host timestamp at which it was due
+unsigned long long ReplayWait(TwoCanReplayClock *clock, const unsigned long long logTime, const BOOL *isRunning);
+
+// Release the replay clock's resources
+void ReplayClose(TwoCanReplayClock *clock);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
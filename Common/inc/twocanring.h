@@ -0,0 +1,79 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+#ifndef _TWOCAN_RING
+#define _TWOCAN_RING
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Maximum number of frames held in a ring, must be a power of two
+#define CONST_RING_CAPACITY 1024
+
+// Interval at which a read thread waiting for the caller to drain a full ring checks again whether the ring
+// has space, or the adapter's own receive queue is filling up (milliseconds)
+#define CONST_BACK_PRESSURE_WAIT 10
+
+// Single producer, single consumer ring buffer of CAN Frames, allocated by the caller and passed to ReadAdapterEx.
+// The driver's read thread is the only producer and only advances head,
+// the caller is the only consumer and only advances tail.
+// head and tail are free running counters, the number of queued frames is head - tail.
+// After draining the ring the caller should signal CONST_DATACONSUMED_EVENT, a read thread
+// that finds the ring full waits on that event rather than discarding frames.
+typedef struct TwoCanRing {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	// Number of usable slots, a power of two no larger than CONST_RING_CAPACITY
+	unsigned int capacity;
+	unsigned int mask;
+	// Number of frames discarded because the ring was full
+	volatile unsigned int overflowCount;
+	TwoCanFrame frames[CONST_RING_CAPACITY];
+} TwoCanRing;
+
+// Initialise an empty ring, capacity must be a power of two, no larger than CONST_RING_CAPACITY
+int RingInitialise(TwoCanRing *ring, const unsigned int capacity);
+
+// Check that a caller supplied ring has been correctly initialised
+int RingIsValid(const TwoCanRing *ring);
+
+// Producer, append a frame, returns FALSE and increments the overflow count if the ring is full
+int RingWrite(TwoCanRing *ring, const TwoCanFrame *frame);
+
+// Consumer, remove the oldest frame, returns FALSE if the ring is empty
+int RingRead(TwoCanRing *ring, TwoCanFrame *frame);
+
+// Consumer, remove up to capacity of the oldest frames, returns the number of frames removed
+unsigned int RingReadBatch(TwoCanRing *ring, TwoCanFrame *frames, const unsigned int capacity);
+
+// Number of frames currently queued
+unsigned int RingCount(const TwoCanRing *ring);
+
+// Check whether the producer has any free slots
+int RingIsFull(const TwoCanRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
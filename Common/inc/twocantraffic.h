@@ -0,0 +1,49 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_TRAFFIC
+#define _TWOCAN_TRAFFIC
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// Synthetic NMEA 2000 traffic and recorded logs, used by the adapter emulator and the mock vendor libraries
+// to exercise the drivers without CAN hardware
+
+// Create a synthetic frame, cycling through a mix of the rapid update PGNs seen on a typical network.
+// The first four data bytes carry the sequence number, little endian, so a reader can detect lost frames
+void TrafficGenerateFrame(const unsigned long long sequence, TwoCanFrame *frame);
+
+// Load every frame from a candump, Kees, Yacht Devices or TwoCan raw log, frames is allocated with malloc
+// returns the number of frames loaded, zero if the file could not be read or holds no frames
+unsigned int TrafficLoadLog(const char *fileName, TwoCanFrame **frames);
+
+// Read a numeric setting from the environment, returns defaultValue if the variable is not set
+unsigned long long TrafficGetSetting(const char *name, const unsigned long long defaultValue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
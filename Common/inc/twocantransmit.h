@@ -0,0 +1,118 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_TRANSMIT
+#define _TWOCAN_TRANSMIT
+
+#include "twocandriver.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// NMEA 2000 priorities, 0 is the most urgent
+#define CONST_TRANSMIT_PRIORITIES 8
+
+// Frames queued at each priority, must be a power of two
+#define CONST_TRANSMIT_QUEUE 64
+
+// Most frames handed to the driver's send function at a time
+#define CONST_TRANSMIT_BATCH 16
+
+// Longest the writer thread waits for a frame before checking whether it has been stopped (milliseconds)
+#define CONST_TRANSMIT_TIMEOUT 100
+
+// Longest the writer thread spends sending frames still queued when it is stopped (milliseconds)
+#define CONST_TRANSMIT_FLUSH_TIME 250
+
+// Sends frames to the adapter in order, called only from the writer thread.
+// Returns the number of frames the adapter accepted, the remainder are counted as failed
+typedef int (*TwoCanSendFunction)(const TwoCanFrame *frames, const int count);
+
+// Called from the writer thread once a frame has been sent, or has failed.
+// The frame's timestamp is the host time it was queued
+typedef void (*TwoCanTransmitCallback)(const TwoCanFrame *frame, const int result, void *context);
+
+// Transmit statistics, returned by GetTransmitStatistics
+typedef struct TwoCanTransmitStatistics {
+	unsigned long long framesQueued;
+	unsigned long long framesTransmitted;
+	// Frames the adapter refused
+	unsigned long long framesFailed;
+	// Frames not queued because their priority was full
+	unsigned long long framesRejected;
+	// Microseconds from being queued to being accepted by the adapter
+	unsigned long long totalLatency;
+	unsigned long long maximumLatency;
+	// Most frames waiting at any one time
+	unsigned int maximumDepth;
+} TwoCanTransmitStatistics;
+
+// Frames waiting at one priority, producers hold the queue's mutex, the writer thread is the only consumer
+typedef struct TwoCanTransmitLevel {
+	volatile unsigned int head;
+	volatile unsigned int tail;
+	TwoCanFrame frames[CONST_TRANSMIT_QUEUE];
+} TwoCanTransmitLevel;
+
+// Asynchronous transmit queue, WriteAdapter queues frames and returns, a writer thread sends them
+// in priority order, frames of the same priority in the order they were queued.
+// The writer takes up to CONST_TRANSMIT_BATCH frames at a time, so a driver can send them with a single write
+typedef struct TwoCanTransmitQueue {
+	TwoCanTransmitLevel levels[CONST_TRANSMIT_PRIORITIES];
+	// Serialises the threads queueing frames and guards isRunning against TransmitStop.
+	// The mutex and events are created by the first TransmitStart and never closed, a thread may be waiting
+	// for the mutex while the queue stops and a writer thread that outlives TransmitStop still signals its events
+	TwoCanMutex mutex;
+	// Signalled when frames are queued
+	TwoCanEvent frameQueuedEvent;
+	TwoCanEvent threadFinishedEvent;
+	// Writer thread, kept by TransmitStop if it does not exit in time so the next TransmitStart waits for it
+	TwoCanThread thread;
+	DWORD threadId;
+	volatile int isRunning;
+	TwoCanSendFunction send;
+	TwoCanTransmitCallback volatile callback;
+	void * volatile callbackContext;
+	TwoCanTransmitStatistics statistics;
+} TwoCanTransmitQueue;
+
+// Create the queue's mutex and events if need be and start the writer thread, returns TWOCAN_RESULT_SUCCESS or a fatal error
+int TransmitStart(TwoCanTransmitQueue *queue, TwoCanSendFunction send);
+
+// Send what is still queued, for up to CONST_TRANSMIT_FLUSH_TIME, then stop the writer thread and discard the rest
+void TransmitStop(TwoCanTransmitQueue *queue);
+
+// Queue frames, either all of them or, if any priority lacks the space, none. So the frames of a fast packet
+// message are never partly queued. Returns TWOCAN_RESULT_SUCCESS or TWOCAN_ERROR_TRANSMIT_QUEUE_FULL
+int TransmitEnqueue(TwoCanTransmitQueue *queue, const TwoCanFrame *frames, const int count);
+
+// Number of frames waiting to be sent
+unsigned int TransmitCount(const TwoCanTransmitQueue *queue);
+
+// Set or clear the completion callback
+void TransmitSetCallback(TwoCanTransmitQueue *queue, TwoCanTransmitCallback callback, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,200 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_TRANSPORT
+#define _TWOCAN_TRANSPORT
+
+#include "twocandriver.h"
+#include "twocanfilter.h"
+#include "twocantransmit.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// ISO 11783-3 (J1939-21) transport protocol PGNs, connection management and data transfer
+#define CONST_TRANSPORT_CM_PGN 60416
+#define CONST_TRANSPORT_DT_PGN 60160
+
+// Connection management control bytes
+#define TWOCAN_TRANSPORT_RTS 16
+#define TWOCAN_TRANSPORT_CTS 17
+#define TWOCAN_TRANSPORT_EOM 19
+#define TWOCAN_TRANSPORT_BAM 32
+#define TWOCAN_TRANSPORT_ABORT 255
+
+// Connection abort reasons
+#define TWOCAN_TRANSPORT_ABORT_BUSY 1
+#define TWOCAN_TRANSPORT_ABORT_RESOURCES 2
+#define TWOCAN_TRANSPORT_ABORT_TIMEOUT 3
+
+// Number of sessions that may be in progress at once
+#define CONST_TRANSPORT_SESSIONS 16
+
+// Longest message, 255 packets of 7 bytes
+#define CONST_TRANSPORT_LENGTH 1785
+
+// Shortest message, anything shorter fits in a single frame
+#define CONST_TRANSPORT_MINIMUM_LENGTH 9
+
+// Bytes carried by each data transfer packet
+#define CONST_TRANSPORT_PACKET_BYTES 7
+
+// Most packets requested by each clear to send when the table is the receiver
+#define CONST_TRANSPORT_WINDOW 16
+
+// Timeouts in microseconds, T1 waiting for the next packet, T2 waiting for the first packet after a clear to send
+#define CONST_TRANSPORT_T1 750000
+#define CONST_TRANSPORT_T2 1250000
+
+// Source address meaning the table only monitors sessions between other devices, the ISO 11783 null address
+#define CONST_TRANSPORT_NULL_ADDRESS 254
+
+// Destination address of a broadcast (BAM) session
+#define CONST_TRANSPORT_GLOBAL_ADDRESS 255
+
+// Priority of the connection management frames sent when the table is the receiver
+#define CONST_TRANSPORT_PRIORITY 7
+
+// Results of TransportPush
+// The frame is not a transport protocol frame, the caller handles the frame as it is
+#define TWOCAN_TRANSPORT_IGNORED 0
+// The frame has been consumed, no message is complete yet
+#define TWOCAN_TRANSPORT_PENDING 1
+// The frame completed a message
+#define TWOCAN_TRANSPORT_COMPLETE 2
+// The frame did not belong to a session, or broke the session it belonged to
+#define TWOCAN_TRANSPORT_DISCARDED 3
+
+// A reassembled transport protocol message.
+// data points into the session that received it, it is not copied
+typedef struct TwoCanTransportMessage {
+	// Timestamp of the packet that completed the message
+	unsigned long long timestamp;
+	// PGN of the message, not the transport protocol PGNs
+	unsigned int pgn;
+	byte priority;
+	byte source;
+	// CONST_TRANSPORT_GLOBAL_ADDRESS for a broadcast message
+	byte destination;
+	unsigned int length;
+	const byte *data;
+} TwoCanTransportMessage;
+
+// Called from the driver's read thread with each completed message, the message and its data are only valid during the call
+typedef void (*TwoCanTransportCallback)(const TwoCanTransportMessage *message, void *context);
+
+// Transport protocol statistics, returned by GetTransportStatistics
+typedef struct TwoCanTransportStatistics {
+	unsigned long long messagesCompleted;
+	unsigned long long broadcastSessions;
+	unsigned long long connectedSessions;
+	// Sessions ended by a connection abort, a missing packet or a new session between the same devices
+	unsigned long long sessionsAborted;
+	unsigned long long sessionsTimedOut;
+	// Sessions not started because every session was in use
+	unsigned long long sessionsRejected;
+	// Packets with no session, or repeated
+	unsigned long long framesDiscarded;
+	// Most sessions in progress at any one time
+	unsigned int maximumActive;
+} TwoCanTransportStatistics;
+
+// A session in progress, preallocated with room for the longest message
+typedef struct TwoCanTransportSession {
+	byte isActive;
+	byte isBroadcast;
+	// Set when the table is the receiver and so sends the clear to send and end of message acknowledgements
+	byte isReceiver;
+	byte priority;
+	byte source;
+	byte destination;
+	// Packets in the message, the packet expected next, and the last packet of the current clear to send
+	byte packets;
+	byte nextPacket;
+	byte windowEnd;
+	// Most packets the sender will accept in one clear to send, 255 for no limit
+	byte maximumWindow;
+	unsigned int pgn;
+	unsigned int length;
+	// The session times out if the next frame has not arrived by then
+	unsigned long long deadline;
+	byte data[CONST_TRANSPORT_LENGTH];
+} TwoCanTransportSession;
+
+// Transport protocol session manager, frames are pushed as they are received and complete messages returned.
+// Broadcast (BAM) sessions and connected (RTS/CTS) sessions are reassembled from a fixed pool of sessions,
+// nothing is allocated on the receive path. Connected sessions between other devices are followed from the bus,
+// if an address and a send function are set, sessions addressed to that address are acknowledged.
+// Only used from a single thread, the driver's read thread
+typedef struct TwoCanTransportTable {
+	TwoCanTransportSession sessions[CONST_TRANSPORT_SESSIONS];
+	unsigned int activeCount;
+	// Address sessions are accepted for, CONST_TRANSPORT_NULL_ADDRESS to only monitor
+	byte address;
+	// Sends the clear to send, end of message and abort frames
+	TwoCanSendFunction send;
+	// The message most recently completed
+	TwoCanTransportMessage message;
+	TwoCanTransportCallback volatile callback;
+	void * volatile callbackContext;
+	// The driver's acceptance filters, completed messages are only passed to the callback if their PGN is accepted.
+	// NULL accepts every message
+	const TwoCanFilterTable * volatile filters;
+	TwoCanTransportStatistics statistics;
+} TwoCanTransportTable;
+
+// Clear every session and the statistics, the address, send function, callback and filters are kept
+void TransportInitialise(TwoCanTransportTable *table);
+
+// Set the address connected sessions are accepted for and the function used to answer them.
+// CONST_TRANSPORT_NULL_ADDRESS, or a NULL send function, only monitors sessions
+void TransportSetAddress(TwoCanTransportTable *table, const byte address, TwoCanSendFunction send);
+
+// Add a frame to its session, returns TWOCAN_TRANSPORT_xxx.
+// If COMPLETE, message points at the reassembled message, valid until the next call to TransportPush or TransportExpire
+int TransportPush(TwoCanTransportTable *table, const TwoCanFrame *frame, const TwoCanTransportMessage **message);
+
+// End sessions whose next frame is overdue, returns the number ended
+unsigned int TransportExpire(TwoCanTransportTable *table, const unsigned long long now);
+
+// Push frames and pass each completed message the filters accept to the callback.
+// Does nothing unless there is a callback or an address to answer sessions for
+void TransportProcess(TwoCanTransportTable *table, const TwoCanFrame *frames, const int count);
+
+// Set or clear the completed message callback
+void TransportSetCallback(TwoCanTransportTable *table, TwoCanTransportCallback callback, void *context);
+
+// Set the filters completed messages are checked against, NULL accepts every message
+void TransportSetFilters(TwoCanTransportTable *table, const TwoCanFilterTable *filters);
+
+// Returns TRUE if there is a callback or an address to answer sessions for, so the transport protocol PGNs are needed
+int TransportIsInUse(const TwoCanTransportTable *table);
+
+// Returns TRUE if the frame is a transport protocol frame and the table is in use,
+// the driver passes it to TransportProcess even if its acceptance filters reject it
+int TransportIsWanted(const TwoCanTransportTable *table, const unsigned int id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
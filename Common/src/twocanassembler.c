@@ -0,0 +1,382 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanAssembler
+// Unit Description: Streaming decoder and encoder for the serial adapters' text records
+// Date: 16/10/2026
+// Function: Table driven state machine, each record type is described by a layout of fields and
+// each received character is decoded straight into the frame under construction, with no heap use.
+// Frames to be transmitted are encoded a byte at a time from a table of hexadecimal pairs.
+//
+
+#include "../inc/twocanassembler.h"
+
+#include <string.h>
+
+// Character classes, hexadecimal characters map to their value
+#define CLASS_CR 0x10
+#define CLASS_LF 0x11
+#define CLASS_OTHER 0xFF
+
+static const byte characterClasses[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x11, 0xFF, 0xFF, 0x10, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+// Two upper case hexadecimal characters for each byte value, used to encode records
+static const char hexPairs[] =
+	"000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+	"202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+	"404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+	"606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+	"808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+	"A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+	"C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+	"E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Field types that make up a record layout
+// A single literal character
+#define FIELD_LITERAL 0
+// count characters that are not checked
+#define FIELD_SKIP 1
+// Axiomtek frame type, 1 for an extended frame, 0 for a standard frame
+#define FIELD_FORMAT 2
+// count hexadecimal characters of CAN id
+#define FIELD_ID 3
+// count hexadecimal characters of data length, 0 - 8
+#define FIELD_LENGTH 4
+// Two hexadecimal characters for each data byte, skipped for remote frames
+#define FIELD_DATA 5
+// Up to count optional hexadecimal characters, eg. the SLCAN timestamp, then the terminator
+#define FIELD_END 6
+
+// Results of decoding a character
+#define DECODE_CONTINUE 0
+#define DECODE_FRAME 1
+#define DECODE_REJECT 2
+
+typedef struct AssemblerField {
+	byte type;
+	byte count;
+	char literal;
+} AssemblerField;
+
+// SLCAN, Tiiiiiiiildd..[tttt]CR, Riiiiiiiil[tttt]CR
+static const AssemblerField slcanExtended[] = {
+	{ FIELD_ID, 8, 0 }, { FIELD_LENGTH, 1, 0 }, { FIELD_DATA, 0, 0 }, { FIELD_END, 4, 0 }
+};
+
+// SLCAN, tiiildd..[tttt]CR, riiil[tttt]CR
+static const AssemblerField slcanStandard[] = {
+	{ FIELD_ID, 3, 0 }, { FIELD_LENGTH, 1, 0 }, { FIELD_DATA, 0, 0 }, { FIELD_END, 4, 0 }
+};
+
+// Axiomtek, @Fppppxiiiiiiiilldd..CR LF, where x is the frame type
+static const AssemblerField axiomtekFrame[] = {
+	{ FIELD_LITERAL, 1, 'F' }, { FIELD_SKIP, 4, 0 }, { FIELD_FORMAT, 1, 0 }, { FIELD_ID, 8, 0 },
+	{ FIELD_LENGTH, 2, 0 }, { FIELD_DATA, 0, 0 }, { FIELD_END, 0, 0 }
+};
+
+//
+// Initialise an assembler
+// [in] assembler, pointer to caller allocated assembler
+// [in] format, TWOCAN_ASSEMBLER_SLCAN or TWOCAN_ASSEMBLER_AXIOMTEK
+//
+
+void AssemblerInitialise(TwoCanAssembler *assembler, const int format) {
+	memset(assembler, 0, sizeof(TwoCanAssembler));
+	assembler->format = (byte)format;
+	assembler->state = TWOCAN_ASSEMBLER_IDLE;
+}
+
+//
+// Begin a new record if the character is a record's start character
+// [in] assembler
+// [in] c, character
+// returns TRUE if a record was started
+//
+
+static int StartRecord(TwoCanAssembler *assembler, const byte c) {
+	const AssemblerField *layout = NULL;
+	byte flags = 0;
+
+	if (assembler->format == TWOCAN_ASSEMBLER_SLCAN) {
+		switch (c) {
+		case 'T':
+			layout = slcanExtended;
+			flags = TWOCAN_FRAME_FLAG_EXTENDED;
+			break;
+		case 't':
+			layout = slcanStandard;
+			break;
+		case 'R':
+			layout = slcanExtended;
+			flags = TWOCAN_FRAME_FLAG_EXTENDED | TWOCAN_FRAME_FLAG_REMOTE;
+			break;
+		case 'r':
+			layout = slcanStandard;
+			flags = TWOCAN_FRAME_FLAG_REMOTE;
+			break;
+		}
+	}
+	else if (c == '@') {
+		layout = axiomtekFrame;
+	}
+
+	if (layout == NULL) {
+		return FALSE;
+	}
+
+	assembler->state = TWOCAN_ASSEMBLER_RECORD;
+	assembler->layout = layout;
+	assembler->field = 0;
+	assembler->digits = 0;
+	assembler->value = 0;
+	assembler->frame.id = 0;
+	assembler->frame.dlc = 0;
+	assembler->frame.flags = flags;
+	memset(assembler->frame.data, 0, CONST_PAYLOAD_LENGTH);
+	return TRUE;
+}
+
+//
+// Move on to the next field of the record's layout, remote frames and empty frames have no data field
+// [in] assembler
+//
+
+static void NextField(TwoCanAssembler *assembler) {
+	assembler->field++;
+	assembler->digits = 0;
+	assembler->value = 0;
+	if ((assembler->layout[assembler->field].type == FIELD_DATA) &&
+		((assembler->frame.dlc == 0) || (assembler->frame.flags & TWOCAN_FRAME_FLAG_REMOTE))) {
+		assembler->field++;
+	}
+}
+
+//
+// Decode a character of the current record
+// [in] assembler
+// [in] c, character
+// [in] characterClass, the character's class
+// [in] terminator, class of the format's record terminator
+// returns DECODE_CONTINUE, DECODE_FRAME once the record is complete or DECODE_REJECT
+//
+
+static int DecodeCharacter(TwoCanAssembler *assembler, const byte c, const byte characterClass, const byte terminator) {
+	const AssemblerField *field = &assembler->layout[assembler->field];
+
+	switch (field->type) {
+
+	case FIELD_LITERAL:
+		if (c != (byte)field->literal) {
+			return DECODE_REJECT;
+		}
+		NextField(assembler);
+		return DECODE_CONTINUE;
+
+	case FIELD_SKIP:
+		if (characterClass == terminator) {
+			return DECODE_REJECT;
+		}
+		if (++assembler->digits == field->count) {
+			NextField(assembler);
+		}
+		return DECODE_CONTINUE;
+
+	case FIELD_FORMAT:
+		if (c == '1') {
+			assembler->frame.flags |= TWOCAN_FRAME_FLAG_EXTENDED;
+		}
+		else if (c != '0') {
+			return DECODE_REJECT;
+		}
+		NextField(assembler);
+		return DECODE_CONTINUE;
+
+	case FIELD_ID:
+		if (characterClass > 0x0F) {
+			return DECODE_REJECT;
+		}
+		assembler->value = (assembler->value << 4) | characterClass;
+		if (++assembler->digits == field->count) {
+			if (assembler->value > ((assembler->frame.flags & TWOCAN_FRAME_FLAG_EXTENDED) ? CONST_EXTENDED_ID_MASK : CONST_STANDARD_ID_MASK)) {
+				return DECODE_REJECT;
+			}
+			assembler->frame.id = assembler->value;
+			NextField(assembler);
+		}
+		return DECODE_CONTINUE;
+
+	case FIELD_LENGTH:
+		if (characterClass > 0x0F) {
+			return DECODE_REJECT;
+		}
+		assembler->value = (assembler->value << 4) | characterClass;
+		if (++assembler->digits == field->count) {
+			if (assembler->value > CONST_PAYLOAD_LENGTH) {
+				return DECODE_REJECT;
+			}
+			assembler->frame.dlc = (byte)assembler->value;
+			NextField(assembler);
+		}
+		return DECODE_CONTINUE;
+
+	case FIELD_DATA:
+		if (characterClass > 0x0F) {
+			return DECODE_REJECT;
+		}
+		if (assembler->digits & 1) {
+			assembler->frame.data[assembler->digits >> 1] |= characterClass;
+		}
+		else {
+			assembler->frame.data[assembler->digits >> 1] = (byte)(characterClass << 4);
+		}
+		if (++assembler->digits == (assembler->frame.dlc * 2)) {
+			NextField(assembler);
+		}
+		return DECODE_CONTINUE;
+
+	case FIELD_END:
+		if (characterClass == terminator) {
+			return ((assembler->digits == 0) || (assembler->digits == field->count)) ? DECODE_FRAME : DECODE_REJECT;
+		}
+		if ((characterClass > 0x0F) || (assembler->digits == field->count)) {
+			return DECODE_REJECT;
+		}
+		assembler->digits++;
+		return DECODE_CONTINUE;
+	}
+
+	return DECODE_REJECT;
+}
+
+//
+// Decode received bytes
+// [in] assembler
+// [in] bytes, characters received from the adapter
+// [in] length, number of characters
+// [in] timestamp, host time the characters were received
+// [out] frames, pointer to array of CAN Frames
+// [in] capacity, number of frames the array can hold
+// [out] consumed, number of characters decoded, less than length if the array filled
+// returns the number of frames written
+//
+
+int AssemblerPush(TwoCanAssembler *assembler, const char *bytes, const unsigned int length, const unsigned long long timestamp,
+	TwoCanFrame *frames, const int capacity, unsigned int *consumed) {
+	// SLCAN records end with CR, Axiomtek records with CR LF where the CR is ignored
+	const byte terminator = (assembler->format == TWOCAN_ASSEMBLER_SLCAN) ? CLASS_CR : CLASS_LF;
+	const byte ignored = (assembler->format == TWOCAN_ASSEMBLER_SLCAN) ? CLASS_LF : CLASS_CR;
+	unsigned int i;
+	int count = 0;
+	byte c;
+	byte characterClass;
+
+	for (i = 0; (i < length) && (count < capacity); i++) {
+		c = (byte)bytes[i];
+		characterClass = characterClasses[c];
+
+		if (characterClass == ignored) {
+			continue;
+		}
+
+		// Between records, anything other than a start character is a response to a command
+		// (eg. the Axiomtek's #OK) or the tail of a record that was joined part way through
+		if (assembler->state == TWOCAN_ASSEMBLER_IDLE) {
+			StartRecord(assembler, c);
+			continue;
+		}
+
+		switch (DecodeCharacter(assembler, c, characterClass, terminator)) {
+		case DECODE_FRAME:
+			assembler->frame.timestamp = timestamp;
+			frames[count] = assembler->frame;
+			count++;
+			assembler->state = TWOCAN_ASSEMBLER_IDLE;
+			break;
+		case DECODE_REJECT:
+			// Record corrupted on the serial line, or its terminator was lost and this is the start of the next record
+			assembler->rejectCount++;
+			assembler->state = TWOCAN_ASSEMBLER_IDLE;
+			StartRecord(assembler, c);
+			break;
+		}
+	}
+
+	*consumed = i;
+	return count;
+}
+
+//
+// Encode a frame as the record the adapter expects to be sent
+// SLCAN, Tiiiiiiiildd..CR
+// Only SLCAN is encoded, the Axiomtek's transmit record is not documented so the Axiomtek driver does not transmit
+// [in] format, TWOCAN_ASSEMBLER_SLCAN
+// [in] frame, 29 bit identifier, no more than CONST_PAYLOAD_LENGTH data bytes
+// [out] record, at least CONST_MAX_RECORD_LENGTH characters, not null terminated
+// returns the length of the record, 0 if the format cannot be encoded
+//
+
+unsigned int AssemblerEncode(const int format, const TwoCanFrame *frame, char *record) {
+	char *p = record;
+	unsigned int id = frame->id & CONST_EXTENDED_ID_MASK;
+	unsigned int dlc = (frame->dlc > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : frame->dlc;
+
+	if (format != TWOCAN_ASSEMBLER_SLCAN) {
+		return 0;
+	}
+
+	*p++ = 'T';
+
+	// A table lookup per byte rather than per hexadecimal digit
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		memcpy(p, &hexPairs[((id >> shift) & 0xFF) * 2], 2);
+		p += 2;
+	}
+
+	*p++ = (char)('0' + dlc);
+
+	for (unsigned int i = 0; i < dlc; i++) {
+		memcpy(p, &hexPairs[frame->data[i] * 2], 2);
+		p += 2;
+	}
+
+	*p++ = '\r';
+
+	return (unsigned int)(p - record);
+}
@@ -0,0 +1,373 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanCache
+// Unit Description: Binary replay cache for the text log file drivers
+// Date: 16/10/2026
+// Function: Stores the frames parsed from a text log in a sidecar file of fixed size records,
+// so that later replays, and each loop back to the start of the log, need no parsing at all.
+//
+
+#include "../inc/twocancache.h"
+#include "../inc/twocanerror.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//
+// Compute the key used to match a replay cache with its log file
+// [in] logFileName, full path of the log file
+// [out] header, the source size, time and hash are set
+// returns TRUE if the log file could be read
+//
+
+static int CacheKey(const TwoCanChar *logFileName, TwoCanCacheHeader *header) {
+	TwoCanFile file;
+	unsigned long long offset;
+	byte *buffer;
+	unsigned int bytesRead;
+	unsigned long long hash;
+	int result = FALSE;
+
+	file = FileOpen(logFileName, TWOCAN_FILE_READ);
+	if (file == NULL) {
+		return FALSE;
+	}
+
+	buffer = (byte *)malloc(CONST_CACHE_HASH_SPAN);
+
+	if ((buffer != NULL) && (FileSize(file, &header->sourceSize)) && (FileTime(file, &header->sourceTime))) {
+
+		// FNV-1a of the first and last CONST_CACHE_HASH_SPAN bytes, hashing the whole of a multi gigabyte log
+		// would cost as much as parsing it, the size and time catch changes to the middle of the file
+		hash = 0xCBF29CE484222325ULL;
+		result = TRUE;
+		for (int i = 0; (i < 2) && (result); i++) {
+			offset = 0;
+			if ((i == 1) && (header->sourceSize > CONST_CACHE_HASH_SPAN)) {
+				offset = header->sourceSize - CONST_CACHE_HASH_SPAN;
+			}
+			result = (FileSeek(file, offset) && FileRead(file, buffer, CONST_CACHE_HASH_SPAN, &bytesRead));
+			for (unsigned int j = 0; (result) && (j < bytesRead); j++) {
+				hash = (hash ^ buffer[j]) * 0x100000001B3ULL;
+			}
+		}
+		header->sourceHash = hash;
+	}
+
+	free(buffer);
+	FileClose(file);
+	return result;
+}
+
+//
+// Build the cache file names from the log file name
+// [in] cache, pointer to cache
+// [in] logFileName, full path of the log file
+// returns TRUE if the names fit within TWOCAN_MAX_PATH
+//
+
+static int CacheNames(TwoCanCache *cache, const TwoCanChar *logFileName) {
+	return ((PathAddExtension(cache->cacheName, logFileName, CONST_CACHE_EXTENSION)) &&
+		(PathAddExtension(cache->tempName, cache->cacheName, CONST_CACHE_TEMP_EXTENSION)));
+}
+
+//
+// Reset the cache to its closed state
+// [in] cache, pointer to cache
+//
+
+static void CacheReset(TwoCanCache *cache) {
+	memset(&cache->header, 0, sizeof(TwoCanCacheHeader));
+	cache->file = NULL;
+	cache->mapping = NULL;
+	cache->view = NULL;
+	cache->viewOffset = 0;
+	cache->viewLength = 0;
+	cache->position = 0;
+	cache->writing = FALSE;
+	cache->buffered = 0;
+}
+
+//
+// Map a view of the cache file containing a record
+// [in] cache, pointer to cache
+// [in] offset, file offset of the record
+// returns TRUE if the view was mapped
+//
+
+static int CacheMapView(TwoCanCache *cache, const unsigned long long offset) {
+	unsigned long long viewOffset;
+	unsigned long long viewLength;
+	unsigned long long fileSize;
+	const byte *view;
+
+	fileSize = sizeof(TwoCanCacheHeader) + (cache->header.count * sizeof(TwoCanFrame));
+	viewOffset = offset - (offset % cache->granularity);
+	viewLength = fileSize - viewOffset;
+	if (viewLength > CONST_CACHE_VIEW_SIZE) {
+		viewLength = CONST_CACHE_VIEW_SIZE;
+	}
+
+	view = (const byte *)MappingView(cache->mapping, viewOffset, viewLength);
+	if (view == NULL) {
+		DebugPrintf(L"Map replay cache view failed: %d\n", PlatformGetLastError());
+		return FALSE;
+	}
+
+	if (cache->view != NULL) {
+		MappingUnview(cache->view, cache->viewLength);
+	}
+
+	cache->view = view;
+	cache->viewOffset = viewOffset;
+	cache->viewLength = viewLength;
+	return TRUE;
+}
+
+//
+// Open an existing replay cache
+// [in] cache, pointer to cache
+// [in] logFileName, full path of the log file
+// returns TRUE if the cache exists, matches the log file and has been mapped
+//
+
+int CacheOpen(TwoCanCache *cache, const TwoCanChar *logFileName) {
+	TwoCanCacheHeader key;
+	unsigned long long fileSize;
+	unsigned int bytesRead;
+
+	CacheReset(cache);
+
+	if ((!CacheNames(cache, logFileName)) || (!CacheKey(logFileName, &key))) {
+		return FALSE;
+	}
+
+	cache->file = FileOpen(cache->cacheName, TWOCAN_FILE_READ);
+	if (cache->file == NULL) {
+		return FALSE;
+	}
+
+	// Validate the header against the log file and the size of the cache file
+	if ((!FileRead(cache->file, &cache->header, sizeof(TwoCanCacheHeader), &bytesRead)) || (bytesRead != sizeof(TwoCanCacheHeader)) ||
+		(cache->header.magic != CONST_CACHE_MAGIC) || (cache->header.recordSize != sizeof(TwoCanFrame)) ||
+		(cache->header.sourceSize != key.sourceSize) || (cache->header.sourceTime != key.sourceTime) ||
+		(cache->header.sourceHash != key.sourceHash) || (cache->header.count == 0) ||
+		(!FileSize(cache->file, &fileSize)) ||
+		(fileSize != sizeof(TwoCanCacheHeader) + (cache->header.count * sizeof(TwoCanFrame)))) {
+		DebugPrintf(L"Replay cache out of date\n");
+		CacheClose(cache);
+		return FALSE;
+	}
+
+	cache->mapping = MappingCreate(cache->file);
+	if (cache->mapping == NULL) {
+		DebugPrintf(L"Map replay cache failed: %d\n", PlatformGetLastError());
+		CacheClose(cache);
+		return FALSE;
+	}
+
+	cache->granularity = MappingGranularity();
+
+	if (!CacheMapView(cache, sizeof(TwoCanCacheHeader))) {
+		CacheClose(cache);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//
+// Start writing a replay cache, frames are written to a temporary file that only replaces
+// the cache once it is complete. The cache must have been initialised by CacheOpen
+// [in] cache, pointer to cache
+// [in] logFileName, full path of the log file
+// returns TRUE if the temporary file was created
+//
+
+int CacheCreate(TwoCanCache *cache, const TwoCanChar *logFileName) {
+	CacheClose(cache);
+	memset(&cache->header, 0, sizeof(TwoCanCacheHeader));
+
+	if ((!CacheNames(cache, logFileName)) || (!CacheKey(logFileName, &cache->header))) {
+		return FALSE;
+	}
+
+	cache->header.magic = CONST_CACHE_MAGIC;
+	cache->header.recordSize = sizeof(TwoCanFrame);
+	cache->header.count = 0;
+
+	cache->file = FileOpen(cache->tempName, TWOCAN_FILE_CREATE);
+	if (cache->file == NULL) {
+		DebugPrintf(L"Create replay cache failed: %d\n", PlatformGetLastError());
+		return FALSE;
+	}
+
+	// The header is rewritten with the frame count once the cache is complete
+	if (!FileWrite(cache->file, &cache->header, sizeof(TwoCanCacheHeader))) {
+		DebugPrintf(L"Write replay cache failed: %d\n", PlatformGetLastError());
+		FileClose(cache->file);
+		cache->file = NULL;
+		FileDelete(cache->tempName);
+		return FALSE;
+	}
+
+	cache->writing = TRUE;
+	cache->buffered = 0;
+	return TRUE;
+}
+
+//
+// Write the buffered frames to the cache file
+// [in] cache, pointer to cache
+// returns TRUE if the frames were written
+//
+
+static int CacheFlush(TwoCanCache *cache) {
+	if (cache->buffered == 0) {
+		return TRUE;
+	}
+
+	if (!FileWrite(cache->file, cache->buffer, cache->buffered * sizeof(TwoCanFrame))) {
+		DebugPrintf(L"Write replay cache failed: %d\n", PlatformGetLastError());
+		return FALSE;
+	}
+
+	cache->header.count += cache->buffered;
+	cache->buffered = 0;
+	return TRUE;
+}
+
+//
+// Append a frame to the cache being written
+// [in] cache, pointer to cache
+// [in] frame, pointer to CAN Frame, with the timestamp recorded in the log
+// returns TRUE if the frame was appended, on failure the cache is discarded
+//
+
+int CacheWrite(TwoCanCache *cache, const TwoCanFrame *frame) {
+	if (!cache->writing) {
+		return FALSE;
+	}
+
+	cache->buffer[cache->buffered++] = *frame;
+
+	if ((cache->buffered == CONST_CACHE_WRITE_BUFFER) && (!CacheFlush(cache))) {
+		CacheClose(cache);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//
+// Complete the cache being written, replace any previous cache and reopen it for reading
+// [in] cache, pointer to cache
+// [in] logFileName, full path of the log file
+// returns TRUE if the completed cache is ready to read
+//
+
+int CacheCommit(TwoCanCache *cache, const TwoCanChar *logFileName) {
+	if (!cache->writing) {
+		return FALSE;
+	}
+
+	if ((!CacheFlush(cache)) || (cache->header.count == 0) ||
+		(!FileSeek(cache->file, 0)) ||
+		(!FileWrite(cache->file, &cache->header, sizeof(TwoCanCacheHeader)))) {
+		CacheClose(cache);
+		return FALSE;
+	}
+
+	FileClose(cache->file);
+	cache->file = NULL;
+	cache->writing = FALSE;
+
+	if (!FileReplace(cache->tempName, cache->cacheName)) {
+		DebugPrintf(L"Rename replay cache failed: %d\n", PlatformGetLastError());
+		FileDelete(cache->tempName);
+		return FALSE;
+	}
+
+	return CacheOpen(cache, logFileName);
+}
+
+//
+// Retrieve the next frame from the cache
+// [in] cache, pointer to cache
+// [out] frame, pointer to CAN Frame, with the timestamp recorded in the log
+// returns TRUE if a frame was retrieved, FALSE at the end of the cache
+//
+
+int CacheRead(TwoCanCache *cache, TwoCanFrame *frame) {
+	unsigned long long offset;
+
+	if ((cache->view == NULL) || (cache->position >= cache->header.count)) {
+		return FALSE;
+	}
+
+	offset = sizeof(TwoCanCacheHeader) + (cache->position * sizeof(TwoCanFrame));
+
+	// Record straddles the end of the current view
+	if ((offset + sizeof(TwoCanFrame)) > (cache->viewOffset + cache->viewLength)) {
+		if (!CacheMapView(cache, offset)) {
+			return FALSE;
+		}
+	}
+
+	memcpy(frame, cache->view + (offset - cache->viewOffset), sizeof(TwoCanFrame));
+	cache->position++;
+	return TRUE;
+}
+
+//
+// Restart from the first frame
+// [in] cache, pointer to cache
+//
+
+void CacheRewind(TwoCanCache *cache) {
+	cache->position = 0;
+	if ((cache->view != NULL) && (cache->viewOffset != 0)) {
+		CacheMapView(cache, sizeof(TwoCanCacheHeader));
+	}
+}
+
+//
+// Close the cache, discarding an incomplete cache
+// [in] cache, pointer to cache
+//
+
+void CacheClose(TwoCanCache *cache) {
+	if (cache->view != NULL) {
+		MappingUnview(cache->view, cache->viewLength);
+		cache->view = NULL;
+	}
+	if (cache->mapping != NULL) {
+		MappingClose(cache->mapping);
+		cache->mapping = NULL;
+	}
+	FileClose(cache->file);
+	cache->file = NULL;
+	if (cache->writing) {
+		FileDelete(cache->tempName);
+		cache->writing = FALSE;
+	}
+}
@@ -0,0 +1,108 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanClock
+// Unit Description: Correlates adapter timestamps with the host clock
+// Date: 16/10/2026
+// Function: Extends the adapter's 32 bit timestamp past its wrap and normalises it to microseconds
+// in the same time base as GetHostTimestamp, so frames from any adapter can be compared.
+//
+
+#include "../inc/twocanclock.h"
+
+//
+// Reset the clock correlation, the first converted timestamp synchronises the clock
+// [in] clock, pointer to clock
+// [in] resolution, microseconds per adapter tick
+//
+
+void ClockInitialise(TwoCanClock *clock, const unsigned int resolution) {
+	clock->resolution = (resolution == 0) ? 1 : resolution;
+	clock->lastDevice = 0;
+	clock->deviceTime = 0;
+	clock->offset = 0;
+	clock->windowOffset = 0;
+	clock->windowStart = 0;
+	clock->lastTimestamp = 0;
+	clock->synchronised = FALSE;
+}
+
+//
+// Convert an adapter timestamp to the host clock
+// [in] clock, pointer to clock
+// [in] deviceTicks, raw adapter timestamp
+// [in] hostTime, host clock in microseconds when the frame was read from the adapter
+// returns the adapter timestamp in host clock microseconds
+//
+
+unsigned long long ClockConvert(TwoCanClock *clock, const unsigned int deviceTicks, const unsigned long long hostTime) {
+	unsigned int delta;
+	long long offset;
+	unsigned long long timestamp;
+
+	if (!clock->synchronised) {
+		clock->lastDevice = deviceTicks;
+		clock->deviceTime = (unsigned long long)deviceTicks * clock->resolution;
+		clock->offset = (long long)hostTime - (long long)clock->deviceTime;
+		clock->windowOffset = clock->offset;
+		clock->windowStart = hostTime;
+		clock->lastTimestamp = hostTime;
+		clock->synchronised = TRUE;
+		return hostTime;
+	}
+
+	// Unsigned subtraction handles the 32 bit wrap, a "negative" step is a frame delivered out of order
+	delta = deviceTicks - clock->lastDevice;
+	if (delta < 0x80000000) {
+		clock->deviceTime += (unsigned long long)delta * clock->resolution;
+		clock->lastDevice = deviceTicks;
+	}
+
+	offset = (long long)hostTime - (long long)clock->deviceTime;
+
+	// A smaller offset is a frame that suffered less latency, adopt it immediately
+	if (offset < clock->offset) {
+		clock->offset = offset;
+	}
+
+	// Follow oscillator drift, at the end of each window adopt the window's minimum even if it is larger
+	if (offset < clock->windowOffset) {
+		clock->windowOffset = offset;
+	}
+	if ((hostTime - clock->windowStart) >= CONST_CLOCK_WINDOW) {
+		clock->offset = clock->windowOffset;
+		clock->windowOffset = offset;
+		clock->windowStart = hostTime;
+	}
+
+	timestamp = (unsigned long long)((long long)clock->deviceTime + clock->offset);
+
+	// Never later than the host saw the frame, never earlier than the previous frame
+	if (timestamp > hostTime) {
+		timestamp = hostTime;
+	}
+	if (timestamp < clock->lastTimestamp) {
+		timestamp = clock->lastTimestamp;
+	}
+	clock->lastTimestamp = timestamp;
+	return timestamp;
+}
@@ -27,48 +27,122 @@
 //
 
 
-#include "..\inc\twocandriver.h"
+#include "../inc/twocandriver.h"
+
+#include <string.h>
+
+// SSE2 is always available on x64 and on x86 when built with /arch:SSE2 or later
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2)) || defined(__SSE2__)
+#define TWOCAN_HEX_SSE2
+#include <emmintrin.h>
+#endif
+
+// Lookup table of hexadecimal character values, 0xFF for non hexadecimal characters, shared with the log file parsers
+const byte hexValues[256] = {
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+	0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#ifdef TWOCAN_HEX_SSE2
 
 //
-// Reverse the 4 byte header as Cantact device seems to present the header as Big Endian
-// [in][out] buf, pointer to byte array
+// Convert a vector of hexadecimal characters to nibble values
+// [in] chars, hexadecimal characters
+// [out] nibbles, value of each character
+// returns a bit mask with a bit set for each character that is not a hexadecimal digit
 //
 
-void ReverseHeader(byte* buf)
-{
-	byte tmp[CONST_HEADER_LENGTH];
-	byte *val;
-	val = buf;
-	for (int i = CONST_HEADER_LENGTH - 1; i >= 0; i--, val++)
-		tmp[i] = *val;
-	memcpy(buf, tmp, CONST_HEADER_LENGTH);
+static int ConvertHexVector(const __m128i chars, __m128i *nibbles) {
+	// Characters above 0x7F are negative as signed bytes and so fail both range checks
+	__m128i lower = _mm_or_si128(chars, _mm_set1_epi8(0x20));
+	__m128i isDigit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+	__m128i isLetter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	__m128i digits = _mm_and_si128(isDigit, _mm_sub_epi8(chars, _mm_set1_epi8('0')));
+	__m128i letters = _mm_and_si128(isLetter, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10)));
+	*nibbles = _mm_or_si128(digits, letters);
+	return ~_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) & 0xFFFF;
 }
 
+//
+// Combine pairs of nibbles, high nibble first, into bytes
+// [in] nibbles, up to 16 nibble values
+// returns the bytes packed into the low 8 bytes of the vector
+//
+
+static __m128i PackNibbles(const __m128i nibbles) {
+	// Each 16 bit lane holds the high nibble in its low byte and the low nibble in its high byte
+	__m128i high = _mm_slli_epi16(_mm_and_si128(nibbles, _mm_set1_epi16(0x00FF)), 4);
+	__m128i low = _mm_srli_epi16(nibbles, 8);
+	return _mm_packus_epi16(_mm_or_si128(high, low), _mm_setzero_si128());
+}
+
+#endif
+
 //
 // Convert hexadecimal string to byte array
-// [in]hexstr, pointer to array of hexadecimal characters
-// [in]len, number of hexadecimal characters
+// Uses SSE2 to convert 16 characters (a CAN payload) or 8 characters (a CAN header) at a time, with a table driven scalar fallback
+// [in]hexstr, pointer to array of hexadecimal characters, need not be null terminated
+// [in]len, number of bytes to convert, ie. half the number of hexadecimal characters
 // [out] buf, pointer to byte array
-// returns error code
+// returns TRUE if every character was a hexadecimal digit, FALSE otherwise
 //
 
 int ConvertHexStringToByteArray(const byte *hexstr, const unsigned int len, byte *buf) {
-	// Must be a even number of hexadecimal characters
-	// BUG BUG Another check is to perform an isxdigit on each character
-	if ((len % 2 == 0) && (hexstr != NULL) && (buf != NULL)) {
-		byte val;
-		byte pair[2];
-		for (unsigned int i = 0; i < len; i++) {
-			pair[0] = hexstr[i * 2];
-			pair[1] = hexstr[(i * 2) + 1];
-			val = (byte)strtoul((char *)pair, NULL, 16);
-			buf[i] = val;
+	unsigned int i = 0;
+	byte high;
+	byte low;
+
+	if ((hexstr == NULL) || (buf == NULL)) {
+		return FALSE;
+	}
+
+#ifdef TWOCAN_HEX_SSE2
+	__m128i nibbles;
+	int result;
+
+	// 16 characters to 8 bytes
+	for (; (i + 8) <= len; i += 8) {
+		if (ConvertHexVector(_mm_loadu_si128((const __m128i *)&hexstr[i * 2]), &nibbles) != 0) {
+			return FALSE;
 		}
-		return TRUE;
+		_mm_storel_epi64((__m128i *)&buf[i], PackNibbles(nibbles));
 	}
-	else	{
-		return FALSE;
+
+	// 8 characters to 4 bytes, load only the 8 characters to avoid reading past the string
+	if ((i + 4) <= len) {
+		if (ConvertHexVector(_mm_loadl_epi64((const __m128i *)&hexstr[i * 2]), &nibbles) & 0xFF) {
+			return FALSE;
+		}
+		result = _mm_cvtsi128_si32(PackNibbles(nibbles));
+		memcpy(&buf[i], &result, 4);
+		i += 4;
 	}
+#endif
+
+	for (; i < len; i++) {
+		high = hexValues[hexstr[i * 2]];
+		low = hexValues[hexstr[(i * 2) + 1]];
+		if ((high | low) == 0xFF) {
+			return FALSE;
+		}
+		buf[i] = (high << 4) | low;
+	}
+
+	return TRUE;
 }
 
 //
@@ -80,7 +154,8 @@ int ConvertHexStringToByteArray(const byte *hexstr, const unsigned int len, byte
 //
 
 int ConvertIntegerToByteArray(const unsigned int value, byte *buf){
-	if ((buf != NULL) && (COUNT(buf) == 4)) {
+	// COUNT of a pointer is the pointer size, not the array length, so it can not check the buffer
+	if (buf != NULL) {
 		buf[0] = (value >> 24) & 0xFF;
 		buf[1] = (value >> 16) & 0xFF;
 		buf[2] = (value >> 8) & 0xFF;
@@ -91,3 +166,32 @@ int ConvertIntegerToByteArray(const unsigned int value, byte *buf){
 		return FALSE;
 	}
 }
+
+//
+// Convert a 12 byte CAN Frame to a TwoCanFrame
+// [in] buf, pointer to 12 byte array, little endian 4 byte header followed by the payload
+// [in] dlc, number of valid payload bytes
+// [out] frame, pointer to TwoCanFrame, the timestamp is left to the caller
+//
+
+void ConvertByteArrayToFrame(const byte *buf, const byte dlc, TwoCanFrame *frame) {
+	frame->id = (buf[0] | (buf[1] << 8) | (buf[2] << 16) | (buf[3] << 24)) & CONST_EXTENDED_ID_MASK;
+	frame->dlc = (dlc > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : dlc;
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	memset(frame->data, 0, CONST_PAYLOAD_LENGTH);
+	memcpy(frame->data, &buf[CONST_HEADER_LENGTH], frame->dlc);
+}
+
+//
+// Convert a TwoCanFrame to a 12 byte CAN Frame
+// [in] frame, pointer to TwoCanFrame
+// [out] buf, pointer to 12 byte array
+//
+
+void ConvertFrameToByteArray(const TwoCanFrame *frame, byte *buf) {
+	buf[0] = frame->id & 0xFF;
+	buf[1] = (frame->id >> 8) & 0xFF;
+	buf[2] = (frame->id >> 16) & 0xFF;
+	buf[3] = (frame->id >> 24) & 0xFF;
+	memcpy(&buf[CONST_HEADER_LENGTH], frame->data, CONST_PAYLOAD_LENGTH);
+}
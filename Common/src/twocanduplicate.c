@@ -0,0 +1,146 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanDuplicate
+// Unit Description: Suppress repeated CAN Frames
+// Date: 16/10/2026
+// Function: Remembers the frames passed within a time window, so that a frame seen again, from a second
+// adapter on the same bus or from a log file that has looped, is discarded before it reaches the caller.
+//
+
+#include "../inc/twocanduplicate.h"
+
+#include <string.h>
+
+//
+// Initialise an empty table
+// [in] table
+// [in] window, microseconds, CONST_DUPLICATE_DISABLED to pass every frame
+// returns TRUE if the window is valid
+//
+
+int DuplicateInitialise(TwoCanDuplicateTable *table, const unsigned int window) {
+	if (window > CONST_DUPLICATE_MAX_WINDOW) {
+		return FALSE;
+	}
+	memset(table, 0, sizeof(TwoCanDuplicateTable));
+	table->window = window;
+	return TRUE;
+}
+
+//
+// Change the window, may be called while the read thread is checking frames
+// [in] table
+// [in] window, microseconds, CONST_DUPLICATE_DISABLED to pass every frame
+// returns TRUE if the window is valid
+//
+
+int DuplicateSetWindow(TwoCanDuplicateTable *table, const unsigned int window) {
+	if (window > CONST_DUPLICATE_MAX_WINDOW) {
+		return FALSE;
+	}
+	table->window = window;
+	return TRUE;
+}
+
+//
+// Check a frame against the frames passed within the window, and remember it if it is passed
+// If every slot the frame could use holds a frame still within the window, the oldest is evicted
+// [in] table
+// [in] frame, its timestamp is the time the frame was received
+// returns TRUE if the frame is a duplicate and should be discarded
+//
+
+int DuplicateCheck(TwoCanDuplicateTable *table, const TwoCanFrame *frame) {
+	TwoCanDuplicateSlot *slot;
+	TwoCanDuplicateSlot *freeSlot = NULL;
+	TwoCanDuplicateSlot *oldestSlot = NULL;
+	unsigned int window = table->window;
+	unsigned int words[2];
+	unsigned int hash;
+	unsigned int index;
+	byte dlc;
+	byte data[CONST_PAYLOAD_LENGTH];
+
+	if (window == CONST_DUPLICATE_DISABLED) {
+		return FALSE;
+	}
+
+	dlc = (frame->dlc > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : frame->dlc;
+	memset(data, 0, CONST_PAYLOAD_LENGTH);
+	memcpy(data, frame->data, dlc);
+
+	// Fibonacci hashing of each word in turn, the top bits of the product are the index
+	memcpy(words, data, CONST_PAYLOAD_LENGTH);
+	hash = (frame->id ^ ((unsigned int)dlc << 29)) * 2654435761u;
+	hash = (hash ^ words[0]) * 2654435761u;
+	hash = (hash ^ words[1]) * 2654435761u;
+	index = hash >> (32 - CONST_DUPLICATE_SLOT_BITS);
+
+	for (int i = 0; i < CONST_DUPLICATE_PROBES; i++) {
+		slot = &table->slots[(index + i) & (CONST_DUPLICATE_SLOTS - 1)];
+
+		// Frames are stored in the first free slot they probe and slots are never emptied,
+		// so the frame can not be beyond a slot that has never been used
+		if (!slot->isUsed) {
+			if (freeSlot == NULL) {
+				freeSlot = slot;
+			}
+			break;
+		}
+
+		if ((frame->timestamp < slot->timestamp) || ((frame->timestamp - slot->timestamp) > window)) {
+			// Aged out, the timestamp going backwards also means a new window
+			if ((slot->id == frame->id) && (slot->dlc == dlc) && (memcmp(slot->data, data, CONST_PAYLOAD_LENGTH) == 0)) {
+				freeSlot = slot;
+				break;
+			}
+			if (freeSlot == NULL) {
+				freeSlot = slot;
+			}
+		}
+		else {
+			if ((slot->id == frame->id) && (slot->dlc == dlc) && (memcmp(slot->data, data, CONST_PAYLOAD_LENGTH) == 0)) {
+				table->statistics.framesSuppressed++;
+				return TRUE;
+			}
+			if ((oldestSlot == NULL) || (slot->timestamp < oldestSlot->timestamp)) {
+				oldestSlot = slot;
+			}
+		}
+	}
+
+	if (freeSlot == NULL) {
+		table->statistics.framesEvicted++;
+		freeSlot = oldestSlot;
+	}
+
+	freeSlot->timestamp = frame->timestamp;
+	freeSlot->id = frame->id;
+	freeSlot->dlc = dlc;
+	freeSlot->isUsed = TRUE;
+	memcpy(freeSlot->data, data, CONST_PAYLOAD_LENGTH);
+
+	table->statistics.framesPassed++;
+	return FALSE;
+}
@@ -26,33 +26,18 @@
 //
 
 
-#include "../../common/inc/twocanerror.h"
+#include "../inc/twocanerror.h"
 
 // Formatted debug output
-void DebugPrintf(wchar_t *fmt, ...)
+void DebugPrintf(const wchar_t *fmt, ...)
 {
 	va_list argp;
 	va_start(argp, fmt);
-	wchar_t dbg_out[4096];
-	vswprintf_s(dbg_out, sizeof(dbg_out), fmt, argp);
+	PlatformDebugOutput(fmt, argp);
 	va_end(argp);
-	OutputDebugString(dbg_out);
 }
 
 // Retrieve the system error message for the last-error code
 char *GetErrorMessage(int win32ErrorCode) {
-
-	LPVOID lpMsgBuf;
-	
-	FormatMessage(
-		FORMAT_MESSAGE_ALLOCATE_BUFFER |
-		FORMAT_MESSAGE_FROM_SYSTEM |
-		FORMAT_MESSAGE_IGNORE_INSERTS,
-		NULL,
-		win32ErrorCode,
-		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-		(LPTSTR)&lpMsgBuf,
-		0, NULL);
-	return (char *)lpMsgBuf;
-	
+	return PlatformErrorMessage(win32ErrorCode);
 }
\ No newline at end of file
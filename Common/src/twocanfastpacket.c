@@ -0,0 +1,333 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanFastPacket
+// Unit Description: NMEA 2000 fast packet reassembly
+// Date: 16/10/2026
+// Function: Collects the frames of fast packet messages, up to 223 bytes sent as a first frame carrying
+// the length and up to 31 numbered continuation frames, into complete messages. Drivers optionally pass
+// the completed messages to a callback, so the caller no longer needs to reassemble them.
+//
+
+#include "../inc/twocanfastpacket.h"
+#include "../inc/twocanheader.h"
+
+#include <string.h>
+
+// Bytes of the message carried by the first frame and by each continuation frame
+#define CONST_FIRST_FRAME_BYTES 6
+#define CONST_NEXT_FRAME_BYTES 7
+
+// The first data byte holds a 3 bit sequence id, shared by every frame of a message, and a 5 bit frame counter
+#define CONST_FRAME_COUNTER_MASK 0x1F
+#define CONST_SEQUENCE_SHIFT 5
+
+// NMEA 2000 PGNs transmitted as fast packets, the proprietary range 130816 - 131071 is added separately
+static const unsigned int fastPacketPgns[] = {
+	126208, 126464, 126720, 126983, 126984, 126985, 126986, 126987, 126988, 126996, 126998,
+	127233, 127237, 127489, 127496, 127497, 127498, 127503, 127504, 127506, 127507, 127509,
+	127510, 127511, 127512, 127513, 127514, 128275, 128520, 129029, 129038, 129039, 129040,
+	129041, 129044, 129045, 129284, 129285, 129301, 129302, 129538, 129540, 129541, 129542,
+	129545, 129547, 129549, 129551, 129556, 129792, 129793, 129794, 129795, 129796, 129797,
+	129798, 129799, 129800, 129801, 129802, 129803, 129804, 129805, 129806, 129807, 129808,
+	129809, 129810, 130052, 130053, 130054, 130060, 130061, 130064, 130065, 130066, 130067,
+	130068, 130069, 130070, 130071, 130072, 130073, 130074, 130320, 130321, 130322, 130323,
+	130324, 130567, 130577, 130578, 130580, 130581, 130583, 130584, 130586
+};
+
+#define CONST_PROPRIETARY_FAST_FIRST 130816
+#define CONST_PROPRIETARY_FAST_LAST 131071
+
+//
+// Key identifying a message, the PGN, sequence id and source address fit in 29 bits
+// [in] pgn
+// [in] sequence, 3 bit sequence id
+// [in] source, source address
+// returns the key
+//
+
+static unsigned int FastPacketKey(const unsigned int pgn, const unsigned int sequence, const unsigned int source) {
+	return (pgn << 11) | (sequence << 8) | source;
+}
+
+//
+// Release a slot once its message is complete or abandoned
+// [in] table
+// [in] slot
+//
+
+static void FastPacketRelease(TwoCanFastPacketTable *table, TwoCanFastSlot *slot) {
+	slot->isActive = FALSE;
+	table->activeCount--;
+}
+
+//
+// Find the slot of a message, or claim one for a new message
+// A message whose last frame has timed out is abandoned and its slot reused.
+// If every slot the key may use is busy, the one with the oldest frame is evicted
+// [in] table
+// [in] key, see FastPacketKey
+// [in] timestamp, timestamp of the frame being added
+// returns the slot
+//
+
+static TwoCanFastSlot *FastPacketFindSlot(TwoCanFastPacketTable *table, const unsigned int key, const unsigned long long timestamp) {
+	TwoCanFastSlot *slot;
+	TwoCanFastSlot *freeSlot = NULL;
+	TwoCanFastSlot *oldestSlot = NULL;
+	// Fibonacci hash, the multiplication spreads the PGN bits into the bits used for the index
+	unsigned int index = (key * 2654435761u) >> 16;
+
+	for (int i = 0; i < CONST_FASTPACKET_PROBES; i++) {
+		slot = &table->slots[(index + i) & (CONST_FASTPACKET_SLOTS - 1)];
+		if (slot->isActive) {
+			if (slot->key == key) {
+				if ((timestamp > slot->lastTimestamp) && ((timestamp - slot->lastTimestamp) > CONST_FASTPACKET_TIMEOUT)) {
+					table->statistics.sequencesAbandoned++;
+					FastPacketRelease(table, slot);
+					freeSlot = slot;
+					break;
+				}
+				return slot;
+			}
+			if ((oldestSlot == NULL) || (slot->lastTimestamp < oldestSlot->lastTimestamp)) {
+				oldestSlot = slot;
+			}
+		}
+		else if (freeSlot == NULL) {
+			freeSlot = slot;
+		}
+	}
+
+	if (freeSlot == NULL) {
+		table->statistics.sequencesEvicted++;
+		FastPacketRelease(table, oldestSlot);
+		freeSlot = oldestSlot;
+	}
+
+	freeSlot->key = key;
+	freeSlot->isActive = TRUE;
+	freeSlot->framesExpected = 0;
+	freeSlot->nextFrame = 0;
+	freeSlot->framesReceived = 0;
+	freeSlot->lastTimestamp = timestamp;
+	freeSlot->message.length = 0;
+
+	table->activeCount++;
+	if (table->activeCount > table->statistics.maximumActive) {
+		table->statistics.maximumActive = table->activeCount;
+	}
+	return freeSlot;
+}
+
+//
+// Initialise the table, clearing any partly reassembled messages and the statistics
+// [in] table, pointer to caller allocated table
+//
+
+void FastPacketInitialise(TwoCanFastPacketTable *table) {
+	memset(table->slots, 0, sizeof(table->slots));
+	memset(&table->statistics, 0, sizeof(TwoCanFastPacketStatistics));
+	memset(table->fastPgns, 0, sizeof(table->fastPgns));
+	table->activeCount = 0;
+	table->expireTime = 0;
+
+	for (unsigned int i = 0; i < COUNT(fastPacketPgns); i++) {
+		table->fastPgns[fastPacketPgns[i] >> 5] |= 1u << (fastPacketPgns[i] & 0x1F);
+	}
+	for (unsigned int pgn = CONST_PROPRIETARY_FAST_FIRST; pgn <= CONST_PROPRIETARY_FAST_LAST; pgn++) {
+		table->fastPgns[pgn >> 5] |= 1u << (pgn & 0x1F);
+	}
+}
+
+//
+// Check whether a PGN is transmitted as a fast packet
+// [in] table
+// [in] pgn
+// returns TRUE for a fast packet PGN
+//
+
+int FastPacketIsFastPacket(const TwoCanFastPacketTable *table, const unsigned int pgn) {
+	return (pgn < CONST_PGN_COUNT) && ((table->fastPgns[pgn >> 5] & (1u << (pgn & 0x1F))) != 0);
+}
+
+//
+// Add a frame to the message it belongs to
+// [in] table
+// [in] frame, received CAN Frame
+// [out] message, set to the completed message if the result is TWOCAN_FASTPACKET_COMPLETE
+// returns TWOCAN_FASTPACKET_SINGLE, PENDING, COMPLETE or DISCARDED
+//
+
+int FastPacketPush(TwoCanFastPacketTable *table, const TwoCanFrame *frame, const TwoCanFastMessage **message) {
+	TwoCanFastSlot *slot;
+	unsigned int pgn;
+	unsigned int counter;
+	unsigned int length;
+	unsigned int complete;
+
+	pgn = HeaderGetPgn(frame->id);
+	if (!FastPacketIsFastPacket(table, pgn)) {
+		return TWOCAN_FASTPACKET_SINGLE;
+	}
+
+	counter = frame->data[0] & CONST_FRAME_COUNTER_MASK;
+
+	// A first frame carries the length and at least one byte of the message, a continuation frame at least one byte
+	if ((frame->dlc < 2) || ((counter == 0) && (frame->data[1] > CONST_FASTPACKET_LENGTH))) {
+		table->statistics.framesDiscarded++;
+		return TWOCAN_FASTPACKET_DISCARDED;
+	}
+
+	slot = FastPacketFindSlot(table, FastPacketKey(pgn, frame->data[0] >> CONST_SEQUENCE_SHIFT, HeaderGetSource(frame->id)), frame->timestamp);
+
+	// Without its first frame, a frame well into a message is most likely what remains of a message whose first frame was lost
+	if ((slot->framesExpected == 0) && (counter >= CONST_FASTPACKET_REORDER)) {
+		table->statistics.framesDiscarded++;
+		if (slot->framesReceived == 0) {
+			FastPacketRelease(table, slot);
+		}
+		return TWOCAN_FASTPACKET_DISCARDED;
+	}
+
+	if (slot->framesReceived & (1u << counter)) {
+		if (counter != 0) {
+			table->statistics.framesDiscarded++;
+			return TWOCAN_FASTPACKET_DISCARDED;
+		}
+		// A new message reusing the sequence id before the previous one was completed
+		table->statistics.sequencesAbandoned++;
+		slot->framesExpected = 0;
+		slot->nextFrame = 0;
+		slot->framesReceived = 0;
+	}
+
+	if ((slot->framesExpected > 0) && (counter >= slot->framesExpected)) {
+		table->statistics.framesDiscarded++;
+		return TWOCAN_FASTPACKET_DISCARDED;
+	}
+
+	if (counter == 0) {
+		length = frame->data[1];
+		slot->message.id = frame->id;
+		slot->message.pgn = pgn;
+		slot->message.length = length;
+		slot->framesExpected = (byte)((length <= CONST_FIRST_FRAME_BYTES) ? 1 :
+			1 + ((length - CONST_FIRST_FRAME_BYTES + CONST_NEXT_FRAME_BYTES - 1) / CONST_NEXT_FRAME_BYTES));
+		memcpy(slot->message.data, &frame->data[2], frame->dlc - 2);
+
+		// Continuation frames that arrived ahead of the first frame may lie beyond the end of this message
+		slot->framesReceived &= (slot->framesExpected >= CONST_FASTPACKET_FRAMES) ? 0xFFFFFFFF : ((1u << slot->framesExpected) - 1);
+	}
+	else {
+		memcpy(&slot->message.data[CONST_FIRST_FRAME_BYTES + ((counter - 1) * CONST_NEXT_FRAME_BYTES)], &frame->data[1], frame->dlc - 1);
+	}
+
+	if (counter != slot->nextFrame) {
+		table->statistics.framesOutOfOrder++;
+	}
+	slot->nextFrame = (byte)(counter + 1);
+	slot->framesReceived |= 1u << counter;
+	slot->lastTimestamp = frame->timestamp;
+
+	if (slot->framesExpected == 0) {
+		return TWOCAN_FASTPACKET_PENDING;
+	}
+
+	complete = (slot->framesExpected >= CONST_FASTPACKET_FRAMES) ? 0xFFFFFFFF : ((1u << slot->framesExpected) - 1);
+	if (slot->framesReceived != complete) {
+		return TWOCAN_FASTPACKET_PENDING;
+	}
+
+	slot->message.timestamp = frame->timestamp;
+	FastPacketRelease(table, slot);
+	table->statistics.messagesCompleted++;
+	*message = &slot->message;
+	return TWOCAN_FASTPACKET_COMPLETE;
+}
+
+//
+// Abandon messages that have not received a frame within CONST_FASTPACKET_TIMEOUT
+// The slots are examined at most once every CONST_FASTPACKET_EXPIRE_INTERVAL
+// [in] table
+// [in] now, current time in the frames' time base
+// returns the number of messages abandoned
+//
+
+unsigned int FastPacketExpire(TwoCanFastPacketTable *table, const unsigned long long now) {
+	unsigned int expired = 0;
+
+	if ((table->activeCount == 0) || (now < table->expireTime)) {
+		return 0;
+	}
+	table->expireTime = now + CONST_FASTPACKET_EXPIRE_INTERVAL;
+
+	for (int i = 0; i < CONST_FASTPACKET_SLOTS; i++) {
+		TwoCanFastSlot *slot = &table->slots[i];
+		if ((slot->isActive) && (now > slot->lastTimestamp) && ((now - slot->lastTimestamp) > CONST_FASTPACKET_TIMEOUT)) {
+			FastPacketRelease(table, slot);
+			expired++;
+		}
+	}
+
+	table->statistics.sequencesAbandoned += expired;
+	return expired;
+}
+
+//
+// Reassemble received frames and pass each completed message to the callback
+// [in] table
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+//
+
+void FastPacketProcess(TwoCanFastPacketTable *table, const TwoCanFrame *frames, const int count) {
+	TwoCanFastPacketCallback callback = table->callback;
+	const TwoCanFastMessage *message;
+
+	if (callback == NULL) {
+		return;
+	}
+
+	PlatformMemoryBarrier();
+	for (int i = 0; i < count; i++) {
+		if (FastPacketPush(table, &frames[i], &message) == TWOCAN_FASTPACKET_COMPLETE) {
+			callback(message, table->callbackContext);
+		}
+	}
+}
+
+//
+// Set or clear the completed message callback, may be called while the read thread is running
+// [in] table
+// [in] callback, NULL to stop reassembling
+// [in] context, passed to the callback
+//
+
+void FastPacketSetCallback(TwoCanFastPacketTable *table, TwoCanFastPacketCallback callback, void *context) {
+	table->callback = NULL;
+	PlatformMemoryBarrier();
+	table->callbackContext = context;
+	PlatformMemoryBarrier();
+	table->callback = callback;
+}
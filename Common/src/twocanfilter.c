@@ -0,0 +1,361 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanFilter
+// Unit Description: PGN and source address acceptance filters
+// Date: 16/10/2026
+// Function: Compiles a list of PGNs, each optionally restricted to one source address, into identifier
+// code and mask pairs. Drivers load the combined pair into the adapter's acceptance filter where it has one,
+// and match received frames against the full set in software, with a bitmap lookup of the frame's PGN.
+//
+
+#include "../inc/twocanfilter.h"
+#include "../inc/twocanheader.h"
+
+#include <string.h>
+
+
+// Bits of the 29 bit identifier holding the data page and PDU format, the PGN's high bits
+#define CONST_ID_PDU_FORMAT_MASK 0x03FF0000
+// Bits holding the PDU specific field, the PGN's low byte for PDU2 or the destination for PDU1
+#define CONST_ID_PDU_SPECIFIC_MASK 0x0000FF00
+#define CONST_ID_SOURCE_MASK 0x000000FF
+
+//
+// Compile filters into a set
+// [out] set, pointer to the set
+// [in] filters, pointer to array of filters, may be NULL if count is zero
+// [in] count, number of filters, zero accepts every frame
+// returns TRUE if the filters were compiled
+//
+
+int FilterCompile(TwoCanFilterSet *set, const TwoCanFilter *filters, const int count) {
+	unsigned int code;
+	unsigned int mask;
+
+	if ((set == NULL) || (count < 0) || (count > CONST_MAX_FILTERS) || ((filters == NULL) && (count > 0))) {
+		return FALSE;
+	}
+
+	memset(set->anySource, 0, sizeof(set->anySource));
+	memset(set->someSources, 0, sizeof(set->someSources));
+
+	for (int i = 0; i < count; i++) {
+		if (filters[i].pgn > CONST_HEADER_PGN_MASK) {
+			return FALSE;
+		}
+
+		code = filters[i].pgn << 8;
+		mask = CONST_ID_PDU_FORMAT_MASK;
+
+		if (!HeaderIsPdu1(filters[i].pgn)) {
+			mask |= CONST_ID_PDU_SPECIFIC_MASK;
+		}
+		else if ((filters[i].pgn & 0xFF) != 0) {
+			// The low byte of an addressed PGN is the destination, not part of the PGN
+			return FALSE;
+		}
+
+		if (filters[i].source != CONST_FILTER_ANY_SOURCE) {
+			code |= filters[i].source;
+			mask |= CONST_ID_SOURCE_MASK;
+			set->someSources[filters[i].pgn >> 5] |= 1u << (filters[i].pgn & 0x1F);
+		}
+		else {
+			set->anySource[filters[i].pgn >> 5] |= 1u << (filters[i].pgn & 0x1F);
+		}
+
+		set->codes[i] = code;
+		set->masks[i] = mask;
+	}
+
+	set->count = count;
+	set->hardwareCode = 0;
+	set->hardwareMask = 0;
+
+	if (count > 0) {
+		// Only the bits that every filter checks, with the same value, can be left to the adapter
+		code = set->codes[0];
+		mask = set->masks[0];
+		for (int i = 1; i < count; i++) {
+			mask &= set->masks[i] & ~(set->codes[i] ^ code);
+		}
+		set->hardwareCode = code & mask;
+		set->hardwareMask = mask;
+	}
+
+	return TRUE;
+}
+
+//
+// Check a frame against a compiled set
+// [in] set, pointer to the set
+// [in] id, 29 bit identifier
+// returns TRUE if the frame is accepted
+//
+
+int FilterMatch(const TwoCanFilterSet *set, const unsigned int id) {
+	unsigned int pgn;
+	unsigned int bit;
+
+	if (set->count == 0) {
+		return TRUE;
+	}
+
+	pgn = HeaderGetPgn(id);
+	bit = 1u << (pgn & 0x1F);
+
+	if ((set->anySource[pgn >> 5] & bit) != 0) {
+		return TRUE;
+	}
+
+	// Frames of a PGN nobody asked for are rejected without looking at the pairs
+	if ((set->someSources[pgn >> 5] & bit) == 0) {
+		return FALSE;
+	}
+
+	for (unsigned int i = 0; i < set->count; i++) {
+		if (((id ^ set->codes[i]) & set->masks[i]) == 0) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+//
+// Take the table for an update, waiting for any update already in progress
+// [in] table, pointer to the table
+// returns the sequence to pass to FilterTableUnlock
+//
+
+static unsigned int FilterTableLock(TwoCanFilterTable *table) {
+	unsigned int sequence;
+
+	for (;;) {
+		sequence = table->sequence;
+		if (((sequence & 1) == 0) && (PlatformCompareExchange(&table->sequence, sequence + 1, sequence) == sequence)) {
+			return sequence + 1;
+		}
+		ThreadSleep(1);
+	}
+}
+
+//
+// Finish an update, readers that overlapped it see the sequence change and match again
+// [in] table, pointer to the table
+// [in] sequence, as returned by FilterTableLock
+//
+
+static void FilterTableUnlock(TwoCanFilterTable *table, const unsigned int sequence) {
+	PlatformMemoryBarrier();
+	table->sequence = sequence + 1;
+}
+
+//
+// Compile filters into the inactive set and make it active, the caller holds the lock
+// [in] table, pointer to the table
+// [in] filters, count, as for FilterCompile, filters must not be the table's own list
+// returns TRUE if the filters were valid and are now active
+//
+
+static int FilterTablePublish(TwoCanFilterTable *table, const TwoCanFilter *filters, const int count) {
+	unsigned int next = table->active ^ 1;
+
+	if (!FilterCompile(&table->sets[next], filters, count)) {
+		return FALSE;
+	}
+
+	// The new set must be complete before the read thread can see it
+	PlatformMemoryBarrier();
+	table->active = next;
+
+	if (count > 0) {
+		memcpy(table->filters, filters, count * sizeof(TwoCanFilter));
+	}
+	table->filterCount = count;
+	return TRUE;
+}
+
+//
+// Replace the active set, may be called from any thread
+// [in] table, pointer to the table
+// [in] filters, count, as for FilterCompile
+// returns TRUE if the filters were valid and are now active
+//
+
+int FilterTableUpdate(TwoCanFilterTable *table, const TwoCanFilter *filters, const int count) {
+	unsigned int sequence = FilterTableLock(table);
+	int result = FilterTablePublish(table, filters, count);
+
+	FilterTableUnlock(table, sequence);
+	return result;
+}
+
+//
+// Add a single filter to the active set
+// [in] table, pointer to the table
+// [in] pgn, as for TwoCanFilter
+// [in] source, source address or CONST_FILTER_ANY_SOURCE
+// returns TRUE if the filter was valid and is now active, or was already active
+//
+
+int FilterTableSubscribe(TwoCanFilterTable *table, const unsigned int pgn, const byte source) {
+	TwoCanFilter filters[CONST_MAX_FILTERS];
+	unsigned int sequence = FilterTableLock(table);
+	unsigned int count = table->filterCount;
+	int result = TRUE;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if ((table->filters[i].pgn == pgn) && (table->filters[i].source == source)) {
+			FilterTableUnlock(table, sequence);
+			return TRUE;
+		}
+	}
+
+	if (count == CONST_MAX_FILTERS) {
+		result = FALSE;
+	}
+	else {
+		memcpy(filters, table->filters, count * sizeof(TwoCanFilter));
+		filters[count].pgn = pgn;
+		filters[count].source = source;
+		result = FilterTablePublish(table, filters, count + 1);
+	}
+
+	FilterTableUnlock(table, sequence);
+	return result;
+}
+
+//
+// Remove a single filter from the active set
+// [in] table, pointer to the table
+// [in] pgn, source, as given to FilterTableSubscribe or in the list given to FilterTableUpdate
+// returns TRUE if the filter was removed, FALSE if it was not in the set
+//
+
+int FilterTableUnsubscribe(TwoCanFilterTable *table, const unsigned int pgn, const byte source) {
+	TwoCanFilter filters[CONST_MAX_FILTERS];
+	unsigned int sequence = FilterTableLock(table);
+	unsigned int count = 0;
+	int result = FALSE;
+
+	for (unsigned int i = 0; i < table->filterCount; i++) {
+		if ((table->filters[i].pgn != pgn) || (table->filters[i].source != source)) {
+			filters[count++] = table->filters[i];
+		}
+	}
+
+	if (count != table->filterCount) {
+		result = FilterTablePublish(table, filters, count);
+	}
+
+	FilterTableUnlock(table, sequence);
+	return result;
+}
+
+//
+// Check a frame against the active set, only the read thread calls this
+// [in] table, pointer to the table
+// [in] id, 29 bit identifier
+// returns TRUE if the frame is accepted
+//
+
+int FilterTableMatch(const TwoCanFilterTable *table, const unsigned int id) {
+	unsigned int sequence;
+	int result;
+
+	do {
+		sequence = table->sequence;
+		PlatformReadBarrier();
+		result = FilterMatch(&table->sets[table->active & 1], id);
+		PlatformReadBarrier();
+	} while (sequence != table->sequence);
+
+	return result;
+}
+
+//
+// Combined code and mask of the active set
+// [in] table, pointer to the table
+// [out] code, mask, for the adapter's acceptance filter, a zero mask accepts every frame
+//
+
+void FilterTableHardware(const TwoCanFilterTable *table, unsigned int *code, unsigned int *mask) {
+	unsigned int sequence;
+	const TwoCanFilterSet *set;
+
+	do {
+		sequence = table->sequence;
+		PlatformReadBarrier();
+		set = &table->sets[table->active & 1];
+		*code = (set->count == 0) ? 0 : set->hardwareCode;
+		*mask = (set->count == 0) ? 0 : set->hardwareMask;
+		PlatformReadBarrier();
+	} while (sequence != table->sequence);
+}
+
+//
+// Widen an acceptance filter's code and mask so that it also accepts a PGN, from any source and to any destination
+// [in,out] code, mask, as returned by FilterTableHardware
+// [in] pgn, for PDU1 PGNs the low byte is zero
+//
+
+void FilterWidenHardware(unsigned int *code, unsigned int *mask, const unsigned int pgn) {
+	unsigned int checked = CONST_ID_PDU_FORMAT_MASK;
+
+	if (!HeaderIsPdu1(pgn)) {
+		checked |= CONST_ID_PDU_SPECIFIC_MASK;
+	}
+
+	// Keep only the bits the PGN's frames share with the code
+	*mask &= checked & ~((pgn << 8) ^ *code);
+	*code &= *mask;
+}
+
+//
+// Copy the code and mask pairs of the active set
+// [in] table, pointer to the table
+// [out] codes, masks, arrays of CONST_MAX_FILTERS
+// returns the number of pairs, zero if every frame is accepted
+//
+
+unsigned int FilterTableCodes(const TwoCanFilterTable *table, unsigned int *codes, unsigned int *masks) {
+	unsigned int sequence;
+	unsigned int count;
+	const TwoCanFilterSet *set;
+
+	do {
+		sequence = table->sequence;
+		PlatformReadBarrier();
+		set = &table->sets[table->active & 1];
+		count = set->count;
+		if (count > CONST_MAX_FILTERS) {
+			count = 0;
+		}
+		memcpy(codes, set->codes, count * sizeof(unsigned int));
+		memcpy(masks, set->masks, count * sizeof(unsigned int));
+		PlatformReadBarrier();
+	} while (sequence != table->sequence);
+
+	return count;
+}
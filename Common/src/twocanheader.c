@@ -0,0 +1,44 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanHeader
+// Unit Description: Encode and decode the 29 bit identifier of an NMEA 2000 frame
+// Date: 16/10/2026
+// Function: The single field codec is inline in twocanheader.h, so that the drivers, parsers
+// and protocol layers share one definition of the PDU1/PDU2 rules. The batch decode lives here.
+//
+
+#include "../inc/twocanheader.h"
+
+//
+// Decode the ids of an array of frames
+// [in] frames, pointer to array of CAN Frames
+// [out] headers, pointer to array of at least count headers
+// [in] count, number of frames
+//
+
+void HeaderDecodeBatch(const TwoCanFrame *frames, CanHeader *headers, const unsigned int count) {
+	for (unsigned int i = 0; i < count; i++) {
+		HeaderDecode(frames[i].id, &headers[i]);
+	}
+}
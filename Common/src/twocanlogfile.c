@@ -0,0 +1,187 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanLogFile
+// Unit Description: Memory mapped log file reader used by the log file replay drivers
+// Date: 16/10/2026
+// Function: Maps the log file into memory and scans for line endings directly in the mapped view,
+// so lines are handed to the parsers without any stdio buffering or copying.
+//
+
+#include "../inc/twocanlogfile.h"
+#include "../inc/twocanerror.h"
+
+#include <string.h>
+
+//
+// Map a view of the file starting at or before offset
+// [in] logFile, pointer to log file
+// [in] offset, file offset that must be within the view
+// returns TRUE if the view was mapped
+//
+
+static int MapView(TwoCanLogFile *logFile, const unsigned long long offset) {
+	unsigned long long viewOffset;
+	unsigned long long viewLength;
+	const char *view;
+
+	// Views must start on an allocation granularity boundary
+	viewOffset = offset - (offset % logFile->granularity);
+	viewLength = logFile->size - viewOffset;
+	if (viewLength > CONST_LOG_VIEW_SIZE) {
+		viewLength = CONST_LOG_VIEW_SIZE;
+	}
+
+	view = (const char *)MappingView(logFile->mapping, viewOffset, viewLength);
+	if (view == NULL) {
+		DebugPrintf(L"Map log file view failed: %d\n", PlatformGetLastError());
+		return FALSE;
+	}
+
+	if (logFile->view != NULL) {
+		MappingUnview(logFile->view, logFile->viewLength);
+	}
+
+	logFile->view = view;
+	logFile->viewOffset = viewOffset;
+	logFile->viewLength = viewLength;
+	return TRUE;
+}
+
+//
+// Open and map a log file
+// [in] logFile, pointer to log file
+// [in] fileName, full path of the log file
+// returns TRUE if the log file was mapped
+//
+
+int LogFileOpen(TwoCanLogFile *logFile, const TwoCanChar *fileName) {
+	memset(logFile, 0, sizeof(TwoCanLogFile));
+
+	logFile->file = FileOpen(fileName, TWOCAN_FILE_READ);
+	if (logFile->file == NULL) {
+		DebugPrintf(L"Open log file failed: %d\n", PlatformGetLastError());
+		return FALSE;
+	}
+
+	// An empty file can not be mapped
+	if ((!FileSize(logFile->file, &logFile->size)) || (logFile->size == 0)) {
+		DebugPrintf(L"Empty log file\n");
+		LogFileClose(logFile);
+		return FALSE;
+	}
+
+	logFile->mapping = MappingCreate(logFile->file);
+	if (logFile->mapping == NULL) {
+		DebugPrintf(L"Map log file failed: %d\n", PlatformGetLastError());
+		LogFileClose(logFile);
+		return FALSE;
+	}
+
+	logFile->granularity = MappingGranularity();
+
+	if (!MapView(logFile, 0)) {
+		LogFileClose(logFile);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+//
+// Retrieve the next line
+// [in] logFile, pointer to log file
+// [out] line, pointer to the first character of the line within the mapped view
+// [out] length, number of characters in the line, excluding CR/LF
+// returns TRUE if a line was retrieved, FALSE at the end of the file
+//
+
+int LogFileReadLine(TwoCanLogFile *logFile, const char **line, unsigned int *length) {
+	const char *start;
+	const char *newLine;
+	unsigned long long available;
+
+	if (logFile->position >= logFile->size) {
+		return FALSE;
+	}
+
+	start = logFile->view + (logFile->position - logFile->viewOffset);
+	available = logFile->viewLength - (logFile->position - logFile->viewOffset);
+	newLine = (const char *)memchr(start, '\n', (size_t)available);
+
+	// The line continues past the end of this view, remap starting at the line
+	if ((newLine == NULL) && (logFile->viewOffset + logFile->viewLength < logFile->size)) {
+		if (!MapView(logFile, logFile->position)) {
+			return FALSE;
+		}
+		start = logFile->view + (logFile->position - logFile->viewOffset);
+		available = logFile->viewLength - (logFile->position - logFile->viewOffset);
+		newLine = (const char *)memchr(start, '\n', (size_t)available);
+	}
+
+	// Last line without a line terminator, or a line longer than a view
+	if (newLine == NULL) {
+		newLine = start + available;
+		logFile->position += available;
+	}
+	else {
+		logFile->position += (newLine - start) + 1;
+	}
+
+	if ((newLine > start) && (newLine[-1] == '\r')) {
+		newLine--;
+	}
+
+	*line = start;
+	*length = (unsigned int)(newLine - start);
+	return TRUE;
+}
+
+//
+// Restart from the beginning of the file
+// [in] logFile, pointer to log file
+//
+
+void LogFileRewind(TwoCanLogFile *logFile) {
+	logFile->position = 0;
+	if (logFile->viewOffset != 0) {
+		MapView(logFile, 0);
+	}
+}
+
+//
+// Unmap and close the log file
+// [in] logFile, pointer to log file
+//
+
+void LogFileClose(TwoCanLogFile *logFile) {
+	if (logFile->view != NULL) {
+		MappingUnview(logFile->view, logFile->viewLength);
+		logFile->view = NULL;
+	}
+	if (logFile->mapping != NULL) {
+		MappingClose(logFile->mapping);
+		logFile->mapping = NULL;
+	}
+	FileClose(logFile->file);
+	logFile->file = NULL;
+}
@@ -0,0 +1,375 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanParser
+// Unit Description: Log file line parsers
+// Date: 16/10/2026
+// Function: Hand written scanners for the Kees, Yacht Devices and candump log formats.
+// Each works directly on the caller's line buffer with no heap allocation, replacing std::regex.
+//
+
+#include "../inc/twocanparser.h"
+#include "../inc/twocanheader.h"
+
+#include <string.h>
+
+// Kees logs the PGN 59904 ISO Request with a 3 byte payload, valid but nothing to replay
+#define CONST_ISO_REQUEST_PGN 59904
+
+// Scanner state, the unread portion of the line
+typedef struct Scanner {
+	const char *ptr;
+	const char *end;
+} Scanner;
+
+//
+// Initialise the scanner, ignoring any trailing CR/LF
+//
+
+static void ScanStart(Scanner *scanner, const char *line, const unsigned int length) {
+	scanner->ptr = line;
+	scanner->end = line + length;
+	while ((scanner->end > scanner->ptr) && ((scanner->end[-1] == '\r') || (scanner->end[-1] == '\n'))) {
+		scanner->end--;
+	}
+}
+
+//
+// Consume a single expected character
+// returns TRUE if the character matched
+//
+
+static int ScanChar(Scanner *scanner, const char c) {
+	if ((scanner->ptr < scanner->end) && (*scanner->ptr == c)) {
+		scanner->ptr++;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+//
+// Consume a run of decimal digits
+// [in] minDigits, maxDigits, permitted length of the run
+// [out] value, the decimal value
+// [out] digits, optional, the number of digits consumed
+// returns TRUE if the run was within the permitted length
+//
+
+static int ScanDecimal(Scanner *scanner, const int minDigits, const int maxDigits, unsigned long long *value, int *digits) {
+	unsigned long long result = 0;
+	int count = 0;
+
+	while ((scanner->ptr < scanner->end) && (count < maxDigits) && (*scanner->ptr >= '0') && (*scanner->ptr <= '9')) {
+		result = (result * 10) + (*scanner->ptr - '0');
+		scanner->ptr++;
+		count++;
+	}
+
+	// A longer run than permitted is also an error
+	if ((count < minDigits) || ((scanner->ptr < scanner->end) && (*scanner->ptr >= '0') && (*scanner->ptr <= '9'))) {
+		return FALSE;
+	}
+
+	*value = result;
+	if (digits != NULL) {
+		*digits = count;
+	}
+	return TRUE;
+}
+
+//
+// Consume an exact number of hexadecimal characters
+// [in] count, number of characters
+// [out] value, the hexadecimal value
+// returns TRUE if count hexadecimal characters were consumed
+//
+
+static int ScanHex(Scanner *scanner, const int count, unsigned int *value) {
+	unsigned int result = 0;
+	byte nibble;
+
+	if ((scanner->end - scanner->ptr) < count) {
+		return FALSE;
+	}
+
+	for (int i = 0; i < count; i++) {
+		nibble = hexValues[(byte)scanner->ptr[i]];
+		if (nibble == 0xFF) {
+			return FALSE;
+		}
+		result = (result << 4) | nibble;
+	}
+
+	scanner->ptr += count;
+	*value = result;
+	return TRUE;
+}
+
+//
+// Consume a time of day, hh:mm:ss.mmm
+// [out] value, microseconds since midnight
+//
+
+static int ScanTimeOfDay(Scanner *scanner, unsigned long long *value) {
+	unsigned long long hours, minutes, seconds, milliseconds;
+
+	if (ScanDecimal(scanner, 2, 2, &hours, NULL) && ScanChar(scanner, ':') &&
+		ScanDecimal(scanner, 2, 2, &minutes, NULL) && ScanChar(scanner, ':') &&
+		ScanDecimal(scanner, 2, 2, &seconds, NULL) && ScanChar(scanner, '.') &&
+		ScanDecimal(scanner, 3, 3, &milliseconds, NULL)) {
+		*value = ((((hours * 60) + minutes) * 60 + seconds) * 1000 + milliseconds) * 1000;
+		return TRUE;
+	}
+	return FALSE;
+}
+
+//
+// Days since 1970-01-01 of a proleptic Gregorian calendar date
+//
+
+static unsigned long long DaysFromCivil(unsigned long long year, const unsigned long long month, const unsigned long long day) {
+	unsigned long long era, yearOfEra, dayOfYear, dayOfEra;
+
+	year -= (month <= 2) ? 1 : 0;
+	era = year / 400;
+	yearOfEra = year - (era * 400);
+	dayOfYear = ((153 * ((month > 2) ? (month - 3) : (month + 9))) + 2) / 5 + day - 1;
+	dayOfEra = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) + dayOfYear;
+	return (era * 146097) + dayOfEra - 719468;
+}
+
+//
+// Parse a Kees log line, date & time, priority, PGN, source, destination, length and 8 comma separated hexadecimal bytes
+// [in] line, pointer to the line, need not be null terminated
+// [in] length, number of characters in the line
+// [out] frame, CAN Frame
+// returns TWOCAN_PARSE_FRAME, TWOCAN_PARSE_IGNORED for an ISO Request or TWOCAN_PARSE_INVALID
+//
+
+int ParseKeesLine(const char *line, const unsigned int length, TwoCanFrame *frame) {
+	Scanner scanner;
+	unsigned long long year, month, day, timeOfDay;
+	unsigned long long priority, pgn, source, destination, dataLength;
+	unsigned int value;
+	int dataBytes;
+
+	ScanStart(&scanner, line, length);
+
+	if (!(ScanDecimal(&scanner, 4, 4, &year, NULL) && ScanChar(&scanner, '-') &&
+		ScanDecimal(&scanner, 2, 2, &month, NULL) && ScanChar(&scanner, '-') &&
+		ScanDecimal(&scanner, 2, 2, &day, NULL))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	if (!(ScanChar(&scanner, 'T') || ScanChar(&scanner, 'Z'))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	if (!(ScanTimeOfDay(&scanner, &timeOfDay) && ScanChar(&scanner, ',') &&
+		ScanDecimal(&scanner, 1, 1, &priority, NULL) && ScanChar(&scanner, ',') &&
+		ScanDecimal(&scanner, 5, 6, &pgn, NULL) && ScanChar(&scanner, ',') &&
+		ScanDecimal(&scanner, 1, 10, &source, NULL) && ScanChar(&scanner, ',') &&
+		ScanDecimal(&scanner, 1, 10, &destination, NULL) && ScanChar(&scanner, ',') &&
+		ScanDecimal(&scanner, 1, 1, &dataLength, NULL))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	if ((month < 1) || (month > 12)) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	// Kees logs single frame messages, either 8 data bytes or a 3 byte ISO Request
+	dataBytes = ((pgn == CONST_ISO_REQUEST_PGN) && (dataLength == 3)) ? 3 : CONST_PAYLOAD_LENGTH;
+
+	memset(frame->data, 0, CONST_PAYLOAD_LENGTH);
+	for (int i = 0; i < dataBytes; i++) {
+		if (!(ScanChar(&scanner, ',') && ScanHex(&scanner, 2, &value))) {
+			return TWOCAN_PARSE_INVALID;
+		}
+		frame->data[i] = (byte)value;
+	}
+
+	if (scanner.ptr != scanner.end) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	if (dataBytes != CONST_PAYLOAD_LENGTH) {
+		return TWOCAN_PARSE_IGNORED;
+	}
+
+	frame->id = HeaderMakeId((byte)priority, (unsigned int)pgn, (byte)destination, (byte)source);
+	frame->dlc = CONST_PAYLOAD_LENGTH;
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	frame->timestamp = (DaysFromCivil(year, month, day) * 86400000000ULL) + timeOfDay;
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Parse a Yacht Devices log line, time, direction, 29 bit id and up to 8 space separated hexadecimal bytes
+// Only received (R) frames are replayed
+// [in] line, pointer to the line, need not be null terminated
+// [in] length, number of characters in the line
+// [out] frame, CAN Frame
+// returns TWOCAN_PARSE_FRAME or TWOCAN_PARSE_INVALID
+//
+
+int ParseYachtDevicesLine(const char *line, const unsigned int length, TwoCanFrame *frame) {
+	Scanner scanner;
+	unsigned long long timeOfDay;
+	unsigned int value;
+	byte dlc = 0;
+
+	ScanStart(&scanner, line, length);
+
+	if (!(ScanTimeOfDay(&scanner, &timeOfDay) && ScanChar(&scanner, ' ') &&
+		ScanChar(&scanner, 'R') && ScanChar(&scanner, ' ') &&
+		ScanHex(&scanner, 8, &frame->id))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	memset(frame->data, 0, CONST_PAYLOAD_LENGTH);
+	while ((scanner.ptr < scanner.end) && (dlc < CONST_PAYLOAD_LENGTH)) {
+		if (!(ScanChar(&scanner, ' ') && ScanHex(&scanner, 2, &value))) {
+			return TWOCAN_PARSE_INVALID;
+		}
+		frame->data[dlc++] = (byte)value;
+	}
+
+	if ((dlc == 0) || (scanner.ptr != scanner.end)) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	frame->id &= CONST_EXTENDED_ID_MASK;
+	frame->dlc = dlc;
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	frame->timestamp = timeOfDay;
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Parse a candump log line, (seconds.fraction) interface id#data
+// [in] line, pointer to the line, need not be null terminated
+// [in] length, number of characters in the line
+// [out] frame, CAN Frame
+// returns TWOCAN_PARSE_FRAME or TWOCAN_PARSE_INVALID
+//
+
+int ParseCandumpLine(const char *line, const unsigned int length, TwoCanFrame *frame) {
+	Scanner scanner;
+	unsigned long long seconds, fraction, interfaceNumber;
+	unsigned int value;
+	int digits;
+	byte dlc = 0;
+
+	ScanStart(&scanner, line, length);
+
+	if (!(ScanChar(&scanner, '(') && ScanDecimal(&scanner, 1, 12, &seconds, NULL) && ScanChar(&scanner, '.') &&
+		ScanDecimal(&scanner, 1, 9, &fraction, &digits) && ScanChar(&scanner, ')') && ScanChar(&scanner, ' '))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	// Interface name, can, vcan or slcan followed by a single digit
+	if (ScanChar(&scanner, 's')) {
+		if (!(ScanChar(&scanner, 'l') && ScanChar(&scanner, 'c'))) {
+			return TWOCAN_PARSE_INVALID;
+		}
+	}
+	else if (ScanChar(&scanner, 'v')) {
+		if (!ScanChar(&scanner, 'c')) {
+			return TWOCAN_PARSE_INVALID;
+		}
+	}
+	else if (!ScanChar(&scanner, 'c')) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	if (!(ScanChar(&scanner, 'a') && ScanChar(&scanner, 'n') && ScanDecimal(&scanner, 1, 1, &interfaceNumber, NULL) &&
+		ScanChar(&scanner, ' ') && ScanHex(&scanner, 8, &frame->id) && ScanChar(&scanner, '#'))) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	memset(frame->data, 0, CONST_PAYLOAD_LENGTH);
+	while ((scanner.ptr < scanner.end) && (dlc < CONST_PAYLOAD_LENGTH)) {
+		if (!ScanHex(&scanner, 2, &value)) {
+			return TWOCAN_PARSE_INVALID;
+		}
+		frame->data[dlc++] = (byte)value;
+	}
+
+	if (scanner.ptr != scanner.end) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	// Scale the fractional seconds to microseconds
+	for (; digits < 6; digits++) {
+		fraction *= 10;
+	}
+	for (; digits > 6; digits--) {
+		fraction /= 10;
+	}
+
+	frame->id &= CONST_EXTENDED_ID_MASK;
+	frame->dlc = dlc;
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	frame->timestamp = (seconds * 1000000) + fraction;
+	return TWOCAN_PARSE_FRAME;
+}
+
+//
+// Parse a TwoCan raw log line, 12 comma separated hexadecimal bytes with an optional 0x prefix
+// [in] line, pointer to the line, need not be null terminated
+// [in] length, number of characters in the line
+// [out] frame, CAN Frame
+// returns TWOCAN_PARSE_FRAME or TWOCAN_PARSE_INVALID
+//
+
+int ParseTwoCanRawLine(const char *line, const unsigned int length, TwoCanFrame *frame) {
+	Scanner scanner;
+	unsigned int value;
+	byte canFrame[CONST_FRAME_LENGTH];
+
+	ScanStart(&scanner, line, length);
+
+	for (int i = 0; i < CONST_FRAME_LENGTH; i++) {
+		if ((i > 0) && (!ScanChar(&scanner, ','))) {
+			return TWOCAN_PARSE_INVALID;
+		}
+		if (ScanChar(&scanner, '0')) {
+			if (!(ScanChar(&scanner, 'x') || ScanChar(&scanner, 'X'))) {
+				// Not a prefix, just a leading zero
+				scanner.ptr--;
+			}
+		}
+		if (!(ScanHex(&scanner, 2, &value) || ScanHex(&scanner, 1, &value))) {
+			return TWOCAN_PARSE_INVALID;
+		}
+		canFrame[i] = (byte)value;
+	}
+
+	if (scanner.ptr != scanner.end) {
+		return TWOCAN_PARSE_INVALID;
+	}
+
+	ConvertByteArrayToFrame(canFrame, CONST_PAYLOAD_LENGTH, frame);
+	frame->timestamp = 0;
+	return TWOCAN_PARSE_FRAME;
+}
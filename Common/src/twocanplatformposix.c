@@ -0,0 +1,1006 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanPlatform
+// Unit Description: POSIX implementation of the platform layer
+// Date: 16/10/2026
+// Function: Events, mutexes, threads, timers, files, memory mappings, serial ports, paths and debug output
+// implemented with pthreads, clock_gettime, mmap and termios, so the log file drivers build on Linux.
+//
+
+#include "../inc/twocanplatform.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Auto reset event
+struct TwoCanEventObject {
+	pthread_mutex_t mutex;
+	pthread_cond_t condition;
+	int signalled;
+};
+
+struct TwoCanMutexObject {
+	pthread_mutex_t mutex;
+};
+
+struct TwoCanThreadObject {
+	pthread_t thread;
+};
+
+// A mapping shares the file's descriptor, views are mapped directly from it
+struct TwoCanFileObject {
+	int fd;
+};
+
+// Nothing to hold, clock_nanosleep already has sub millisecond resolution
+struct TwoCanTimerObject {
+	int unused;
+};
+
+// Entry point and parameter handed to a new thread, freed by the thread itself
+typedef struct ThreadStart {
+	TwoCanThreadFunction function;
+	void *parameter;
+} ThreadStart;
+
+// Identifiers handed out by ThreadCreate
+static volatile DWORD nextThreadId = 0;
+
+//
+// Calculate an absolute deadline
+// [in] clockId, clock the deadline is measured against
+// [in] timeoutMs, milliseconds from now
+// [out] deadline
+//
+
+static void GetDeadline(const clockid_t clockId, const unsigned int timeoutMs, struct timespec *deadline) {
+	clock_gettime(clockId, deadline);
+	deadline->tv_sec += timeoutMs / 1000;
+	deadline->tv_nsec += (long)(timeoutMs % 1000) * 1000000;
+	if (deadline->tv_nsec >= 1000000000) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+}
+
+//
+// Create an auto reset event
+// [in] name, ignored, POSIX events are private to the process
+// returns the event, NULL on failure
+//
+
+TwoCanEvent EventCreate(const TwoCanChar *name) {
+	TwoCanEvent event;
+	pthread_condattr_t attributes;
+
+	(void)name;
+
+	event = (TwoCanEvent)calloc(1, sizeof(struct TwoCanEventObject));
+	if (event == NULL) {
+		return NULL;
+	}
+
+	// Timeouts are measured against the monotonic clock so they are unaffected by changes to the time of day
+	pthread_condattr_init(&attributes);
+	pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+	if ((pthread_mutex_init(&event->mutex, NULL) != 0) || (pthread_cond_init(&event->condition, &attributes) != 0)) {
+		pthread_condattr_destroy(&attributes);
+		free(event);
+		return NULL;
+	}
+	pthread_condattr_destroy(&attributes);
+	return event;
+}
+
+//
+// Signal an event, releasing one waiting thread
+// [in] event
+// returns TRUE on success
+//
+
+int EventSet(TwoCanEvent event) {
+	if (event == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+	pthread_mutex_lock(&event->mutex);
+	event->signalled = TRUE;
+	pthread_cond_signal(&event->condition);
+	pthread_mutex_unlock(&event->mutex);
+	return TRUE;
+}
+
+//
+// Wait for an event to be signalled, the event is reset once the wait is satisfied
+// [in] event
+// [in] timeoutMs, milliseconds, TWOCAN_WAIT_INFINITE to wait forever
+// returns TWOCAN_WAIT_SIGNALLED, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int EventWait(TwoCanEvent event, const unsigned int timeoutMs) {
+	struct timespec deadline;
+	int result = 0;
+
+	if (event == NULL) {
+		errno = EINVAL;
+		return TWOCAN_WAIT_FAILED;
+	}
+
+	if (timeoutMs != TWOCAN_WAIT_INFINITE) {
+		GetDeadline(CLOCK_MONOTONIC, timeoutMs, &deadline);
+	}
+
+	pthread_mutex_lock(&event->mutex);
+	while ((!event->signalled) && (result == 0)) {
+		if (timeoutMs == TWOCAN_WAIT_INFINITE) {
+			result = pthread_cond_wait(&event->condition, &event->mutex);
+		}
+		else {
+			result = pthread_cond_timedwait(&event->condition, &event->mutex, &deadline);
+		}
+	}
+
+	if (event->signalled) {
+		event->signalled = FALSE;
+		pthread_mutex_unlock(&event->mutex);
+		return TWOCAN_WAIT_SIGNALLED;
+	}
+
+	pthread_mutex_unlock(&event->mutex);
+	if (result == ETIMEDOUT) {
+		return TWOCAN_WAIT_TIMEOUT;
+	}
+	errno = result;
+	return TWOCAN_WAIT_FAILED;
+}
+
+//
+// Close an event
+// [in] event
+// returns TRUE on success
+//
+
+int EventClose(TwoCanEvent event) {
+	if (event == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+	pthread_cond_destroy(&event->condition);
+	pthread_mutex_destroy(&event->mutex);
+	free(event);
+	return TRUE;
+}
+
+//
+// Create a mutex, POSIX has no equivalent of the caller's named mutex
+// [in] name, ignored
+// returns the mutex, NULL on failure
+//
+
+TwoCanMutex MutexOpen(const TwoCanChar *name) {
+	(void)name;
+	return MutexCreate();
+}
+
+//
+// Create an unnamed mutex
+// returns the mutex, NULL on failure
+//
+
+TwoCanMutex MutexCreate(void) {
+	TwoCanMutex mutex;
+
+	mutex = (TwoCanMutex)calloc(1, sizeof(struct TwoCanMutexObject));
+	if (mutex == NULL) {
+		return NULL;
+	}
+	if (pthread_mutex_init(&mutex->mutex, NULL) != 0) {
+		free(mutex);
+		return NULL;
+	}
+	return mutex;
+}
+
+//
+// Acquire a mutex
+// [in] mutex
+// [in] timeoutMs, milliseconds, TWOCAN_WAIT_INFINITE to wait forever
+// returns TWOCAN_WAIT_SIGNALLED if the mutex was acquired, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int MutexLock(TwoCanMutex mutex, const unsigned int timeoutMs) {
+	struct timespec deadline;
+	int result;
+
+	if (mutex == NULL) {
+		errno = EINVAL;
+		return TWOCAN_WAIT_FAILED;
+	}
+
+	if (timeoutMs == TWOCAN_WAIT_INFINITE) {
+		result = pthread_mutex_lock(&mutex->mutex);
+	}
+	else {
+		// pthread_mutex_timedlock only accepts a deadline on the realtime clock
+		GetDeadline(CLOCK_REALTIME, timeoutMs, &deadline);
+		result = pthread_mutex_timedlock(&mutex->mutex, &deadline);
+	}
+
+	if (result == 0) {
+		return TWOCAN_WAIT_SIGNALLED;
+	}
+	if (result == ETIMEDOUT) {
+		return TWOCAN_WAIT_TIMEOUT;
+	}
+	errno = result;
+	return TWOCAN_WAIT_FAILED;
+}
+
+//
+// Release a mutex
+// [in] mutex
+// returns TRUE on success
+//
+
+int MutexUnlock(TwoCanMutex mutex) {
+	return ((mutex != NULL) && (pthread_mutex_unlock(&mutex->mutex) == 0));
+}
+
+//
+// Close a mutex
+// [in] mutex
+// returns TRUE on success
+//
+
+int MutexClose(TwoCanMutex mutex) {
+	if (mutex == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+	pthread_mutex_destroy(&mutex->mutex);
+	free(mutex);
+	return TRUE;
+}
+
+//
+// pthread entry point, calls the thread function
+// [in] parameter, ThreadStart allocated by ThreadCreate
+// returns the thread's exit code
+//
+
+static void *ThreadMain(void *parameter) {
+	ThreadStart start = *(ThreadStart *)parameter;
+
+	free(parameter);
+	return (void *)(uintptr_t)start.function(start.parameter);
+}
+
+//
+// Start a thread
+// [in] function, thread entry point
+// [in] parameter, passed to the entry point
+// [out] threadId, sequence number identifying the thread in debug output
+// returns the thread, NULL on failure
+//
+
+TwoCanThread ThreadCreate(TwoCanThreadFunction function, void *parameter, DWORD *threadId) {
+	TwoCanThread thread;
+	ThreadStart *start;
+	int result;
+
+	thread = (TwoCanThread)calloc(1, sizeof(struct TwoCanThreadObject));
+	start = (ThreadStart *)malloc(sizeof(ThreadStart));
+	if ((thread == NULL) || (start == NULL)) {
+		free(thread);
+		free(start);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	start->function = function;
+	start->parameter = parameter;
+
+	result = pthread_create(&thread->thread, NULL, ThreadMain, start);
+	if (result != 0) {
+		free(thread);
+		free(start);
+		errno = result;
+		return NULL;
+	}
+
+	*threadId = __sync_add_and_fetch(&nextThreadId, 1);
+	return thread;
+}
+
+//
+// End the calling thread
+// [in] exitCode, the thread's exit code
+//
+
+void ThreadExit(const DWORD exitCode) {
+	pthread_exit((void *)(uintptr_t)exitCode);
+}
+
+//
+// Release a thread, the thread is detached so its resources are freed once it returns
+// [in] thread
+// returns TRUE on success
+//
+
+int ThreadClose(TwoCanThread thread) {
+	int result;
+
+	if (thread == NULL) {
+		errno = EINVAL;
+		return FALSE;
+	}
+	result = pthread_detach(thread->thread);
+	free(thread);
+	if (result != 0) {
+		errno = result;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//
+// Suspend the calling thread
+// [in] milliseconds
+//
+
+void ThreadSleep(const unsigned int milliseconds) {
+	TimerWait(NULL, (unsigned long long)milliseconds * 1000);
+}
+
+//
+// Create a timer for sub millisecond waits
+// returns the timer, NULL on failure
+//
+
+TwoCanTimer TimerCreate(void) {
+	return (TwoCanTimer)calloc(1, sizeof(struct TwoCanTimerObject));
+}
+
+//
+// Wait for a period of time, measured against the monotonic clock
+// [in] timer, unused
+// [in] microseconds, time to wait
+//
+
+void TimerWait(TwoCanTimer timer, const unsigned long long microseconds) {
+	struct timespec deadline;
+
+	(void)timer;
+
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_sec += (time_t)(microseconds / 1000000);
+	deadline.tv_nsec += (long)(microseconds % 1000000) * 1000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	// An absolute deadline means an interrupted sleep can simply be restarted
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+	}
+}
+
+//
+// Close a timer
+// [in] timer, may be NULL
+//
+
+void TimerClose(TwoCanTimer timer) {
+	free(timer);
+}
+
+//
+// Monotonic host clock
+// returns microseconds since an arbitrary epoch, from CLOCK_MONOTONIC
+//
+
+unsigned long long GetHostTimestamp(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((unsigned long long)now.tv_sec * 1000000) + ((unsigned long long)now.tv_nsec / 1000);
+}
+
+//
+// Open a file
+// [in] fileName, full path of the file
+// [in] mode, TWOCAN_FILE_READ to read an existing file, TWOCAN_FILE_CREATE to create or truncate a file for writing
+// returns the file, NULL on failure
+//
+
+TwoCanFile FileOpen(const TwoCanChar *fileName, const int mode) {
+	TwoCanFile file;
+	int fd;
+
+	if (mode == TWOCAN_FILE_CREATE) {
+		fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	}
+	else {
+		fd = open(fileName, O_RDONLY | O_CLOEXEC);
+	}
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (mode != TWOCAN_FILE_CREATE) {
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	file = (TwoCanFile)malloc(sizeof(struct TwoCanFileObject));
+	if (file == NULL) {
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	file->fd = fd;
+	return file;
+}
+
+//
+// Read from the current file position
+// [in] file
+// [out] buffer
+// [in] length, maximum number of bytes to read
+// [out] bytesRead, number of bytes read, zero at the end of the file
+// returns TRUE on success
+//
+
+int FileRead(TwoCanFile file, void *buffer, const unsigned int length, unsigned int *bytesRead) {
+	ssize_t count;
+
+	do {
+		count = read(file->fd, buffer, length);
+	} while ((count < 0) && (errno == EINTR));
+
+	*bytesRead = (count < 0) ? 0 : (unsigned int)count;
+	return (count >= 0);
+}
+
+//
+// Write at the current file position
+// [in] file
+// [in] buffer
+// [in] length, number of bytes to write
+// returns TRUE if all of the bytes were written
+//
+
+int FileWrite(TwoCanFile file, const void *buffer, const unsigned int length) {
+	const char *next = (const char *)buffer;
+	size_t remaining = length;
+	ssize_t count;
+
+	while (remaining > 0) {
+		count = write(file->fd, next, remaining);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		next += count;
+		remaining -= (size_t)count;
+	}
+	return TRUE;
+}
+
+//
+// Set the file position
+// [in] file
+// [in] offset, from the start of the file
+// returns TRUE on success
+//
+
+int FileSeek(TwoCanFile file, const unsigned long long offset) {
+	return (lseek(file->fd, (off_t)offset, SEEK_SET) != (off_t)-1);
+}
+
+//
+// Retrieve the size of a file
+// [in] file
+// [out] size, in bytes
+// returns TRUE on success
+//
+
+int FileSize(TwoCanFile file, unsigned long long *size) {
+	struct stat status;
+
+	if (fstat(file->fd, &status) != 0) {
+		return FALSE;
+	}
+	*size = (unsigned long long)status.st_size;
+	return TRUE;
+}
+
+//
+// Retrieve the last write time of a file
+// [in] file
+// [out] lastWrite, only ever compared for equality
+// returns TRUE on success
+//
+
+int FileTime(TwoCanFile file, unsigned long long *lastWrite) {
+	struct stat status;
+
+	if (fstat(file->fd, &status) != 0) {
+		return FALSE;
+	}
+	*lastWrite = ((unsigned long long)status.st_mtim.tv_sec * 1000000000) + (unsigned long long)status.st_mtim.tv_nsec;
+	return TRUE;
+}
+
+//
+// Close a file
+// [in] file, may be NULL
+//
+
+void FileClose(TwoCanFile file) {
+	if (file != NULL) {
+		close(file->fd);
+		free(file);
+	}
+}
+
+//
+// Check whether a file exists
+// [in] fileName, full path of the file
+// returns TRUE if the file exists
+//
+
+int FileExists(const TwoCanChar *fileName) {
+	struct stat status;
+
+	return (stat(fileName, &status) == 0);
+}
+
+//
+// Delete a file
+// [in] fileName, full path of the file
+// returns TRUE on success
+//
+
+int FileDelete(const TwoCanChar *fileName) {
+	return (unlink(fileName) == 0);
+}
+
+//
+// Rename a file, replacing any existing file
+// [in] source, full path of the file
+// [in] destination, full path of the new name
+// returns TRUE on success
+//
+
+int FileReplace(const TwoCanChar *source, const TwoCanChar *destination) {
+	return (rename(source, destination) == 0);
+}
+
+//
+// Create a read only mapping of a file, views are mapped straight from the file's descriptor
+// [in] file, must not be empty
+// returns the mapping, NULL on failure
+//
+
+TwoCanMapping MappingCreate(TwoCanFile file) {
+	if (file == NULL) {
+		errno = EINVAL;
+	}
+	return file;
+}
+
+//
+// Map a view of a file
+// [in] mapping
+// [in] offset, must be a multiple of MappingGranularity
+// [in] length, number of bytes to map
+// returns the view, NULL on failure
+//
+
+const void *MappingView(TwoCanMapping mapping, const unsigned long long offset, const unsigned long long length) {
+	void *view;
+
+	view = mmap(NULL, (size_t)length, PROT_READ, MAP_SHARED, mapping->fd, (off_t)offset);
+	if (view == MAP_FAILED) {
+		return NULL;
+	}
+
+	// Log files and replay caches are read from start to finish
+	madvise(view, (size_t)length, MADV_SEQUENTIAL);
+	return view;
+}
+
+//
+// Unmap a view of a file
+// [in] view
+// [in] length, as passed to MappingView
+//
+
+void MappingUnview(const void *view, const unsigned long long length) {
+	munmap((void *)view, (size_t)length);
+}
+
+//
+// Close a mapping, the file remains open
+// [in] mapping, unused, the mapping is owned by the file
+//
+
+void MappingClose(TwoCanMapping mapping) {
+	(void)mapping;
+}
+
+//
+// Alignment required for the offset of a view
+// returns the page size
+//
+
+unsigned int MappingGranularity(void) {
+	return (unsigned int)sysconf(_SC_PAGESIZE);
+}
+
+// Serial port, the descriptor is non blocking and reads sleep in poll until a byte arrives
+struct TwoCanSerialObject {
+	int fd;
+};
+
+//
+// Convert a baud rate into a termios speed
+// [in] baudRate
+// returns the speed, B0 if the rate is not supported
+//
+
+static speed_t GetSerialSpeed(const int baudRate) {
+	switch (baudRate) {
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+#if defined(B460800)
+	case 460800: return B460800;
+	case 921600: return B921600;
+	case 1000000: return B1000000;
+	case 2000000: return B2000000;
+	case 3000000: return B3000000;
+#endif
+	default: return B0;
+	}
+}
+
+//
+// Open a serial port, or the slave side of a pseudo terminal, in raw mode
+// [in] portName, eg. /dev/ttyACM0
+// [in] baudRate, zero keeps the current speed
+// [in] dataBits
+// [in] stopBits, DCB convention
+// [in] parity, DCB convention
+// returns the port, NULL on failure
+//
+
+TwoCanSerial SerialOpen(const TwoCanChar *portName, const int baudRate, const int dataBits, const int stopBits, const int parity) {
+	TwoCanSerial port;
+	struct termios settings;
+	speed_t speed;
+	int fd;
+
+	fd = open(portName, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (tcgetattr(fd, &settings) == 0) {
+		cfmakeraw(&settings);
+		settings.c_cflag |= CLOCAL | CREAD;
+
+		settings.c_cflag &= ~CSIZE;
+		switch (dataBits) {
+		case 5: settings.c_cflag |= CS5; break;
+		case 6: settings.c_cflag |= CS6; break;
+		case 7: settings.c_cflag |= CS7; break;
+		default: settings.c_cflag |= CS8; break;
+		}
+
+		if (stopBits == 2) {
+			settings.c_cflag |= CSTOPB;
+		}
+		else {
+			settings.c_cflag &= ~CSTOPB;
+		}
+
+		settings.c_cflag &= ~(PARENB | PARODD);
+		if (parity == 1) {
+			settings.c_cflag |= PARENB | PARODD;
+		}
+		else if (parity == 2) {
+			settings.c_cflag |= PARENB;
+		}
+
+		// A read returns as soon as a single byte is available, poll provides the timeout
+		settings.c_cc[VMIN] = 1;
+		settings.c_cc[VTIME] = 0;
+
+		speed = GetSerialSpeed(baudRate);
+		if (speed != B0) {
+			cfsetispeed(&settings, speed);
+			cfsetospeed(&settings, speed);
+		}
+
+		// USB serial adapters ignore the line settings, so failing to apply them is not fatal
+		tcsetattr(fd, TCSANOW, &settings);
+	}
+
+	port = (TwoCanSerial)malloc(sizeof(struct TwoCanSerialObject));
+	if (port == NULL) {
+		close(fd);
+		errno = ENOMEM;
+		return NULL;
+	}
+	port->fd = fd;
+	return port;
+}
+
+//
+// Wait for bytes to arrive on a serial port
+// [in] port
+// [out] buffer
+// [in] length, maximum number of bytes to read
+// [out] bytesRead, number of bytes read
+// [in] timeoutMs, maximum time to wait if nothing is buffered
+// returns TWOCAN_WAIT_SIGNALLED if bytes were read, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int SerialRead(TwoCanSerial port, void *buffer, const unsigned int length, unsigned int *bytesRead, const unsigned int timeoutMs) {
+	struct pollfd pollDescriptor;
+	ssize_t count;
+	int pollResult;
+
+	*bytesRead = 0;
+
+	for (int attempt = 0; attempt < 2; attempt++) {
+		do {
+			count = read(port->fd, buffer, length);
+		} while ((count < 0) && (errno == EINTR));
+
+		if (count > 0) {
+			*bytesRead = (unsigned int)count;
+			return TWOCAN_WAIT_SIGNALLED;
+		}
+
+		if ((count == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+			// End of file, eg. the other side of a pseudo terminal has closed, or a device error
+			return TWOCAN_WAIT_FAILED;
+		}
+
+		if (attempt > 0) {
+			break;
+		}
+
+		// Nothing buffered, sleep until a byte arrives
+		pollDescriptor.fd = port->fd;
+		pollDescriptor.events = POLLIN;
+		pollDescriptor.revents = 0;
+		do {
+			pollResult = poll(&pollDescriptor, 1, (timeoutMs == TWOCAN_WAIT_INFINITE) ? -1 : (int)timeoutMs);
+		} while ((pollResult < 0) && (errno == EINTR));
+
+		if (pollResult < 0) {
+			return TWOCAN_WAIT_FAILED;
+		}
+		if (pollResult == 0) {
+			return TWOCAN_WAIT_TIMEOUT;
+		}
+	}
+	return TWOCAN_WAIT_TIMEOUT;
+}
+
+//
+// Received bytes not yet read
+// [in] port
+// returns the number of bytes waiting in the terminal's input buffer
+//
+
+unsigned int SerialBytesQueued(TwoCanSerial port) {
+	int count = 0;
+
+	if (ioctl(port->fd, FIONREAD, &count) < 0) {
+		return 0;
+	}
+	return (unsigned int)count;
+}
+
+//
+// Write to a serial port
+// [in] port
+// [in] buffer
+// [in] length, number of bytes to write
+// returns TRUE if all of the bytes were written
+//
+
+int SerialWrite(TwoCanSerial port, const void *buffer, const unsigned int length) {
+	struct pollfd pollDescriptor;
+	const char *next = (const char *)buffer;
+	size_t remaining = length;
+	ssize_t count;
+
+	while (remaining > 0) {
+		count = write(port->fd, next, remaining);
+		if (count < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+				return FALSE;
+			}
+			// Output buffer full, wait for the device to drain it
+			pollDescriptor.fd = port->fd;
+			pollDescriptor.events = POLLOUT;
+			pollDescriptor.revents = 0;
+			if (poll(&pollDescriptor, 1, 1000) <= 0) {
+				return FALSE;
+			}
+			continue;
+		}
+		next += count;
+		remaining -= (size_t)count;
+	}
+	return TRUE;
+}
+
+//
+// Close a serial port
+// [in] port, may be NULL
+//
+
+void SerialClose(TwoCanSerial port) {
+	if (port != NULL) {
+		close(port->fd);
+		free(port);
+	}
+}
+
+//
+// Full path of a file in the user's Documents folder, or their home folder if they have no Documents folder
+// [in] fileName
+// [out] path, TWOCAN_MAX_PATH characters
+// returns TRUE if the home folder was found
+//
+
+int GetDocumentsPath(const TwoCanChar *fileName, TwoCanChar *path) {
+	const char *home;
+	struct stat status;
+	int length;
+
+	home = getenv("HOME");
+	if ((home == NULL) || (*home == '\0')) {
+		return FALSE;
+	}
+
+	length = snprintf(path, TWOCAN_MAX_PATH, "%s/Documents", home);
+	if ((length < 0) || (length >= TWOCAN_MAX_PATH) || (stat(path, &status) != 0) || (!S_ISDIR(status.st_mode))) {
+		length = snprintf(path, TWOCAN_MAX_PATH, "%s", home);
+		if ((length < 0) || (length >= TWOCAN_MAX_PATH)) {
+			return FALSE;
+		}
+	}
+
+	length = snprintf(path + length, TWOCAN_MAX_PATH - length, "/%s", fileName);
+	return ((length >= 0) && (length < TWOCAN_MAX_PATH));
+}
+
+//
+// Append an extension to a file name
+// [out] path, TWOCAN_MAX_PATH characters
+// [in] fileName
+// [in] extension
+// returns FALSE if the result does not fit
+//
+
+int PathAddExtension(TwoCanChar *path, const TwoCanChar *fileName, const TwoCanChar *extension) {
+	size_t fileNameLength = strlen(fileName);
+	size_t extensionLength = strlen(extension);
+
+	if ((fileNameLength + extensionLength) >= TWOCAN_MAX_PATH) {
+		return FALSE;
+	}
+	memcpy(path, fileName, fileNameLength);
+	memcpy(path + fileNameLength, extension, extensionLength + 1);
+	return TRUE;
+}
+
+//
+// Error code of the last failed call
+// returns errno
+//
+
+int PlatformGetLastError(void) {
+	return errno;
+}
+
+//
+// Retrieve the system error message for an error code
+// [in] errorCode, errno value
+// returns the message, allocated by malloc
+//
+
+char *PlatformErrorMessage(const int errorCode) {
+	return strdup(strerror(errorCode));
+}
+
+//
+// Write formatted debug output to stderr, only when the TWOCAN_DEBUG environment variable is set
+// The drivers' formats follow the Microsoft convention, %s is a string of TwoCanChar and %S a narrow string,
+// both are UTF-8 here, so the format is narrowed and %S, %ls, %C and %lc are mapped to %s and %c
+// [in] format, wide character printf format
+// [in] args
+//
+
+void PlatformDebugOutput(const wchar_t *format, va_list args) {
+	static int enabled = -1;
+	char narrowFormat[1024];
+	size_t i = 0;
+
+	if (enabled == -1) {
+		enabled = (getenv("TWOCAN_DEBUG") != NULL);
+	}
+
+	if (!enabled) {
+		return;
+	}
+
+	for (; (*format != L'\0') && (i < sizeof(narrowFormat) - 1); format++) {
+		if ((*format == L'S') || (*format == L'C') || (*format == L's') || (*format == L'c')) {
+			// Only a conversion if preceded by a format specification
+			size_t j = i;
+			while ((j > 0) && (strchr("0123456789.*-+# hlz", narrowFormat[j - 1]) != NULL)) {
+				j--;
+			}
+			if ((j > 0) && (narrowFormat[j - 1] == '%')) {
+				if (narrowFormat[i - 1] == 'l') {
+					i--;
+				}
+				narrowFormat[i++] = ((*format == L'S') || (*format == L's')) ? 's' : 'c';
+				continue;
+			}
+		}
+		narrowFormat[i++] = (*format < 0x80) ? (char)*format : '?';
+	}
+	narrowFormat[i] = '\0';
+
+	vfprintf(stderr, narrowFormat, args);
+}
@@ -0,0 +1,758 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanPlatform
+// Unit Description: Win32 implementation of the platform layer
+// Date: 16/10/2026
+// Function: Events, mutexes, threads, timers, files, memory mappings, serial ports, paths and debug output
+// implemented directly on the Win32 API.
+//
+
+#include "../inc/twocanplatform.h"
+
+// for "my documents" folder and path appending
+// remember to also add Shlwapi.lib to linker
+#include <ShlObj.h>
+#include <ShlWapi.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Only defined by the Windows 10 1803 and later SDKs
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+//
+// Convert a Win32 wait result
+// [in] waitResult, result of WaitForSingleObject
+// returns TWOCAN_WAIT_SIGNALLED, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+static int ConvertWaitResult(const DWORD waitResult) {
+	switch (waitResult) {
+	case WAIT_OBJECT_0:
+	// An abandoned mutex is still acquired by the waiting thread
+	case WAIT_ABANDONED:
+		return TWOCAN_WAIT_SIGNALLED;
+	case WAIT_TIMEOUT:
+		return TWOCAN_WAIT_TIMEOUT;
+	default:
+		return TWOCAN_WAIT_FAILED;
+	}
+}
+
+//
+// Create an auto reset event
+// [in] name, name of the event, shared with the caller
+// returns the event, NULL on failure
+//
+
+TwoCanEvent EventCreate(const TwoCanChar *name) {
+	return CreateEvent(NULL, FALSE, FALSE, name);
+}
+
+//
+// Signal an event
+// [in] event
+// returns TRUE on success
+//
+
+int EventSet(TwoCanEvent event) {
+	return SetEvent(event);
+}
+
+//
+// Wait for an event to be signalled
+// [in] event
+// [in] timeoutMs, milliseconds, TWOCAN_WAIT_INFINITE to wait forever
+// returns TWOCAN_WAIT_SIGNALLED, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int EventWait(TwoCanEvent event, const unsigned int timeoutMs) {
+	return ConvertWaitResult(WaitForSingleObject(event, timeoutMs));
+}
+
+//
+// Close an event
+// [in] event
+// returns TRUE on success
+//
+
+int EventClose(TwoCanEvent event) {
+	return CloseHandle(event);
+}
+
+//
+// Open the mutex created by the caller
+// [in] name, name of the mutex
+// returns the mutex, NULL on failure
+//
+
+TwoCanMutex MutexOpen(const TwoCanChar *name) {
+	return OpenMutex(SYNCHRONIZE, TRUE, name);
+}
+
+//
+// Create an unnamed mutex
+// returns the mutex, NULL on failure
+//
+
+TwoCanMutex MutexCreate(void) {
+	return CreateMutex(NULL, FALSE, NULL);
+}
+
+//
+// Acquire a mutex
+// [in] mutex
+// [in] timeoutMs, milliseconds, TWOCAN_WAIT_INFINITE to wait forever
+// returns TWOCAN_WAIT_SIGNALLED if the mutex was acquired, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int MutexLock(TwoCanMutex mutex, const unsigned int timeoutMs) {
+	return ConvertWaitResult(WaitForSingleObject(mutex, timeoutMs));
+}
+
+//
+// Release a mutex
+// [in] mutex
+// returns TRUE on success
+//
+
+int MutexUnlock(TwoCanMutex mutex) {
+	return ReleaseMutex(mutex);
+}
+
+//
+// Close a mutex
+// [in] mutex
+// returns TRUE on success
+//
+
+int MutexClose(TwoCanMutex mutex) {
+	return CloseHandle(mutex);
+}
+
+//
+// Start a thread
+// [in] function, thread entry point
+// [in] parameter, passed to the entry point
+// [out] threadId, thread identifier
+// returns the thread, NULL on failure
+//
+
+TwoCanThread ThreadCreate(TwoCanThreadFunction function, void *parameter, DWORD *threadId) {
+	return CreateThread(NULL, 0, function, parameter, 0, threadId);
+}
+
+//
+// End the calling thread
+// [in] exitCode, the thread's exit code
+//
+
+void ThreadExit(const DWORD exitCode) {
+	ExitThread(exitCode);
+}
+
+//
+// Release a thread handle
+// [in] thread
+// returns TRUE on success
+//
+
+int ThreadClose(TwoCanThread thread) {
+	return CloseHandle(thread);
+}
+
+//
+// Suspend the calling thread
+// [in] milliseconds
+//
+
+void ThreadSleep(const unsigned int milliseconds) {
+	Sleep(milliseconds);
+}
+
+//
+// Create a timer for sub millisecond waits
+// returns the timer, NULL if no waitable timer is available
+//
+
+TwoCanTimer TimerCreate(void) {
+	TwoCanTimer timer;
+
+	// Fall back to a standard resolution timer on older versions of Windows
+	timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (timer == NULL) {
+		timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+	}
+	return timer;
+}
+
+//
+// Wait for a period of time, falling back to Sleep if the timer is unavailable
+// [in] timer
+// [in] microseconds, time to wait
+//
+
+void TimerWait(TwoCanTimer timer, const unsigned long long microseconds) {
+	LARGE_INTEGER dueTime;
+
+	if (timer != NULL) {
+		// Negative values are relative, in 100 nanosecond units
+		dueTime.QuadPart = -(LONGLONG)(microseconds * 10);
+		if (SetWaitableTimer(timer, &dueTime, 0, NULL, NULL, FALSE)) {
+			WaitForSingleObject(timer, INFINITE);
+			return;
+		}
+	}
+	Sleep((DWORD)(microseconds / 1000));
+}
+
+//
+// Close a timer
+// [in] timer
+//
+
+void TimerClose(TwoCanTimer timer) {
+	if (timer != NULL) {
+		CloseHandle(timer);
+	}
+}
+
+//
+// Monotonic host clock
+// returns microseconds since an arbitrary epoch, from QueryPerformanceCounter
+//
+
+unsigned long long GetHostTimestamp(void) {
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+
+	if (frequency.QuadPart == 0) {
+		QueryPerformanceFrequency(&frequency);
+	}
+	QueryPerformanceCounter(&counter);
+
+	// Split the conversion to avoid overflowing 64 bits with high resolution counters
+	return ((counter.QuadPart / frequency.QuadPart) * 1000000) + (((counter.QuadPart % frequency.QuadPart) * 1000000) / frequency.QuadPart);
+}
+
+//
+// Open a file
+// [in] fileName, full path of the file
+// [in] mode, TWOCAN_FILE_READ to read an existing file, TWOCAN_FILE_CREATE to create or truncate a file for writing
+// returns the file, NULL on failure
+//
+
+TwoCanFile FileOpen(const TwoCanChar *fileName, const int mode) {
+	HANDLE fileHandle;
+
+	if (mode == TWOCAN_FILE_CREATE) {
+		fileHandle = CreateFile(fileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+	else {
+		fileHandle = CreateFile(fileName, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	}
+	return (fileHandle == INVALID_HANDLE_VALUE) ? NULL : fileHandle;
+}
+
+//
+// Read from the current file position
+// [in] file
+// [out] buffer
+// [in] length, maximum number of bytes to read
+// [out] bytesRead, number of bytes read, zero at the end of the file
+// returns TRUE on success
+//
+
+int FileRead(TwoCanFile file, void *buffer, const unsigned int length, unsigned int *bytesRead) {
+	DWORD count = 0;
+	int result;
+
+	result = ReadFile(file, buffer, length, &count, NULL);
+	*bytesRead = count;
+	return result;
+}
+
+//
+// Write at the current file position
+// [in] file
+// [in] buffer
+// [in] length, number of bytes to write
+// returns TRUE if all of the bytes were written
+//
+
+int FileWrite(TwoCanFile file, const void *buffer, const unsigned int length) {
+	DWORD bytesWritten;
+
+	return ((WriteFile(file, buffer, length, &bytesWritten, NULL)) && (bytesWritten == length));
+}
+
+//
+// Set the file position
+// [in] file
+// [in] offset, from the start of the file
+// returns TRUE on success
+//
+
+int FileSeek(TwoCanFile file, const unsigned long long offset) {
+	LARGE_INTEGER position;
+
+	position.QuadPart = (LONGLONG)offset;
+	return SetFilePointerEx(file, position, NULL, FILE_BEGIN);
+}
+
+//
+// Retrieve the size of a file
+// [in] file
+// [out] size, in bytes
+// returns TRUE on success
+//
+
+int FileSize(TwoCanFile file, unsigned long long *size) {
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize)) {
+		return FALSE;
+	}
+	*size = (unsigned long long)fileSize.QuadPart;
+	return TRUE;
+}
+
+//
+// Retrieve the last write time of a file
+// [in] file
+// [out] lastWrite, only ever compared for equality
+// returns TRUE on success
+//
+
+int FileTime(TwoCanFile file, unsigned long long *lastWrite) {
+	FILETIME fileTime;
+
+	if (!GetFileTime(file, NULL, NULL, &fileTime)) {
+		return FALSE;
+	}
+	*lastWrite = ((unsigned long long)fileTime.dwHighDateTime << 32) | fileTime.dwLowDateTime;
+	return TRUE;
+}
+
+//
+// Close a file
+// [in] file, may be NULL
+//
+
+void FileClose(TwoCanFile file) {
+	if (file != NULL) {
+		CloseHandle(file);
+	}
+}
+
+//
+// Check whether a file exists
+// [in] fileName, full path of the file
+// returns TRUE if the file exists
+//
+
+int FileExists(const TwoCanChar *fileName) {
+	return PathFileExists(fileName);
+}
+
+//
+// Delete a file
+// [in] fileName, full path of the file
+// returns TRUE on success
+//
+
+int FileDelete(const TwoCanChar *fileName) {
+	return DeleteFile(fileName);
+}
+
+//
+// Rename a file, replacing any existing file
+// [in] source, full path of the file
+// [in] destination, full path of the new name
+// returns TRUE on success
+//
+
+int FileReplace(const TwoCanChar *source, const TwoCanChar *destination) {
+	return MoveFileEx(source, destination, MOVEFILE_REPLACE_EXISTING);
+}
+
+//
+// Create a read only mapping of a file
+// [in] file, must not be empty
+// returns the mapping, NULL on failure
+//
+
+TwoCanMapping MappingCreate(TwoCanFile file) {
+	return CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+}
+
+//
+// Map a view of a file
+// [in] mapping
+// [in] offset, must be a multiple of MappingGranularity
+// [in] length, number of bytes to map
+// returns the view, NULL on failure
+//
+
+const void *MappingView(TwoCanMapping mapping, const unsigned long long offset, const unsigned long long length) {
+	return MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(offset >> 32), (DWORD)(offset & 0xFFFFFFFF), (SIZE_T)length);
+}
+
+//
+// Unmap a view of a file
+// [in] view
+// [in] length, as passed to MappingView
+//
+
+void MappingUnview(const void *view, const unsigned long long length) {
+	UnmapViewOfFile(view);
+}
+
+//
+// Close a mapping, the file remains open
+// [in] mapping, may be NULL
+//
+
+void MappingClose(TwoCanMapping mapping) {
+	if (mapping != NULL) {
+		CloseHandle(mapping);
+	}
+}
+
+//
+// Alignment required for the offset of a view
+// returns the allocation granularity
+//
+
+unsigned int MappingGranularity(void) {
+	SYSTEM_INFO systemInfo;
+
+	GetSystemInfo(&systemInfo);
+	return systemInfo.dwAllocationGranularity;
+}
+
+// Overlapped serial port, reads sleep in WaitCommEvent rather than polling with interval timeouts
+struct TwoCanSerialObject {
+	HANDLE handle;
+	OVERLAPPED readOverlapped;
+	OVERLAPPED waitOverlapped;
+	OVERLAPPED writeOverlapped;
+	// A WaitCommEvent left outstanding by a read that timed out, reused by the next read
+	BOOL waitPending;
+	DWORD eventMask;
+};
+
+//
+// Release a serial port's handle and events
+// [in] port
+//
+
+static void SerialRelease(TwoCanSerial port) {
+	if (port->handle != INVALID_HANDLE_VALUE) {
+		CloseHandle(port->handle);
+	}
+	if (port->readOverlapped.hEvent != NULL) {
+		CloseHandle(port->readOverlapped.hEvent);
+	}
+	if (port->waitOverlapped.hEvent != NULL) {
+		CloseHandle(port->waitOverlapped.hEvent);
+	}
+	if (port->writeOverlapped.hEvent != NULL) {
+		CloseHandle(port->writeOverlapped.hEvent);
+	}
+	free(port);
+}
+
+//
+// Open a serial port for overlapped I/O
+// [in] portName, eg. COM3
+// [in] baudRate, zero keeps the current speed
+// [in] dataBits
+// [in] stopBits, DCB convention
+// [in] parity, DCB convention
+// returns the port, NULL on failure
+//
+
+TwoCanSerial SerialOpen(const TwoCanChar *portName, const int baudRate, const int dataBits, const int stopBits, const int parity) {
+	TwoCanSerial port;
+	DCB dcbSettings = { 0 };
+	COMMTIMEOUTS timeouts = { 0 };
+
+	port = (TwoCanSerial)calloc(1, sizeof(struct TwoCanSerialObject));
+	if (port == NULL) {
+		SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+		return NULL;
+	}
+
+	port->handle = CreateFile(portName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, NULL);
+	port->readOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	port->waitOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	port->writeOverlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	if ((port->handle == INVALID_HANDLE_VALUE) || (port->readOverlapped.hEvent == NULL) ||
+		(port->waitOverlapped.hEvent == NULL) || (port->writeOverlapped.hEvent == NULL)) {
+		DWORD error = GetLastError();
+		SerialRelease(port);
+		SetLastError(error);
+		return NULL;
+	}
+
+	// USB serial adapters ignore the line settings, so failing to apply them is not fatal
+	dcbSettings.DCBlength = sizeof(dcbSettings);
+	if (GetCommState(port->handle, &dcbSettings)) {
+		if (baudRate > 0) {
+			dcbSettings.BaudRate = baudRate;
+		}
+		dcbSettings.ByteSize = (BYTE)dataBits;
+		dcbSettings.StopBits = (BYTE)stopBits;
+		dcbSettings.Parity = (BYTE)parity;
+		SetCommState(port->handle, &dcbSettings);
+	}
+
+	// ReadFile returns immediately with whatever is already buffered, SerialRead does the waiting
+	timeouts.ReadIntervalTimeout = MAXDWORD;
+	timeouts.ReadTotalTimeoutConstant = 0;
+	timeouts.ReadTotalTimeoutMultiplier = 0;
+	timeouts.WriteTotalTimeoutConstant = 1000;
+	timeouts.WriteTotalTimeoutMultiplier = 0;
+
+	if ((!SetCommTimeouts(port->handle, &timeouts)) || (!SetCommMask(port->handle, EV_RXCHAR))) {
+		DWORD error = GetLastError();
+		SerialRelease(port);
+		SetLastError(error);
+		return NULL;
+	}
+
+	return port;
+}
+
+//
+// Read whatever is already buffered by the serial driver
+// [in] port
+// [out] buffer
+// [in] length
+// [out] bytesRead
+// returns TWOCAN_WAIT_SIGNALLED if bytes were read, TWOCAN_WAIT_TIMEOUT if none were buffered or TWOCAN_WAIT_FAILED
+//
+
+static int SerialReadBuffered(TwoCanSerial port, void *buffer, const unsigned int length, unsigned int *bytesRead) {
+	DWORD count = 0;
+
+	if (!ReadFile(port->handle, buffer, length, &count, &port->readOverlapped)) {
+		if (GetLastError() != ERROR_IO_PENDING) {
+			return TWOCAN_WAIT_FAILED;
+		}
+		// Completes at once given the read timeouts
+		if (!GetOverlappedResult(port->handle, &port->readOverlapped, &count, TRUE)) {
+			return TWOCAN_WAIT_FAILED;
+		}
+	}
+	*bytesRead = count;
+	return (count > 0) ? TWOCAN_WAIT_SIGNALLED : TWOCAN_WAIT_TIMEOUT;
+}
+
+//
+// Wait for bytes to arrive on a serial port
+// [in] port
+// [out] buffer
+// [in] length, maximum number of bytes to read
+// [out] bytesRead, number of bytes read
+// [in] timeoutMs, maximum time to wait if nothing is buffered
+// returns TWOCAN_WAIT_SIGNALLED if bytes were read, TWOCAN_WAIT_TIMEOUT or TWOCAN_WAIT_FAILED
+//
+
+int SerialRead(TwoCanSerial port, void *buffer, const unsigned int length, unsigned int *bytesRead, const unsigned int timeoutMs) {
+	COMSTAT status;
+	DWORD errors;
+	DWORD transferred;
+	int result;
+
+	*bytesRead = 0;
+
+	result = SerialReadBuffered(port, buffer, length, bytesRead);
+	if (result != TWOCAN_WAIT_TIMEOUT) {
+		return result;
+	}
+
+	// Nothing buffered, sleep until the driver reports a received character
+	if (!port->waitPending) {
+		if (WaitCommEvent(port->handle, &port->eventMask, &port->waitOverlapped)) {
+			return SerialReadBuffered(port, buffer, length, bytesRead);
+		}
+		if (GetLastError() != ERROR_IO_PENDING) {
+			return TWOCAN_WAIT_FAILED;
+		}
+		port->waitPending = TRUE;
+
+		// A character that arrived between the read and WaitCommEvent does not raise EV_RXCHAR
+		if ((ClearCommError(port->handle, &errors, &status)) && (status.cbInQue > 0)) {
+			return SerialReadBuffered(port, buffer, length, bytesRead);
+		}
+	}
+
+	switch (WaitForSingleObject(port->waitOverlapped.hEvent, timeoutMs)) {
+	case WAIT_OBJECT_0:
+		port->waitPending = FALSE;
+		if (!GetOverlappedResult(port->handle, &port->waitOverlapped, &transferred, FALSE)) {
+			return TWOCAN_WAIT_FAILED;
+		}
+		return SerialReadBuffered(port, buffer, length, bytesRead);
+	case WAIT_TIMEOUT:
+		// Leave the WaitCommEvent outstanding for the next read
+		return TWOCAN_WAIT_TIMEOUT;
+	default:
+		return TWOCAN_WAIT_FAILED;
+	}
+}
+
+//
+// Received bytes not yet read
+// [in] port
+// returns the number of bytes waiting in the driver's input queue
+//
+
+unsigned int SerialBytesQueued(TwoCanSerial port) {
+	DWORD errors;
+	COMSTAT status;
+
+	if (!ClearCommError(port->handle, &errors, &status)) {
+		return 0;
+	}
+	return status.cbInQue;
+}
+
+//
+// Write to a serial port
+// [in] port
+// [in] buffer
+// [in] length, number of bytes to write
+// returns TRUE if all of the bytes were written
+//
+
+int SerialWrite(TwoCanSerial port, const void *buffer, const unsigned int length) {
+	DWORD bytesWritten = 0;
+
+	if (!WriteFile(port->handle, buffer, length, &bytesWritten, &port->writeOverlapped)) {
+		if (GetLastError() != ERROR_IO_PENDING) {
+			return FALSE;
+		}
+		if (!GetOverlappedResult(port->handle, &port->writeOverlapped, &bytesWritten, TRUE)) {
+			return FALSE;
+		}
+	}
+	return (bytesWritten == length);
+}
+
+//
+// Close a serial port, cancelling any outstanding wait
+// [in] port, may be NULL
+//
+
+void SerialClose(TwoCanSerial port) {
+	DWORD transferred;
+
+	if (port == NULL) {
+		return;
+	}
+	if (port->waitPending) {
+		// Clearing the mask completes the outstanding WaitCommEvent
+		SetCommMask(port->handle, 0);
+		GetOverlappedResult(port->handle, &port->waitOverlapped, &transferred, TRUE);
+	}
+	SerialRelease(port);
+}
+
+//
+// Full path of a file in the user's My Documents folder
+// [in] fileName
+// [out] path, TWOCAN_MAX_PATH characters
+// returns TRUE if the My Documents folder was found
+//
+
+int GetDocumentsPath(const TwoCanChar *fileName, TwoCanChar *path) {
+	if (SHGetFolderPath(NULL, CSIDL_PERSONAL, NULL, SHGFP_TYPE_CURRENT, path) != S_OK) {
+		return FALSE;
+	}
+	return PathAppend(path, fileName);
+}
+
+//
+// Append an extension to a file name
+// [out] path, TWOCAN_MAX_PATH characters
+// [in] fileName
+// [in] extension
+// returns FALSE if the result does not fit
+//
+
+int PathAddExtension(TwoCanChar *path, const TwoCanChar *fileName, const TwoCanChar *extension) {
+	if ((wcslen(fileName) + wcslen(extension)) >= TWOCAN_MAX_PATH) {
+		return FALSE;
+	}
+	wcscpy(path, fileName);
+	wcscat(path, extension);
+	return TRUE;
+}
+
+//
+// Error code of the last failed call
+// returns GetLastError
+//
+
+int PlatformGetLastError(void) {
+	return (int)GetLastError();
+}
+
+//
+// Retrieve the system error message for an error code
+// [in] errorCode, Win32 error code
+// returns the message, allocated by FormatMessage
+//
+
+char *PlatformErrorMessage(const int errorCode) {
+	LPVOID lpMsgBuf;
+
+	FormatMessage(
+		FORMAT_MESSAGE_ALLOCATE_BUFFER |
+		FORMAT_MESSAGE_FROM_SYSTEM |
+		FORMAT_MESSAGE_IGNORE_INSERTS,
+		NULL,
+		errorCode,
+		MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+		(LPTSTR)&lpMsgBuf,
+		0, NULL);
+	return (char *)lpMsgBuf;
+}
+
+//
+// Write formatted debug output to the debugger
+// [in] format, wide character printf format
+// [in] args
+//
+
+void PlatformDebugOutput(const wchar_t *format, va_list args) {
+	wchar_t dbg_out[4096];
+	vswprintf_s(dbg_out, sizeof(dbg_out) / sizeof(wchar_t), format, args);
+	OutputDebugString(dbg_out);
+}
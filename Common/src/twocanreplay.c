@@ -0,0 +1,116 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanReplay
+// Unit Description: Replay scheduler for the log file drivers
+// Date: 16/10/2026
+// Function: Releases replayed frames at their recorded inter-arrival times, scaled by a speed factor,
+// using the high resolution host clock and the platform's sub millisecond timer.
+//
+
+#include "../inc/twocanreplay.h"
+
+//
+// Initialise the replay clock
+// [in] clock, pointer to replay clock
+// [in] speed, multiple of the recorded rate, CONST_REPLAY_SPEED_MAXIMUM to replay without pacing
+// returns TRUE if the clock's timer was created
+//
+
+int ReplayInitialise(TwoCanReplayClock *clock, const double speed) {
+	clock->requestedSpeed = speed;
+	clock->speed = speed;
+	clock->anchored = FALSE;
+	clock->anchorLog = 0;
+	clock->anchorHost = 0;
+	clock->lastLog = 0;
+
+	clock->timer = TimerCreate();
+	return (clock->timer != NULL);
+}
+
+//
+// Change the replay speed, may be called from any thread
+// [in] clock, pointer to replay clock
+// [in] speed, multiple of the recorded rate, CONST_REPLAY_SPEED_MAXIMUM to replay without pacing
+//
+
+void ReplaySetSpeed(TwoCanReplayClock *clock, const double speed) {
+	clock->requestedSpeed = speed;
+}
+
+//
+// Wait until a replayed frame is due
+// [in] clock, pointer to replay clock
+// [in] logTime, frame's timestamp as recorded in the log, microseconds
+// [in] isRunning, pointer to the read thread's running flag, the wait ends early if it is cleared
+// returns the host timestamp (GetHostTimestamp) at which the frame was due
+//
+
+unsigned long long ReplayWait(TwoCanReplayClock *clock, const unsigned long long logTime, const BOOL *isRunning) {
+	unsigned long long now;
+	unsigned long long due;
+	unsigned long long remaining;
+	double speed = clock->requestedSpeed;
+
+	now = GetHostTimestamp();
+
+	if (speed <= CONST_REPLAY_SPEED_MAXIMUM) {
+		clock->anchored = FALSE;
+		return now;
+	}
+
+	// Start a new anchor at this frame
+	if ((!clock->anchored) || (speed != clock->speed) || (logTime < clock->lastLog) || ((logTime - clock->lastLog) > CONST_REPLAY_MAX_GAP)) {
+		clock->speed = speed;
+		clock->anchorLog = logTime;
+		clock->anchorHost = now;
+		clock->lastLog = logTime;
+		clock->anchored = TRUE;
+		return now;
+	}
+
+	clock->lastLog = logTime;
+	due = clock->anchorHost + (unsigned long long)((double)(logTime - clock->anchorLog) / speed);
+
+	// If the caller is slower than the log the frame is already due and is released immediately
+	while ((*isRunning) && (now < due)) {
+		remaining = due - now;
+		if (remaining > (CONST_REPLAY_MAX_WAIT * 1000)) {
+			remaining = CONST_REPLAY_MAX_WAIT * 1000;
+		}
+		TimerWait(clock->timer, remaining);
+		now = GetHostTimestamp();
+	}
+
+	return due;
+}
+
+//
+// Release the replay clock's timer
+// [in] clock, pointer to replay clock
+//
+
+void ReplayClose(TwoCanReplayClock *clock) {
+	TimerClose(clock->timer);
+	clock->timer = NULL;
+}
@@ -0,0 +1,163 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanRing
+// Unit Description: Lock free ring buffer used to hand CAN Frames from a driver to the caller
+// Date: 16/10/2026
+// Function: Single producer, single consumer queue. The driver's read thread writes frames,
+// the caller drains them in bursts without taking a mutex for each frame.
+//
+
+#include "../inc/twocanring.h"
+
+//
+// Initialise an empty ring
+// [in] ring, pointer to caller allocated ring
+// [in] capacity, number of slots to use, must be a power of two no larger than CONST_RING_CAPACITY
+// returns TRUE if the ring was initialised
+//
+
+int RingInitialise(TwoCanRing *ring, const unsigned int capacity) {
+	if ((ring == NULL) || (capacity == 0) || (capacity > CONST_RING_CAPACITY) || ((capacity & (capacity - 1)) != 0)) {
+		return FALSE;
+	}
+	ring->head = 0;
+	ring->tail = 0;
+	ring->capacity = capacity;
+	ring->mask = capacity - 1;
+	ring->overflowCount = 0;
+	return TRUE;
+}
+
+//
+// Check a caller supplied ring before the read thread starts using it
+// [in] ring, pointer to ring
+// returns TRUE if the ring has a valid capacity and mask
+//
+
+int RingIsValid(const TwoCanRing *ring) {
+	if ((ring == NULL) || (ring->capacity == 0) || (ring->capacity > CONST_RING_CAPACITY)) {
+		return FALSE;
+	}
+	return (((ring->capacity & (ring->capacity - 1)) == 0) && (ring->mask == ring->capacity - 1));
+}
+
+//
+// Append a frame to the ring, only ever called from the driver's read thread
+// [in] ring, pointer to ring
+// [in] frame, pointer to CAN Frame
+// returns TRUE if the frame was queued, FALSE if the ring was full and the frame discarded
+//
+
+int RingWrite(TwoCanRing *ring, const TwoCanFrame *frame) {
+	unsigned int head = ring->head;
+	unsigned int tail = ring->tail;
+
+	if ((head - tail) >= ring->capacity) {
+		ring->overflowCount++;
+		return FALSE;
+	}
+
+	ring->frames[head & ring->mask] = *frame;
+
+	// Frame contents must be visible before the consumer sees the new head
+	PlatformMemoryBarrier();
+	ring->head = head + 1;
+	return TRUE;
+}
+
+//
+// Remove the oldest frame from the ring, only ever called from the consumer
+// [in] ring, pointer to ring
+// [out] frame, pointer to CAN Frame
+// returns TRUE if a frame was retrieved, FALSE if the ring was empty
+//
+
+int RingRead(TwoCanRing *ring, TwoCanFrame *frame) {
+	unsigned int tail = ring->tail;
+	unsigned int head = ring->head;
+
+	if (head == tail) {
+		return FALSE;
+	}
+
+	// Read the frame contents only after observing the producer's head
+	PlatformMemoryBarrier();
+	*frame = ring->frames[tail & ring->mask];
+
+	// Finish copying before handing the slot back to the producer
+	PlatformMemoryBarrier();
+	ring->tail = tail + 1;
+	return TRUE;
+}
+
+//
+// Remove a batch of frames from the ring, only ever called from the consumer
+// A single pair of barriers covers the whole batch rather than one pair per frame
+// [in] ring, pointer to ring
+// [out] frames, pointer to array of CAN Frames
+// [in] capacity, maximum number of frames to remove
+// returns the number of frames retrieved
+//
+
+unsigned int RingReadBatch(TwoCanRing *ring, TwoCanFrame *frames, const unsigned int capacity) {
+	unsigned int tail = ring->tail;
+	unsigned int head = ring->head;
+	unsigned int count = head - tail;
+
+	if (count > capacity) {
+		count = capacity;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	PlatformMemoryBarrier();
+	for (unsigned int i = 0; i < count; i++) {
+		frames[i] = ring->frames[(tail + i) & ring->mask];
+	}
+
+	PlatformMemoryBarrier();
+	ring->tail = tail + count;
+	return count;
+}
+
+//
+// Number of frames currently queued
+// [in] ring, pointer to ring
+// returns the number of frames waiting to be read
+//
+
+unsigned int RingCount(const TwoCanRing *ring) {
+	return ring->head - ring->tail;
+}
+
+//
+// Check whether the ring is full
+// [in] ring, pointer to ring
+// returns TRUE if a write would currently fail
+//
+
+int RingIsFull(const TwoCanRing *ring) {
+	return ((ring->head - ring->tail) >= ring->capacity);
+}
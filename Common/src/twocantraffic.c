@@ -0,0 +1,143 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanTraffic
+// Unit Description: Synthetic and recorded CAN traffic for benchmarking the drivers
+// Date: 16/10/2026
+// Function: Generates numbered NMEA 2000 frames and loads log files, shared by the adapter emulator
+// and the mock CANAL and CANlib libraries.
+//
+
+#include "../inc/twocantraffic.h"
+#include "../inc/twocanparser.h"
+#include "../inc/twocanheader.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// A mix of the rapid update PGNs seen on a typical network
+static const struct {
+	byte priority;
+	unsigned int pgn;
+	byte source;
+	byte dlc;
+} trafficTable[] = {
+	{ 2, 127250, 0x23, 8 },	// Vessel Heading
+	{ 2, 127251, 0x23, 8 },	// Rate of Turn
+	{ 2, 129025, 0x01, 8 },	// Position, Rapid Update
+	{ 2, 129026, 0x01, 8 },	// COG & SOG, Rapid Update
+	{ 2, 130306, 0x05, 8 },	// Wind Data
+	{ 2, 127488, 0x11, 8 },	// Engine Parameters, Rapid Update
+	{ 3, 128267, 0x07, 8 },	// Water Depth
+	{ 6, 59904, 0x01, 3 },	// ISO Request, to the global address
+};
+
+#define TRAFFIC_TABLE_SIZE (sizeof(trafficTable) / sizeof(trafficTable[0]))
+
+//
+// Create a synthetic frame
+// [in] sequence, frame number, the first four data bytes carry it little endian
+// [out] frame
+//
+
+void TrafficGenerateFrame(const unsigned long long sequence, TwoCanFrame *frame) {
+	unsigned int entry = (unsigned int)(sequence % TRAFFIC_TABLE_SIZE);
+
+	memset(frame, 0, sizeof(TwoCanFrame));
+	frame->id = HeaderMakeId(trafficTable[entry].priority, trafficTable[entry].pgn, CONST_HEADER_GLOBAL_ADDRESS, trafficTable[entry].source);
+	frame->dlc = trafficTable[entry].dlc;
+	frame->flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	for (unsigned int i = 0; (i < frame->dlc) && (i < CONST_PAYLOAD_LENGTH); i++) {
+		frame->data[i] = (i < 4) ? (byte)(sequence >> (i * 8)) : (byte)(i * 0x11);
+	}
+}
+
+//
+// Load the frames from a log file, lines that none of the parsers accept are skipped
+// [in] fileName, log file
+// [out] frames, array allocated with malloc, NULL if no frames were loaded
+// returns the number of frames loaded
+//
+
+unsigned int TrafficLoadLog(const char *fileName, TwoCanFrame **frames) {
+	FILE *file;
+	char line[1024];
+	unsigned int count = 0;
+	unsigned int capacity = 0;
+	TwoCanFrame frame;
+
+	*frames = NULL;
+
+	file = fopen(fileName, "r");
+	if (file == NULL) {
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		unsigned int length = (unsigned int)strlen(line);
+
+		if ((ParseCandumpLine(line, length, &frame) != TWOCAN_PARSE_FRAME) &&
+			(ParseYachtDevicesLine(line, length, &frame) != TWOCAN_PARSE_FRAME) &&
+			(ParseKeesLine(line, length, &frame) != TWOCAN_PARSE_FRAME) &&
+			(ParseTwoCanRawLine(line, length, &frame) != TWOCAN_PARSE_FRAME)) {
+			continue;
+		}
+
+		if (count == capacity) {
+			TwoCanFrame *resized;
+
+			capacity = (capacity == 0) ? 4096 : capacity * 2;
+			resized = (TwoCanFrame *)realloc(*frames, capacity * sizeof(TwoCanFrame));
+			if (resized == NULL) {
+				break;
+			}
+			*frames = resized;
+		}
+		(*frames)[count++] = frame;
+	}
+
+	fclose(file);
+
+	if (count == 0) {
+		free(*frames);
+		*frames = NULL;
+	}
+	return count;
+}
+
+//
+// Read a numeric setting from the environment
+// [in] name, environment variable
+// [in] defaultValue, used if the variable is not set
+// returns the setting
+//
+
+unsigned long long TrafficGetSetting(const char *name, const unsigned long long defaultValue) {
+	const char *value = getenv(name);
+
+	if ((value == NULL) || (*value == '\0')) {
+		return defaultValue;
+	}
+	return strtoull(value, NULL, 10);
+}
@@ -0,0 +1,331 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanTransmit
+// Unit Description: Asynchronous, priority ordered transmit queue
+// Date: 16/10/2026
+// Function: WriteAdapter queues frames and returns straight away, a writer thread owned by the queue
+// hands them to the adapter, most urgent NMEA 2000 priority first. The caller's thread never waits for the adapter.
+//
+
+#include "../inc/twocantransmit.h"
+#include "../inc/twocanheader.h"
+
+#include "../inc/twocanerror.h"
+
+#include <string.h>
+
+//
+// Remove up to capacity frames, most urgent priority first and oldest first within a priority
+// [in] queue
+// [out] frames, pointer to array of CAN Frames
+// [in] capacity, maximum number of frames to remove
+// returns the number of frames removed
+//
+
+static int TransmitDequeue(TwoCanTransmitQueue *queue, TwoCanFrame *frames, const int capacity) {
+	int count = 0;
+
+	for (int i = 0; (i < CONST_TRANSMIT_PRIORITIES) && (count < capacity); i++) {
+		TwoCanTransmitLevel *level = &queue->levels[i];
+		unsigned int tail = level->tail;
+		unsigned int head = level->head;
+
+		if (head == tail) {
+			continue;
+		}
+
+		// Read the frames only after observing the producer's head
+		PlatformMemoryBarrier();
+		while ((tail != head) && (count < capacity)) {
+			frames[count++] = level->frames[tail & (CONST_TRANSMIT_QUEUE - 1)];
+			tail++;
+		}
+
+		// Finish copying before handing the slots back to the producers
+		PlatformMemoryBarrier();
+		level->tail = tail;
+	}
+	return count;
+}
+
+//
+// Writer thread, sends queued frames until stopped, then flushes what it can
+// Re-examines every priority before each batch, so an urgent frame overtakes a backlog of less urgent ones
+// Upon exit, returns TWOCAN_RESULT_SUCCESS as Thread Exit Code
+//
+
+static DWORD TWOCAN_THREAD_CALL TransmitThread(void *lParam) {
+	TwoCanTransmitQueue *queue = (TwoCanTransmitQueue *)lParam;
+	TwoCanTransmitCallback callback;
+	TwoCanFrame frames[CONST_TRANSMIT_BATCH];
+	unsigned long long deadline = 0;
+	unsigned long long now;
+	unsigned long long latency;
+	int count;
+	int sent;
+	int result;
+
+	while (TRUE) {
+		if (!queue->isRunning) {
+			if (deadline == 0) {
+				deadline = GetHostTimestamp() + (CONST_TRANSMIT_FLUSH_TIME * 1000ULL);
+			}
+			if ((TransmitCount(queue) == 0) || (GetHostTimestamp() >= deadline)) {
+				break;
+			}
+		}
+
+		count = TransmitDequeue(queue, frames, CONST_TRANSMIT_BATCH);
+		if (count == 0) {
+			if (queue->isRunning) {
+				EventWait(queue->frameQueuedEvent, CONST_TRANSMIT_TIMEOUT);
+			}
+			continue;
+		}
+
+		sent = queue->send(frames, count);
+		now = GetHostTimestamp();
+
+		for (int i = 0; i < count; i++) {
+			if (i < sent) {
+				result = TWOCAN_RESULT_SUCCESS;
+				queue->statistics.framesTransmitted++;
+				latency = now - frames[i].timestamp;
+				queue->statistics.totalLatency += latency;
+				if (latency > queue->statistics.maximumLatency) {
+					queue->statistics.maximumLatency = latency;
+				}
+			}
+			else {
+				result = SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_TRANSMIT_FAILURE);
+				queue->statistics.framesFailed++;
+			}
+
+			callback = queue->callback;
+			if (callback != NULL) {
+				callback(&frames[i], result, queue->callbackContext);
+			}
+		}
+	}
+
+	EventSet(queue->threadFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+//
+// Start the writer thread
+// [in] queue, pointer to the driver's queue
+// [in] send, the driver's function that sends a single frame
+// returns TWOCAN_RESULT_SUCCESS if the thread started
+//
+
+int TransmitStart(TwoCanTransmitQueue *queue, TwoCanSendFunction send) {
+	// The mutex and events are created once and kept for the life of the driver, a thread queueing frames
+	// may still be waiting for the mutex after TransmitStop, and a writer thread that did not stop in time
+	// still signals threadFinishedEvent when it exits
+	if (queue->mutex == NULL) {
+		queue->mutex = MutexCreate();
+	}
+	if (queue->frameQueuedEvent == NULL) {
+		queue->frameQueuedEvent = EventCreate(NULL);
+	}
+	if (queue->threadFinishedEvent == NULL) {
+		queue->threadFinishedEvent = EventCreate(NULL);
+	}
+	if ((queue->mutex == NULL) || (queue->frameQueuedEvent == NULL) || (queue->threadFinishedEvent == NULL)) {
+		// Fatal Error
+		DebugPrintf(L"Create transmit queue failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_TRANSMIT_THREAD);
+	}
+
+	// A writer thread left running by TransmitStop must exit first, the queue only has one consumer
+	if (queue->thread != NULL) {
+		if (EventWait(queue->threadFinishedEvent, CONST_TRANSMIT_FLUSH_TIME + 1000) != TWOCAN_WAIT_SIGNALLED) {
+			// Fatal Error
+			DebugPrintf(L"Previous transmit thread is still running\n");
+			return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_TRANSMIT_THREAD);
+		}
+		ThreadClose(queue->thread);
+		queue->thread = NULL;
+	}
+
+	// Nothing is queued while the queue is stopped, the callback may have been set before the adapter was opened
+	memset(queue->levels, 0, sizeof(queue->levels));
+	memset(&queue->statistics, 0, sizeof(TwoCanTransmitStatistics));
+	queue->send = send;
+
+	MutexLock(queue->mutex, TWOCAN_WAIT_INFINITE);
+	queue->isRunning = TRUE;
+	MutexUnlock(queue->mutex);
+
+	queue->thread = ThreadCreate(TransmitThread, queue, &queue->threadId);
+	if (queue->thread == NULL) {
+		// Fatal Error
+		DebugPrintf(L"Transmit thread failed (%d)\n", PlatformGetLastError());
+		TransmitStop(queue);
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_TRANSMIT_THREAD);
+	}
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Stop the writer thread, it first sends the frames still queued for up to CONST_TRANSMIT_FLUSH_TIME
+// [in] queue, pointer to the driver's queue
+//
+
+void TransmitStop(TwoCanTransmitQueue *queue) {
+	if (queue->mutex == NULL) {
+		return;
+	}
+
+	// Once isRunning is cleared under the lock, no thread is queueing frames, and any that call
+	// TransmitEnqueue later see the queue is stopped
+	MutexLock(queue->mutex, TWOCAN_WAIT_INFINITE);
+	queue->isRunning = FALSE;
+	MutexUnlock(queue->mutex);
+
+	if (queue->thread != NULL) {
+		EventSet(queue->frameQueuedEvent);
+		if (EventWait(queue->threadFinishedEvent, CONST_TRANSMIT_FLUSH_TIME + 1000) != TWOCAN_WAIT_SIGNALLED) {
+			// Still blocked sending, its handle is kept so that TransmitStart waits for it to exit
+			DebugPrintf(L"Wait for transmit thread timed out\n");
+			return;
+		}
+		ThreadClose(queue->thread);
+		queue->thread = NULL;
+	}
+
+	if (TransmitCount(queue) > 0) {
+		DebugPrintf(L"Discarded %d queued frames\n", TransmitCount(queue));
+	}
+}
+
+//
+// Queue frames for the writer thread, may be called from any thread
+// [in] queue, pointer to the driver's queue
+// [in] frames, pointer to array of CAN Frames, the priority is taken from each frame's identifier
+// [in] count, number of frames
+// returns TWOCAN_RESULT_SUCCESS if every frame was queued, otherwise an error code and no frame is queued
+//
+
+int TransmitEnqueue(TwoCanTransmitQueue *queue, const TwoCanFrame *frames, const int count) {
+	unsigned int needed[CONST_TRANSMIT_PRIORITIES] = { 0 };
+	unsigned int heads[CONST_TRANSMIT_PRIORITIES];
+	unsigned long long now;
+	unsigned int depth;
+
+	if ((frames == NULL) || (count <= 0)) {
+		return TWOCAN_ERROR_INVALID_BUFFER;
+	}
+
+	// Never started
+	if (queue->mutex == NULL) {
+		return TWOCAN_ERROR_TRANSMIT_FAILURE;
+	}
+
+	for (int i = 0; i < count; i++) {
+		if (frames[i].dlc > CONST_PAYLOAD_LENGTH) {
+			return TWOCAN_ERROR_INVALID_BUFFER;
+		}
+		needed[HeaderGetPriority(frames[i].id)]++;
+	}
+
+	if (MutexLock(queue->mutex, 200) != TWOCAN_WAIT_SIGNALLED) {
+		return TWOCAN_ERROR_TRANSMIT_FAILURE;
+	}
+
+	// Checked under the lock, TransmitStop clears it under the lock before closing the events
+	if (!queue->isRunning) {
+		MutexUnlock(queue->mutex);
+		return TWOCAN_ERROR_TRANSMIT_FAILURE;
+	}
+
+	for (int i = 0; i < CONST_TRANSMIT_PRIORITIES; i++) {
+		heads[i] = queue->levels[i].head;
+		if (needed[i] > (CONST_TRANSMIT_QUEUE - (heads[i] - queue->levels[i].tail))) {
+			queue->statistics.framesRejected += count;
+			MutexUnlock(queue->mutex);
+			return TWOCAN_ERROR_TRANSMIT_QUEUE_FULL;
+		}
+	}
+
+	now = GetHostTimestamp();
+	for (int i = 0; i < count; i++) {
+		unsigned int priority = HeaderGetPriority(frames[i].id);
+		TwoCanFrame *slot = &queue->levels[priority].frames[heads[priority] & (CONST_TRANSMIT_QUEUE - 1)];
+
+		*slot = frames[i];
+		slot->timestamp = now;
+		heads[priority]++;
+	}
+
+	// The frames must be visible before the writer thread sees the new heads
+	PlatformMemoryBarrier();
+	for (int i = 0; i < CONST_TRANSMIT_PRIORITIES; i++) {
+		queue->levels[i].head = heads[i];
+	}
+
+	queue->statistics.framesQueued += count;
+	depth = TransmitCount(queue);
+	if (depth > queue->statistics.maximumDepth) {
+		queue->statistics.maximumDepth = depth;
+	}
+
+	// Signalled before unlocking, so TransmitStop can not have closed the event
+	EventSet(queue->frameQueuedEvent);
+
+	MutexUnlock(queue->mutex);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Frames waiting to be sent
+// [in] queue
+// returns the number of queued frames
+//
+
+unsigned int TransmitCount(const TwoCanTransmitQueue *queue) {
+	unsigned int count = 0;
+
+	for (int i = 0; i < CONST_TRANSMIT_PRIORITIES; i++) {
+		count += queue->levels[i].head - queue->levels[i].tail;
+	}
+	return count;
+}
+
+//
+// Set the function called after each frame is sent
+// [in] queue
+// [in] callback, NULL for none
+// [in] context, passed to the callback
+//
+
+void TransmitSetCallback(TwoCanTransmitQueue *queue, TwoCanTransmitCallback callback, void *context) {
+	queue->callback = NULL;
+	PlatformMemoryBarrier();
+	queue->callbackContext = context;
+	PlatformMemoryBarrier();
+	queue->callback = callback;
+}
@@ -0,0 +1,512 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: TwoCanTransport
+// Unit Description: ISO 11783 transport protocol reassembly
+// Date: 16/10/2026
+// Function: Messages longer than a fast packet are sent using the ISO 11783-3 transport protocol, a connection
+// management frame (PGN 60416) announces the message and its data follows in numbered packets (PGN 60160).
+// Broadcast messages (BAM) are simply collected, connected messages (RTS/CTS) are followed as the sender
+// and receiver exchange them, or acknowledged if they are addressed to the driver.
+//
+
+#include "../inc/twocantransport.h"
+
+#include "../inc/twocanheader.h"
+#include "../inc/twocanerror.h"
+
+#include <string.h>
+
+//
+// Send a connection management frame, when the table is the receiver of a session
+// [in] table
+// [in] session
+// [in] data, the eight data bytes, the PGN is added
+//
+
+static void TransportSend(TwoCanTransportTable *table, const TwoCanTransportSession *session, byte *data) {
+	TwoCanSendFunction send = table->send;
+	TwoCanFrame frame;
+
+	if (send == NULL) {
+		return;
+	}
+
+	frame.timestamp = 0;
+	frame.id = HeaderMakeId(CONST_TRANSPORT_PRIORITY, CONST_TRANSPORT_CM_PGN, session->source, session->destination);
+	frame.dlc = CONST_PAYLOAD_LENGTH;
+	frame.flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	memcpy(frame.data, data, 5);
+	frame.data[5] = session->pgn & 0xFF;
+	frame.data[6] = (session->pgn >> 8) & 0xFF;
+	frame.data[7] = (session->pgn >> 16) & 0xFF;
+
+	if (send(&frame, 1) != 1) {
+		DebugPrintf(L"Transport protocol send failed\n");
+	}
+}
+
+//
+// Ask the sender for the next packets, up to the smaller of the sender's and our own window
+// [in] table
+// [in] session, a session the table is the receiver of
+//
+
+static void TransportSendClearToSend(TwoCanTransportTable *table, TwoCanTransportSession *session) {
+	unsigned int window = session->packets - session->nextPacket + 1;
+	byte data[5];
+
+	if (window > session->maximumWindow) {
+		window = session->maximumWindow;
+	}
+	if (window > CONST_TRANSPORT_WINDOW) {
+		window = CONST_TRANSPORT_WINDOW;
+	}
+	session->windowEnd = (byte)(session->nextPacket + window - 1);
+
+	data[0] = TWOCAN_TRANSPORT_CTS;
+	data[1] = (byte)window;
+	data[2] = session->nextPacket;
+	data[3] = 0xFF;
+	data[4] = 0xFF;
+	TransportSend(table, session, data);
+}
+
+//
+// Abort a session the table is the receiver of
+// [in] table
+// [in] session
+// [in] reason, TWOCAN_TRANSPORT_ABORT_xxx
+//
+
+static void TransportSendAbort(TwoCanTransportTable *table, TwoCanTransportSession *session, const byte reason) {
+	byte data[5] = { TWOCAN_TRANSPORT_ABORT, reason, 0xFF, 0xFF, 0xFF };
+
+	TransportSend(table, session, data);
+}
+
+//
+// Find the session between a sender and a receiver
+// [in] table
+// [in] source, the sender
+// [in] destination, the receiver, or CONST_TRANSPORT_GLOBAL_ADDRESS for a broadcast session
+// returns the session or NULL
+//
+
+static TwoCanTransportSession *TransportFindSession(TwoCanTransportTable *table, const byte source, const byte destination) {
+	if (table->activeCount == 0) {
+		return NULL;
+	}
+
+	for (int i = 0; i < CONST_TRANSPORT_SESSIONS; i++) {
+		TwoCanTransportSession *session = &table->sessions[i];
+		if ((session->isActive) && (session->source == source) && (session->destination == destination)) {
+			return session;
+		}
+	}
+	return NULL;
+}
+
+//
+// End a session
+// [in] table
+// [in] session
+//
+
+static void TransportRelease(TwoCanTransportTable *table, TwoCanTransportSession *session) {
+	session->isActive = FALSE;
+	table->activeCount--;
+}
+
+//
+// Start a session announced by a broadcast announce or request to send frame.
+// A session already in progress between the same devices is abandoned, as its sender has started again
+// [in] table
+// [in] frame, the connection management frame
+// [in] source
+// [in] destination
+// returns the session, or NULL if the announcement is invalid or there is no free session
+//
+
+static TwoCanTransportSession *TransportStartSession(TwoCanTransportTable *table, const TwoCanFrame *frame, const byte source, const byte destination) {
+	TwoCanTransportSession *session;
+	unsigned int length = frame->data[1] | (frame->data[2] << 8);
+	unsigned int packets = frame->data[3];
+
+	if ((length < CONST_TRANSPORT_MINIMUM_LENGTH) || (length > CONST_TRANSPORT_LENGTH) ||
+		(packets != ((length + CONST_TRANSPORT_PACKET_BYTES - 1) / CONST_TRANSPORT_PACKET_BYTES))) {
+		return NULL;
+	}
+
+	session = TransportFindSession(table, source, destination);
+	if (session != NULL) {
+		table->statistics.sessionsAborted++;
+	}
+	else {
+		for (int i = 0; i < CONST_TRANSPORT_SESSIONS; i++) {
+			if (!table->sessions[i].isActive) {
+				session = &table->sessions[i];
+				break;
+			}
+		}
+		if (session == NULL) {
+			table->statistics.sessionsRejected++;
+			return NULL;
+		}
+		table->activeCount++;
+		if (table->activeCount > table->statistics.maximumActive) {
+			table->statistics.maximumActive = table->activeCount;
+		}
+	}
+
+	session->isActive = TRUE;
+	session->isBroadcast = (destination == CONST_TRANSPORT_GLOBAL_ADDRESS);
+	session->isReceiver = FALSE;
+	session->priority = HeaderGetPriority(frame->id);
+	session->source = source;
+	session->destination = destination;
+	session->packets = (byte)packets;
+	session->nextPacket = 1;
+	session->windowEnd = (byte)packets;
+	session->maximumWindow = frame->data[4];
+	session->pgn = frame->data[5] | (frame->data[6] << 8) | (frame->data[7] << 16);
+	session->length = length;
+	session->deadline = frame->timestamp + CONST_TRANSPORT_T1;
+	return session;
+}
+
+//
+// Handle a connection management frame
+// [in] table
+// [in] frame
+// [in] source
+// [in] destination
+// returns TWOCAN_TRANSPORT_PENDING or TWOCAN_TRANSPORT_DISCARDED
+//
+
+static int TransportConnection(TwoCanTransportTable *table, const TwoCanFrame *frame, const byte source, const byte destination) {
+	TwoCanTransportSession *session;
+
+	switch (frame->data[0]) {
+
+		case TWOCAN_TRANSPORT_BAM:
+			if ((destination != CONST_TRANSPORT_GLOBAL_ADDRESS) || (TransportStartSession(table, frame, source, destination) == NULL)) {
+				return TWOCAN_TRANSPORT_DISCARDED;
+			}
+			table->statistics.broadcastSessions++;
+			return TWOCAN_TRANSPORT_PENDING;
+
+		case TWOCAN_TRANSPORT_RTS:
+			if (destination == CONST_TRANSPORT_GLOBAL_ADDRESS) {
+				return TWOCAN_TRANSPORT_DISCARDED;
+			}
+			session = TransportStartSession(table, frame, source, destination);
+			if (session == NULL) {
+				return TWOCAN_TRANSPORT_DISCARDED;
+			}
+			table->statistics.connectedSessions++;
+
+			if ((table->send != NULL) && (table->address != CONST_TRANSPORT_NULL_ADDRESS) && (destination == table->address)) {
+				session->isReceiver = TRUE;
+				TransportSendClearToSend(table, session);
+			}
+			session->deadline = frame->timestamp + CONST_TRANSPORT_T2;
+			return TWOCAN_TRANSPORT_PENDING;
+
+		case TWOCAN_TRANSPORT_CTS:
+			// Sent by the receiver, so the session's sender is this frame's destination
+			session = TransportFindSession(table, destination, source);
+			if ((session == NULL) || (session->isReceiver)) {
+				return TWOCAN_TRANSPORT_DISCARDED;
+			}
+			// A clear to send for no packets holds the session open
+			if (frame->data[1] > 0) {
+				// The receiver may ask for packets again, but not skip packets that were missed here
+				if ((frame->data[2] == 0) || (frame->data[2] > session->nextPacket)) {
+					table->statistics.sessionsAborted++;
+					TransportRelease(table, session);
+					return TWOCAN_TRANSPORT_DISCARDED;
+				}
+				session->nextPacket = frame->data[2];
+				session->windowEnd = (byte)(frame->data[2] + frame->data[1] - 1);
+			}
+			session->deadline = frame->timestamp + CONST_TRANSPORT_T2;
+			return TWOCAN_TRANSPORT_PENDING;
+
+		case TWOCAN_TRANSPORT_ABORT:
+			// Either device may abort
+			session = TransportFindSession(table, source, destination);
+			if (session == NULL) {
+				session = TransportFindSession(table, destination, source);
+			}
+			if (session == NULL) {
+				return TWOCAN_TRANSPORT_DISCARDED;
+			}
+			table->statistics.sessionsAborted++;
+			TransportRelease(table, session);
+			return TWOCAN_TRANSPORT_PENDING;
+
+		case TWOCAN_TRANSPORT_EOM:
+			// The message was complete once its last packet arrived
+			return TWOCAN_TRANSPORT_PENDING;
+
+		default:
+			return TWOCAN_TRANSPORT_DISCARDED;
+	}
+}
+
+//
+// Handle a data transfer packet, packets are numbered from one and stored in order
+// [in] table
+// [in] frame
+// [in] source
+// [in] destination
+// [out] message, set if the packet completes the message
+// returns TWOCAN_TRANSPORT_PENDING, COMPLETE or DISCARDED
+//
+
+static int TransportData(TwoCanTransportTable *table, const TwoCanFrame *frame, const byte source, const byte destination, const TwoCanTransportMessage **message) {
+	TwoCanTransportSession *session;
+	unsigned int packet = frame->data[0];
+
+	session = TransportFindSession(table, source, destination);
+	if ((session == NULL) || (packet < session->nextPacket)) {
+		// No session, or a packet repeated by the sender
+		table->statistics.framesDiscarded++;
+		return TWOCAN_TRANSPORT_DISCARDED;
+	}
+
+	if ((packet > session->nextPacket) || (frame->dlc < CONST_PAYLOAD_LENGTH)) {
+		// A packet has been lost, a receiver asks for it again once the sender reaches the end of the window,
+		// otherwise the message can not be completed
+		table->statistics.framesDiscarded++;
+		if (session->isReceiver) {
+			if (packet >= session->windowEnd) {
+				TransportSendClearToSend(table, session);
+				session->deadline = frame->timestamp + CONST_TRANSPORT_T2;
+			}
+			return TWOCAN_TRANSPORT_DISCARDED;
+		}
+		table->statistics.sessionsAborted++;
+		TransportRelease(table, session);
+		return TWOCAN_TRANSPORT_DISCARDED;
+	}
+
+	memcpy(&session->data[(packet - 1) * CONST_TRANSPORT_PACKET_BYTES], &frame->data[1], CONST_TRANSPORT_PACKET_BYTES);
+	session->nextPacket++;
+	session->deadline = frame->timestamp + CONST_TRANSPORT_T1;
+
+	if (packet < session->packets) {
+		if ((session->isReceiver) && (packet == session->windowEnd)) {
+			TransportSendClearToSend(table, session);
+			session->deadline = frame->timestamp + CONST_TRANSPORT_T2;
+		}
+		return TWOCAN_TRANSPORT_PENDING;
+	}
+
+	if (session->isReceiver) {
+		byte data[5] = { TWOCAN_TRANSPORT_EOM, session->length & 0xFF, (session->length >> 8) & 0xFF, session->packets, 0xFF };
+		TransportSend(table, session, data);
+	}
+
+	table->message.timestamp = frame->timestamp;
+	table->message.pgn = session->pgn;
+	table->message.priority = session->priority;
+	table->message.source = session->source;
+	table->message.destination = session->destination;
+	table->message.length = session->length;
+	table->message.data = session->data;
+	*message = &table->message;
+
+	TransportRelease(table, session);
+	table->statistics.messagesCompleted++;
+	return TWOCAN_TRANSPORT_COMPLETE;
+}
+
+//
+// Initialise the table, ending any sessions in progress and clearing the statistics
+// [in] table, pointer to caller allocated table
+//
+
+void TransportInitialise(TwoCanTransportTable *table) {
+	for (int i = 0; i < CONST_TRANSPORT_SESSIONS; i++) {
+		table->sessions[i].isActive = FALSE;
+	}
+	table->activeCount = 0;
+	memset(&table->message, 0, sizeof(TwoCanTransportMessage));
+	memset(&table->statistics, 0, sizeof(TwoCanTransportStatistics));
+}
+
+//
+// Set the address connected sessions are accepted for, may be called while the read thread is running
+// [in] table
+// [in] address, the driver's source address, or CONST_TRANSPORT_NULL_ADDRESS to only monitor sessions
+// [in] send, sends the clear to send, end of message and abort frames
+//
+
+void TransportSetAddress(TwoCanTransportTable *table, const byte address, TwoCanSendFunction send) {
+	table->send = NULL;
+	PlatformMemoryBarrier();
+	table->address = address;
+	PlatformMemoryBarrier();
+	table->send = send;
+}
+
+//
+// Add a frame to its session
+// [in] table
+// [in] frame, received CAN Frame
+// [out] message, set to the completed message if the result is TWOCAN_TRANSPORT_COMPLETE
+// returns TWOCAN_TRANSPORT_IGNORED, PENDING, COMPLETE or DISCARDED
+//
+
+int TransportPush(TwoCanTransportTable *table, const TwoCanFrame *frame, const TwoCanTransportMessage **message) {
+	unsigned int pgn = HeaderGetPgn(frame->id);
+	byte source = HeaderGetSource(frame->id);
+	byte destination = HeaderGetDestination(frame->id);
+
+	// Both PGNs are destination specific, PDU1, with the destination in the low byte
+	if ((pgn != CONST_TRANSPORT_CM_PGN) && (pgn != CONST_TRANSPORT_DT_PGN)) {
+		return TWOCAN_TRANSPORT_IGNORED;
+	}
+
+	if (frame->dlc < CONST_PAYLOAD_LENGTH - CONST_TRANSPORT_PACKET_BYTES + 1) {
+		table->statistics.framesDiscarded++;
+		return TWOCAN_TRANSPORT_DISCARDED;
+	}
+
+	if (pgn == CONST_TRANSPORT_CM_PGN) {
+		if (frame->dlc < CONST_PAYLOAD_LENGTH) {
+			table->statistics.framesDiscarded++;
+			return TWOCAN_TRANSPORT_DISCARDED;
+		}
+		return TransportConnection(table, frame, source, destination);
+	}
+
+	return TransportData(table, frame, source, destination, message);
+}
+
+//
+// End sessions whose next frame is overdue, a session the table is the receiver of is aborted
+// [in] table
+// [in] now, current time in the frames' time base
+// returns the number of sessions ended
+//
+
+unsigned int TransportExpire(TwoCanTransportTable *table, const unsigned long long now) {
+	unsigned int expired = 0;
+
+	if (table->activeCount == 0) {
+		return 0;
+	}
+
+	for (int i = 0; i < CONST_TRANSPORT_SESSIONS; i++) {
+		TwoCanTransportSession *session = &table->sessions[i];
+		if ((session->isActive) && (now > session->deadline)) {
+			if (session->isReceiver) {
+				TransportSendAbort(table, session, TWOCAN_TRANSPORT_ABORT_TIMEOUT);
+			}
+			TransportRelease(table, session);
+			expired++;
+		}
+	}
+
+	table->statistics.sessionsTimedOut += expired;
+	return expired;
+}
+
+//
+// Reassemble received frames and pass each completed message to the callback
+// [in] table
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+//
+
+void TransportProcess(TwoCanTransportTable *table, const TwoCanFrame *frames, const int count) {
+	TwoCanTransportCallback callback = table->callback;
+	const TwoCanFilterTable *filters = table->filters;
+	const TwoCanTransportMessage *message;
+
+	if (!TransportIsInUse(table)) {
+		return;
+	}
+
+	PlatformMemoryBarrier();
+	for (int i = 0; i < count; i++) {
+		// Sessions addressed to the table are acknowledged even if there is no callback
+		if ((TransportPush(table, &frames[i], &message) == TWOCAN_TRANSPORT_COMPLETE) && (callback != NULL)) {
+			// The filters apply to the PGN the message carries, not the transport protocol PGNs
+			if ((filters == NULL) || (FilterTableMatch(filters, HeaderMakeId(message->priority, message->pgn, message->destination, message->source)))) {
+				callback(message, table->callbackContext);
+			}
+		}
+	}
+}
+
+//
+// Set or clear the completed message callback, may be called while the read thread is running
+// [in] table
+// [in] callback, NULL to stop reassembling
+// [in] context, passed to the callback
+//
+
+void TransportSetCallback(TwoCanTransportTable *table, TwoCanTransportCallback callback, void *context) {
+	table->callback = NULL;
+	PlatformMemoryBarrier();
+	table->callbackContext = context;
+	PlatformMemoryBarrier();
+	table->callback = callback;
+}
+
+//
+// Set the filters completed messages are checked against, may be called while the read thread is running
+// [in] table
+// [in] filters, the driver's acceptance filters, or NULL to pass every message to the callback
+//
+
+void TransportSetFilters(TwoCanTransportTable *table, const TwoCanFilterTable *filters) {
+	table->filters = filters;
+}
+
+//
+// Check whether the table needs the transport protocol frames
+// [in] table
+// returns TRUE if there is a callback, or an address and send function to answer sessions with
+//
+
+int TransportIsInUse(const TwoCanTransportTable *table) {
+	return (table->callback != NULL) || ((table->send != NULL) && (table->address != CONST_TRANSPORT_NULL_ADDRESS));
+}
+
+//
+// Check whether a frame the acceptance filters may have rejected is still needed by the table
+// [in] table
+// [in] id, 29 bit identifier
+// returns TRUE if the frame is a connection management or data transfer frame and the table is in use
+//
+
+int TransportIsWanted(const TwoCanTransportTable *table, const unsigned int id) {
+	unsigned int pgn = HeaderGetPgn(id);
+
+	return ((pgn == CONST_TRANSPORT_CM_PGN) || (pgn == CONST_TRANSPORT_DT_PGN)) && (TransportIsInUse(table));
+}
@@ -20,23 +20,19 @@
 #ifndef _TWOCAN_FILEDEVICE
 #define _TWOCAN_FILEDEVICE
 
-#include "..\..\common\inc\twocandriver.h"
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanparser.h"
+#include "../../Common/inc/twocanlogfile.h"
+#include "../../Common/inc/twocanduplicate.h"
 
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
-
-// for "my documents" folder and path appending
-// remember to also add Shlwapi.lib to linker
-#include <ShlObj.h>
-#include <ShlWapi.h>
-
-// 'C' runtime functions for file i/o, strtok etc.
+// 'C' runtime functions
 #include <stdio.h>
 
 // Hardcoded input LogFile
-#define CONST_LOG_FILE L"twocanraw.log"
+#define CONST_LOG_FILE TWOCAN_TEXT("twocanraw.log")
 
-#define DllExport __declspec(dllexport)
+#define DllExport TWOCAN_EXPORT
 
 DllExport char *DriverName(void);
 DllExport char *DriverVersion(void);
@@ -44,8 +40,13 @@ DllExport char *ManufacturerName(void);
 DllExport int OpenAdapter(void);
 DllExport int CloseAdapter(void);
 DllExport int ReadAdapter(byte *frame);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
+DllExport int SetDuplicateWindow(unsigned int window);
+DllExport int GetDuplicateStatistics(TwoCanDuplicateStatistics *statistics);
 
-DWORD WINAPI ReadThread(LPVOID lParam);
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrame(const TwoCanFrame *frame);
 
 
 #endif
\ No newline at end of file
@@ -21,20 +21,53 @@
 #ifndef _TWOCAN_KVASER
 #define _TWOCAN_KVASER
 
-#include "..\..\common\inc\twocandriver.h"
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanclock.h"
+#include "../../Common/inc/twocanfilter.h"
+#include "../../Common/inc/twocantransmit.h"
+#include "../../Common/inc/twocanfastpacket.h"
+#include "../../Common/inc/twocantransport.h"
 
 // Required for kvaser libraries
+#if defined(_WIN32)
 #include "canlib.h"
 #include "canstat.h"
-
-// Win32 functions
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
+#else
+// Kvaser's linuxcan canlib.h, or the mock CANlib's subset of it
+#include <canlib.h>
+#endif
 
 // 'C' runtime functions
 #include <stdio.h>
 
-#define DllExport __declspec( dllexport )
+// Maximum number of frames converted before they are handed to the caller
+#define CONST_RECEIVE_BATCH 64
+
+// canReadWait timeout (milliseconds), so the read thread notices when it is stopped
+#define CONST_RECEIVE_TIMEOUT 100
+
+// Frames waiting in the adapter's receive queue at which the read thread stops waiting for the caller to drain
+// a full ring and discards frames instead, so that the adapter does not overrun
+#define CONST_RECEIVE_QUEUE_LIMIT 192
+
+// Receive statistics, returned by GetAdapterStatistics
+typedef struct KvaserStatistics {
+	// Frames read from the adapter, including error frames and frames that are not passed to the caller
+	unsigned long long framesReceived;
+	unsigned long long errorFrames;
+	// Frames flagged by the adapter as following lost frames
+	unsigned long long overruns;
+	// Number of times the read thread woke and drained the adapter's queue
+	unsigned long long drainPasses;
+	// Most frames read in a single pass
+	unsigned int drainMaximum;
+	// Frames queued in the adapter behind the first frame of the latest pass, and the highest seen
+	unsigned int receiveQueueLevel;
+	unsigned int receiveQueueMaximum;
+} KvaserStatistics;
+
+#define DllExport TWOCAN_EXPORT
 
 DllExport char *DriverName(void);
 DllExport char *DriverVersion(void);
@@ -42,8 +75,28 @@ DllExport char *ManufacturerName(void);
 DllExport int OpenAdapter(void);
 DllExport int CloseAdapter(void);
 DllExport int ReadAdapter(byte *frame);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
 DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data);
+DllExport int WriteAdapterEx(const TwoCanFrame *frames, int count);
+DllExport int SetTransmitCallback(TwoCanTransmitCallback callback, void *context);
+DllExport int GetTransmitStatistics(TwoCanTransmitStatistics *statistics);
+DllExport int SetFastPacketCallback(TwoCanFastPacketCallback callback, void *context);
+DllExport int GetFastPacketStatistics(TwoCanFastPacketStatistics *statistics);
+DllExport int SetTransportCallback(TwoCanTransportCallback callback, void *context);
+DllExport int SetTransportAddress(int address);
+DllExport int GetTransportStatistics(TwoCanTransportStatistics *statistics);
+DllExport int GetAdapterStatistics(KvaserStatistics *statistics);
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count);
+DllExport int SubscribePgn(unsigned int pgn, int source);
+DllExport int UnsubscribePgn(unsigned int pgn, int source);
 
-DWORD WINAPI ReadThread(LPVOID lParam);
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrames(const TwoCanFrame *frames, const int count);
+void PostFrame(const TwoCanFrame *frame);
+int ReceiveQueueFilling(void);
+int SendFrames(const TwoCanFrame *frames, const int count);
+int QueueFrames(const TwoCanFrame *frames, const int count);
+void ApplyAcceptanceFilters(void);
 
 #endif
\ No newline at end of file
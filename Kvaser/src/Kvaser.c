@@ -30,39 +30,73 @@
 // 1.0 Initial Release
 // 1.1 - 2/4/2019 Added Write function
 
-#include "..\inc\kvaser.h"
+#include "../inc/kvaser.h"
 
-#include "..\..\common\inc\twocanerror.h"
+#include "../../Common/inc/twocanerror.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 // Separate thread to read data from the Kvaser Lightleaf device
-HANDLE threadHandle;
+TwoCanThread threadHandle;
 
 // The thread id.
 DWORD threadId;
 
 // Event signalled when valid CAN Frame is received
-HANDLE frameReceivedEvent;
+TwoCanEvent frameReceivedEvent;
 
 // Signal that the thread has terminated
-HANDLE threadFinishedEvent;
+TwoCanEvent threadFinishedEvent;
+
+// Event signalled by the caller once it has consumed the received frames
+TwoCanEvent frameConsumedEvent;
 
 // Mutex used to synchronize access to the CAN Frame buffer
-HANDLE frameReceivedMutex;
+TwoCanMutex frameReceivedMutex;
 
 // Pointer to the caller's CAN Frame buffer
 byte *canFramePtr;
 
+// Pointer to the caller's ring buffer, used instead of canFramePtr when started by ReadAdapterEx
+TwoCanRing *canRingPtr = NULL;
+
+// Ring buffer owned by the driver, used when started by ReadAdapterBatch
+TwoCanRing batchRing;
+
 // Variable to indicate thread state
 BOOL isRunning = FALSE;
 
+// Set once the read thread has been started, until CloseAdapter, isRunning is also cleared if the thread fails
+BOOL isStarted = FALSE;
+
 // Kvaser variables
 canStatus status;
-canHandle handle;
+canHandle handle = canINVALID_HANDLE;
+
+// Correlates the adapter's timestamps with the host clock
+TwoCanClock adapterClock;
+
+// Receive statistics, written only by the read thread
+KvaserStatistics adapterStatistics;
+
+// PGN and source address filters, the adapter applies their combined code and mask
+TwoCanFilterTable acceptanceFilters;
+
+// Frames waiting to be sent by the writer thread
+TwoCanTransmitQueue transmitQueue;
+
+// Fast packet messages being reassembled by the read thread
+TwoCanFastPacketTable fastPackets;
+
+// ISO transport protocol sessions being reassembled by the read thread
+TwoCanTransportTable transportSessions;
 
 //
 // The DLL entry point
 //
 
+#if defined(_WIN32)
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved) {
 	switch (fdwReason)	{
 	case DLL_PROCESS_ATTACH:
@@ -81,6 +115,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved)
 	// As nothing to do, just return TRUE
 	return TRUE;
 }
+#endif
 
 //
 // Drivername,
@@ -117,37 +152,63 @@ DllExport char *ManufacturerName(void)	{
 //
 
 DllExport int OpenAdapter(void)	{
+	DWORD timerScale;
+
+	// The events and mutex are created by the first OpenAdapter and kept for the life of the driver, see CloseAdapter
 	// Create an event that is used to notify the caller of a received frame
-	frameReceivedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_DATARX_EVENT);
+	if (frameReceivedEvent == NULL) {
+		frameReceivedEvent = EventCreate(CONST_DATARX_EVENT);
+	}
 
 	if (frameReceivedEvent == NULL)
 	{
 		// Fatal Error
-		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_EVENT);
 	}
 
 	// Create an event that is used to notify the close method that the thread has ended
-	threadFinishedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_EVENT_THREAD_ENDED);
+	if (threadFinishedEvent == NULL) {
+		threadFinishedEvent = EventCreate(CONST_EVENT_THREAD_ENDED);
+	}
 
 	if (threadFinishedEvent == NULL)
 	{
 		// Fatal Error
-		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_COMPLETE_EVENT);
 	}
+
+	// Create an event that the caller signals once it has consumed the received frames
+	if (frameConsumedEvent == NULL) {
+		frameConsumedEvent = EventCreate(CONST_DATACONSUMED_EVENT);
+	}
+
+	if (frameConsumedEvent == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Create FrameConsumed Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT);
+	}
 	
 	// Open the mutex that is used to synchronize access to the Can Frame buffer
 	// Initial state set to true, meaning we "own" the initial state of the mutex
-	frameReceivedMutex = OpenMutex(SYNCHRONIZE, TRUE, CONST_MUTEX_NAME);
+	if (frameReceivedMutex == NULL) {
+		frameReceivedMutex = MutexOpen(CONST_MUTEX_NAME);
+	}
 
 	if (frameReceivedMutex == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Open Mutex failed (%d)\n", GetLastError());
+		DebugPrintf(L"Open Mutex failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_MUTEX);
 	}
 
+	memset(&adapterStatistics, 0, sizeof(KvaserStatistics));
+	FastPacketInitialise(&fastPackets);
+	TransportInitialise(&transportSessions);
+	TransportSetFilters(&transportSessions, &acceptanceFilters);
+
 	// Kvaser Channel initialization
 	canInitializeLibrary();
 
@@ -170,6 +231,19 @@ DllExport int OpenAdapter(void)	{
 	// Open Channel 0
 	handle = canOpenChannel(0, 0);
 
+	// Request microsecond timestamps, otherwise the adapter reports milliseconds
+	timerScale = 1;
+	if (canIoCtl(handle, canIOCTL_SET_TIMER_SCALE, &timerScale, sizeof(timerScale)) == canOK) {
+		ClockInitialise(&adapterClock, 1);
+	}
+	else {
+		// Non fatal error
+		DebugPrintf(L"Kvaser Set Timer Scale failed\n");
+		ClockInitialise(&adapterClock, 1000);
+	}
+
+	ApplyAcceptanceFilters();
+
 	// Set bitrate to 250k for NMEA2000
 	status = canSetBusParams(handle, canBITRATE_250K, 0, 0, 0, 0, 0);
 	
@@ -192,7 +266,7 @@ DllExport int OpenAdapter(void)	{
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SET_BUS_ON);
 	}
 
-	return TWOCAN_RESULT_SUCCESS;
+	return TransmitStart(&transmitQueue, SendFrames);
 }
 
 //
@@ -203,34 +277,37 @@ DllExport int OpenAdapter(void)	{
 DllExport int CloseAdapter(void)	{
 	// Terminate the read thread
 	isRunning = FALSE;
+	isStarted = FALSE;
 
-	// Wait for the thread to exit
-	int waitResult;
-	waitResult = WaitForSingleObject(threadFinishedEvent, 1000);
-	if (waitResult == WAIT_TIMEOUT) {
-		DebugPrintf(L"Wait for threadFinishedEVent timed out");
-	}
-	if (waitResult == WAIT_ABANDONED) {
-		DebugPrintf(L"Wait for threadFinishedEVent abandoned");
-	}
-	if (waitResult == WAIT_FAILED) {
-		DebugPrintf(L"Wait for threadFinishedEVent Error: %d", GetLastError());
+	// Wait for the thread to exit, if it was started
+	int waitResult = TWOCAN_WAIT_SIGNALLED;
+	if (threadHandle != NULL) {
+		waitResult = EventWait(threadFinishedEvent, 1000);
+		if (waitResult == TWOCAN_WAIT_TIMEOUT) {
+			DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		}
+		if (waitResult == TWOCAN_WAIT_FAILED) {
+			DebugPrintf(L"Wait for threadFinishedEvent Error: %d", PlatformGetLastError());
+		}
+
+		// Release the handle, a thread that has not exited keeps running until it returns
+		int closeResult;
+		closeResult = ThreadClose(threadHandle);
+		if (closeResult == 0) {
+			DebugPrintf(L"Close threadHandle Error: %d", PlatformGetLastError());
+		}
+		threadHandle = NULL;
 	}
 
-	// Close all the handles
-	int closeResult;
-	closeResult = CloseHandle(threadFinishedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadFinsishedEvent Error: %d", GetLastError());
-	}
+	// The events and mutex are kept for the life of the driver rather than closed, a read thread that has
+	// not exited or a caller still waiting in ReadAdapterBatch may be using them
 
-	closeResult = CloseHandle(frameReceivedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close frameReceivedEvent Error: %d", GetLastError());
-	}
-	closeResult = CloseHandle(threadHandle);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadHandle Error: %d", GetLastError());
+	// Send what is still queued before going off bus
+	TransmitStop(&transmitQueue);
+
+	// A read thread that has not exited may still be reading from the adapter, so it is left open
+	if (waitResult != TWOCAN_WAIT_SIGNALLED) {
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_DELETE_THREAD_HANDLE);
 	}
 
 	// Close the Kvaser adapter
@@ -242,6 +319,7 @@ DllExport int CloseAdapter(void)	{
 	if (status != canOK) {
 		DebugPrintf(L"Kvaser Close Adapter Error: %d", status);
 	}
+	handle = canINVALID_HANDLE;
 	return TWOCAN_RESULT_SUCCESS;
 }
 
@@ -256,108 +334,581 @@ DllExport int ReadAdapter(byte *frame)	{
 
 	// Save the pointer to the Can Frame buffer
 	canFramePtr = frame;
+	canRingPtr = NULL;
 
 	// Indicate thread is in running state
 	isRunning = TRUE;
 
 	// Start the read thread
-	threadHandle = CreateThread(NULL, 0, ReadThread, NULL, 0, &threadId);
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
 
 	if (threadHandle != NULL) {
+		isStarted = TRUE;
 		return TWOCAN_RESULT_SUCCESS;
 	}
 	// Fatal Error
 	isRunning = FALSE;
-	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, GetLastError());
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
 	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
 }
 
 //
-// Write, Transmit a frame onto the NMEA 2000 network
+// ReadEx, starts the read thread, received frames are queued in the caller's ring buffer
+// [in] ring, pointer to a ring buffer initialised with RingInitialise
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
+//
+
+DllExport int ReadAdapterEx(TwoCanRing *ring)	{
+
+	if (!RingIsValid(ring)) {
+		DebugPrintf(L"Invalid ring buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_RING);
+	}
+
+	// Save the pointer to the ring buffer
+	canRingPtr = ring;
+	canFramePtr = NULL;
+
+	// Indicate thread is in running state
+	isRunning = TRUE;
+
+	// Start the read thread
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
+
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		return TWOCAN_RESULT_SUCCESS;
+	}
+	// Fatal Error
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
+}
+
+//
+// ReadBatch, returns the frames received since the previous call, waiting up to timeoutMs if none are queued
+// The first call starts the read thread, frames are then queued in the driver's own ring buffer between calls
+// [out] frames, pointer to the caller's array of CAN Frames
+// [in] capacity, number of CAN Frames the array can hold
+// [out] count, number of CAN Frames returned, zero if the wait timed out
+// [in] timeoutMs, maximum time to wait for a frame
+// Returns TWOCAN_RESULT_SUCCESS if the read thread is running
+//
+
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs)	{
+	int result;
+
+	if ((frames == NULL) || (count == NULL) || (capacity <= 0)) {
+		DebugPrintf(L"Invalid frame buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+
+	*count = 0;
+
+	if (!isStarted) {
+		RingInitialise(&batchRing, CONST_RING_CAPACITY);
+		result = ReadAdapterEx(&batchRing);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			return result;
+		}
+	}
+	else if (canRingPtr != &batchRing) {
+		// Already started by ReadAdapter or ReadAdapterEx
+		DebugPrintf(L"Read thread already running\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_READ_FUNCTION);
+	}
+	else if ((!isRunning) && (RingCount(&batchRing) == 0)) {
+		// The read thread ended after a fatal error, once its last frames have been returned. It is not restarted
+		DebugPrintf(L"Read thread has stopped\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_RECEIVE_FAILURE);
+	}
+
+	if (RingCount(&batchRing) == 0) {
+		EventWait(frameReceivedEvent, timeoutMs);
+	}
+
+	*count = RingReadBatch(&batchRing, frames, capacity);
+
+	// Let the read thread know there is space in the ring
+	EventSet(frameConsumedEvent);
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Write, queue a frame for transmission onto the NMEA 2000 network, returns without waiting for the adapter
 // [in] 29bit Can header (id), payload and payload length
-// returns TWOCAN_RESULT_SUCCESS 
+// returns TWOCAN_RESULT_SUCCESS if the frame was queued
 //
 
 DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data) {
-	status = canWrite(handle, id, data, dataLength, canMSG_EXT);
-	if (status == canOK) {
-		return TWOCAN_RESULT_SUCCESS;
+	TwoCanFrame frame;
+
+	if ((dataLength < 0) || (dataLength > CONST_PAYLOAD_LENGTH) || ((data == NULL) && (dataLength > 0))) {
+		DebugPrintf(L"Invalid transmit frame\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
 	}
-	else {
-		DebugPrintf(L"Transmit frame failed: %d\n", status);
-		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_TRANSMIT_FAILURE);
+
+	memset(&frame, 0, sizeof(TwoCanFrame));
+	frame.id = id & CONST_EXTENDED_ID_MASK;
+	frame.dlc = (byte)dataLength;
+	frame.flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	if (dataLength > 0) {
+		memcpy(frame.data, data, dataLength);
+	}
+
+	return WriteAdapterEx(&frame, 1);
+}
+
+//
+// WriteEx, queue several frames as a unit, eg. the frames of a fast packet message. Either all of them are queued or none.
+// Frames are sent most urgent priority first, frames of the same priority in order
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns TWOCAN_RESULT_SUCCESS if the frames were queued
+//
+
+DllExport int WriteAdapterEx(const TwoCanFrame *frames, int count) {
+	int result;
+
+	result = TransmitEnqueue(&transmitQueue, frames, count);
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		DebugPrintf(L"Transmit queue error: %d\n", result);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, result);
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the writer thread after each frame is sent or fails, may be called before OpenAdapter
+// [in] callback, NULL to remove the callback
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetTransmitCallback(TwoCanTransmitCallback callback, void *context) {
+	TransmitSetCallback(&transmitQueue, callback, context);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Transmit statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetTransmitStatistics(TwoCanTransmitStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = transmitQueue.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the read thread with each reassembled fast packet message, may be called before OpenAdapter.
+// The frames of the message are still passed to the caller as usual
+// [in] callback, NULL to stop reassembling messages
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetFastPacketCallback(TwoCanFastPacketCallback callback, void *context) {
+	FastPacketSetCallback(&fastPackets, callback, context);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Fast packet reassembly statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetFastPacketStatistics(TwoCanFastPacketStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = fastPackets.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the read thread with each reassembled ISO transport protocol message, may be called before OpenAdapter.
+// The frames of the message are still passed to the caller as usual
+// [in] callback, NULL to stop reassembling messages
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetTransportCallback(TwoCanTransportCallback callback, void *context) {
+	TransportSetCallback(&transportSessions, callback, context);
+
+	// The adapter's filter must now let the transport protocol frames through, or may stop doing so
+	if (handle != canINVALID_HANDLE) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Set the source address whose transport protocol sessions the driver answers with clear to send and end of message acknowledgements
+// [in] address, the caller's claimed address, or CONST_TRANSPORT_NULL_ADDRESS to only follow sessions
+// returns TWOCAN_RESULT_SUCCESS if the address is valid
+//
+
+DllExport int SetTransportAddress(int address) {
+	if ((address < 0) || (address > CONST_TRANSPORT_NULL_ADDRESS)) {
+		DebugPrintf(L"Invalid transport protocol address: %d\n", address);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_ADDRESS);
+	}
+	TransportSetAddress(&transportSessions, (byte)address, (address == CONST_TRANSPORT_NULL_ADDRESS) ? NULL : QueueFrames);
+
+	if (handle != canINVALID_HANDLE) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Transport protocol statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetTransportStatistics(TwoCanTransportStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = transportSessions.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Queue the transport protocol acknowledgements sent from the read thread
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns the number of frames queued
+//
+
+int QueueFrames(const TwoCanFrame *frames, const int count) {
+	return (TransmitEnqueue(&transmitQueue, frames, count) == TWOCAN_RESULT_SUCCESS) ? count : 0;
+}
+
+//
+// Send frames in order, called only from the transmit queue's writer thread
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns the number of frames the adapter accepted
+//
+
+int SendFrames(const TwoCanFrame *frames, const int count) {
+	canStatus result;
+
+	for (int i = 0; i < count; i++) {
+		result = canWrite(handle, frames[i].id, (void *)frames[i].data, frames[i].dlc, canMSG_EXT);
+		if (result != canOK) {
+			DebugPrintf(L"Transmit frame failed: %d\n", result);
+			return i;
+		}
+	}
+	return count;
+}
+
+//
+// Statistics, a snapshot of the read thread's receive statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetAdapterStatistics(KvaserStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = adapterStatistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Filter, accept only the listed PGNs, may be called before or after OpenAdapter
+// [in] filters, pointer to array of PGN and source address filters
+// [in] count, number of filters, zero accepts every frame
+// returns TWOCAN_RESULT_SUCCESS if the filters are valid
+//
+
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count) {
+	if (!FilterTableUpdate(&acceptanceFilters, filters, count)) {
+		DebugPrintf(L"Invalid acceptance filters\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle != canINVALID_HANDLE) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Subscribe, add a PGN to the acceptance filters, may be called before or after OpenAdapter
+// Frames of other PGNs are discarded by the read thread once any filter is set
+// [in] pgn, as for TwoCanFilter
+// [in] source, source address or CONST_FILTER_ANY_SOURCE
+// returns TWOCAN_RESULT_SUCCESS if the PGN is now accepted
+//
+
+DllExport int SubscribePgn(unsigned int pgn, int source) {
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableSubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"Invalid subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle != canINVALID_HANDLE) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Unsubscribe, remove a PGN added with SubscribePgn or SetAcceptanceFilters
+// Removing the last PGN leaves no filters, so every frame is accepted again
+// [in] pgn, source, as given when the PGN was added
+// returns TWOCAN_RESULT_SUCCESS if the PGN was removed
+//
+
+DllExport int UnsubscribePgn(unsigned int pgn, int source) {
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableUnsubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"No subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle != canINVALID_HANDLE) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Load the combined code and mask of the active filters into the adapter's extended frame acceptance filter
+//
+
+void ApplyAcceptanceFilters(void) {
+	unsigned int code;
+	unsigned int mask;
+
+	FilterTableHardware(&acceptanceFilters, &code, &mask);
+
+	// Sessions are reassembled whatever the filters, the messages they carry are filtered once complete
+	if (TransportIsInUse(&transportSessions)) {
+		FilterWidenHardware(&code, &mask, CONST_TRANSPORT_CM_PGN);
+		FilterWidenHardware(&code, &mask, CONST_TRANSPORT_DT_PGN);
+	}
+
+	if ((canAccept(handle, mask, canFILTER_SET_MASK_EXT) != canOK) ||
+		(canAccept(handle, code, canFILTER_SET_CODE_EXT) != canOK)) {
+		// Non fatal error, the read thread still applies the filters
+		DebugPrintf(L"Kvaser Set Acceptance Filter failed\n");
 	}
 }
 
 //
 // Read thread, reads CAN Frames from Kvaser device, if a valid frame is received,
 // parse the frame into the correct format and notify the caller
+// Blocks in canReadWait for the first frame, then drains the frames already queued by the adapter
+// with canRead, so a burst such as a fast packet PGN is handed to the caller in a single pass
 // Upon exit, returns TWOCAN_RESULT_SUCCESS as Thread Exit Code
 //
 
-DWORD WINAPI ReadThread(LPVOID lParam)
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam)
 {
-	DWORD mutexResult;
+	TwoCanFrame frames[CONST_RECEIVE_BATCH];
 	byte data[8];
 	long id;
 	unsigned int dlc;
 	unsigned int flags;
 	unsigned long time;
+	unsigned long long hostTime;
+	unsigned int level;
+	int count;
+	int drained;
+	int isAccepted;
+	int isTransport;
 
 	while (isRunning) {
 
-		status = canReadWait(handle, &id, data, &dlc, &flags, &time, 100);
-		if (status == canOK) {
-			// Only interested in CAN 2.0 extended frames
-			if (flags & canMSG_EXT) {
-				// Make sure we can get a lock on the buffer
-				mutexResult = WaitForSingleObject(frameReceivedMutex, 200);
+		status = canReadWait(handle, &id, data, &dlc, &flags, &time, CONST_RECEIVE_TIMEOUT);
+		if (status != canOK) {
+			// Nothing received, sessions waiting for their next frame must still time out
+			if ((fastPackets.activeCount > 0) || (transportSessions.activeCount > 0)) {
+				hostTime = GetHostTimestamp();
+				FastPacketExpire(&fastPackets, hostTime);
+				TransportExpire(&transportSessions, hostTime);
+			}
+			continue;
+		}
+
+		// Frames still queued in the adapter after the first one
+		if (canIoCtl(handle, canIOCTL_GET_RX_BUFFER_LEVEL, &level, sizeof(level)) == canOK) {
+			adapterStatistics.receiveQueueLevel = level;
+			if (level > adapterStatistics.receiveQueueMaximum) {
+				adapterStatistics.receiveQueueMaximum = level;
+			}
+		}
+
+		count = 0;
+		drained = 0;
 
-				if (mutexResult == WAIT_OBJECT_0) {
+		do {
+			drained++;
 
-					// Convert id (long) to TwoCan header format (byte array)
-					canFramePtr[3] = (id >> 24) & 0xFF;
-					canFramePtr[2] = (id >> 16) & 0xFF;
-					canFramePtr[1] = (id >> 8) & 0xFF;
-					canFramePtr[0] = id & 0xFF;
+			// Read once the frame has been read, ClockConvert needs a host time no earlier than the frame's arrival.
+			// Frames drained after a back pressure wait in PostFrames arrived well after the first frame of the pass
+			hostTime = GetHostTimestamp();
 
-					// Copy the CAN data
-					memcpy(&canFramePtr[4], data, dlc);
+			if (flags & (canMSGERR_HW_OVERRUN | canMSGERR_SW_OVERRUN)) {
+				adapterStatistics.overruns++;
+			}
 
-					// Release the lock
-					ReleaseMutex(frameReceivedMutex);
+			if (flags & canMSG_ERROR_FRAME) {
+				adapterStatistics.errorFrames++;
+			}
+			// Only interested in CAN 2.0 extended data frames, that pass the filters the adapter could not apply
+			else if ((flags & canMSG_EXT) && (!(flags & canMSG_RTR))) {
+				isAccepted = FilterTableMatch(&acceptanceFilters, id & CONST_EXTENDED_ID_MASK);
+				// Transport protocol frames are reassembled even if the filters reject them, the message they carry may be accepted
+				isTransport = TransportIsWanted(&transportSessions, id & CONST_EXTENDED_ID_MASK);
+
+				if ((isAccepted) || (isTransport)) {
+					frames[count].timestamp = ClockConvert(&adapterClock, time, hostTime);
+					frames[count].id = id & CONST_EXTENDED_ID_MASK;
+					frames[count].dlc = (dlc > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : (byte)dlc;
+					frames[count].flags = TWOCAN_FRAME_FLAG_EXTENDED | TWOCAN_FRAME_FLAG_HARDWARE_TIMESTAMP;
+
+					// Copy the CAN data
+					memset(frames[count].data, 0, CONST_PAYLOAD_LENGTH);
+					memcpy(frames[count].data, data, frames[count].dlc);
 
-					// Notify the caller
-					if (SetEvent(frameReceivedEvent)) {
-						Sleep(10);
+					if (isTransport) {
+						TransportProcess(&transportSessions, &frames[count], 1);
 					}
-					else {
-						// Non fatal error
-						DebugPrintf(L"Set Event Error: %d\n", GetLastError());
+
+					// A rejected frame is overwritten by the next one
+					if (isAccepted) {
+						count++;
 					}
 				}
+			}
 
-				else {
-					// Non fatal error
-					DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, GetLastError());
-				}
-			}  // end Can Extended Frame handling
-
-			if (flags & canMSG_STD) {
-				// Not interested in these
-			} 
-			
-			if (flags & canMSG_RTR) {
-				// Nor these
-			} 
-			
-			if (flags & canMSG_ERROR_FRAME) {
-				// Nor these 
+			if (count == CONST_RECEIVE_BATCH) {
+				PostFrames(frames, count);
+				count = 0;
 			}
-			
-		} // end if canStatus.OK
+
+		} while ((isRunning) && (canRead(handle, &id, data, &dlc, &flags, &time) == canOK));
+
+		if (count > 0) {
+			PostFrames(frames, count);
+		}
+
+		FastPacketExpire(&fastPackets, hostTime);
+		TransportExpire(&transportSessions, hostTime);
+
+		adapterStatistics.framesReceived += drained;
+		adapterStatistics.drainPasses++;
+		if ((unsigned int)drained > adapterStatistics.drainMaximum) {
+			adapterStatistics.drainMaximum = drained;
+		}
 
 	} // end while
-	SetEvent(threadFinishedEvent);
-	ExitThread(TWOCAN_RESULT_SUCCESS);
+	EventSet(threadFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+//
+// Pass a batch of received frames to the caller, via the ring buffer if started by ReadAdapterEx or ReadAdapterBatch,
+// otherwise one at a time via the caller's CAN Frame buffer
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+//
+
+void PostFrames(const TwoCanFrame *frames, const int count) {
+	int queued = 0;
+
+	FastPacketProcess(&fastPackets, frames, count);
+
+	if (canRingPtr == NULL) {
+		for (int i = 0; i < count; i++) {
+			PostFrame(&frames[i]);
+		}
+		return;
+	}
+
+	// Back pressure, wait for the caller to drain the ring while the adapter buffers incoming frames.
+	// Frames are only discarded, and counted as overflows, once the adapter's receive queue is in danger of dropping them itself
+	while ((isRunning) && ((canRingPtr->capacity - RingCount(canRingPtr)) < (unsigned int)count) && (!ReceiveQueueFilling())) {
+		EventWait(frameConsumedEvent, CONST_BACK_PRESSURE_WAIT);
+	}
+
+	// No lock required, the read thread is the only writer
+	for (int i = 0; i < count; i++) {
+		queued += RingWrite(canRingPtr, &frames[i]);
+	}
+
+	// A single notification for the whole batch
+	if ((queued > 0) && (!EventSet(frameReceivedEvent))) {
+		// Non fatal error
+		DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+	}
+}
+
+//
+// Whether the adapter's receive queue is close to overrunning, so the read thread must stop waiting for the caller
+// returns non zero if the queue holds CONST_RECEIVE_QUEUE_LIMIT or more frames
+//
+
+int ReceiveQueueFilling(void) {
+	unsigned int level;
+
+	if (canIoCtl(handle, canIOCTL_GET_RX_BUFFER_LEVEL, &level, sizeof(level)) != canOK) {
+		return FALSE;
+	}
+	return (level >= CONST_RECEIVE_QUEUE_LIMIT);
+}
+
+//
+// Pass a single frame to the caller's CAN Frame buffer, as used by ReadAdapter
+// [in] frame, pointer to CAN Frame
+//
+
+void PostFrame(const TwoCanFrame *frame) {
+	int mutexResult;
+
+	// Make sure we can get a lock on the buffer
+	mutexResult = MutexLock(frameReceivedMutex, 200);
+
+	if (mutexResult == TWOCAN_WAIT_SIGNALLED) {
+
+		ConvertFrameToByteArray(frame, canFramePtr);
+
+		// Release the lock
+		MutexUnlock(frameReceivedMutex);
+
+		// Notify the caller
+		if (EventSet(frameReceivedEvent)) {
+			// Wait for the caller to acknowledge the frame before it can be overwritten,
+			// callers that never signal frameConsumedEvent are paced by the timeout
+			EventWait(frameConsumedEvent, 10);
+		}
+		else {
+			// Non fatal error
+			DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+		}
+	}
+
+	else {
+		// Non fatal error
+		DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, PlatformGetLastError());
+	}
 }
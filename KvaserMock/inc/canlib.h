@@ -0,0 +1,127 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+// The subset of Kvaser's CANlib API implemented by the mock CANlib library on Linux.
+// Declarations and values match Kvaser's canlib.h and canstat.h, so the Kvaser driver
+// builds unchanged against either this header or Kvaser's linuxcan headers.
+
+#ifndef _CANLIB_H_
+#define _CANLIB_H_
+
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+typedef int canHandle;
+#define CanHandle int
+#define canINVALID_HANDLE (-1)
+
+#ifndef CANLIBAPI
+#define CANLIBAPI
+#endif
+
+// Status codes, from canstat.h
+typedef enum {
+	canOK = 0,
+	canERR_PARAM = -1,
+	canERR_NOMSG = -2,
+	canERR_NOTFOUND = -3,
+	canERR_NOMEM = -4,
+	canERR_NOCHANNELS = -5,
+	canERR_TIMEOUT = -7,
+	canERR_NOTINITIALIZED = -8,
+	canERR_NOHANDLES = -9,
+	canERR_INVHANDLE = -10,
+	canERR_TXBUFOFL = -13,
+	canERR_NOT_SUPPORTED = -19,
+	canERR_NOT_IMPLEMENTED = -32
+} canStatus;
+
+// Message flags
+#define canMSG_MASK 0x00ff
+#define canMSG_RTR 0x0001
+#define canMSG_STD 0x0002
+#define canMSG_EXT 0x0004
+#define canMSG_ERROR_FRAME 0x0020
+#define canMSG_TXACK 0x0040
+
+// Error flags, set on the first message received after the error
+#define canMSGERR_MASK 0xff00
+#define canMSGERR_HW_OVERRUN 0x0200
+#define canMSGERR_SW_OVERRUN 0x0400
+#define canMSGERR_STUFF 0x0800
+#define canMSGERR_FORM 0x1000
+#define canMSGERR_CRC 0x2000
+#define canMSGERR_OVERRUN 0x0600
+
+// Predefined bit rates
+#define canBITRATE_1M (-1)
+#define canBITRATE_500K (-2)
+#define canBITRATE_250K (-3)
+#define canBITRATE_125K (-4)
+
+// canAccept
+#define canFILTER_ACCEPT 1
+#define canFILTER_REJECT 2
+#define canFILTER_SET_CODE_STD 3
+#define canFILTER_SET_MASK_STD 4
+#define canFILTER_SET_CODE_EXT 5
+#define canFILTER_SET_MASK_EXT 6
+#define canFILTER_NULL_MASK 0L
+
+// canGetChannelData
+#define canCHANNELDATA_CARD_SERIAL_NO 7
+#define canCHANNELDATA_CHANNEL_NAME 13
+#define canCHANNELDATA_DRIVER_NAME 27
+
+// canIoCtl
+#define canIOCTL_SET_TIMER_SCALE 6
+#define canIOCTL_GET_RX_BUFFER_LEVEL 8
+#define canIOCTL_GET_TX_BUFFER_LEVEL 9
+#define canIOCTL_FLUSH_RX_BUFFER 10
+#define canIOCTL_FLUSH_TX_BUFFER 11
+#define canIOCTL_GET_TIMER_SCALE 12
+
+void CANLIBAPI canInitializeLibrary(void);
+CanHandle CANLIBAPI canOpenChannel(int channel, int flags);
+canStatus CANLIBAPI canClose(const CanHandle hnd);
+canStatus CANLIBAPI canBusOn(const CanHandle hnd);
+canStatus CANLIBAPI canBusOff(const CanHandle hnd);
+canStatus CANLIBAPI canResetBus(const CanHandle hnd);
+canStatus CANLIBAPI canSetBusParams(const CanHandle hnd, long freq, unsigned int tseg1, unsigned int tseg2, unsigned int sjw, unsigned int noSamp, unsigned int syncmode);
+canStatus CANLIBAPI canAccept(const CanHandle hnd, const long envelope, const unsigned int flag);
+canStatus CANLIBAPI canWrite(const CanHandle hnd, long id, void *msg, unsigned int dlc, unsigned int flag);
+canStatus CANLIBAPI canWriteSync(const CanHandle hnd, unsigned long timeout);
+canStatus CANLIBAPI canRead(const CanHandle hnd, long *id, void *msg, unsigned int *dlc, unsigned int *flag, unsigned long *time);
+canStatus CANLIBAPI canReadWait(const CanHandle hnd, long *id, void *msg, unsigned int *dlc, unsigned int *flag, unsigned long *time, unsigned long timeout);
+unsigned long CANLIBAPI canReadTimer(const CanHandle hnd);
+canStatus CANLIBAPI canIoCtl(const CanHandle hnd, unsigned int func, void *buf, unsigned int buflen);
+canStatus CANLIBAPI canGetNumberOfChannels(int *channelCount);
+canStatus CANLIBAPI canGetChannelData(int channel, int item, void *buffer, size_t bufsize);
+canStatus CANLIBAPI canGetErrorText(canStatus err, char *buf, unsigned int bufsiz);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
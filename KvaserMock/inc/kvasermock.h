@@ -0,0 +1,113 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_KVASER_MOCK
+#define _TWOCAN_KVASER_MOCK
+
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+
+// The CANlib API implemented by the mock, Kvaser's own header on Windows
+#if defined(_WIN32)
+#include "../../Kvaser/inc/canlib.h"
+#else
+#include "canlib.h"
+#endif
+
+// Environment variables used to configure the mock, read by canOpenChannel
+// Frames per second, 0 generates frames as fast as the caller reads them
+#define CONST_MOCK_RATE "KVASER_MOCK_RATE"
+// Number of frames generated at a time
+#define CONST_MOCK_BURST "KVASER_MOCK_BURST"
+// Microseconds between a frame's timestamp and the frame being available to canRead
+#define CONST_MOCK_LATENCY "KVASER_MOCK_LATENCY"
+// Number of frames the adapter can hold, further frames are overrun
+#define CONST_MOCK_QUEUE "KVASER_MOCK_QUEUE"
+// Number of frames generated after canBusOn, 0 for no limit
+#define CONST_MOCK_FRAMES "KVASER_MOCK_FRAMES"
+// An error frame follows every n frames, 0 for none
+#define CONST_MOCK_ERROR_INTERVAL "KVASER_MOCK_ERROR_INTERVAL"
+// The bus falls silent for KVASER_MOCK_SILENCE milliseconds after every n frames, so that reads time out with canERR_NOMSG
+#define CONST_MOCK_SILENCE_INTERVAL "KVASER_MOCK_SILENCE_INTERVAL"
+#define CONST_MOCK_SILENCE "KVASER_MOCK_SILENCE"
+// Microseconds taken by canWrite
+#define CONST_MOCK_WRITE_LATENCY "KVASER_MOCK_WRITE_LATENCY"
+// Log file replayed in a loop instead of the synthetic frames, any format the TwoCan parsers accept
+#define CONST_MOCK_LOG "KVASER_MOCK_LOG"
+
+// Defaults
+#define CONST_DEFAULT_RATE 1000
+#define CONST_DEFAULT_QUEUE 256
+
+// Longest the generator sleeps before checking whether it has been stopped, in microseconds
+#define CONST_GENERATOR_SLEEP 10000
+
+// Kvaser's default timer resolution, in microseconds
+#define CONST_DEFAULT_TIMER_SCALE 1000
+
+// The only handle returned by canOpenChannel, the mock emulates a single channel Leaf Light
+#define CONST_MOCK_HANDLE 0
+
+#define CONST_MOCK_DRIVER_NAME "kvmock"
+
+// Marks an error frame in the receive queue, never set on a TwoCanFrame outside the mock
+#define MOCK_FRAME_FLAG_ERROR 0x80
+
+// State of the emulated channel
+typedef struct KvaserMock {
+	volatile int isOpen;
+	volatile int isOnBus;
+	// Configuration
+	unsigned long long rate;
+	unsigned int burst;
+	unsigned long long latency;
+	unsigned long long frameLimit;
+	unsigned long long errorInterval;
+	unsigned long long silenceInterval;
+	unsigned long long silence;
+	unsigned long long writeLatency;
+	unsigned int timerScale;
+	// Frames waiting for canRead, the generator thread is the producer
+	TwoCanRing receiveQueue;
+	TwoCanEvent receiveEvent;
+	// Signalled by the read functions, paces the generator when there is no fixed rate
+	TwoCanEvent spaceEvent;
+	TwoCanEvent generatorFinishedEvent;
+	TwoCanThread generatorThread;
+	DWORD generatorThreadId;
+	TwoCanTimer timer;
+	// Frames loaded from CONST_MOCK_LOG
+	TwoCanFrame *logFrames;
+	unsigned int logCount;
+	// Frames generated since canBusOn, including overruns and filtered frames
+	unsigned long long sequence;
+	unsigned long long startTime;
+	// Extended frame acceptance filter, a frame is accepted if ((id ^ code) & mask) == 0
+	long filterCode;
+	long filterMask;
+	// Statistics
+	unsigned long long receivedFrames;
+	unsigned long long errorFrames;
+	unsigned long long transmittedFrames;
+	volatile unsigned long long overruns;
+	unsigned long long overrunsReported;
+} KvaserMock;
+
+#endif
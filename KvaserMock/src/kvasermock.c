@@ -0,0 +1,574 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: KvaserMock
+// Unit Description: Mock Kvaser CANlib library
+// Date: 16/10/2026
+// Function: Implements the CANlib functions used by the Kvaser driver without a Leaf Light adapter.
+// After canBusOn a generator thread produces synthetic NMEA 2000 frames, or replays a log file,
+// at a configurable rate, burst size and latency into a fixed size receive queue, interleaved with
+// error frames and periods of silence. Frames that arrive while the queue is full are overrun and
+// flagged with canMSGERR_HW_OVERRUN on the next frame read, as they would be by the adapter.
+// Configured with the KVASER_MOCK_xxx environment variables listed in kvasermock.h
+//
+
+#include "../inc/kvasermock.h"
+
+#include "../../Common/inc/twocanerror.h"
+#include "../../Common/inc/twocantraffic.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The emulated channel
+static KvaserMock mock;
+
+//
+// Queue a frame for the read functions, applying the acceptance filter
+// [in] frame, the frame's timestamp is its arrival time at the adapter
+//
+
+static void PublishFrame(const TwoCanFrame *frame) {
+	if (!(frame->flags & MOCK_FRAME_FLAG_ERROR) && (((frame->id ^ mock.filterCode) & mock.filterMask) != 0)) {
+		return;
+	}
+
+	if (RingWrite(&mock.receiveQueue, frame)) {
+		if (frame->flags & MOCK_FRAME_FLAG_ERROR) {
+			mock.errorFrames++;
+		}
+		else {
+			mock.receivedFrames++;
+		}
+	}
+	else {
+		mock.overruns++;
+	}
+}
+
+//
+// Generator thread, produces the frames received by the adapter
+// With a fixed rate, each burst is due at start + (first frame of the burst / rate) and is queued
+// latency microseconds later, a generator that falls behind catches up burst by burst.
+// Without a rate, frames are generated whenever the receive queue has space
+// Upon exit, returns TWOCAN_RESULT_SUCCESS as Thread Exit Code
+//
+
+static DWORD TWOCAN_THREAD_CALL GeneratorThread(void *lParam) {
+	TwoCanFrame frame;
+
+	(void)lParam;
+
+	while (mock.isOpen) {
+		if ((!mock.isOnBus) || ((mock.frameLimit > 0) && (mock.sequence >= mock.frameLimit))) {
+			ThreadSleep(CONST_GENERATOR_SLEEP / 1000);
+			continue;
+		}
+
+		unsigned long long now = GetHostTimestamp();
+		unsigned long long due = now;
+		unsigned int count = 1;
+
+		if (mock.rate > 0) {
+			due = mock.startTime + (((mock.sequence / mock.burst) * mock.burst * 1000000ULL) / mock.rate);
+			if (now < (due + mock.latency)) {
+				unsigned long long delay = (due + mock.latency) - now;
+				TimerWait(mock.timer, (delay > CONST_GENERATOR_SLEEP) ? CONST_GENERATOR_SLEEP : delay);
+				continue;
+			}
+			count = mock.burst - (unsigned int)(mock.sequence % mock.burst);
+		}
+		else if (RingIsFull(&mock.receiveQueue)) {
+			EventWait(mock.spaceEvent, CONST_GENERATOR_SLEEP / 1000);
+			continue;
+		}
+
+		for (unsigned int i = 0; i < count; i++) {
+			if ((mock.frameLimit > 0) && (mock.sequence >= mock.frameLimit)) {
+				break;
+			}
+
+			if (mock.logCount > 0) {
+				frame = mock.logFrames[mock.sequence % mock.logCount];
+			}
+			else {
+				TrafficGenerateFrame(mock.sequence, &frame);
+			}
+			frame.timestamp = due;
+			PublishFrame(&frame);
+			mock.sequence++;
+
+			// Error frames are in addition to the numbered frames
+			if ((mock.errorInterval > 0) && ((mock.sequence % mock.errorInterval) == 0)) {
+				memset(&frame, 0, sizeof(TwoCanFrame));
+				frame.flags = MOCK_FRAME_FLAG_ERROR;
+				frame.timestamp = due;
+				PublishFrame(&frame);
+			}
+
+			if ((mock.silenceInterval > 0) && ((mock.sequence % mock.silenceInterval) == 0)) {
+				break;
+			}
+		}
+
+		EventSet(mock.receiveEvent);
+
+		if ((mock.silenceInterval > 0) && (mock.silence > 0) && ((mock.sequence % mock.silenceInterval) == 0)) {
+			// Delay the rest of the schedule, so the silence does not produce a burst of late frames
+			if (mock.rate > 0) {
+				mock.startTime += mock.silence * 1000;
+			}
+			else {
+				ThreadSleep((unsigned int)mock.silence);
+			}
+		}
+	}
+
+	EventSet(mock.generatorFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+void CANLIBAPI canInitializeLibrary(void) {
+}
+
+//
+// Open the channel and start the generator, frames are generated once the channel is on bus
+// [in] channel, only channel 0 exists
+// [in] flags, ignored
+// returns the handle, or a canERR_xxx status
+//
+
+CanHandle CANLIBAPI canOpenChannel(int channel, int flags) {
+	unsigned int queueSize;
+	const char *logFile;
+
+	(void)flags;
+
+	if (channel != 0) {
+		return canERR_NOTFOUND;
+	}
+
+	if (mock.isOpen) {
+		return canERR_NOHANDLES;
+	}
+
+	memset(&mock, 0, sizeof(KvaserMock));
+
+	mock.rate = TrafficGetSetting(CONST_MOCK_RATE, CONST_DEFAULT_RATE);
+	mock.burst = (unsigned int)TrafficGetSetting(CONST_MOCK_BURST, 1);
+	mock.latency = TrafficGetSetting(CONST_MOCK_LATENCY, 0);
+	mock.frameLimit = TrafficGetSetting(CONST_MOCK_FRAMES, 0);
+	mock.errorInterval = TrafficGetSetting(CONST_MOCK_ERROR_INTERVAL, 0);
+	mock.silenceInterval = TrafficGetSetting(CONST_MOCK_SILENCE_INTERVAL, 0);
+	mock.silence = TrafficGetSetting(CONST_MOCK_SILENCE, 0);
+	mock.writeLatency = TrafficGetSetting(CONST_MOCK_WRITE_LATENCY, 0);
+	mock.timerScale = CONST_DEFAULT_TIMER_SCALE;
+	queueSize = (unsigned int)TrafficGetSetting(CONST_MOCK_QUEUE, CONST_DEFAULT_QUEUE);
+
+	if (mock.burst == 0) {
+		mock.burst = 1;
+	}
+
+	if (!RingInitialise(&mock.receiveQueue, queueSize)) {
+		DebugPrintf(L"Kvaser mock queue size must be a power of two, no larger than %d\n", CONST_RING_CAPACITY);
+		return canERR_PARAM;
+	}
+
+	logFile = getenv(CONST_MOCK_LOG);
+	if (logFile != NULL) {
+		mock.logCount = TrafficLoadLog(logFile, &mock.logFrames);
+		if (mock.logCount == 0) {
+			DebugPrintf(L"Kvaser mock unable to load %s\n", logFile);
+			return canERR_PARAM;
+		}
+	}
+
+	mock.receiveEvent = EventCreate(NULL);
+	mock.spaceEvent = EventCreate(NULL);
+	mock.generatorFinishedEvent = EventCreate(NULL);
+	mock.timer = TimerCreate();
+
+	if ((mock.receiveEvent == NULL) || (mock.spaceEvent == NULL) || (mock.generatorFinishedEvent == NULL)) {
+		DebugPrintf(L"Kvaser mock unable to create events (%d)\n", PlatformGetLastError());
+		canClose(CONST_MOCK_HANDLE);
+		return canERR_NOMEM;
+	}
+
+	mock.isOpen = TRUE;
+	mock.generatorThread = ThreadCreate(GeneratorThread, NULL, &mock.generatorThreadId);
+	if (mock.generatorThread == NULL) {
+		DebugPrintf(L"Kvaser mock unable to start the generator (%d)\n", PlatformGetLastError());
+		mock.isOpen = FALSE;
+		canClose(CONST_MOCK_HANDLE);
+		return canERR_NOMEM;
+	}
+
+	return CONST_MOCK_HANDLE;
+}
+
+//
+// Close the channel, stops the generator and reports the statistics
+// [in] hnd
+// returns canOK
+//
+
+canStatus CANLIBAPI canClose(const CanHandle hnd) {
+	if (hnd != CONST_MOCK_HANDLE) {
+		return canERR_INVHANDLE;
+	}
+
+	mock.isOnBus = FALSE;
+	if (mock.isOpen) {
+		mock.isOpen = FALSE;
+		// Wake any thread blocked in canReadWait
+		EventSet(mock.receiveEvent);
+		if (EventWait(mock.generatorFinishedEvent, 1000) != TWOCAN_WAIT_SIGNALLED) {
+			DebugPrintf(L"Kvaser mock generator did not stop\n");
+		}
+		ThreadClose(mock.generatorThread);
+	}
+
+	DebugPrintf(L"Kvaser mock received %llu frames, %llu error frames, %llu overruns, transmitted %llu frames\n",
+		mock.receivedFrames, mock.errorFrames, mock.overruns, mock.transmittedFrames);
+
+	if (mock.receiveEvent != NULL) {
+		EventClose(mock.receiveEvent);
+	}
+	if (mock.spaceEvent != NULL) {
+		EventClose(mock.spaceEvent);
+	}
+	if (mock.generatorFinishedEvent != NULL) {
+		EventClose(mock.generatorFinishedEvent);
+	}
+	TimerClose(mock.timer);
+	free(mock.logFrames);
+
+	memset(&mock, 0, sizeof(KvaserMock));
+	return canOK;
+}
+
+//
+// Go on bus, the generator starts a new sequence of frames
+// [in] hnd
+// returns canOK
+//
+
+canStatus CANLIBAPI canBusOn(const CanHandle hnd) {
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+	mock.sequence = 0;
+	mock.startTime = GetHostTimestamp();
+	mock.isOnBus = TRUE;
+	return canOK;
+}
+
+//
+// Go off bus, a thread blocked in canReadWait returns canERR_NOMSG
+// [in] hnd
+// returns canOK
+//
+
+canStatus CANLIBAPI canBusOff(const CanHandle hnd) {
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+	mock.isOnBus = FALSE;
+	EventSet(mock.receiveEvent);
+	return canOK;
+}
+
+canStatus CANLIBAPI canResetBus(const CanHandle hnd) {
+	return ((hnd == CONST_MOCK_HANDLE) && mock.isOpen) ? canOK : canERR_INVHANDLE;
+}
+
+canStatus CANLIBAPI canSetBusParams(const CanHandle hnd, long freq, unsigned int tseg1, unsigned int tseg2, unsigned int sjw, unsigned int noSamp, unsigned int syncmode) {
+	(void)tseg1;
+	(void)tseg2;
+	(void)sjw;
+	(void)noSamp;
+	(void)syncmode;
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+	return (freq == canBITRATE_250K) ? canOK : canERR_PARAM;
+}
+
+//
+// Set the extended frame acceptance code or mask, standard frame filters are accepted but have no effect
+// [in] hnd
+// [in] envelope, code or mask
+// [in] flag, canFILTER_SET_xxx
+// returns canOK
+//
+
+canStatus CANLIBAPI canAccept(const CanHandle hnd, const long envelope, const unsigned int flag) {
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+
+	switch (flag) {
+		case canFILTER_SET_CODE_EXT:
+			mock.filterCode = envelope;
+			return canOK;
+		case canFILTER_SET_MASK_EXT:
+			mock.filterMask = envelope;
+			return canOK;
+		case canFILTER_SET_CODE_STD:
+		case canFILTER_SET_MASK_STD:
+			return canOK;
+		default:
+			return canERR_PARAM;
+	}
+}
+
+//
+// Transmit a frame, takes KVASER_MOCK_WRITE_LATENCY microseconds
+// [in] hnd, [in] id, [in] msg, [in] dlc, [in] flag
+// returns canOK
+//
+
+canStatus CANLIBAPI canWrite(const CanHandle hnd, long id, void *msg, unsigned int dlc, unsigned int flag) {
+	(void)id;
+	(void)flag;
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+
+	if ((dlc > CONST_PAYLOAD_LENGTH) || ((msg == NULL) && (dlc > 0))) {
+		return canERR_PARAM;
+	}
+
+	if (mock.writeLatency > 0) {
+		TimerWait(mock.timer, mock.writeLatency);
+	}
+
+	mock.transmittedFrames++;
+	return canOK;
+}
+
+canStatus CANLIBAPI canWriteSync(const CanHandle hnd, unsigned long timeout) {
+	(void)timeout;
+	return ((hnd == CONST_MOCK_HANDLE) && mock.isOpen) ? canOK : canERR_INVHANDLE;
+}
+
+//
+// Remove the oldest frame from the receive queue
+// [in] hnd
+// [out] id, msg, dlc, flag and time, in units of the timer scale
+// returns canOK, or canERR_NOMSG if no frame is queued
+//
+
+canStatus CANLIBAPI canRead(const CanHandle hnd, long *id, void *msg, unsigned int *dlc, unsigned int *flag, unsigned long *time) {
+	TwoCanFrame frame;
+	unsigned int flags;
+
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+
+	if (!RingRead(&mock.receiveQueue, &frame)) {
+		return canERR_NOMSG;
+	}
+
+	if (mock.rate == 0) {
+		EventSet(mock.spaceEvent);
+	}
+
+	if (frame.flags & MOCK_FRAME_FLAG_ERROR) {
+		flags = canMSG_ERROR_FRAME;
+	}
+	else {
+		flags = (frame.flags & TWOCAN_FRAME_FLAG_EXTENDED) ? canMSG_EXT : canMSG_STD;
+		if (frame.flags & TWOCAN_FRAME_FLAG_REMOTE) {
+			flags |= canMSG_RTR;
+		}
+	}
+
+	// Report frames lost since the previous read
+	if (mock.overrunsReported != mock.overruns) {
+		mock.overrunsReported = mock.overruns;
+		flags |= canMSGERR_HW_OVERRUN;
+	}
+
+	if (id != NULL) {
+		*id = (long)frame.id;
+	}
+	if (msg != NULL) {
+		memcpy(msg, frame.data, frame.dlc);
+	}
+	if (dlc != NULL) {
+		*dlc = frame.dlc;
+	}
+	if (flag != NULL) {
+		*flag = flags;
+	}
+	if (time != NULL) {
+		// The adapter's free running 32 bit counter
+		*time = (unsigned int)(frame.timestamp / mock.timerScale);
+	}
+	return canOK;
+}
+
+//
+// Wait up to timeout milliseconds for a frame
+// [in] hnd
+// [out] id, msg, dlc, flag and time
+// [in] timeout, milliseconds
+// returns canOK, or canERR_NOMSG if no frame arrived or the channel went off bus
+//
+
+canStatus CANLIBAPI canReadWait(const CanHandle hnd, long *id, void *msg, unsigned int *dlc, unsigned int *flag, unsigned long *time, unsigned long timeout) {
+	canStatus result;
+
+	result = canRead(hnd, id, msg, dlc, flag, time);
+	if ((result != canERR_NOMSG) || (!mock.isOnBus)) {
+		return result;
+	}
+
+	EventWait(mock.receiveEvent, (unsigned int)timeout);
+
+	if (!mock.isOpen) {
+		return canERR_NOMSG;
+	}
+	return canRead(hnd, id, msg, dlc, flag, time);
+}
+
+unsigned long CANLIBAPI canReadTimer(const CanHandle hnd) {
+	(void)hnd;
+	return (unsigned int)(GetHostTimestamp() / mock.timerScale);
+}
+
+//
+// Input/output control
+// [in] hnd
+// [in] func, canIOCTL_xxx
+// [in,out] buf, buflen
+// returns canOK, or canERR_NOT_IMPLEMENTED for functions the mock does not support
+//
+
+canStatus CANLIBAPI canIoCtl(const CanHandle hnd, unsigned int func, void *buf, unsigned int buflen) {
+	TwoCanFrame frame;
+
+	if ((hnd != CONST_MOCK_HANDLE) || (!mock.isOpen)) {
+		return canERR_INVHANDLE;
+	}
+
+	switch (func) {
+		case canIOCTL_SET_TIMER_SCALE:
+			if ((buf == NULL) || (buflen < sizeof(unsigned int)) || (*(unsigned int *)buf == 0)) {
+				return canERR_PARAM;
+			}
+			mock.timerScale = *(unsigned int *)buf;
+			return canOK;
+		case canIOCTL_GET_TIMER_SCALE:
+			if ((buf == NULL) || (buflen < sizeof(unsigned int))) {
+				return canERR_PARAM;
+			}
+			*(unsigned int *)buf = mock.timerScale;
+			return canOK;
+		case canIOCTL_GET_RX_BUFFER_LEVEL:
+			if ((buf == NULL) || (buflen < sizeof(unsigned int))) {
+				return canERR_PARAM;
+			}
+			*(unsigned int *)buf = RingCount(&mock.receiveQueue);
+			return canOK;
+		case canIOCTL_GET_TX_BUFFER_LEVEL:
+			if ((buf == NULL) || (buflen < sizeof(unsigned int))) {
+				return canERR_PARAM;
+			}
+			*(unsigned int *)buf = 0;
+			return canOK;
+		case canIOCTL_FLUSH_RX_BUFFER:
+			while (RingRead(&mock.receiveQueue, &frame)) {
+			}
+			return canOK;
+		case canIOCTL_FLUSH_TX_BUFFER:
+			return canOK;
+		default:
+			return canERR_NOT_IMPLEMENTED;
+	}
+}
+
+canStatus CANLIBAPI canGetNumberOfChannels(int *channelCount) {
+	if (channelCount == NULL) {
+		return canERR_PARAM;
+	}
+	*channelCount = 1;
+	return canOK;
+}
+
+//
+// Channel information
+// [in] channel, only channel 0 exists
+// [in] item, canCHANNELDATA_xxx
+// [out] buffer, bufsize
+// returns canOK, or canERR_NOT_IMPLEMENTED for items the mock does not support
+//
+
+canStatus CANLIBAPI canGetChannelData(int channel, int item, void *buffer, size_t bufsize) {
+	if (channel != 0) {
+		return canERR_NOTFOUND;
+	}
+
+	if ((buffer == NULL) || (bufsize == 0)) {
+		return canERR_PARAM;
+	}
+
+	switch (item) {
+		case canCHANNELDATA_DRIVER_NAME:
+			snprintf((char *)buffer, bufsize, "%s", CONST_MOCK_DRIVER_NAME);
+			return canOK;
+		case canCHANNELDATA_CHANNEL_NAME:
+			snprintf((char *)buffer, bufsize, "%s", "Kvaser Leaf Light v2 (mock) (channel 0)");
+			return canOK;
+		case canCHANNELDATA_CARD_SERIAL_NO:
+			memset(buffer, 0, bufsize);
+			return canOK;
+		default:
+			return canERR_NOT_IMPLEMENTED;
+	}
+}
+
+canStatus CANLIBAPI canGetErrorText(canStatus err, char *buf, unsigned int bufsiz) {
+	if ((buf == NULL) || (bufsiz == 0)) {
+		return canERR_PARAM;
+	}
+
+	switch (err) {
+		case canOK:
+			snprintf(buf, bufsiz, "No error");
+			break;
+		case canERR_NOMSG:
+			snprintf(buf, bufsiz, "No messages available");
+			break;
+		case canERR_INVHANDLE:
+			snprintf(buf, bufsiz, "Handle is invalid");
+			break;
+		default:
+			snprintf(buf, bufsiz, "Error %d", err);
+			break;
+	}
+	return canOK;
+}
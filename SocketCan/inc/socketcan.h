@@ -0,0 +1,72 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+
+#ifndef _TWOCAN_SOCKETCAN
+#define _TWOCAN_SOCKETCAN
+
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanfilter.h"
+
+// Linux SocketCAN
+#include <sys/socket.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <linux/net_tstamp.h>
+
+// 'C' runtime functions
+#include <stdio.h>
+
+// Default CAN interface, may be changed with SetAdapterInterface before OpenAdapter
+#define CONST_INTERFACE_NAME "can0"
+
+// Maximum number of frames retrieved by a single recvmmsg call
+#define CONST_RECEIVE_BATCH 64
+
+// Receive timeout (milliseconds), so the read thread notices when it is stopped
+#define CONST_RECEIVE_TIMEOUT 100
+
+// Percentage of the socket's receive buffer in use at which the read thread stops waiting for the caller to drain
+// a full ring and discards frames instead, so that the kernel does not drop them
+#define CONST_RECEIVE_QUEUE_LIMIT 75
+
+#define DllExport TWOCAN_EXPORT
+
+DllExport char *DriverName(void);
+DllExport char *DriverVersion(void);
+DllExport char *ManufacturerName(void);
+DllExport int OpenAdapter(void);
+DllExport int CloseAdapter(void);
+DllExport int ReadAdapter(byte *frame);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
+DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data);
+DllExport int SetAdapterInterface(const char *interfaceName);
+DllExport int OpenAdapterSocket(int socketDescriptor);
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count);
+DllExport int SubscribePgn(unsigned int pgn, int source);
+DllExport int UnsubscribePgn(unsigned int pgn, int source);
+
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrames(const TwoCanFrame *frames, const int count);
+void PostFrame(const TwoCanFrame *frame);
+int ReceiveQueueFilling(void);
+
+#endif
@@ -0,0 +1,775 @@
+// Copyright(C) 2018 by Steven Adler
+//
+// This file is part of TwoCan, a plugin for OpenCPN.
+//
+// TwoCan is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TwoCan is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TwoCan. If not, see <https://www.gnu.org/licenses/>.
+//
+// NMEA2000® is a registered Trademark of the National Marine Electronics Association
+
+//
+// Project: TwoCan
+// Project Description: NMEA2000 Plugin for OpenCPN
+// Unit: Driver for Linux SocketCAN interfaces
+// Unit Description: Access any SocketCAN interface (can0, vcan0, slcan0 etc.) via a raw CAN socket
+// Date: 16/10/2026
+// Function: Frames are retrieved in batches with recvmmsg, stamped with the kernel's receive time,
+// converted into TwoCan format and the application is signalled once per batch.
+// Only extended data frames pass the kernel's CAN_RAW_FILTER, so the read thread never wakes for others.
+//
+
+#include "../inc/socketcan.h"
+
+#include "../../Common/inc/twocanerror.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <linux/sock_diag.h>
+
+// Control message delivered with SO_TIMESTAMPING, software timestamp in ts[0], raw hardware timestamp in ts[2]
+typedef struct ScmTimestamping {
+	struct timespec ts[3];
+} ScmTimestamping;
+
+// Separate thread to read data from the CAN socket
+TwoCanThread threadHandle;
+
+// The thread id.
+DWORD threadId;
+
+// Event signalled when valid CAN Frame is received
+TwoCanEvent frameReceivedEvent;
+
+// Signal that the thread has terminated
+TwoCanEvent threadFinishedEvent;
+
+// Event signalled by the caller once it has consumed the received frames
+TwoCanEvent frameConsumedEvent;
+
+// Mutex used to synchronize access to the CAN Frame buffer
+TwoCanMutex frameReceivedMutex;
+
+// Pointer to the caller's CAN Frame buffer
+byte *canFramePtr;
+
+// Pointer to the caller's ring buffer, used instead of canFramePtr when started by ReadAdapterEx
+TwoCanRing *canRingPtr = NULL;
+
+// Ring buffer owned by the driver, used when started by ReadAdapterBatch
+TwoCanRing batchRing;
+
+// Variable to indicate thread state
+BOOL isRunning = FALSE;
+
+// Set once the read thread has been started, until CloseAdapter, isRunning is also cleared if the thread fails
+BOOL isStarted = FALSE;
+
+// SocketCAN variables
+int canSocket = -1;
+char interfaceName[IFNAMSIZ] = CONST_INTERFACE_NAME;
+
+// PGN and source address filters, loaded into the socket's CAN_RAW_FILTER list
+TwoCanFilterTable acceptanceFilters;
+
+//
+// Drivername,
+// returns the name of this driver
+//
+
+DllExport char *DriverName(void)	{
+	return (char *)L"Linux SocketCAN";
+}
+
+//
+// Version
+// return an arbitary version number for this driver
+//
+
+DllExport char *DriverVersion(void)	{
+	return (char *)L"1.0";
+}
+
+//
+// Manufacturer
+// return the name of this driver's hardware manufacturer
+//
+
+DllExport char *ManufacturerName(void)	{
+	return (char *)L"TwoCan";
+}
+
+//
+// Select the CAN interface opened by OpenAdapter
+// [in] interfaceName, eg. can0 or vcan0
+// returns TWOCAN_RESULT_SUCCESS if the name is valid
+//
+
+DllExport int SetAdapterInterface(const char *name)	{
+	if ((name == NULL) || (*name == '\0') || (strlen(name) >= IFNAMSIZ)) {
+		DebugPrintf(L"Invalid interface name\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_ADAPTER_NOT_FOUND);
+	}
+	strcpy(interfaceName, name);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Create the events and open the mutex used to notify the caller
+// returns TWOCAN_RESULT_SUCCESS if events and mutexes created correctly
+//
+
+static int OpenEvents(void)	{
+	// The events and mutex are created by the first OpenAdapter and kept for the life of the driver, see CloseAdapter
+	// Create an event that is used to notify the caller of a received frame
+	if (frameReceivedEvent == NULL) {
+		frameReceivedEvent = EventCreate(CONST_DATARX_EVENT);
+	}
+
+	if (frameReceivedEvent == NULL)
+	{
+		// Fatal Error
+		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_EVENT);
+	}
+
+	// Create an event that is used to notify the close method that the thread has ended
+	if (threadFinishedEvent == NULL) {
+		threadFinishedEvent = EventCreate(CONST_EVENT_THREAD_ENDED);
+	}
+
+	if (threadFinishedEvent == NULL)
+	{
+		// Fatal Error
+		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_COMPLETE_EVENT);
+	}
+
+	// Create an event that the caller signals once it has consumed the received frames
+	if (frameConsumedEvent == NULL) {
+		frameConsumedEvent = EventCreate(CONST_DATACONSUMED_EVENT);
+	}
+
+	if (frameConsumedEvent == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Create FrameConsumed Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT);
+	}
+
+	// Open the mutex that is used to synchronize access to the Can Frame buffer
+	if (frameReceivedMutex == NULL) {
+		frameReceivedMutex = MutexOpen(CONST_MUTEX_NAME);
+	}
+
+	if (frameReceivedMutex == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Open Mutex failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_MUTEX);
+	}
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Configure the receive timeout and kernel timestamps of the open socket
+// returns TWOCAN_RESULT_SUCCESS if the receive timeout was set
+//
+
+static int ConfigureSocket(void)	{
+	struct timeval timeout;
+	int timestampFlags;
+	int bufferSize;
+
+	// The read thread must wake periodically to notice that it has been stopped
+	timeout.tv_sec = 0;
+	timeout.tv_usec = CONST_RECEIVE_TIMEOUT * 1000;
+	if (setsockopt(canSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+		// Fatal error
+		DebugPrintf(L"Set receive timeout failed (%d)\n", errno);
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_FLAGS);
+	}
+
+	// Ask the kernel to stamp each frame as it is received rather than when the read thread gets to it
+	timestampFlags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+	if (setsockopt(canSocket, SOL_SOCKET, SO_TIMESTAMPING, &timestampFlags, sizeof(timestampFlags)) < 0) {
+		// Non fatal error, frames are stamped with the host time they were read
+		DebugPrintf(L"Set kernel timestamps failed (%d)\n", errno);
+	}
+
+	// Room for bursts while the caller is busy, the kernel doubles the requested size
+	bufferSize = CONST_RECEIVE_BATCH * 1024;
+	if (setsockopt(canSocket, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize)) < 0) {
+		// Non fatal error
+		DebugPrintf(L"Set receive buffer failed (%d)\n", errno);
+	}
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Load the active PGN filters into the socket's filter list, the kernel then discards every other frame.
+// NMEA 2000 only uses extended data frames, so standard and remote frames are always dropped.
+// Error frames are already excluded as CAN_RAW_ERR_FILTER defaults to none
+//
+
+static void ApplyAcceptanceFilters(void)	{
+	struct can_filter filters[CONST_MAX_FILTERS];
+	unsigned int codes[CONST_MAX_FILTERS];
+	unsigned int masks[CONST_MAX_FILTERS];
+	unsigned int count = FilterTableCodes(&acceptanceFilters, codes, masks);
+
+	if (count == 0) {
+		filters[0].can_id = CAN_EFF_FLAG;
+		filters[0].can_mask = CAN_EFF_FLAG | CAN_RTR_FLAG;
+		count = 1;
+	}
+	else {
+		for (unsigned int i = 0; i < count; i++) {
+			filters[i].can_id = codes[i] | CAN_EFF_FLAG;
+			filters[i].can_mask = masks[i] | CAN_EFF_FLAG | CAN_RTR_FLAG;
+		}
+	}
+
+	if (setsockopt(canSocket, SOL_CAN_RAW, CAN_RAW_FILTER, filters, count * sizeof(struct can_filter)) < 0) {
+		// Non fatal error, the read thread also discards them
+		DebugPrintf(L"Set CAN filter failed (%d)\n", errno);
+	}
+}
+
+//
+// Filter, accept only the listed PGNs, may be called before or after OpenAdapter
+// [in] filters, pointer to array of PGN and source address filters
+// [in] count, number of filters, zero accepts every extended data frame
+// returns TWOCAN_RESULT_SUCCESS if the filters are valid
+//
+
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count)	{
+	if (!FilterTableUpdate(&acceptanceFilters, filters, count)) {
+		DebugPrintf(L"Invalid acceptance filters\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (canSocket >= 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Subscribe, add a PGN to the acceptance filters, may be called before or after OpenAdapter
+// Frames of other PGNs are discarded by the read thread once any filter is set
+// [in] pgn, as for TwoCanFilter
+// [in] source, source address or CONST_FILTER_ANY_SOURCE
+// returns TWOCAN_RESULT_SUCCESS if the PGN is now accepted
+//
+
+DllExport int SubscribePgn(unsigned int pgn, int source)	{
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableSubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"Invalid subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (canSocket >= 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Unsubscribe, remove a PGN added with SubscribePgn or SetAcceptanceFilters
+// Removing the last PGN leaves no filters, so every frame is accepted again
+// [in] pgn, source, as given when the PGN was added
+// returns TWOCAN_RESULT_SUCCESS if the PGN was removed
+//
+
+DllExport int UnsubscribePgn(unsigned int pgn, int source)	{
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableUnsubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"No subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (canSocket >= 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Open. Connect to the CAN interface and get ready to start reading
+// returns TWOCAN_RESULT_SUCCESS if events, mutexes and the CAN socket configured correctly
+//
+
+DllExport int OpenAdapter(void)	{
+	struct ifreq interfaceRequest;
+	struct sockaddr_can address;
+	int result;
+
+	result = OpenEvents();
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		return result;
+	}
+
+	canSocket = socket(PF_CAN, SOCK_RAW | SOCK_CLOEXEC, CAN_RAW);
+	if (canSocket < 0) {
+		// Fatal Error
+		DebugPrintf(L"Create CAN socket failed (%d)\n", errno);
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_CREATE);
+	}
+
+	memset(&interfaceRequest, 0, sizeof(interfaceRequest));
+	strcpy(interfaceRequest.ifr_name, interfaceName);
+	if (ioctl(canSocket, SIOCGIFINDEX, &interfaceRequest) < 0) {
+		// Fatal Error
+		DebugPrintf(L"CAN interface %s not found (%d)\n", interfaceName, errno);
+		close(canSocket);
+		canSocket = -1;
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_IOCTL);
+	}
+
+	ApplyAcceptanceFilters();
+
+	result = ConfigureSocket();
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		close(canSocket);
+		canSocket = -1;
+		return result;
+	}
+
+	memset(&address, 0, sizeof(address));
+	address.can_family = AF_CAN;
+	address.can_ifindex = interfaceRequest.ifr_ifindex;
+	if (bind(canSocket, (struct sockaddr *)&address, sizeof(address)) < 0) {
+		// Fatal Error
+		DebugPrintf(L"Bind CAN socket failed (%d)\n", errno);
+		close(canSocket);
+		canSocket = -1;
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_BIND);
+	}
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Open using a socket supplied by the caller instead of a CAN interface,
+// eg. one end of a socketpair carrying struct can_frame datagrams. The driver closes the socket in CloseAdapter
+// [in] socketDescriptor, connected datagram or sequenced packet socket
+// returns TWOCAN_RESULT_SUCCESS if events, mutexes and the socket configured correctly
+//
+
+DllExport int OpenAdapterSocket(int socketDescriptor)	{
+	int result;
+
+	if (socketDescriptor < 0) {
+		DebugPrintf(L"Invalid socket\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_CREATE);
+	}
+
+	result = OpenEvents();
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		return result;
+	}
+
+	canSocket = socketDescriptor;
+	return ConfigureSocket();
+}
+
+//
+// Close, Stop reading & disconnect
+// returns TWOCAN_RESULT_SUCCESS if reading thread terminated successfully
+//
+
+DllExport int CloseAdapter(void)	{
+	// Terminate the read thread
+	isRunning = FALSE;
+	isStarted = FALSE;
+
+	// Wait for the thread to exit, if it was started
+	int waitResult = TWOCAN_WAIT_SIGNALLED;
+	if (threadHandle != NULL) {
+		waitResult = EventWait(threadFinishedEvent, 1000);
+		if (waitResult == TWOCAN_WAIT_TIMEOUT) {
+			DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		}
+		if (waitResult == TWOCAN_WAIT_FAILED) {
+			DebugPrintf(L"Wait for threadFinishedEvent Error: %d", PlatformGetLastError());
+		}
+
+		// Release the handle, a thread that has not exited keeps running until it returns
+		int closeResult;
+		closeResult = ThreadClose(threadHandle);
+		if (closeResult == 0) {
+			DebugPrintf(L"Close threadHandle Error: %d", PlatformGetLastError());
+		}
+		threadHandle = NULL;
+	}
+
+	// The events and mutex are kept for the life of the driver rather than closed, a read thread that has
+	// not exited or a caller still waiting in ReadAdapterBatch may be using them
+
+	// A read thread that has not exited may still be reading from the adapter, so it is left open
+	if (waitResult != TWOCAN_WAIT_SIGNALLED) {
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_DELETE_THREAD_HANDLE);
+	}
+
+	// Close the CAN socket
+	if (canSocket >= 0) {
+		close(canSocket);
+		canSocket = -1;
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Read, starts the read thread
+// [in] frame, pointer to byte array for the CAN Frame buffer
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
+//
+
+DllExport int ReadAdapter(byte *frame)	{
+
+	// Save the pointer to the Can Frame buffer
+	canFramePtr = frame;
+	canRingPtr = NULL;
+
+	// Indicate thread is in running state
+	isRunning = TRUE;
+
+	// Start the read thread
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
+
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		return TWOCAN_RESULT_SUCCESS;
+	}
+	// Fatal Error
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
+}
+
+//
+// ReadEx, starts the read thread, received frames are queued in the caller's ring buffer
+// [in] ring, pointer to a ring buffer initialised with RingInitialise
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
+//
+
+DllExport int ReadAdapterEx(TwoCanRing *ring)	{
+
+	if (!RingIsValid(ring)) {
+		DebugPrintf(L"Invalid ring buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_RING);
+	}
+
+	// Save the pointer to the ring buffer
+	canRingPtr = ring;
+	canFramePtr = NULL;
+
+	// Indicate thread is in running state
+	isRunning = TRUE;
+
+	// Start the read thread
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
+
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		return TWOCAN_RESULT_SUCCESS;
+	}
+	// Fatal Error
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
+}
+
+//
+// ReadBatch, retrieves the frames received since the last call, starting the read thread on the first call
+// [out] frames, pointer to caller's array of CAN Frames
+// [in] capacity, number of frames the array can hold
+// [out] count, number of frames retrieved
+// [in] timeoutMs, milliseconds to wait if no frames are waiting
+// Returns TWOCAN_RESULT_SUCCESS, count is zero if the wait timed out
+//
+
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs)	{
+	int result;
+
+	if ((frames == NULL) || (count == NULL) || (capacity <= 0)) {
+		DebugPrintf(L"Invalid frame buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+
+	*count = 0;
+
+	if (!isStarted) {
+		RingInitialise(&batchRing, CONST_RING_CAPACITY);
+		result = ReadAdapterEx(&batchRing);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			return result;
+		}
+	}
+	else if (canRingPtr != &batchRing) {
+		// Already started by ReadAdapter or ReadAdapterEx
+		DebugPrintf(L"Read thread already running\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_READ_FUNCTION);
+	}
+	else if ((!isRunning) && (RingCount(&batchRing) == 0)) {
+		// The read thread ended after a fatal error, once its last frames have been returned. It is not restarted
+		DebugPrintf(L"Read thread has stopped\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_RECEIVE_FAILURE);
+	}
+
+	if (RingCount(&batchRing) == 0) {
+		EventWait(frameReceivedEvent, timeoutMs);
+	}
+
+	*count = RingReadBatch(&batchRing, frames, capacity);
+
+	// Let the read thread know there is space in the ring
+	EventSet(frameConsumedEvent);
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Write, Transmit a frame onto the NMEA 2000 network
+// [in] id, 29 bit CAN id
+// [in] dataLength, number of data bytes, 0 - 8
+// [in] data, pointer to the data bytes
+// Returns TWOCAN_RESULT_SUCCESS if the frame was queued by the kernel
+//
+
+DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data) {
+	struct can_frame canFrame;
+
+	if ((dataLength < 0) || (dataLength > CONST_PAYLOAD_LENGTH) || ((data == NULL) && (dataLength > 0))) {
+		DebugPrintf(L"Invalid frame length: %d\n", dataLength);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_TRANSMIT_FAILURE);
+	}
+
+	memset(&canFrame, 0, sizeof(canFrame));
+	canFrame.can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	canFrame.can_dlc = (byte)dataLength;
+	if (dataLength > 0) {
+		memcpy(canFrame.data, data, dataLength);
+	}
+
+	if (write(canSocket, &canFrame, sizeof(canFrame)) == sizeof(canFrame)) {
+		return TWOCAN_RESULT_SUCCESS;
+	}
+
+	DebugPrintf(L"Transmit frame failed: %d\n", errno);
+	return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_TRANSMIT_FAILURE);
+}
+
+//
+// Retrieve the kernel's receive timestamp from a message's control data
+// [in] message, message returned by recvmmsg
+// [in] hostTime, GetHostTimestamp value taken after recvmmsg returned
+// [in] realtimeOffset, realtime clock - host clock in microseconds, taken at the same time as hostTime
+// returns the receive time in the host clock's time base, hostTime if the kernel did not stamp the frame
+//
+
+static unsigned long long GetKernelTimestamp(struct msghdr *message, const unsigned long long hostTime, const long long realtimeOffset) {
+	struct cmsghdr *controlMessage;
+	const ScmTimestamping *timestamps;
+	long long kernelTime;
+
+	for (controlMessage = CMSG_FIRSTHDR(message); controlMessage != NULL; controlMessage = CMSG_NXTHDR(message, controlMessage)) {
+		if ((controlMessage->cmsg_level == SOL_SOCKET) && (controlMessage->cmsg_type == SO_TIMESTAMPING)) {
+			timestamps = (const ScmTimestamping *)CMSG_DATA(controlMessage);
+			if ((timestamps->ts[0].tv_sec == 0) && (timestamps->ts[0].tv_nsec == 0)) {
+				break;
+			}
+			// Software timestamps are taken from the realtime clock
+			kernelTime = ((long long)timestamps->ts[0].tv_sec * 1000000) + (timestamps->ts[0].tv_nsec / 1000) - realtimeOffset;
+			if ((kernelTime < 0) || ((unsigned long long)kernelTime > hostTime)) {
+				break;
+			}
+			return (unsigned long long)kernelTime;
+		}
+	}
+	return hostTime;
+}
+
+//
+// Read Thread, retrieves batches of frames from the CAN socket
+// If a valid frame is received, convert it to a TwoCanFrame and notify the caller
+//
+
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam)
+{
+	// Frames are received straight into canFrames, one recvmmsg call fills as many as are waiting
+	struct can_frame canFrames[CONST_RECEIVE_BATCH];
+	struct iovec vectors[CONST_RECEIVE_BATCH];
+	struct mmsghdr messages[CONST_RECEIVE_BATCH];
+	byte control[CONST_RECEIVE_BATCH][CMSG_SPACE(sizeof(ScmTimestamping))];
+	TwoCanFrame frames[CONST_RECEIVE_BATCH];
+	struct timespec realtime;
+	unsigned long long hostTime;
+	long long realtimeOffset;
+	int received;
+	int count;
+
+	memset(messages, 0, sizeof(messages));
+	for (int i = 0; i < CONST_RECEIVE_BATCH; i++) {
+		vectors[i].iov_base = &canFrames[i];
+		vectors[i].iov_len = sizeof(struct can_frame);
+		messages[i].msg_hdr.msg_iov = &vectors[i];
+		messages[i].msg_hdr.msg_iovlen = 1;
+		messages[i].msg_hdr.msg_control = control[i];
+	}
+
+	while (isRunning) {
+		// recvmmsg overwrites the control lengths with the length actually used
+		for (int i = 0; i < CONST_RECEIVE_BATCH; i++) {
+			messages[i].msg_hdr.msg_controllen = sizeof(control[i]);
+		}
+
+		// Block until a frame arrives (or the receive timeout), then take all the frames already queued without blocking again
+		received = recvmmsg(canSocket, messages, CONST_RECEIVE_BATCH, MSG_WAITFORONE, NULL);
+
+		if (received < 0) {
+			if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) {
+				continue;
+			}
+			// Fatal Error, eg. the interface has gone down
+			DebugPrintf(L"Receive Error: %d\n", errno);
+			isRunning = FALSE;
+			EventSet(threadFinishedEvent);
+			ThreadExit(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SOCKET_READ));
+		}
+
+		hostTime = GetHostTimestamp();
+		clock_gettime(CLOCK_REALTIME, &realtime);
+		realtimeOffset = ((long long)realtime.tv_sec * 1000000) + (realtime.tv_nsec / 1000) - (long long)hostTime;
+
+		count = 0;
+		for (int i = 0; i < received; i++) {
+			const struct can_frame *canFrame = &canFrames[i];
+
+			// Only interested in CAN 2.0 extended data frames, a socketpair stand-in is not filtered by the kernel
+			if ((messages[i].msg_len != sizeof(struct can_frame)) || (!(canFrame->can_id & CAN_EFF_FLAG)) ||
+				(canFrame->can_id & (CAN_RTR_FLAG | CAN_ERR_FLAG)) || (!FilterTableMatch(&acceptanceFilters, canFrame->can_id & CAN_EFF_MASK))) {
+				continue;
+			}
+
+			frames[count].timestamp = GetKernelTimestamp(&messages[i].msg_hdr, hostTime, realtimeOffset);
+			frames[count].id = canFrame->can_id & CAN_EFF_MASK;
+			frames[count].dlc = (canFrame->can_dlc > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : canFrame->can_dlc;
+			frames[count].flags = TWOCAN_FRAME_FLAG_EXTENDED;
+
+			// Copy the CAN data
+			memset(frames[count].data, 0, CONST_PAYLOAD_LENGTH);
+			memcpy(frames[count].data, canFrame->data, frames[count].dlc);
+			count++;
+		}
+
+		if (count > 0) {
+			PostFrames(frames, count);
+		}
+
+	} // end while
+
+	EventSet(threadFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+//
+// Pass a batch of received frames to the caller, via the ring buffer if started by ReadAdapterEx or ReadAdapterBatch,
+// otherwise one at a time via the caller's CAN Frame buffer
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+//
+
+void PostFrames(const TwoCanFrame *frames, const int count) {
+	int queued = 0;
+
+	if (canRingPtr == NULL) {
+		for (int i = 0; i < count; i++) {
+			PostFrame(&frames[i]);
+		}
+		return;
+	}
+
+	// Back pressure, wait for the caller to drain the ring while the kernel buffers incoming frames.
+	// Frames are only discarded, and counted as overflows, once the socket's receive buffer is in danger of dropping them itself
+	while ((isRunning) && ((canRingPtr->capacity - RingCount(canRingPtr)) < (unsigned int)count) && (!ReceiveQueueFilling())) {
+		EventWait(frameConsumedEvent, CONST_BACK_PRESSURE_WAIT);
+	}
+
+	// No lock required, the read thread is the only writer
+	for (int i = 0; i < count; i++) {
+		queued += RingWrite(canRingPtr, &frames[i]);
+	}
+
+	// A single notification for the whole batch
+	if ((queued > 0) && (!EventSet(frameReceivedEvent))) {
+		// Non fatal error
+		DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+	}
+}
+
+//
+// Whether the socket's receive buffer is close to full, so the read thread must stop waiting for the caller
+// returns non zero if CONST_RECEIVE_QUEUE_LIMIT percent or more of the buffer is in use
+//
+
+int ReceiveQueueFilling(void) {
+	unsigned int memoryInfo[SK_MEMINFO_VARS];
+	socklen_t length = sizeof(memoryInfo);
+
+	if (getsockopt(canSocket, SOL_SOCKET, SO_MEMINFO, memoryInfo, &length) < 0) {
+		return FALSE;
+	}
+	return ((memoryInfo[SK_MEMINFO_RMEM_ALLOC] * 100ULL) >= ((unsigned long long)memoryInfo[SK_MEMINFO_RCVBUF] * CONST_RECEIVE_QUEUE_LIMIT));
+}
+
+//
+// Pass a single frame to the caller's CAN Frame buffer, as used by ReadAdapter
+// [in] frame, pointer to CAN Frame
+//
+
+void PostFrame(const TwoCanFrame *frame) {
+	int mutexResult;
+
+	// Make sure we can get a lock on the buffer
+	mutexResult = MutexLock(frameReceivedMutex, 200);
+
+	if (mutexResult == TWOCAN_WAIT_SIGNALLED) {
+
+		ConvertFrameToByteArray(frame, canFramePtr);
+
+		// Release the lock
+		MutexUnlock(frameReceivedMutex);
+
+		// Notify the caller
+		if (EventSet(frameReceivedEvent)) {
+			// Wait for the caller to acknowledge the frame before it can be overwritten,
+			// callers that never signal frameConsumedEvent are paced by the timeout
+			EventWait(frameConsumedEvent, 10);
+		}
+		else {
+			// Non fatal error
+			DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+		}
+	}
+
+	else {
+		// Non fatal error
+		DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, PlatformGetLastError());
+	}
+}
@@ -123,7 +123,7 @@ int CanalGetDeviceId(long handle, unsigned long *deviceid);
 #ifdef WIN32
 int WINAPI EXPORT CanalGetVendor(long handle, unsigned int size, char *vendor);
 #else
-int CanalGetVendor(long handle, unsigned long *bootloader_version);
+int CanalGetVendor(long handle, unsigned int size, char *vendor);
 #endif
 
 #ifdef WIN32
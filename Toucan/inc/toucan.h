@@ -22,20 +22,29 @@
 #ifndef _TWOCAN_TOUCAN
 #define _TWOCAN_TOUCAN
 
-#include "..\..\common\inc\twocandriver.h"
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanclock.h"
+#include "../../Common/inc/twocanfilter.h"
+#include "../../Common/inc/twocantransmit.h"
+#include "../../Common/inc/twocanfastpacket.h"
+#include "../../Common/inc/twocantransport.h"
 
 // Required for CAN Abstraction Library (CANAL) libraries
 #include "canal.h"
 #include "canal_a.h"
 
-// Win32 functions
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
-
 // 'C' runtime functions
 #include <stdio.h>
 
-#define DllExport __declspec( dllexport )
+// Default CANAL device serial number on Linux, where only the mock CANAL library is available
+#define CONST_SERIAL_NUMBER "00000000"
+
+// Frames waiting in the CANAL receive queue at which the read thread stops waiting for the caller to drain
+// a full ring and discards frames instead, so that the adapter does not overrun
+#define CONST_RECEIVE_QUEUE_LIMIT 192
+
+#define DllExport TWOCAN_EXPORT
 
 DllExport char *DriverName(void);
 DllExport char *DriverVersion(void);
@@ -43,9 +52,30 @@ DllExport char *ManufacturerName(void);
 DllExport int OpenAdapter(void);
 DllExport int CloseAdapter(void);
 DllExport int ReadAdapter(byte *frame);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
 DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data);
+DllExport int WriteAdapterEx(const TwoCanFrame *frames, int count);
+DllExport int SetTransmitCallback(TwoCanTransmitCallback callback, void *context);
+DllExport int GetTransmitStatistics(TwoCanTransmitStatistics *statistics);
+DllExport int SetFastPacketCallback(TwoCanFastPacketCallback callback, void *context);
+DllExport int GetFastPacketStatistics(TwoCanFastPacketStatistics *statistics);
+DllExport int SetTransportCallback(TwoCanTransportCallback callback, void *context);
+DllExport int SetTransportAddress(int address);
+DllExport int GetTransportStatistics(TwoCanTransportStatistics *statistics);
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count);
+DllExport int SubscribePgn(unsigned int pgn, int source);
+DllExport int UnsubscribePgn(unsigned int pgn, int source);
 
-DWORD WINAPI ReadThread(LPVOID lParam);
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrame(const TwoCanFrame *frame);
+int ReceiveQueueFilling(void);
+int SendFrames(const TwoCanFrame *frames, const int count);
+int QueueFrames(const TwoCanFrame *frames, const int count);
+void ApplyAcceptanceFilters(void);
 BOOL FindAdapter(char *serialNumber, int serialNumberLength);
+#if !defined(_WIN32)
+DllExport int SetAdapterSerialNumber(const char *serialNumber);
+#endif
 
 #endif
\ No newline at end of file
@@ -30,39 +30,75 @@
 // 1.1 20/8/2019 Initial Release
 // Note, initial version 1.1 indicates that this driver supports the Write functionality
 
-#include "..\inc\toucan.h"
+#include "../inc/toucan.h"
 
-#include "..\..\common\inc\twocanerror.h"
+#include "../../Common/inc/twocanerror.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 // Separate thread to read data from the CAN device
-HANDLE threadHandle;
+TwoCanThread threadHandle;
 
 // The thread id.
 DWORD threadId;
 
 // Event signalled when valid CAN Frame is received
-HANDLE frameReceivedEvent;
+TwoCanEvent frameReceivedEvent;
 
 // Signal that the thread has terminated
-HANDLE threadFinishedEvent;
+TwoCanEvent threadFinishedEvent;
+
+// Event signalled by the caller once it has consumed the received frames
+TwoCanEvent frameConsumedEvent;
 
 // Mutex used to synchronize access to the CAN Frame buffer
-HANDLE frameReceivedMutex;
+TwoCanMutex frameReceivedMutex;
 
 // Pointer to the caller's CAN Frame buffer
 byte *canFramePtr;
 
+// Pointer to the caller's ring buffer, used instead of canFramePtr when started by ReadAdapterEx
+TwoCanRing *canRingPtr = NULL;
+
+// Ring buffer owned by the driver, used when started by ReadAdapterBatch
+TwoCanRing batchRing;
+
 // Variable to indicate thread state
 BOOL isRunning = FALSE;
 
+// Set once the read thread has been started, until CloseAdapter, isRunning is also cleared if the thread fails
+BOOL isStarted = FALSE;
+
 // CANAL variables
 long status;
 long handle;
 
+// Correlates the adapter's timestamps with the host clock
+TwoCanClock adapterClock;
+
+// PGN and source address filters, the adapter applies their combined code and mask
+TwoCanFilterTable acceptanceFilters;
+
+// Frames waiting to be sent by the writer thread
+TwoCanTransmitQueue transmitQueue;
+
+// Fast packet messages being reassembled by the read thread
+TwoCanFastPacketTable fastPackets;
+
+// ISO transport protocol sessions being reassembled by the read thread
+TwoCanTransportTable transportSessions;
+
+#if !defined(_WIN32)
+// Serial number selected by SetAdapterSerialNumber, there is no registry to enumerate the devices
+char adapterSerialNumber[9] = CONST_SERIAL_NUMBER;
+#endif
+
 //
 // The DLL entry point
 //
 
+#if defined(_WIN32)
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved) {
 	switch (fdwReason)	{
 	case DLL_PROCESS_ATTACH:
@@ -81,6 +117,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved)
 	// As nothing to do, just return TRUE
 	return TRUE;
 }
+#endif
 
 //
 // Drivername,
@@ -110,6 +147,23 @@ DllExport char *ManufacturerName(void)	{
 	return (char *)L"Rusoku";
 }
 
+#if !defined(_WIN32)
+//
+// Select the device opened by OpenAdapter, Windows finds the device's serial number in the registry
+// [in] serialNumber, 8 digit serial number
+// returns TWOCAN_RESULT_SUCCESS if the serial number is valid
+//
+
+DllExport int SetAdapterSerialNumber(const char *serialNumber) {
+	if ((serialNumber == NULL) || (strlen(serialNumber) != (sizeof(adapterSerialNumber) - 1))) {
+		DebugPrintf(L"Invalid serial number\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_ADAPTER_NOT_FOUND);
+	}
+	strcpy(adapterSerialNumber, serialNumber);
+	return TWOCAN_RESULT_SUCCESS;
+}
+#endif
+
 
 //
 // Open. Connect to the adapter and get ready to start reading
@@ -117,34 +171,53 @@ DllExport char *ManufacturerName(void)	{
 //
 
 DllExport int OpenAdapter(void)	{
+	// The events and mutex are created by the first OpenAdapter and kept for the life of the driver, see CloseAdapter
 	// Create an event that is used to notify the caller of a received frame
-	frameReceivedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_DATARX_EVENT);
+	if (frameReceivedEvent == NULL) {
+		frameReceivedEvent = EventCreate(CONST_DATARX_EVENT);
+	}
 
 	if (frameReceivedEvent == NULL)
 	{
 		// Fatal Error
-		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_EVENT);
 	}
 
 	// Create an event that is used to notify the close method that the thread has ended
-	threadFinishedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_EVENT_THREAD_ENDED);
+	if (threadFinishedEvent == NULL) {
+		threadFinishedEvent = EventCreate(CONST_EVENT_THREAD_ENDED);
+	}
 
 	if (threadFinishedEvent == NULL)
 	{
 		// Fatal Error
-		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_COMPLETE_EVENT);
 	}
+
+	// Create an event that the caller signals once it has consumed the received frames
+	if (frameConsumedEvent == NULL) {
+		frameConsumedEvent = EventCreate(CONST_DATACONSUMED_EVENT);
+	}
+
+	if (frameConsumedEvent == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Create FrameConsumed Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT);
+	}
 	
 	// Open the mutex that is used to synchronize access to the Can Frame buffer
 	// Initial state set to true, meaning we "own" the initial state of the mutex
-	frameReceivedMutex = OpenMutex(SYNCHRONIZE, TRUE, CONST_MUTEX_NAME);
+	if (frameReceivedMutex == NULL) {
+		frameReceivedMutex = MutexOpen(CONST_MUTEX_NAME);
+	}
 
 	if (frameReceivedMutex == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Open Mutex failed (%d)\n", GetLastError());
+		DebugPrintf(L"Open Mutex failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_MUTEX);
 	}
 
@@ -161,7 +234,12 @@ DllExport int OpenAdapter(void)	{
 	// device no;serial no;baud where device number is 0, serial number is 8 digits, 
 	// and baud must be 250 for NMEA 2000 networks.
 	char initString[15];
-	int length = sprintf_s(initString, sizeof(initString), "0;%s;250", deviceSerialNumber);
+	int length = snprintf(initString, sizeof(initString), "0;%s;250", deviceSerialNumber);
+	if ((length < 0) || (length >= (int)sizeof(initString))) {
+		// Fatal error, a truncated string would open the wrong device or baud rate
+		DebugPrintf(L"CANAL Initialization String too long: %d\n", length);
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CONFIGURE_ADAPTER);
+	}
 	DebugPrintf(L"CANAL Initialization String: %s\n", initString);
 
 	handle = CanalOpen(initString, 0);
@@ -172,6 +250,13 @@ DllExport int OpenAdapter(void)	{
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SET_BUS_SPEED);
 	}
 
+	// CANAL timestamps are in microseconds
+	ClockInitialise(&adapterClock, 1);
+
+	FastPacketInitialise(&fastPackets);
+	TransportInitialise(&transportSessions);
+	TransportSetFilters(&transportSessions, &acceptanceFilters);
+
 	// Get the vendor id name
 	char *vendorId;
 	vendorId = (char *)malloc(1024);
@@ -193,6 +278,8 @@ DllExport int OpenAdapter(void)	{
 		DebugPrintf(L"CANAL Interface Off failed: (%d)\n", status);
 	}
 
+	ApplyAcceptanceFilters();
+
 	status = CanalInterfaceStart(handle);
 
 	if (status != CANAL_ERROR_SUCCESS) {
@@ -201,7 +288,7 @@ DllExport int OpenAdapter(void)	{
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_SET_BUS_ON);
 	}
 
-	return TWOCAN_RESULT_SUCCESS;
+	return TransmitStart(&transmitQueue, SendFrames);
 }
 
 //
@@ -212,34 +299,37 @@ DllExport int OpenAdapter(void)	{
 DllExport int CloseAdapter(void)	{
 	// Terminate the read thread
 	isRunning = FALSE;
+	isStarted = FALSE;
 
-	// Wait for the thread to exit
-	int waitResult;
-	waitResult = WaitForSingleObject(threadFinishedEvent, 1000);
-	if (waitResult == WAIT_TIMEOUT) {
-		DebugPrintf(L"Wait for threadFinishedEvent timed out");
-	}
-	if (waitResult == WAIT_ABANDONED) {
-		DebugPrintf(L"Wait for threadFinishedEvent abandoned");
-	}
-	if (waitResult == WAIT_FAILED) {
-		DebugPrintf(L"Wait for threadFinishedEvent Error: %d", GetLastError());
-	}
+	// Wait for the thread to exit, if it was started
+	int waitResult = TWOCAN_WAIT_SIGNALLED;
+	if (threadHandle != NULL) {
+		waitResult = EventWait(threadFinishedEvent, 1000);
+		if (waitResult == TWOCAN_WAIT_TIMEOUT) {
+			DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		}
+		if (waitResult == TWOCAN_WAIT_FAILED) {
+			DebugPrintf(L"Wait for threadFinishedEvent Error: %d", PlatformGetLastError());
+		}
 
-	// Close all the handles
-	int closeResult;
-	closeResult = CloseHandle(threadFinishedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadFinsishedEvent Error: %d", GetLastError());
+		// Release the handle, a thread that has not exited keeps running until it returns
+		int closeResult;
+		closeResult = ThreadClose(threadHandle);
+		if (closeResult == 0) {
+			DebugPrintf(L"Close threadHandle Error: %d", PlatformGetLastError());
+		}
+		threadHandle = NULL;
 	}
 
-	closeResult = CloseHandle(frameReceivedEvent);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close frameReceivedEvent Error: %d", GetLastError());
-	}
-	closeResult = CloseHandle(threadHandle);
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadHandle Error: %d", GetLastError());
+	// The events and mutex are kept for the life of the driver rather than closed, a read thread that has
+	// not exited or a caller still waiting in ReadAdapterBatch may be using them
+
+	// Send what is still queued before stopping the interface
+	TransmitStop(&transmitQueue);
+
+	// A read thread that has not exited may still be reading from the adapter, so it is left open
+	if (waitResult != TWOCAN_WAIT_SIGNALLED) {
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_DELETE_THREAD_HANDLE);
 	}
 
 	// Close the Canal adapter
@@ -251,6 +341,7 @@ DllExport int CloseAdapter(void)	{
 	if (status != CANAL_ERROR_SUCCESS) {
 		DebugPrintf(L"CANAL Close Adapter failed: (%d)", status);
 	}
+	handle = 0;
 	return TWOCAN_RESULT_SUCCESS;
 }
 
@@ -265,41 +356,373 @@ DllExport int ReadAdapter(byte *frame)	{
 
 	// Save the pointer to the Can Frame buffer
 	canFramePtr = frame;
+	canRingPtr = NULL;
+
+	// Indicate thread is in running state
+	isRunning = TRUE;
+
+	// Start the read thread
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
+
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		return TWOCAN_RESULT_SUCCESS;
+	}
+	// Fatal Error
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
+}
+
+//
+// ReadEx, starts the read thread, received frames are queued in the caller's ring buffer
+// [in] ring, pointer to a ring buffer initialised with RingInitialise
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
+//
+
+DllExport int ReadAdapterEx(TwoCanRing *ring)	{
+
+	if (!RingIsValid(ring)) {
+		DebugPrintf(L"Invalid ring buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_RING);
+	}
+
+	// Save the pointer to the ring buffer
+	canRingPtr = ring;
+	canFramePtr = NULL;
 
 	// Indicate thread is in running state
 	isRunning = TRUE;
 
 	// Start the read thread
-	threadHandle = CreateThread(NULL, 0, ReadThread, NULL, 0, &threadId);
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
 
 	if (threadHandle != NULL) {
+		isStarted = TRUE;
 		return TWOCAN_RESULT_SUCCESS;
 	}
 	// Fatal Error
 	isRunning = FALSE;
-	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, GetLastError());
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
 	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
 }
 
 //
-// Write, Transmit a frame onto the NMEA 2000 network
+// ReadBatch, returns the frames received since the previous call, waiting up to timeoutMs if none are queued
+// The first call starts the read thread, frames are then queued in the driver's own ring buffer between calls
+// [out] frames, pointer to the caller's array of CAN Frames
+// [in] capacity, number of CAN Frames the array can hold
+// [out] count, number of CAN Frames returned, zero if the wait timed out
+// [in] timeoutMs, maximum time to wait for a frame
+// Returns TWOCAN_RESULT_SUCCESS if the read thread is running
+//
+
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs)	{
+	int result;
+
+	if ((frames == NULL) || (count == NULL) || (capacity <= 0)) {
+		DebugPrintf(L"Invalid frame buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+
+	*count = 0;
+
+	if (!isStarted) {
+		RingInitialise(&batchRing, CONST_RING_CAPACITY);
+		result = ReadAdapterEx(&batchRing);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			return result;
+		}
+	}
+	else if (canRingPtr != &batchRing) {
+		// Already started by ReadAdapter or ReadAdapterEx
+		DebugPrintf(L"Read thread already running\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_READ_FUNCTION);
+	}
+	else if ((!isRunning) && (RingCount(&batchRing) == 0)) {
+		// The read thread ended after a fatal error, once its last frames have been returned. It is not restarted
+		DebugPrintf(L"Read thread has stopped\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_RECEIVE_FAILURE);
+	}
+
+	if (RingCount(&batchRing) == 0) {
+		EventWait(frameReceivedEvent, timeoutMs);
+	}
+
+	*count = RingReadBatch(&batchRing, frames, capacity);
+
+	// Let the read thread know there is space in the ring
+	EventSet(frameConsumedEvent);
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Write, queue a frame for transmission onto the NMEA 2000 network, returns without waiting for the adapter
 // [in] 29bit Can header (id), payload and payload length
-// returns TWOCAN_RESULT_SUCCESS 
+// returns TWOCAN_RESULT_SUCCESS if the frame was queued
 //
 
 DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *data) {
+	TwoCanFrame frame;
+
+	if ((dataLength < 0) || (dataLength > CONST_PAYLOAD_LENGTH) || ((data == NULL) && (dataLength > 0))) {
+		DebugPrintf(L"Invalid transmit frame\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+
+	memset(&frame, 0, sizeof(TwoCanFrame));
+	frame.id = id & CONST_EXTENDED_ID_MASK;
+	frame.dlc = (byte)dataLength;
+	frame.flags = TWOCAN_FRAME_FLAG_EXTENDED;
+	if (dataLength > 0) {
+		memcpy(frame.data, data, dataLength);
+	}
+
+	return WriteAdapterEx(&frame, 1);
+}
+
+//
+// WriteEx, queue several frames as a unit, eg. the frames of a fast packet message. Either all of them are queued or none.
+// Frames are sent most urgent priority first, frames of the same priority in order
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns TWOCAN_RESULT_SUCCESS if the frames were queued
+//
+
+DllExport int WriteAdapterEx(const TwoCanFrame *frames, int count) {
+	int result;
+
+	result = TransmitEnqueue(&transmitQueue, frames, count);
+	if (result != TWOCAN_RESULT_SUCCESS) {
+		DebugPrintf(L"Transmit queue error: %d\n", result);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, result);
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the writer thread after each frame is sent or fails, may be called before OpenAdapter
+// [in] callback, NULL to remove the callback
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetTransmitCallback(TwoCanTransmitCallback callback, void *context) {
+	TransmitSetCallback(&transmitQueue, callback, context);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Transmit statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetTransmitStatistics(TwoCanTransmitStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = transmitQueue.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the read thread with each reassembled fast packet message, may be called before OpenAdapter.
+// The frames of the message are still passed to the caller as usual
+// [in] callback, NULL to stop reassembling messages
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetFastPacketCallback(TwoCanFastPacketCallback callback, void *context) {
+	FastPacketSetCallback(&fastPackets, callback, context);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Fast packet reassembly statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetFastPacketStatistics(TwoCanFastPacketStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = fastPackets.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Register a function called from the read thread with each reassembled ISO transport protocol message, may be called before OpenAdapter.
+// The frames of the message are still passed to the caller as usual
+// [in] callback, NULL to stop reassembling messages
+// [in] context, passed to the callback
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int SetTransportCallback(TwoCanTransportCallback callback, void *context) {
+	TransportSetCallback(&transportSessions, callback, context);
+
+	// The adapter's filter must now let the transport protocol frames through, or may stop doing so
+	if (handle > 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Set the source address whose transport protocol sessions the driver answers with clear to send and end of message acknowledgements
+// [in] address, the caller's claimed address, or CONST_TRANSPORT_NULL_ADDRESS to only follow sessions
+// returns TWOCAN_RESULT_SUCCESS if the address is valid
+//
+
+DllExport int SetTransportAddress(int address) {
+	if ((address < 0) || (address > CONST_TRANSPORT_NULL_ADDRESS)) {
+		DebugPrintf(L"Invalid transport protocol address: %d\n", address);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_ADDRESS);
+	}
+	TransportSetAddress(&transportSessions, (byte)address, (address == CONST_TRANSPORT_NULL_ADDRESS) ? NULL : QueueFrames);
+
+	if (handle > 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Transport protocol statistics since OpenAdapter
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetTransportStatistics(TwoCanTransportStatistics *statistics) {
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = transportSessions.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Queue the transport protocol acknowledgements sent from the read thread
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns the number of frames queued
+//
+
+int QueueFrames(const TwoCanFrame *frames, const int count) {
+	return (TransmitEnqueue(&transmitQueue, frames, count) == TWOCAN_RESULT_SUCCESS) ? count : 0;
+}
+
+//
+// Send frames in order, called only from the transmit queue's writer thread
+// [in] frames, pointer to array of CAN Frames
+// [in] count, number of frames
+// returns the number of frames the adapter accepted
+//
+
+int SendFrames(const TwoCanFrame *frames, const int count) {
 	canalMsg msg;
-	msg.id = id;
-	msg.sizeData = dataLength;
-	memcpy(msg.data, data, dataLength);
-	msg.flags = CANAL_IDFLAG_EXTENDED | CANAL_IDFLAG_SEND;
-	status = CanalSend(handle, &msg);
-	if (status == CANAL_ERROR_SUCCESS) {
-		return TWOCAN_RESULT_SUCCESS;
+	int result;
+
+	for (int i = 0; i < count; i++) {
+		memset(&msg, 0, sizeof(canalMsg));
+		msg.id = frames[i].id;
+		msg.sizeData = frames[i].dlc;
+		memcpy(msg.data, frames[i].data, frames[i].dlc);
+		msg.flags = CANAL_IDFLAG_EXTENDED | CANAL_IDFLAG_SEND;
+
+		result = CanalSend(handle, &msg);
+		if (result != CANAL_ERROR_SUCCESS) {
+			DebugPrintf(L"Transmit frame failed: (%d)\n", result);
+			return i;
+		}
 	}
-	else {
-		DebugPrintf(L"Transmit frame failed: (%d)\n", status);
-		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_TRANSMIT_FAILURE);
+	return count;
+}
+//
+// Filter, accept only the listed PGNs, may be called before or after OpenAdapter
+// [in] filters, pointer to array of PGN and source address filters
+// [in] count, number of filters, zero accepts every frame
+// returns TWOCAN_RESULT_SUCCESS if the filters are valid
+//
+
+DllExport int SetAcceptanceFilters(const TwoCanFilter *filters, int count) {
+	if (!FilterTableUpdate(&acceptanceFilters, filters, count)) {
+		DebugPrintf(L"Invalid acceptance filters\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle > 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Subscribe, add a PGN to the acceptance filters, may be called before or after OpenAdapter
+// Frames of other PGNs are discarded by the read thread once any filter is set
+// [in] pgn, as for TwoCanFilter
+// [in] source, source address or CONST_FILTER_ANY_SOURCE
+// returns TWOCAN_RESULT_SUCCESS if the PGN is now accepted
+//
+
+DllExport int SubscribePgn(unsigned int pgn, int source) {
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableSubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"Invalid subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle > 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Unsubscribe, remove a PGN added with SubscribePgn or SetAcceptanceFilters
+// Removing the last PGN leaves no filters, so every frame is accepted again
+// [in] pgn, source, as given when the PGN was added
+// returns TWOCAN_RESULT_SUCCESS if the PGN was removed
+//
+
+DllExport int UnsubscribePgn(unsigned int pgn, int source) {
+	if ((source < 0) || (source > CONST_FILTER_ANY_SOURCE) || (!FilterTableUnsubscribe(&acceptanceFilters, pgn, (byte)source))) {
+		DebugPrintf(L"No subscription %u from %d\n", pgn, source);
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_FILTER);
+	}
+
+	if (handle > 0) {
+		ApplyAcceptanceFilters();
+	}
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Load the combined code and mask of the active filters into the adapter's 29 bit acceptance filter
+//
+
+void ApplyAcceptanceFilters(void) {
+	unsigned int code;
+	unsigned int mask;
+
+	FilterTableHardware(&acceptanceFilters, &code, &mask);
+
+	// Sessions are reassembled whatever the filters, the messages they carry are filtered once complete
+	if (TransportIsInUse(&transportSessions)) {
+		FilterWidenHardware(&code, &mask, CONST_TRANSPORT_CM_PGN);
+		FilterWidenHardware(&code, &mask, CONST_TRANSPORT_DT_PGN);
+	}
+
+	status = CanalSetFilter29bit(handle, (mask == 0) ? FILTER_ACCEPT_ALL : FILTER_VALUE, code, mask);
+	if (status != CANAL_ERROR_SUCCESS) {
+		// Non fatal error, the read thread still applies the filters
+		DebugPrintf(L"CANAL Set Filter failed: (%d)\n", status);
 	}
 }
 
@@ -309,10 +732,13 @@ DllExport int WriteAdapter(const unsigned int id, const int dataLength, byte *da
 // Upon exit, returns TWOCAN_RESULT_SUCCESS as Thread Exit Code
 //
 
-DWORD WINAPI ReadThread(LPVOID lParam)
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam)
 {
-	DWORD mutexResult;
+	TwoCanFrame frame;
 	canalMsg msg;
+	unsigned long long hostTime;
+	int isAccepted;
+	int isTransport;
 
 	while (isRunning) {
 
@@ -321,39 +747,28 @@ DWORD WINAPI ReadThread(LPVOID lParam)
 
 		if (status == CANAL_ERROR_SUCCESS) {
 
-			// Only interested in CAN 2.0 extended frames with 29bit Id's
-			if (msg.flags & CANAL_IDFLAG_EXTENDED) {
-			
-				// Make sure we can get a lock on the buffer
-				mutexResult = WaitForSingleObject(frameReceivedMutex, 200);
-
-				if (mutexResult == WAIT_OBJECT_0) {
-
-					// Convert id (long) to TwoCan header format (byte array)
-					canFramePtr[3] = (msg.id >> 24) & 0xFF;
-					canFramePtr[2] = (msg.id >> 16) & 0xFF;
-					canFramePtr[1] = (msg.id >> 8) & 0xFF;
-					canFramePtr[0] = msg.id & 0xFF;
-
-					// Copy the CAN data
-					memcpy(&canFramePtr[4], msg.data, msg.sizeData);
-
-					// Release the lock
-					ReleaseMutex(frameReceivedMutex);
-
-					// Notify the caller
-					if (SetEvent(frameReceivedEvent)) {
-						Sleep(10);
-					}
-					else {
-						// Non fatal error
-						DebugPrintf(L"Set Event Error: %d\n", GetLastError());
-					}
+			// Only interested in CAN 2.0 extended frames with 29bit Id's, that pass the filters the adapter could not apply.
+			// Transport protocol frames are reassembled even if the filters reject them, the message they carry may be accepted
+			isAccepted = (msg.flags & CANAL_IDFLAG_EXTENDED) && (FilterTableMatch(&acceptanceFilters, msg.id & CONST_EXTENDED_ID_MASK));
+			isTransport = (msg.flags & CANAL_IDFLAG_EXTENDED) && (TransportIsWanted(&transportSessions, msg.id & CONST_EXTENDED_ID_MASK));
+
+			if ((isAccepted) || (isTransport)) {
+
+				frame.timestamp = ClockConvert(&adapterClock, msg.timestamp, GetHostTimestamp());
+				frame.id = msg.id & CONST_EXTENDED_ID_MASK;
+				frame.dlc = (msg.sizeData > CONST_PAYLOAD_LENGTH) ? CONST_PAYLOAD_LENGTH : msg.sizeData;
+				frame.flags = TWOCAN_FRAME_FLAG_EXTENDED | TWOCAN_FRAME_FLAG_HARDWARE_TIMESTAMP;
+
+				// Copy the CAN data
+				memset(frame.data, 0, CONST_PAYLOAD_LENGTH);
+				memcpy(frame.data, msg.data, frame.dlc);
+
+				if (isTransport) {
+					TransportProcess(&transportSessions, &frame, 1);
 				}
 
-				else {
-					// Non fatal error
-					DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, GetLastError());
+				if (isAccepted) {
+					PostFrame(&frame);
 				}
 			}  // end Can Extended Frame handling
 
@@ -371,11 +786,80 @@ DWORD WINAPI ReadThread(LPVOID lParam)
 			
 		} // end if CANAL_ERROR_SUCCESS
 
+		if ((fastPackets.activeCount > 0) || (transportSessions.activeCount > 0)) {
+			hostTime = GetHostTimestamp();
+			FastPacketExpire(&fastPackets, hostTime);
+			TransportExpire(&transportSessions, hostTime);
+		}
+
 	} // end while
-	SetEvent(threadFinishedEvent);
-	ExitThread(TWOCAN_RESULT_SUCCESS);
+	EventSet(threadFinishedEvent);
+	ThreadExit(TWOCAN_RESULT_SUCCESS);
+}
+
+//
+// Whether the CANAL receive queue is close to overrunning, so the read thread must stop waiting for the caller
+// returns non zero if the queue holds CONST_RECEIVE_QUEUE_LIMIT or more frames
+//
+
+int ReceiveQueueFilling(void) {
+	return (CanalDataAvailable(handle) >= CONST_RECEIVE_QUEUE_LIMIT);
 }
 
+//
+// Hand a received frame to the caller, either by queueing it in the caller's ring buffer
+// or by converting it into the caller's single 12 byte CAN Frame buffer
+// [in] frame, pointer to CAN Frame
+//
+
+void PostFrame(const TwoCanFrame *frame) {
+	int mutexResult;
+
+	FastPacketProcess(&fastPackets, frame, 1);
+
+	if (canRingPtr != NULL) {
+		// Back pressure, wait for the caller to drain a full ring while the adapter buffers incoming frames.
+		// No lock required, the frame is only discarded, and counted as an overflow, once the CANAL receive queue
+		// is in danger of dropping frames itself
+		while ((isRunning) && (RingIsFull(canRingPtr)) && (!ReceiveQueueFilling())) {
+			EventWait(frameConsumedEvent, CONST_BACK_PRESSURE_WAIT);
+		}
+
+		if (RingWrite(canRingPtr, frame)) {
+			if (!EventSet(frameReceivedEvent)) {
+				DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+			}
+		}
+		return;
+	}
+
+	// Make sure we can get a lock on the buffer
+	mutexResult = MutexLock(frameReceivedMutex, 200);
+
+	if (mutexResult == TWOCAN_WAIT_SIGNALLED) {
+
+		ConvertFrameToByteArray(frame, canFramePtr);
+
+		// Release the lock
+		MutexUnlock(frameReceivedMutex);
+
+		// Notify the caller
+		if (EventSet(frameReceivedEvent)) {
+			// Wait for the caller to acknowledge the frame before it can be overwritten,
+			// callers that never signal frameConsumedEvent are paced by the timeout
+			EventWait(frameConsumedEvent, 10);
+		}
+		else {
+			DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+		}
+	}
+
+	else {
+		DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, PlatformGetLastError());
+	}
+}
+
+#if defined(_WIN32)
 #define TOUCAN_KEY_UNICODE  L"{FD361109-858D-4F6F-81EE-AAB5D6CBF06B}"
 #define TOUCAN_KEY_ANSI "{FD361109-858D-4F6F-81EE-AAB5D6CBF06B}"
 #define TOUCAN_PNP_KEY L"SYSTEM\\CurrentControlSet\\enum\\USB\\VID_16D0&PID_0EAC"
@@ -404,7 +888,7 @@ BOOL FindAdapter(char *serialNumber, int serialNumberLength) {
 	// Get a handle to the registry key for the Rusoku Toucan device
 	result = RegOpenKeyEx(HKEY_LOCAL_MACHINE, TOUCAN_PNP_KEY, 0, KEY_READ, &registryKey);
 
-	DebugPrintf(L"RegOpenKey: %d (%d)\n", result, GetLastError());
+	DebugPrintf(L"RegOpenKey: %d (%d)\n", result, PlatformGetLastError());
 
 	// if the key isn't found, assume the Rusoku Toucan device has never been installed
 	if (result != ERROR_SUCCESS) {
@@ -472,3 +956,16 @@ BOOL FindAdapter(char *serialNumber, int serialNumberLength) {
 
 	return foundKey;
 }
+#else
+//
+// Retrieve the serial number used to open the adapter
+// [out] serialNumber, the serial number selected by SetAdapterSerialNumber
+// [in] serialNumberLength, size of serialNumber
+// returns TRUE
+//
+
+BOOL FindAdapter(char *serialNumber, int serialNumberLength) {
+	snprintf(serialNumber, serialNumberLength, "%s", adapterSerialNumber);
+	return TRUE;
+}
+#endif
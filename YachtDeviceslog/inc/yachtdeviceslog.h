@@ -20,28 +20,23 @@
 #ifndef _TWOCAN_YACHTDEVICES
 #define _TWOCAN_YACHTDEVICES
 
-#include "..\..\common\inc\twocandriver.h"
+#include "../../Common/inc/twocandriver.h"
+#include "../../Common/inc/twocanring.h"
+#include "../../Common/inc/twocanparser.h"
+#include "../../Common/inc/twocanlogfile.h"
+#include "../../Common/inc/twocanduplicate.h"
+#include "../../Common/inc/twocanreplay.h"
+#include "../../Common/inc/twocancache.h"
 
-#define WINDOWS_LEAN_AND_MEAN
-#include <windows.h>
-
-// for "my documents" folder and path appending
-// remember to also add Shlwapi.lib to linker
-#include <ShlObj.h>
-#include <ShlWapi.h>
-
-// 'C++' STL
-#include <fstream>
-#include <regex>
 
 
 // Hardcoded input LogFile
-#define CONST_LOG_FILE L"yachtdevices.log"
+#define CONST_LOG_FILE TWOCAN_TEXT("yachtdevices.log")
 
 #define CONST_MAX_BAD_LINES 100
 
 // Note extern "C" decoration to allow C routines to access these exported C++ functions
-#define DllExport extern "C" __declspec(dllexport)
+#define DllExport extern "C" TWOCAN_EXPORT
 
 DllExport char *DriverName(void);
 DllExport char *DriverVersion(void);
@@ -49,7 +44,13 @@ DllExport char *ManufacturerName(void);
 DllExport int OpenAdapter(void);
 DllExport int CloseAdapter(void);
 DllExport int ReadAdapter(byte *frame);
-
-DWORD WINAPI ReadThread(LPVOID lParam);
+DllExport int ReadAdapterEx(TwoCanRing *ring);
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs);
+DllExport int SetReplaySpeed(double speed);
+DllExport int SetDuplicateWindow(unsigned int window);
+DllExport int GetDuplicateStatistics(TwoCanDuplicateStatistics *statistics);
+
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam);
+void PostFrame(const TwoCanFrame *frame);
 
 #endif
\ No newline at end of file
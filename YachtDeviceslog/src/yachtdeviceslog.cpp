@@ -26,37 +26,65 @@
 // TwoCan byte array and signals an event to the application
 //
 
-#include "..\inc\yachtdeviceslog.h"
+#include "../inc/yachtdeviceslog.h"
 
-#include "..\..\common\inc\twocanerror.h"
+#include "../../Common/inc/twocanerror.h"
 
 // Separate thread to read data from the logfile
-HANDLE threadHandle;
+TwoCanThread threadHandle;
 
 // The thread id.
 DWORD threadId;
 
 // Event signalled when valid CAN Frame is received
-HANDLE frameReceivedEvent;
+TwoCanEvent frameReceivedEvent;
 
 // Signal that the thread has terminated
-HANDLE threadFinishedEvent;
+TwoCanEvent threadFinishedEvent;
+
+// Event signalled by the caller once it has consumed the received frames
+TwoCanEvent frameConsumedEvent;
 
 // Mutex used to synchronize access to the CAN Frame buffer
-HANDLE frameReceivedMutex;
+TwoCanMutex frameReceivedMutex;
 
 // Pointer to the caller's CAN Frame buffer
 byte *canFramePtr;
 
+// Pointer to the caller's ring buffer, used instead of canFramePtr when started by ReadAdapterEx
+TwoCanRing *canRingPtr = NULL;
+
+// Ring buffer owned by the driver, used when started by ReadAdapterBatch
+TwoCanRing batchRing;
+
+// Replay speed as a multiple of the recorded rate, set by SetReplaySpeed
+double replaySpeed = CONST_REPLAY_SPEED_REALTIME;
+
+// Paces replayed frames by their recorded timestamps
+TwoCanReplayClock replayClock;
+
+// Duplicate window in microseconds, set by SetDuplicateWindow
+unsigned int duplicateWindow = CONST_DUPLICATE_DISABLED;
+
+// Frames recently passed to the caller, repeats within the window are discarded
+TwoCanDuplicateTable duplicateFrames;
+
+// Binary cache of the frames parsed from the log file
+TwoCanCache replayCache;
+
 // Variable to indicate thread state
 BOOL isRunning = FALSE;
 
+// Set once the read thread has been started, until CloseAdapter, isRunning is also cleared if the thread fails
+BOOL isStarted = FALSE;
+
 int badLineCount = 0;
 
 //
 // The DLL entry point
 //
 
+#if defined(_WIN32)
 BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved) {
 	switch (fdwReason)	{
 	case DLL_PROCESS_ATTACH:
@@ -75,6 +103,7 @@ BOOL WINAPI DllMain(HINSTANCE hinstDLL, DWORD  fdwReason, LPVOID    lpvReserved)
 	// As nothing to do, just return TRUE
 	return TRUE;
 }
+#endif
 
 //
 // Drivername,
@@ -112,53 +141,63 @@ DllExport char *ManufacturerName(void)	{
 DllExport int OpenAdapter(void)	{
 	DebugPrintf(L"Open called\n");
 
+	// The events and mutex are created by the first OpenAdapter and kept for the life of the driver, see CloseAdapter
 	// Create an event that is used to notify the caller of a received frame
-<<<<<<< HEAD
-	frameReceivedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_DATARX_EVENT);
-=======
-	frameReceivedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_DATARX_EVENT_);
->>>>>>> 96c9bd0ef85ef00a47cbc872354fefe8c0bab698
+	if (frameReceivedEvent == NULL) {
+		frameReceivedEvent = EventCreate(CONST_DATARX_EVENT);
+	}
 
 	if (frameReceivedEvent == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create FrameReceivedEvent failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_EVENT);
 	}
 
 	// Create an event that is used to notify the close method that the thread has ended
-	threadFinishedEvent = CreateEvent(NULL, FALSE, FALSE, CONST_EVENT_THREAD_ENDED);
+	if (threadFinishedEvent == NULL) {
+		threadFinishedEvent = EventCreate(CONST_EVENT_THREAD_ENDED);
+	}
 
 	if (threadFinishedEvent == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", GetLastError());
+		DebugPrintf(L"Create ThreadFinished Event failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_COMPLETE_EVENT);
 	}
 
+	// Create an event that the caller signals once it has consumed the received frames
+	if (frameConsumedEvent == NULL) {
+		frameConsumedEvent = EventCreate(CONST_DATACONSUMED_EVENT);
+	}
+
+	if (frameConsumedEvent == NULL)
+	{
+		// Fatal error
+		DebugPrintf(L"Create FrameConsumed Event failed (%d)\n", PlatformGetLastError());
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_CONSUMED_EVENT);
+	}
+
 
 	// Open the mutex that is used to synchronize access to the Can Frame buffer
 	// Initial state set to true, meaning we "own" the initial state of the mutex
-	frameReceivedMutex = OpenMutex(SYNCHRONIZE, TRUE, CONST_MUTEX_NAME);
+	if (frameReceivedMutex == NULL) {
+		frameReceivedMutex = MutexOpen(CONST_MUTEX_NAME);
+	}
 
 	if (frameReceivedMutex == NULL)
 	{
 		// Fatal error
-		DebugPrintf(L"Open Mutex failed (%d)\n", GetLastError());
+		DebugPrintf(L"Open Mutex failed (%d)\n", PlatformGetLastError());
 		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_FRAME_RECEIVED_MUTEX);
 	}
 
 	// Check if the log file exists
-	WCHAR fileName[MAX_PATH];
-	HRESULT result;
-
-	result = SHGetFolderPath(NULL, CSIDL_PERSONAL, NULL, SHGFP_TYPE_CURRENT, fileName);
+	TwoCanChar fileName[TWOCAN_MAX_PATH];
 
-	if (result == S_OK) {
-		PathAppend(fileName, CONST_LOG_FILE);
-
-		if (!PathFileExists((LPCWSTR)fileName)) {
-			DebugPrintf(L"Log File Not found (%d)\n", GetLastError());
+	if (GetDocumentsPath(CONST_LOG_FILE, fileName)) {
+		if (!FileExists(fileName)) {
+			DebugPrintf(L"Log File Not found (%d)\n", PlatformGetLastError());
 			return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_FILE_NOT_FOUND);
 		}
 	}
@@ -175,188 +214,370 @@ DllExport int OpenAdapter(void)	{
 DllExport int CloseAdapter(void)	{
 	// Terminate the read thread
 	isRunning = FALSE;
+	isStarted = FALSE;
 
-	// Wait for the thread to exit
-	int waitResult;
-	waitResult = WaitForSingleObject(threadFinishedEvent, 1000);
+	// Wait for the thread to exit, if it was started
+	int waitResult = TWOCAN_WAIT_SIGNALLED;
+	if (threadHandle != NULL) {
+		waitResult = EventWait(threadFinishedEvent, 1000);
+		if (waitResult == TWOCAN_WAIT_TIMEOUT) {
+			DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		}
+		if (waitResult == TWOCAN_WAIT_FAILED) {
+			DebugPrintf(L"Wait for threadFinishedEvent Error: %d", PlatformGetLastError());
+		}
 
-	if (waitResult == WAIT_TIMEOUT) {
-		DebugPrintf(L"Wait for threadFinishedEvent timed out");
+		// Release the handle, a thread that has not exited keeps running until it returns
+		int closeResult;
+		closeResult = ThreadClose(threadHandle);
+		if (closeResult == 0) {
+			DebugPrintf(L"Close threadHandle Error: %d", PlatformGetLastError());
+		}
+		threadHandle = NULL;
 	}
 
-	if (waitResult == WAIT_ABANDONED) {
-		DebugPrintf(L"Wait for threadFinishedEvent abandoned");
-	}
+	// The events and mutex are kept for the life of the driver rather than closed, a read thread that has
+	// not exited or a caller still waiting in ReadAdapterBatch may be using them
 
-	if (waitResult == WAIT_FAILED) {
-		DebugPrintf(L"Wait for threadFinishedEvent Error: %d", GetLastError());
+	// Report a read thread that did not exit
+	if (waitResult != TWOCAN_WAIT_SIGNALLED) {
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_DELETE_THREAD_HANDLE);
 	}
+	return TWOCAN_RESULT_SUCCESS;
+}
 
-	// Close all the handles
-	int closeResult;
 
-	closeResult = CloseHandle(threadFinishedEvent);
+//
+// Read, starts the read thread
+// [in] frame, pointer to byte array for the CAN Frame buffer
+//
 
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadFinsishedEvent Error: %d", GetLastError());
-	}
+DllExport int ReadAdapter(byte *frame)	{
 
-	closeResult = CloseHandle(frameReceivedEvent);
+	// Save the pointer to the Can Frame buffer
+	canFramePtr = frame;
+	canRingPtr = NULL;
 
-	if (closeResult == 0) {
-		DebugPrintf(L"Close frameReceivedEvent Error: %d", GetLastError());
-	}
+	// Running
+	isRunning = TRUE;
 
-	closeResult = CloseHandle(threadHandle);
+	// Start the read thread
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
 
-	if (closeResult == 0) {
-		DebugPrintf(L"Close threadHandle Error: %d", GetLastError());
+	if (threadHandle != NULL) {
+		isStarted = TRUE;
+		DebugPrintf(L"Read thread started: %d\n", threadId);
+		return TWOCAN_RESULT_SUCCESS;
 	}
 
-	return TWOCAN_RESULT_SUCCESS;
+	// Fatal error
+	isRunning = FALSE;
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
+	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
 }
 
-
 //
-// Read, starts the read thread
-// [in] frame, pointer to byte array for the CAN Frame buffer
+// ReadEx, starts the read thread, received frames are queued in the caller's ring buffer
+// [in] ring, pointer to a ring buffer initialised with RingInitialise
+// Returns TWOCAN_RESULT_SUCCESS if thread created successfully
 //
 
-DllExport int ReadAdapter(byte *frame)	{
+DllExport int ReadAdapterEx(TwoCanRing *ring)	{
 
-	// Save the pointer to the Can Frame buffer
-	canFramePtr = frame;
+	if (!RingIsValid(ring)) {
+		DebugPrintf(L"Invalid ring buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_RING);
+	}
+
+	// Save the pointer to the ring buffer
+	canRingPtr = ring;
+	canFramePtr = NULL;
 
 	// Running
 	isRunning = TRUE;
 
 	// Start the read thread
-	threadHandle = CreateThread(NULL, 0, ReadThread, NULL, 0, &threadId);
+	threadHandle = ThreadCreate(ReadThread, NULL, &threadId);
 
 	if (threadHandle != NULL) {
+		isStarted = TRUE;
 		DebugPrintf(L"Read thread started: %d\n", threadId);
 		return TWOCAN_RESULT_SUCCESS;
 	}
 
 	// Fatal error
 	isRunning = FALSE;
-	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, GetLastError());
+	DebugPrintf(L"Read thread failed: %d (%d)\n", threadId, PlatformGetLastError());
 	return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_CREATE_THREAD_HANDLE);
 }
 
+//
+// ReadBatch, returns the frames received since the previous call, waiting up to timeoutMs if none are queued
+// The first call starts the read thread, frames are then queued in the driver's own ring buffer between calls
+// [out] frames, pointer to the caller's array of CAN Frames
+// [in] capacity, number of CAN Frames the array can hold
+// [out] count, number of CAN Frames returned, zero if the wait timed out
+// [in] timeoutMs, maximum time to wait for a frame
+// Returns TWOCAN_RESULT_SUCCESS if the read thread is running
+//
+
+DllExport int ReadAdapterBatch(TwoCanFrame *frames, int capacity, int *count, DWORD timeoutMs)	{
+	int result;
+
+	if ((frames == NULL) || (count == NULL) || (capacity <= 0)) {
+		DebugPrintf(L"Invalid frame buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+
+	*count = 0;
+
+	if (!isStarted) {
+		RingInitialise(&batchRing, CONST_RING_CAPACITY);
+		result = ReadAdapterEx(&batchRing);
+		if (result != TWOCAN_RESULT_SUCCESS) {
+			return result;
+		}
+	}
+	else if (canRingPtr != &batchRing) {
+		// Already started by ReadAdapter or ReadAdapterEx
+		DebugPrintf(L"Read thread already running\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_READ_FUNCTION);
+	}
+	else if ((!isRunning) && (RingCount(&batchRing) == 0)) {
+		// The read thread ended after a fatal error, once its last frames have been returned. It is not restarted
+		DebugPrintf(L"Read thread has stopped\n");
+		return SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_RECEIVE_FAILURE);
+	}
+
+	if (RingCount(&batchRing) == 0) {
+		EventWait(frameReceivedEvent, timeoutMs);
+	}
+
+	*count = RingReadBatch(&batchRing, frames, capacity);
+
+	// Let the read thread know there is space in the ring
+	EventSet(frameConsumedEvent);
+
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Set the replay speed, as a multiple of the rate at which the log was recorded
+// [in] speed, eg. 0.5, 1 or 10, or CONST_REPLAY_SPEED_MAXIMUM to replay as fast as the caller consumes the frames
+// Returns TWOCAN_RESULT_SUCCESS if the speed is valid, may be called before or during replay
+//
+
+DllExport int SetReplaySpeed(double speed)	{
+	// Written so that NaN is also rejected
+	if (!(speed >= CONST_REPLAY_SPEED_MAXIMUM)) {
+		DebugPrintf(L"Invalid replay speed\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_REPLAY_SPEED);
+	}
+
+	replaySpeed = speed;
+	ReplaySetSpeed(&replayClock, speed);
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Set the duplicate window, a frame identical to one passed to the caller within the window is discarded
+// Useful when the log loops and the same frames are replayed again
+// [in] window, microseconds up to CONST_DUPLICATE_MAX_WINDOW, or CONST_DUPLICATE_DISABLED to pass every frame
+// Returns TWOCAN_RESULT_SUCCESS if the window is valid, may be called before or during replay
+//
+
+DllExport int SetDuplicateWindow(unsigned int window)	{
+	if (!DuplicateSetWindow(&duplicateFrames, window)) {
+		DebugPrintf(L"Invalid duplicate window\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_DUPLICATE_WINDOW);
+	}
+
+	duplicateWindow = window;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
+//
+// Duplicate suppression statistics since the replay started
+// [out] statistics, pointer to the caller's statistics
+// returns TWOCAN_RESULT_SUCCESS
+//
+
+DllExport int GetDuplicateStatistics(TwoCanDuplicateStatistics *statistics)	{
+	if (statistics == NULL) {
+		DebugPrintf(L"Invalid statistics buffer\n");
+		return SET_ERROR(TWOCAN_RESULT_ERROR, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_BUFFER);
+	}
+	*statistics = duplicateFrames.statistics;
+	return TWOCAN_RESULT_SUCCESS;
+}
+
 //
 // Read thread, reads previously saved NMEA 2000 data from the output of Candump (linux utility).
 // If a valid frame is received parse the frame into the correct format and notify the caller
 //
 
-DWORD WINAPI ReadThread(LPVOID lParam)
+DWORD TWOCAN_THREAD_CALL ReadThread(void *lParam)
 {
-	DWORD mutexResult;
-	WCHAR fileName[MAX_PATH];
-	HRESULT result;
-	byte canFrame[12];
+	TwoCanLogFile logFile;
+	TwoCanChar fileName[TWOCAN_MAX_PATH];
+	TwoCanFrame frame;
+	const char *line;
+	unsigned int lineLength;
+	BOOL useCache;
+
+	if (GetDocumentsPath(CONST_LOG_FILE, fileName)) {
+		DebugPrintf(L"Log File: %s\n\r", fileName);
 
-	result = SHGetFolderPath(NULL, CSIDL_PERSONAL, NULL, SHGFP_TYPE_CURRENT, fileName);
+		if (FileExists(fileName)) {
 
-	if (result == S_OK) {
-		PathAppend(fileName, CONST_LOG_FILE);
+			// Replay from the binary cache if it is up to date, otherwise parse the log and build the cache as we go
+			useCache = CacheOpen(&replayCache, fileName);
 
-		DebugPrintf(L"Log File: %s\n\r", fileName);
+			if (!useCache) {
+				if (!LogFileOpen(&logFile, fileName)) {
+					DebugPrintf(L"File Error\n");
+					isRunning = FALSE;
+					ThreadExit(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_FILE_NOT_FOUND));
+				}
 
-		if (PathFileExists((LPCWSTR)fileName)) {
+				if (!CacheCreate(&replayCache, fileName)) {
+					// Non fatal error, the log is parsed on every loop
+					DebugPrintf(L"Replay cache Error: %d\n", PlatformGetLastError());
+				}
+			}
 
-			std::ifstream inputFile(fileName);
+			// Forget the frames of any previous replay, the window has already been checked by SetDuplicateWindow
+			DuplicateInitialise(&duplicateFrames, duplicateWindow);
 
-			// read a line from the log file
-			std::string inputLine;
-			// specific regular expression for yacht devices log format
-			std::regex yachtDevicesRegex("^[0-9]{2}:[0-9]{2}:[0-9]{2}.[0-9]{3}\\sR\\s([0-9A-F]{8})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})[\\s]([0-9A-F]{2})$");
-			std::smatch matchGroups;
+			if (!ReplayInitialise(&replayClock, replaySpeed)) {
+				// Non fatal error, replay falls back to millisecond pacing
+				DebugPrintf(L"Replay timer Error: %d\n", PlatformGetLastError());
+			}
 
+			// read a frame from the cache or a line from the log file
 			while (isRunning)  {
-				std::getline(inputFile, inputLine);
-				if (inputFile.eof()) {
-					// if at the end of the file, restart from the beginning
-					inputFile.clear();
-					inputFile.seekg(0);
-					std::getline(inputFile, inputLine);
-				}
-
-				// BUG BUG Not sure if this trickles up to report the error
-				if (!std::regex_match(inputLine, yachtDevicesRegex)) {
-					DebugPrintf(L"Invalid Log file Format: %s\n", inputLine);
-					badLineCount++;
-					if (badLineCount == CONST_MAX_BAD_LINES) {
-						isRunning = FALSE;
-						inputFile.close();
-						SetEvent(threadFinishedEvent);
-						ExitThread(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_LOGFILE_FORMAT));
+				if (useCache) {
+					if (!CacheRead(&replayCache, &frame)) {
+						// if at the end of the cache, restart from the beginning
+						CacheRewind(&replayCache);
+						continue;
 					}
 				}
-
-				if (std::regex_match(inputLine, matchGroups, yachtDevicesRegex)) {
-					// Copy 4 byte header
-					unsigned long temp = std::strtoul(matchGroups[1].str().c_str(), NULL, 16);
-					memcpy(&canFrame[0], &temp, 4);
-
-					// Copy 8 byte payload
-					// BUG BUG Should really check that there are 8 data bytes
-					canFrame[4] = static_cast<byte>(std::strtoul(matchGroups[2].str().c_str(), NULL, 16));
-					canFrame[5] = static_cast<byte>(std::strtoul(matchGroups[3].str().c_str(), NULL, 16));
-					canFrame[6] = static_cast<byte>(std::strtoul(matchGroups[4].str().c_str(), NULL, 16));
-					canFrame[7] = static_cast<byte>(std::strtoul(matchGroups[5].str().c_str(), NULL, 16));
-					canFrame[8] = static_cast<byte>(std::strtoul(matchGroups[6].str().c_str(), NULL, 16));
-					canFrame[9] = static_cast<byte>(std::strtoul(matchGroups[7].str().c_str(), NULL, 16));
-					canFrame[10] = static_cast<byte>(std::strtoul(matchGroups[8].str().c_str(), NULL, 16));
-					canFrame[11] = static_cast<byte>(std::strtoul(matchGroups[9].str().c_str(), NULL, 16));
-
-					// make sure we can get a lock on the buffer
-					mutexResult = WaitForSingleObject(frameReceivedMutex, 200);
-
-					if (mutexResult == WAIT_OBJECT_0) {
-						// copy the frame to the buffer
-						memcpy(canFramePtr, &canFrame[0], 12);
-
-						// release the lock
-						ReleaseMutex(frameReceivedMutex);
-
-						// Notify the caller
-						if (SetEvent(frameReceivedEvent)) {
-							Sleep(10);
+				else {
+					if (!LogFileReadLine(&logFile, &line, &lineLength)) {
+						// at the end of the file switch to the completed cache, otherwise restart from the beginning
+						if (CacheCommit(&replayCache, fileName)) {
+							LogFileClose(&logFile);
+							useCache = TRUE;
 						}
 						else {
-
-							DebugPrintf(L"Set Event Error: %d\n", GetLastError());
+							LogFileRewind(&logFile);
 						}
+						continue;
 					}
 
-					else {
-						DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, GetLastError());
+					// BUG BUG Not sure if this trickles up to report the error
+					if (ParseYachtDevicesLine(line, lineLength, &frame) != TWOCAN_PARSE_FRAME) {
+						DebugPrintf(L"Invalid Log file Format: %.*S\n", lineLength, line);
+						badLineCount++;
+						if (badLineCount == CONST_MAX_BAD_LINES) {
+							isRunning = FALSE;
+							LogFileClose(&logFile);
+							CacheClose(&replayCache);
+							ReplayClose(&replayClock);
+							EventSet(threadFinishedEvent);
+							ThreadExit(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_INVALID_LOGFILE_FORMAT));
+						}
+						continue;
 					}
 
-				} // end if regex
+					// Cache the frame with its recorded timestamp
+					CacheWrite(&replayCache, &frame);
+				}
+
+				// Wait until the frame is due, based on its recorded timestamp
+				frame.timestamp = ReplayWait(&replayClock, frame.timestamp, &isRunning);
+
+				// Once the log has looped the same frames are replayed again
+				if (!DuplicateCheck(&duplicateFrames, &frame)) {
+					PostFrame(&frame);
+				}
 
 			} // end while isRunning 
 
 			DebugPrintf(L"Closing File\n");
-			inputFile.close();
+			if (!useCache) {
+				LogFileClose(&logFile);
+			}
+			CacheClose(&replayCache);
+			ReplayClose(&replayClock);
 
-			SetEvent(threadFinishedEvent);
-			ExitThread(TWOCAN_RESULT_SUCCESS);
+			EventSet(threadFinishedEvent);
+			ThreadExit(TWOCAN_RESULT_SUCCESS);
 
 		} // end if file "yachtdevices.log" exists
 		else {
-			DebugPrintf(L"LogFile Error: %d (%d)\n", result, GetLastError());
+			DebugPrintf(L"LogFile Error: %d\n", PlatformGetLastError());
 			isRunning = FALSE;
-			ExitThread(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_FILE_NOT_FOUND));
+			ThreadExit(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_FILE_NOT_FOUND));
 		}
 
 	} // end if My Documents folder exists
 	else {
-		DebugPrintf(L"My Documents Path Error: %d (%d)\n", result, GetLastError());
+		DebugPrintf(L"My Documents Path Error: %d\n", PlatformGetLastError());
 		isRunning = FALSE;
-		ExitThread(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_PATH_NOT_FOUND));
+		ThreadExit(SET_ERROR(TWOCAN_RESULT_FATAL, TWOCAN_SOURCE_DRIVER, TWOCAN_ERROR_PATH_NOT_FOUND));
+	}
+
+}
+
+//
+// Hand a received frame to the caller, either by queueing it in the caller's ring buffer
+// or by converting it into the caller's single 12 byte CAN Frame buffer
+// [in] frame, pointer to CAN Frame
+//
+
+void PostFrame(const TwoCanFrame *frame) {
+	int mutexResult;
+
+	if (canRingPtr != NULL) {
+		// Back pressure, a log file can wait, so never discard a frame, just wait for the caller to drain the ring
+		while ((isRunning) && (RingIsFull(canRingPtr))) {
+			EventWait(frameConsumedEvent, 200);
+		}
+
+		// No lock required, the read thread is the only writer
+		if (RingWrite(canRingPtr, frame)) {
+			if (!EventSet(frameReceivedEvent)) {
+				DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+			}
+		}
+		return;
+	}
+
+	// Make sure we can get a lock on the buffer
+	mutexResult = MutexLock(frameReceivedMutex, 200);
+
+	if (mutexResult == TWOCAN_WAIT_SIGNALLED) {
+
+		ConvertFrameToByteArray(frame, canFramePtr);
+
+		// Release the lock
+		MutexUnlock(frameReceivedMutex);
+
+		// Notify the caller
+		if (EventSet(frameReceivedEvent)) {
+			// Wait for the caller to acknowledge the frame before it can be overwritten,
+			// callers that never signal frameConsumedEvent are paced by the timeout
+			EventWait(frameConsumedEvent, 10);
+		}
+		else {
+			DebugPrintf(L"Set Event Error: %d\n", PlatformGetLastError());
+		}
 	}
 
+	else {
+		DebugPrintf(L"Adapter Mutex: %d -->%d\n", mutexResult, PlatformGetLastError());
+	}
 }
 